@@ -33,6 +33,14 @@
 #include "sleep_routines.h"
 #include "si7021.h"
 #include "shtc3.h"
+#include "calibration.h"
+#include "filter.h"
+#include "median.h"
+#include "archive.h"
+#include "sample_log.h"
+#include "health.h"
+#include "hotpath.h"
+#include "rate_group.h"
 
 
 //***********************************************************************************
@@ -41,8 +49,31 @@
 // Application specific LETIMER0 Macros
 #define PWM_PER               3.0         // PWM period in seconds
 #define PWM_ACT_PER           0.25        // PWM active period in seconds
+// Application specific rate group macros, in LETIMER0 periods (PWM_PER)
+#define APP_SHTC3_PERIOD      1           // SHTC3 sample every 3 s
+#define APP_SHTC3_PHASE       0           // only phase of a 1-period group
+#define APP_SI7021_PERIOD     10          // Si7021 sample every 30 s
+#define APP_SI7021_PHASE      5           // ticks 5, 15, 25, ...
+#define APP_MINUTE_PERIOD     20          // ULFRCO measurement every minute
+#define APP_MINUTE_PHASE      1           // ticks 1, 21, 41, ...; clear of the Si7021
+#define APP_HOUR_PERIOD       1200        // Si7021 configuration check every hour
+#define APP_HOUR_PHASE        7           // never on a Si7021 tick, so I2C0 sees one sequence at a time
+// Application specific on-demand sampling macros, in milli-seconds
+#define APP_SAMPLE_FRESH_MS   1000        // a snapshot this young answers app_sample_now() without a sample
+#define APP_SI7021_LATENCY_MS 30          // RH8/T12 conversion (4 ms max) plus 3 transactions, a queued check and retries
+#define APP_SHTC3_LATENCY_MS  15          // wake-up, LPM measurement (1 ms max), 4 transactions and retries
 // Application specific Si7021 macros
 #define RH_LED_ON             30.0        // Relative humidity threshold to assert LED
+#define APP_SI7021_RES        measureResRH8_T12  // Measurement resolution written to, and checked in, User Register 1
+// Application specific filter macros
+#define APP_FILTER_PRESET     filterPresetBiquadLp10  // Default filter on every sensor channel
+#define APP_MEDIAN_WINDOW     5           // Median window ahead of each filter; rejects spikes up to 2 samples long
+#define APP_MEDIAN_BENCH_MIN  5           // Smallest window median_bench() times in BENCH_MEDIAN builds
+#define APP_MEDIAN_BENCH_MAX  MEDIAN_WINDOW_MAX // Largest window it times
+#define APP_MEDIAN_BENCHES    (APP_MEDIAN_BENCH_MAX - APP_MEDIAN_BENCH_MIN + 1) // Window sizes timed
+// Application specific archive macros; LOG_RAW_CODES builds keep no archive, the host has the log
+#define APP_ARCHIVES          2           // Sensor channels kept in the on-node history archive
+#define APP_ARCHIVE_CHANNELS  { calShtc3RH, calShtc3Temp }  // Archived channels (filtered values)
 // Application specific callback macros
 /* LETIMER0 call backs */
 #define LETIMER0_UF_CB        0x80        // 0b0000 1000 0000; callback for LETIMER0 Underflow callback
@@ -51,27 +82,95 @@
 #define SI7021_TEMP_READ_CB   0x20        // 0b0000 0010 0000; callback for temperature read; from previous RH
 #define SI7021_WRITE_REG_CB   0x10        // 0b0000 0001 0000; write to user register callback
 #define SI7021_READ_REG_CB    0x08        // 0b0000 0000 1000; read from user register callback
+#define SI7021_SAMPLE_CB      0x200       // 0b0010 0000 0000; Si7021 rate group released
+#define SI7021_CHECK_REG_CB   0x4000      // 0b0100 0000 0000 0000; hourly user register read callback
+#define SI7021_DEADLINE_CB    0x8000      // 0b1000 0000 0000 0000; on-demand sample deadline
 /* SHTC3 callbacks */
 #define SHTC3_SLEEP_CB        0X04        // 0b0000 0000 0100; sleep callback
 #define SHTC3_WAKEUP_CB       0x02        // 0b0000 0000 0010; wakeup callback
 #define SHTC3_MEASUREMENT_CB  0x01        // 0b0000 0000 0001; transmit measurement callback
 #define SHTC3_READ_REQ_CB     0x800       // 0b1000 0000 0000; read callback
-#define SHTC3_OPEN_CB         0x400       // 0b0100 0000 0000; open callback
+#define SHTC3_SAMPLE_CB       0x400       // 0b0100 0000 0000; SHTC3 rate group released
+#define SHTC3_DEADLINE_CB     0x10000     // 0b0001 0000 0000 0000 0000; on-demand sample deadline
+/* CMU callbacks */
+#define CMU_CAL_CB            0x100       // 0b0001 0000 0000; ULFRCO measurement done callback
+/* Housekeeping callbacks */
+#define APP_MINUTE_CB         0x1000      // 0b0001 0000 0000 0000; minute rate group released
+#define APP_HOUR_CB           0x2000      // 0b0010 0000 0000 0000; hour rate group released
 
 //***********************************************************************************
 // enums
 //***********************************************************************************
+/*! Enumerated sensors, for health tracking */
+typedef enum
+{
+  appSensorSi7021,      /*! Si7021 on I2C0 */
+  appSensorShtc3,       /*! SHTC3 on I2C1 */
+  appSensors            /*! Number of sensors */
+}APP_SENSOR_Typedef;
+
+
+/*! Enumerated rate groups, all released from the LETIMER0 underflow */
+typedef enum
+{
+  appRateShtc3,         /*! SHTC3 sample */
+  appRateSi7021,        /*! Si7021 sample */
+  appRateMinute,        /*! ULFRCO measurement */
+  appRateHour,          /*! Si7021 configuration check */
+  appRates              /*! Number of rate groups */
+}APP_RATE_Typedef;
 
 
 //***********************************************************************************
 // structs
 //***********************************************************************************
+/*! Sampling statistics of one sensor; latencies in milli-seconds from
+ app_sample_now() to the requester's callback being posted. BENCH_CONV
+ builds also count the DWT cycles of each periodic sample's processing,
+ from the snapshot read to the LED update                             */
+typedef struct
+{
+    uint32_t                      requests;               /// app_sample_now() calls
+    uint32_t                      cached;                 /// answered at once from a fresh snapshot
+    uint32_t                      unavailable;            /// answered at once because the sensor has failed
+    uint32_t                      converted;              /// answered by a sample within the deadline
+    uint32_t                      late;                   /// answered at the deadline
+    uint32_t                      latency_last;           /// latency of the last sampled answer
+    uint32_t                      latency_max;            /// worst latency of a sampled answer
+    uint32_t                      periodic;               /// periodic samples processed (BENCH_CONV)
+    uint32_t                      cycles;                 /// total cycles processing them (BENCH_CONV)
+    uint32_t                      cycles_max;             /// worst cycles of one (BENCH_CONV)
+}APP_SAMPLE_STATS_STRUCT;
+
+
+/*! A sensor's sample chain and the on-demand requests waiting on it */
+typedef struct
+{
+    uint32_t                      cb;                     /// requesters' scheduler events (0 = none waiting)
+    uint32_t                      start;                  /// letimer_uptime() of the oldest waiting request
+    bool                          busy;                   /// a sample chain (or the Si7021 check) holds the sensor
+    bool                          periodic;               /// the sample in flight is filtered and logged
+    APP_SAMPLE_STATS_STRUCT       stats;                  /// on-demand statistics
+}APP_SAMPLE_STRUCT;
 
 
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
 void app_peripheral_setup(void);
+void app_filter_select(CAL_CHANNEL_Typedef channel, const FILTER_COEF_STRUCT *coef);
+#ifndef LOG_RAW_CODES
+uint32_t app_history(CAL_CHANNEL_Typedef channel, uint32_t from, uint32_t to,
+                     ARCHIVE_BUCKET_STRUCT *out, uint32_t max, uint32_t *start, uint32_t *step);
+#endif
+HEALTH_STATE_Typedef app_sensor_health(APP_SENSOR_Typedef sensor);
+void app_sensor_snapshot(APP_SENSOR_Typedef sensor, SNAPSHOT_STRUCT *snap);
+float app_sensor_rh(APP_SENSOR_Typedef sensor, const SNAPSHOT_STRUCT *snap);
+float app_sensor_temp(APP_SENSOR_Typedef sensor, const SNAPSHOT_STRUCT *snap);
+void app_sample_now(APP_SENSOR_Typedef sensor, uint32_t cb);
+void app_sample_stats(APP_SENSOR_Typedef sensor, APP_SAMPLE_STATS_STRUCT *stats);
+void app_rate_set(APP_RATE_Typedef rate, uint32_t period, uint32_t phase);
+void app_rate_enable(APP_RATE_Typedef rate, bool enable);
 /* LETIMER0 callback functions */
 void scheduled_letimer0_uf_cb(void);
 /* SI7021 callback functions */
@@ -79,10 +178,20 @@ void scheduled_si7021_hum_read_cb(void);
 void scheduled_si7021_temp_read_cb(void);
 void scheduled_si7021_write_reg_cb(void);
 void scheduled_si7021_read_reg_cb(void);
+void scheduled_si7021_sample_cb(void);
+void scheduled_si7021_check_reg_cb(void);
+void scheduled_si7021_deadline_cb(void);
 /* SHTC3 callback functions */
 void scheduled_shtc3_sleep_cb(void);
 void scheduled_shtc3_wakeup_cb(void);
 void scheduled_shtc3_measurement_cb(void);
 void scheduled_shtc3_read_req_cb(void);
+void scheduled_shtc3_sample_cb(void);
+void scheduled_shtc3_deadline_cb(void);
+/* CMU callback functions */
+void scheduled_cmu_cal_cb(void);
+/* Housekeeping callback functions */
+void scheduled_app_minute_cb(void);
+void scheduled_app_hour_cb(void);
 
 #endif
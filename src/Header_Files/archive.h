@@ -0,0 +1,96 @@
+/***************************************************************************//**
+ * @file
+ *   archive.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Header file for the multi-resolution round-robin history archive
+ ******************************************************************************/
+
+#ifndef ARCHIVE_HG
+#define ARCHIVE_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Silicon Labs included files
+#include "em_assert.h"
+
+// developer included files
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* Levels, finest first */
+#define ARCHIVE_LEVELS        2                 // number of consolidation levels
+#define ARCHIVE_L0_STEP       60                // level 0 bucket width: 1 minute (in seconds)
+#define ARCHIVE_L0_ROWS       1440              // level 0 retention: 1 day
+#define ARCHIVE_L1_STEP       3600              // level 1 bucket width: 1 hour (in seconds)
+#define ARCHIVE_L1_ROWS       720               // level 1 retention: 30 days
+#define ARCHIVE_ROWS          (ARCHIVE_L0_ROWS + ARCHIVE_L1_ROWS) // buckets per archive, all levels
+/* Buckets */
+#define ARCHIVE_EMPTY         INT16_MIN         // avg/min/max of a bucket that received no samples
+#define ARCHIVE_AUTO_LEVEL    0xFF              // archive_query(): pick the finest level that covers the range
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! One consolidated bucket, in the units of the archived samples */
+typedef struct
+{
+    int16_t                       avg;                    /// mean of the samples in the bucket
+    int16_t                       min;                    /// smallest sample in the bucket
+    int16_t                       max;                    /// largest sample in the bucket
+}ARCHIVE_BUCKET_STRUCT;
+
+
+/*! One consolidation level: a ring of closed buckets plus the bucket being filled */
+typedef struct
+{
+    uint32_t                      step;                   /// bucket width (in seconds)
+    uint16_t                      rows;                   /// ring length
+    uint16_t                      base;                   /// first ring row in ARCHIVE_STRUCT.bucket[]
+    uint16_t                      head;                   /// ring row of the newest closed bucket
+    uint16_t                      filled;                 /// closed buckets held (<= rows)
+    uint32_t                      open_start;             /// start time of the bucket being filled
+    int32_t                       sum;                    /// open bucket: sum of samples
+    int16_t                       min;                    /// open bucket: smallest sample
+    int16_t                       max;                    /// open bucket: largest sample
+    uint16_t                      n;                      /// open bucket: number of samples
+}ARCHIVE_LEVEL_STRUCT;
+
+
+/*! Archive of one quantity; statically allocated by the owner */
+typedef struct
+{
+    ARCHIVE_LEVEL_STRUCT          level[ARCHIVE_LEVELS];  /// consolidation levels, finest first
+    ARCHIVE_BUCKET_STRUCT         bucket[ARCHIVE_ROWS];   /// ring storage for every level
+    bool                          started;                /// False until the first sample
+}ARCHIVE_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void archive_open(ARCHIVE_STRUCT *archive);
+void archive_add(ARCHIVE_STRUCT *archive, uint32_t now, int16_t sample);
+uint8_t archive_pick_level(const ARCHIVE_STRUCT *archive, uint32_t from);
+uint32_t archive_query(const ARCHIVE_STRUCT *archive, uint8_t level, uint32_t from, uint32_t to,
+                       ARCHIVE_BUCKET_STRUCT *out, uint32_t max, uint32_t *start, uint32_t *step);
+
+#endif
@@ -0,0 +1,99 @@
+/***************************************************************************//**
+ * @file
+ *   bench.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Cycle counting for on-target benchmarks (DWT cycle counter)
+ ******************************************************************************/
+
+#ifndef BENCH_HG
+#define BENCH_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Silicon Labs included files
+#include "em_device.h"
+#include "em_msc.h"
+
+// developer included files
+#include "irq_prio.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* DWT cycle counter; counts HFCLK cycles while the core is running */
+#define BENCH_OPEN()          do { CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+                                   DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; } while(0)  // enable the cycle counter
+#ifndef BENCH_CYCLES
+#define BENCH_CYCLES()        (DWT->CYCCNT)                                         // current cycle count (wraps)
+#endif
+
+/* ISR benchmark; build with BENCH_ISR, compiled out otherwise */
+#ifdef BENCH_ISR
+#define BENCH_ISR_ENTER(isr)  uint32_t bench_isr_start = bench_isr_enter(isr)      // first statement of a handler
+#define BENCH_ISR_EXIT(isr)   bench_isr_exit((isr), bench_isr_start)               // before every return of a handler
+#define BENCH_SLEEP()         bench_sleep()                                         // just before the core sleeps
+#else
+#define BENCH_ISR_ENTER(isr)  do {} while(0)
+#define BENCH_ISR_EXIT(isr)   do {} while(0)
+#define BENCH_SLEEP()         do {} while(0)
+#endif
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+/*! Interrupt handlers timed by the ISR benchmark */
+typedef enum
+{
+  benchIsrI2c0,         /*! I2C0_IRQHandler */
+  benchIsrI2c1,         /*! I2C1_IRQHandler */
+  benchIsrTimer1,       /*! TIMER1_IRQHandler: I2C backoff */
+  benchIsrLetimer0,     /*! LETIMER0_IRQHandler: sample period */
+  benchIsrCmu,          /*! CMU_IRQHandler: ULFRCO calibration */
+  benchIsrs             /*! Number of handlers */
+}BENCH_ISR_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! Cycle counts of one interrupt handler. A handler's cycles include any
+ handler that pre-empted it. The wake-up latency is the cycles the core ran
+ between the last instruction before sleep and the handler's first: the
+ counter stops while the core sleeps, so it is exception entry plus the
+ fetches of the wake-up, not the time asleep                             */
+typedef struct
+{
+    uint32_t                      count;                  /// handler runs
+    uint32_t                      cycles;                 /// total cycles in the handler
+    uint32_t                      max;                    /// longest run
+    uint32_t                      wakes;                  /// runs that woke the core
+    uint32_t                      wake_cycles;            /// total wake-up latency
+    uint32_t                      wake_max;               /// longest wake-up latency
+}BENCH_ISR_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void bench_isr_open(void);
+uint32_t bench_isr_enter(BENCH_ISR_Typedef isr);
+void bench_isr_exit(BENCH_ISR_Typedef isr, uint32_t start);
+void bench_sleep(void);
+void bench_isr_get(BENCH_ISR_Typedef isr, BENCH_ISR_STRUCT *stats);
+void bench_cache_get(uint32_t *hits, uint32_t *misses);
+
+
+#endif
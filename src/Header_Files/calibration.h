@@ -0,0 +1,104 @@
+/***************************************************************************//**
+ * @file
+ *   calibration.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Header file for per-sensor calibration records
+ ******************************************************************************/
+
+#ifndef CALIBRATION_HG
+#define CALIBRATION_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+// Silicon Labs included files
+#include "em_msc.h"
+#include "em_core.h"
+#include "em_assert.h"
+
+// developer included files
+#include "irq_prio.h"
+#include "convert.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* Persistent storage */
+#define CAL_FLASH_ADDR        USERDATA_BASE     // records live in the user data page; survives mass erase of main flash
+#define CAL_MAGIC             0x43414C31        // "CAL1": marks a valid block of records
+#define CAL_ERASED            0xFFFFFFFF        // erased flash word
+/* Fixed point formats (convert.h, which applies the records) */
+#define CAL_Q                 CONV_CAL_Q            // coefficients and gains are Q16
+#define CAL_ONE               CONV_CAL_ONE          // 1.0 in Q16
+#define CAL_POLY_SCALE        CONV_CAL_POLY_SCALE   // polynomial input is value / 100.00 units (centi-units)
+#define CAL_MAX_ORDER         CONV_CAL_MAX_ORDER    // highest polynomial order supported
+/* Engineering units */
+#define CAL_CENTI             100               // converted values are carried in centi-units (0.01 %RH, 0.01 C)
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+/*! Enumerated calibrated channels, one per sensor and quantity */
+typedef enum
+{
+  calSi7021RH,        /*! Si7021 relative humidity */
+  calSi7021Temp,      /*! Si7021 temperature */
+  calShtc3RH,         /*! SHTC3 relative humidity */
+  calShtc3Temp,       /*! SHTC3 temperature */
+  calChannels         /*! Number of calibrated channels */
+}CAL_CHANNEL_Typedef;
+
+
+/*! Enumerated correction modes */
+typedef enum
+{
+  calModeNone = CONV_CAL_NONE,      /*! Datasheet formula only */
+  calModeLinear = CONV_CAL_LINEAR,  /*! y = gain * x + offset (2-point fit) */
+  calModePoly = CONV_CAL_POLY       /*! y = c0 + c1*u + c2*u^2 + c3*u^3 with u = x / CAL_POLY_SCALE */
+}CAL_MODE_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! Calibration record for one channel (mode is a CAL_MODE_Typedef) */
+typedef CONV_CAL_STRUCT CAL_RECORD_STRUCT;
+
+
+/*! Block of records as stored in flash */
+typedef struct
+{
+    uint32_t                      magic;                  /// CAL_MAGIC when valid
+    CAL_RECORD_STRUCT             record[calChannels];    /// one record per channel
+    uint32_t                      check;                  /// complement of the word sum of everything above
+}CAL_BLOCK_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void cal_open(void);
+int32_t cal_apply(CAL_CHANNEL_Typedef channel, int32_t value);
+void cal_set_linear(CAL_CHANNEL_Typedef channel, int32_t gain, int32_t offset);
+void cal_set_2point(CAL_CHANNEL_Typedef channel, int32_t raw_lo, int32_t ref_lo,
+                    int32_t raw_hi, int32_t ref_hi);
+void cal_set_poly(CAL_CHANNEL_Typedef channel, uint32_t order, const int32_t *coef);
+void cal_clear(CAL_CHANNEL_Typedef channel);
+bool cal_store(void);
+void cal_get(CAL_CHANNEL_Typedef channel, CAL_RECORD_STRUCT *record);
+uint32_t cal_changes_get(void);
+
+#endif
@@ -17,19 +17,30 @@
 // included files
 //***********************************************************************************
 // system included files
-
+#include <stdint.h>
+#include <stdbool.h>
 
 // Silicon Labs included files
 #include "em_cmu.h"
+#include "em_prs.h"
 #include "em_assert.h"
 
 
 // developer included files
+#include "irq_prio.h"
+#include "scheduler.h"
+#include "sleep_routines.h"
+#include "bench.h"
 
 
 //***********************************************************************************
 // defined macros
 //***********************************************************************************
+/* ULFRCO calibration */
+#define CMU_ULFRCO_HZ         1000              // ULFRCO nominal frequency
+#define CMU_ULFRCO_CAL_CYCLES 16                // ULFRCO cycles per measurement; HFRCO count stays below CALCNT max up to 64 MHz
+#define CMU_ULFRCO_CAL_PRS_CH 0                 // PRS channel carrying the ULFRCO (CLKOUT0) to the down counter
+#define CMU_ULFRCO_CAL_EM     EM2               // HFRCO must keep running while counting; cannot go below EM1
 
 
 //***********************************************************************************
@@ -46,6 +57,8 @@
 // function prototypes
 //***********************************************************************************
 void cmu_open(void);
+void cmu_ulfrco_cal_start(uint32_t cb);
+uint32_t cmu_ulfrco_mhz(void);
 
 
 #endif
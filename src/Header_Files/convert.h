@@ -0,0 +1,99 @@
+/***************************************************************************//**
+ * @file
+ *   convert.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Header file for batch conversion of buffered raw measurement codes
+ ******************************************************************************/
+
+#ifndef CONVERT_HG
+#define CONVERT_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+
+// Silicon Labs included files
+// (none: the reference path builds on a host for bit-exact comparison)
+
+// developer included files
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* Raw measurement codes */
+#define CONV_CODE_BITS        16                // codes are full-scale 16-bit: y = (gain * code >> 16) - offset
+#define CONV_CODES            (1u << CONV_CODE_BITS) // number of distinct raw codes
+#define CONV_SIGN_FLIP        0x80008000u       // maps two unsigned codes to signed (code - 32768) for the DSP multiplies
+#define CONV_LANE_SHIFT       16                // upper halfword of a packed pair
+/* Calibration (records kept by calibration.c, stored in this layout) */
+#define CONV_CAL_NONE         0                 // datasheet formula only
+#define CONV_CAL_LINEAR       1                 // y = gain * x + offset (2-point fit)
+#define CONV_CAL_POLY         2                 // y = c0 + c1*u + c2*u^2 + c3*u^3 with u = x / CONV_CAL_POLY_SCALE
+#define CONV_CAL_Q            16                // coefficients and gains are Q16
+#define CONV_CAL_ONE          (1 << CONV_CAL_Q) // 1.0 in Q16
+#define CONV_CAL_POLY_SCALE   10000             // polynomial input is value / 100.00 units (centi-units)
+#define CONV_CAL_POLY_RECIP   429497            // 2^32 / CONV_CAL_POLY_SCALE, to normalise without a divide
+#define CONV_CAL_MAX_ORDER    3                 // highest polynomial order supported
+/* Benchmark */
+#define CONV_BENCH_SAMPLES    256               // samples per benchmark run (even, so the kernel never takes its tail path)
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! Linear conversion of a raw code to centi-units, as given in the sensor
+ datasheet: y = ((gain * code) >> 16) - offset                          */
+typedef struct
+{
+    uint32_t                      gain;                   /// full-scale span in centi-units (<= 32767)
+    int32_t                       offset;                 /// value of code 0, negated, in centi-units
+}CONV_COEF_STRUCT;
+
+
+/*! Calibration of one channel, applied to the datasheet conversion. All
+ values in centi-units                                                  */
+typedef struct
+{
+    uint32_t                      mode;                   /// CONV_CAL_NONE, CONV_CAL_LINEAR or CONV_CAL_POLY
+    int32_t                       gain;                   /// linear: Q16 gain
+    int32_t                       offset;                 /// linear: offset (centi-units)
+    uint32_t                      order;                  /// poly: polynomial order (<= CONV_CAL_MAX_ORDER)
+    int32_t                       coef[CONV_CAL_MAX_ORDER + 1];/// poly: Q16 coefficients (centi-units), c0 first
+}CONV_CAL_STRUCT;
+
+
+/*! Benchmark result, DWT cycle counts for CONV_BENCH_SAMPLES samples */
+typedef struct
+{
+    uint32_t                      samples;                /// samples converted per run
+    uint32_t                      batch_cycles;           /// cycles taken by conv_batch()
+    uint32_t                      ref_cycles;             /// cycles taken by conv_batch_ref()
+    uint32_t                      codes;                  /// codes compared (every code once)
+    bool                          match;                  /// True = both paths produced identical output for every code
+}CONV_BENCH_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+int16_t conv_sample(const CONV_COEF_STRUCT *coef, uint16_t code);
+void conv_batch(const CONV_COEF_STRUCT *coef, const uint16_t *code, int16_t *out, uint32_t n);
+int32_t conv_calibrate(const CONV_CAL_STRUCT *cal, int32_t value);
+void conv_batch_ref(const CONV_COEF_STRUCT *coef, const uint16_t *code, int16_t *out, uint32_t n);
+void conv_bench(const CONV_COEF_STRUCT *coef, CONV_BENCH_STRUCT *result);
+
+#endif
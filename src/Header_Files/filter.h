@@ -0,0 +1,101 @@
+/***************************************************************************//**
+ * @file
+ *   filter.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Header file for the per-channel FIR/IIR sensor filter stage
+ ******************************************************************************/
+
+#ifndef FILTER_HG
+#define FILTER_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Silicon Labs included files
+#include "em_assert.h"
+
+// developer included files
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* Fixed point format */
+#define FILTER_Q              14                // coefficients are Q14 (16384 is 1.0)
+#define FILTER_ONE            (1 << FILTER_Q)   // 1.0 in Q14
+/* FIR */
+#define FILTER_FIR_TAPS_MAX   8                 // longest FIR, and the size of the circular history buffer
+/* Biquad */
+#define FILTER_BIQUAD_COEFS   5                 // b0, b1, b2, a1, a2
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+/*! Enumerated filter structures */
+typedef enum
+{
+  filterTypeNone,       /*! Pass samples through unchanged */
+  filterTypeFir,        /*! Direct form FIR over a circular history buffer */
+  filterTypeBiquad      /*! Direct form I biquad with error feedback */
+}FILTER_TYPE_Typedef;
+
+
+/*! Enumerated built-in coefficient sets; fs is the sample rate of the channel */
+typedef enum
+{
+  filterPresetNone,         /*! No filtering */
+  filterPresetFir5Binomial, /*! 5-tap binomial low-pass, 2 sample delay */
+  filterPresetFir8Average,  /*! 8-tap moving average, 3.5 sample delay */
+  filterPresetBiquadLp10,   /*! 2nd order Butterworth low-pass, fc = fs/10 */
+  filterPresetBiquadLp20,   /*! 2nd order Butterworth low-pass, fc = fs/20 */
+  filterPresetBiquadLp50,   /*! 2nd order Butterworth low-pass, fc = fs/50 */
+  filterPresets             /*! Number of presets */
+}FILTER_PRESET_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! Filter coefficients. FIR: taps coefficients, which should sum to
+ FILTER_ONE for unity gain. Biquad: b0, b1, b2, a1, a2 with a0 = 1      */
+typedef struct
+{
+    FILTER_TYPE_Typedef           type;                   /// filter structure
+    uint8_t                       taps;                   /// FIR length (<= FILTER_FIR_TAPS_MAX)
+    int16_t                       coef[FILTER_FIR_TAPS_MAX]; /// Q14 coefficients
+}FILTER_COEF_STRUCT;
+
+
+/*! Filter instance, one per sensor channel */
+typedef struct
+{
+    const FILTER_COEF_STRUCT     *coef;                   /// selected coefficients
+    bool                          primed;                 /// False until the first sample seeds the state
+    int32_t                       x[FILTER_FIR_TAPS_MAX]; /// FIR: circular input history; biquad: x[0..1] inputs
+    uint8_t                       head;                   /// FIR: index of the newest input
+    int32_t                       y[2];                   /// biquad: previous two outputs
+    int32_t                       err;                    /// biquad: truncation remainder fed back into the next output
+    int32_t                       out;                    /// latest output
+}FILTER_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+const FILTER_COEF_STRUCT *filter_preset(FILTER_PRESET_Typedef preset);
+void filter_select(FILTER_STRUCT *filter, const FILTER_COEF_STRUCT *coef);
+int32_t filter_step(FILTER_STRUCT *filter, int32_t sample);
+int32_t filter_output(const FILTER_STRUCT *filter);
+
+#endif
@@ -0,0 +1,83 @@
+/***************************************************************************//**
+ * @file
+ *   health.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Header file for per-sensor health tracking
+ ******************************************************************************/
+
+#ifndef HEALTH_HG
+#define HEALTH_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Silicon Labs included files
+#include "em_assert.h"
+
+// developer included files
+#include "trace.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* State changes */
+#define HEALTH_FAIL_MISSES    3                 // consecutive missed samples before a sensor is failed
+/* Probe backoff, in sample cycles */
+#define HEALTH_BACKOFF_MIN    1                 // first probe: the cycle after the sensor failed
+#define HEALTH_BACKOFF_MAX    32                // probe interval cap; a returning sensor is seen within this
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+/*! Enumerated sensor health states */
+typedef enum
+{
+  healthHealthy,        /*! Answering; sampled every cycle */
+  healthDegraded,       /*! Missed recent samples; still sampled every cycle */
+  healthFailed,         /*! Not answering; skipped until its next probe */
+  healthProbing,        /*! One sample in flight to see whether it is back */
+  healthStates          /*! Number of states */
+}HEALTH_STATE_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! Health of one sensor, driven by the outcome of each sample cycle. A failed
+ sensor is probed with binary exponential backoff, HEALTH_BACKOFF_MIN to
+ HEALTH_BACKOFF_MAX cycles apart, so a missing part costs one probe per
+ backoff instead of a NACK storm every cycle                             */
+typedef struct
+{
+    uint8_t                       id;                     /// sensor id, logged with every state change
+    HEALTH_STATE_Typedef          state;                  /// current state
+    uint8_t                       misses;                 /// consecutive missed samples
+    uint16_t                      backoff;                /// cycles between probes while failed
+    uint16_t                      wait;                   /// cycles left until the next probe
+    uint32_t                      failures;               /// times the sensor went failed
+    uint32_t                      probes;                 /// probes issued while failed
+    uint32_t                      skipped;                /// cycles skipped while failed
+}HEALTH_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void health_open(HEALTH_STRUCT *health, uint8_t id);
+bool health_sample_due(HEALTH_STRUCT *health);
+void health_report(HEALTH_STRUCT *health, bool ok);
+HEALTH_STATE_Typedef health_state(const HEALTH_STRUCT *health);
+
+#endif
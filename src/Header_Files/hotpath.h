@@ -0,0 +1,66 @@
+/***************************************************************************//**
+ * @file
+ *   hotpath.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Placement of the interrupt hot paths and flash cache setup
+ ******************************************************************************/
+
+#ifndef HOTPATH_HG
+#define HOTPATH_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+
+// Silicon Labs included files
+#include "em_device.h"
+#include "em_msc.h"
+#include "em_ramfunc.h"
+
+// developer included files
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* Hot path placement. Every wake-up runs the IRQ handlers, the I2C state
+ machine and the scheduler post; from RAM they fetch with no flash wait
+ states and leave the cache to the flash code they call. emlib places RAM
+ functions in .ram, which the stock linker script copies in with .data.
+ Build with HOTPATH_IN_FLASH to leave them in flash (the "before" of the
+ BENCH_ISR benchmark)                                                    */
+#ifndef HOTPATH_IN_FLASH
+#define HOTPATH_DECLARATOR        SL_RAMFUNC_DECLARATOR         // on a prototype
+#define HOTPATH_DEFINITION_BEGIN  SL_RAMFUNC_DEFINITION_BEGIN   // ahead of a definition
+#define HOTPATH_DEFINITION_END    SL_RAMFUNC_DEFINITION_END     // after a definition
+#else
+#define HOTPATH_DECLARATOR
+#define HOTPATH_DEFINITION_BEGIN
+#define HOTPATH_DEFINITION_END
+#endif
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void hotpath_open(void);
+
+
+#endif
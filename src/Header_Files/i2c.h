@@ -21,6 +21,7 @@
 
 // Silicon Labs included files
 #include "em_i2c.h"
+#include "em_timer.h"
 #include "em_assert.h"
 
 // developer included files
@@ -29,6 +30,9 @@
 //#include "si7021.h"
 #include "app.h"
 #include "HW_delay.h"
+#include "trace.h"
+#include "hotpath.h"
+#include "bench.h"
 
 
 //***********************************************************************************
@@ -51,10 +55,37 @@
 #define SHIFT_MSBYTE          8                           // Left shift a byte in data register to accept another byte as LSB
 /* I2C Energy Modes */
 #define I2C_EM_BLOCK          EM2                         // I2C Cannot go below EM2
-/* I2C Timer Delays */
-#define I2C_80MS_DELAY        80                          // 80ms Delay for user with Timer delay to avoid RWM sync issues
 /* I2C Interrupt masks [IEN] */
-#define I2C_IEN_MASK          0x1E0                       // Enable ACK, NACK, RXDATAV and MSTOP interrupt flags
+#define I2C_IEN_MASK          0x7E0                       // Enable ACK, NACK, RXDATAV, MSTOP, ARBLOST and BUSERR interrupt flags
+#define I2C_IF_BUS_FAULT      (I2C_IF_ARBLOST | I2C_IF_BUSERR) // Faults that abort the transaction and force a retry
+/* I2C bus idle timeout [CTRL] */
+#define I2C_BUS_IDLE_TIMEOUT  (I2C_CTRL_BITO_160PCC | I2C_CTRL_GIBITO) // Assume bus idle after 160 clock periods of inactivity (TRM 16.3.12.1)
+/* I2C arbitration loss backoff */
+#define I2C_BACKOFF_TIMER     TIMER1                      // Timer used to delay a retry after arbitration loss / bus error, and to bound sync waits
+#define I2C_BACKOFF_CLK       cmuClock_TIMER1             // CMU clock for the backoff timer
+#define I2C_BACKOFF_IRQn      TIMER1_IRQn                 // NVIC IRQ for the backoff timer
+#define I2C_BACKOFF_PRESCALE  timerPrescale64             // Backoff timer prescaler
+#define I2C_BACKOFF_DIV       64                          // Backoff timer prescaler divisor (matches I2C_BACKOFF_PRESCALE)
+#define I2C_BACKOFF_TOP       0xFFFF                      // Backoff timer is 16-bit and free running
+#define I2C_BACKOFF_SLOT_US   100                         // One backoff slot: roughly one 4-byte frame at 400kHz (in micro-seconds)
+#define I2C_BACKOFF_MAX_EXP   6                           // Cap the contention window at 2^6 slots
+#define I2C0_BACKOFF_CC       0                           // Backoff timer compare channel for I2C0
+#define I2C1_BACKOFF_CC       1                           // Backoff timer compare channel for I2C1
+#define I2C_BACKOFF_CCS       3                           // Backoff timer compare channels in use (I2C0, I2C1, sync)
+/* I2C synchronous transfers */
+#define I2C_SYNC_CC           2                           // Backoff timer compare channel that wakes a sync caller
+#define I2C_SYNC_CC_NONE      0xFF                        // No compare channel
+#define I2C_SYNC_POLL_MS      50                          // Longest single EM1 sleep while waiting (fits the 16-bit timer)
+#define I2C_NO_CB             0x00                        // No scheduler callback on completion
+/* I2C transaction queue */
+#define I2C_QUEUE_DEPTH       4                           // Pending transactions per priority class, per bus; one per driver is in flight (asserted)
+/* I2C bus ownership */
+#define I2C_NO_TOKEN          0x00                        // Transaction belongs to no sequence
+#define I2C_CLAIM_DEPTH       4                           // Sequences that may own or wait for a bus, per bus; one per driver (asserted)
+/* I2C unanswered transactions */
+#define I2C_NACK_LIMIT        3                           // Address/command NACKs before the device is given up on
+#define I2C_POLL_TIMEOUT_MS   500                         // Longest a read header may be NACKed while the device converts
+#define I2C_NACK_RETRY_US     1000                        // Gap before a NACKed packet is re-sent, timed on the backoff timer
 /* Number of bytes requested [bytes_req] */
 #define I2C_BYTES_REQ_READ_2  2
 #define I2C_BYTES_REQ_READ_3  3
@@ -81,6 +112,24 @@ typedef enum
   mStop,           /*! STOP bit sent */
 }I2C_STATES_Typedef;
 
+
+/*! Enumerated transaction priority classes; lower value is started first */
+typedef enum
+{
+  i2cPrioUrgent,        /*! Time-critical measurement traffic; may split a held sequence at a safe point */
+  i2cPrioNormal,        /*! Device power management (wakeup, sleep, reset) */
+  i2cPrioHousekeeping,  /*! ID, firmware revision and register checks */
+  i2cPrioClasses        /*! Number of priority classes */
+}I2C_PRIO_Typedef;
+
+
+/*! Enumerated transaction outcomes, written at MSTOP */
+typedef enum
+{
+  i2cResultOk,          /*! The device answered the whole transaction */
+  i2cResultNoAck,       /*! The device stopped answering; the transaction was abandoned with a STOP */
+}I2C_RESULT_Typedef;
+
 //***********************************************************************************
 // structs
 //***********************************************************************************
@@ -118,15 +167,94 @@ typedef struct
     uint8_t                       bytes_tx;               /// number of bytes to transmit
     uint32_t                      num_bytes;              /// number of bytes remaining
     uint32_t                      i2c_cb;                 /// I2C call back event to request upon completion of I2C operation
-    bool                          lock_sm;                /// True = lock the state machine for addition commands; False = unlock; all commands sent
+    uint32_t                      token;                  /// sequence the transaction belongs to (I2C_NO_TOKEN if none)
+    I2C_RW_Typedef                req_rw;                 /// read/write bit of the initial request packet
+    I2C_STATES_Typedef            start_state;            /// state the transaction started in; restored on retry
+    uint32_t                      start_tx_cmd;           /// command the transaction started with; restored on retry
+    uint8_t                       start_bytes_tx;         /// bytes to transmit at start; restored on retry
+    uint32_t                      start_num_bytes;        /// bytes remaining at start; restored on retry
+    uint8_t                       retries;                /// number of arbitration loss / bus error retries of the current transaction
+    uint8_t                       nacks;                  /// address/command NACKs of the current transaction
+    bool                          nack_retry;             /// True = the armed backoff channel re-sends a NACKed packet, not the whole transaction
+    uint32_t                      start_time;             /// LETIMER uptime when the transaction was last (re)started
+    bool                          abandoned;              /// True once the device stopped answering; completes with a STOP
+    I2C_PRIO_Typedef              prio;                   /// priority class used when the bus is busy
+    bool                          split_ok;               /// True = the owning sequence may be split after this transaction for urgent traffic
+    uint32_t                      submit_time;            /// LETIMER uptime when the transaction was submitted
+    volatile bool                *done;                   /// completion flag set at MSTOP (NULL if none)
+    volatile I2C_RESULT_Typedef  *result;                 /// outcome written at MSTOP (NULL if none)
 }I2C_SM_STRUCT;
 
 
+/*! A sequence's claim on a bus, from i2c_acquire() until its token is
+ released and its last transaction has completed                        */
+typedef struct
+{
+    uint32_t                      token;                  /// token handed out by i2c_acquire()
+    uint8_t                       pending;                /// transactions submitted with the token and not yet completed
+    bool                          released;               /// True = i2c_release() called; the claim ends with its last transaction
+}I2C_CLAIM_STRUCT;
+
+
+/*! Transactions waiting for a bus, one FIFO per priority class, and the
+ sequences claiming it in FIFO order; the oldest claim owns the bus.
+ Instantiated as a pair of private data members (one for I2C0 and one
+ for I2C1)                                                              */
+typedef struct
+{
+    I2C_SM_STRUCT                 pending[i2cPrioClasses][I2C_QUEUE_DEPTH]; /// queued transactions, oldest first
+    uint8_t                       count[i2cPrioClasses];  /// number of queued transactions per class
+    I2C_CLAIM_STRUCT              claim[I2C_CLAIM_DEPTH]; /// claims, oldest first; claim[0] owns the bus
+    uint8_t                       claims;                 /// number of claims (0: nobody owns the bus)
+    uint32_t                      next_token;             /// last token handed out
+    bool                          hold_split;             /// True = the owning sequence may be split for urgent traffic
+}I2C_QUEUE_STRUCT;
+
+
+/*! Register context of an I2C peripheral, cached by i2c_suspend() and
+ written back by i2c_resume(). Instantiated as a pair of private data
+ members (one for I2C0 and one for I2C1)                                */
+typedef struct
+{
+    uint32_t                      ctrl;                   /// CTRL as i2c_open() left it, EN included
+    uint32_t                      clkdiv;                 /// CLKDIV: bus frequency
+    uint32_t                      routeloc0;              /// ROUTELOC0: SDA/SCL locations
+    uint32_t                      routepen;               /// ROUTEPEN: SDA/SCL pin enables
+    bool                          suspended;              /// True = disabled and clock gated; resume before use
+}I2C_CONTEXT_STRUCT;
+
+
+/*! Register context of the backoff timer, cached while its clock is gated */
+typedef struct
+{
+    uint32_t                      ctrl;                   /// CTRL: prescaler and mode
+    uint32_t                      top;                    /// TOP
+    uint32_t                      cc_ctrl[I2C_BACKOFF_CCS];/// CC[n].CTRL: compare mode of each channel
+    bool                          saved;                  /// True = the context holds a configuration to restore
+}I2C_TIMER_CONTEXT_STRUCT;
+
+
+/*! Per priority class latency statistics, submit to START, in LETIMER ticks */
+typedef struct
+{
+    uint32_t                      started;                /// transactions started
+    uint32_t                      total_wait;             /// sum of queueing delays
+    uint32_t                      max_wait;               /// worst queueing delay
+    uint32_t                      jumped;                 /// times started ahead of an older lower priority transaction
+}I2C_PRIO_STATS_STRUCT;
+
+
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
 void i2c_open(I2C_TypeDef *i2c, I2C_OPEN_STRUCT *app_i2c_struct);
 void i2c_init_sm(volatile I2C_SM_STRUCT *i2c_sm);
+bool i2c_transfer_sync(volatile I2C_SM_STRUCT *i2c_sm, uint32_t timeout_ms);
 void i2c_tx_req(volatile I2C_SM_STRUCT *i2c_sm, I2C_RW_Typedef rw);
+uint32_t i2c_acquire(I2C_TypeDef *i2c);
+void i2c_release(I2C_TypeDef *i2c, uint32_t token);
+void i2c_suspend(I2C_TypeDef *i2c);
+void i2c_resume(I2C_TypeDef *i2c);
+void i2c_get_prio_stats(I2C_PRIO_Typedef prio, I2C_PRIO_STATS_STRUCT *stats);
 
 #endif
@@ -0,0 +1,61 @@
+/***************************************************************************//**
+ * @file
+ *   irq_prio.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   NVIC priority tiers and tiered (BASEPRI) critical sections
+ *
+ * @details
+ *   Each interrupt gets its own tier, most urgent first. A critical section
+ *   masks only the tiers whose handlers touch the data it guards, so an
+ *   interrupt above that tier still runs:
+ *
+ *   - IRQ_PRIO_I2C: the bus state machines, the transaction queues, and
+ *     everything the I2C handlers call into (scheduler, sleep blocks,
+ *     trace ring, sensor read buffers)
+ *   - IRQ_PRIO_BACKOFF: backoff retries; the handler masks the I2C tier
+ *     while it restarts a bus
+ *   - IRQ_PRIO_LETIMER: the uptime counter; also the tier for data only
+ *     scheduler callbacks share, the lowest interrupt that can run one
+ *
+ *   Tier 0 is left free. BASEPRI does not mask faults, and a masked
+ *   interrupt does not wake WFI, so a wait loop that sleeps with
+ *   interrupts masked keeps using CORE_ENTER_CRITICAL().
+ ******************************************************************************/
+
+#ifndef IRQ_PRIO_HG
+#define IRQ_PRIO_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+
+// Silicon Labs included files
+#include "em_device.h"
+
+// developer included files
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* NVIC tiers; lower is more urgent (__NVIC_PRIO_BITS = 3: 0 to 7) */
+#define IRQ_PRIO_I2C          1                 // I2C0/I2C1: a late ACK or RXDATAV stretches the bus
+#define IRQ_PRIO_BACKOFF      2                 // TIMER1: backoff retries and sync wait wake-ups
+#define IRQ_PRIO_LETIMER      3                 // LETIMER0: periodic measurements and uptime
+
+/* masks tier prio and every less urgent one; an inner section never lowers the mask */
+#define IRQ_BASEPRI(prio)     ((uint32_t)(prio) << (8U - __NVIC_PRIO_BITS))
+#define IRQ_DECLARE_MASK_STATE  uint32_t irq_mask_state
+#define IRQ_ENTER_MASK(prio)  do { irq_mask_state = __get_BASEPRI(); \
+                                   __set_BASEPRI_MAX(IRQ_BASEPRI(prio)); } while(0)   // mask tier prio and below
+#define IRQ_EXIT_MASK()       __set_BASEPRI(irq_mask_state)                          // restore the previous mask
+
+
+#endif
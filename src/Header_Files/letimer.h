@@ -17,6 +17,7 @@
 // include files
 //***********************************************************************************
 // system included files
+#include <string.h>
 
 
 // Silicon Labs included files
@@ -29,12 +30,14 @@
 // developer included files
 #include "scheduler.h"
 #include "sleep_routines.h"
+#include "hotpath.h"
+#include "bench.h"
 
 
 //***********************************************************************************
 // defined macros
 //***********************************************************************************
-#define LETIMER_HZ		      1000      // utilizing ULFRCO oscillator for LETIMERs
+#define LETIMER_HZ		      1000      // utilizing ULFRCO oscillator for LETIMERs; nominal, see letimer_calibrate()
 #define LETIMER_EM          EM4       // use ULFRCO, block energy mode 4
 #define LETIMER_CNT_RESET   0         // LETIMER counter reset value
 #define DEASSERT            0x00      // de-assert PWM idle values
@@ -43,6 +46,7 @@
 #define REP0                0x00      // repeat0 set value
 #define REP1                0x01      // repeat1 set value
 #define REP_PWM_MODE        0x01      // repeat set PWM mode
+#define LETIMER_TIMERS      4         // low-energy one-shot timers (see letimer_timer_start())
 
 
 //***********************************************************************************
@@ -72,11 +76,35 @@ typedef struct {
 } APP_LETIMER_PWM_TypeDef ;
 
 
+/*! Low-energy one-shot timer. Its event may be posted anywhere in
+ [due, latest]; timers whose windows overlap share one wake-up       */
+typedef struct {
+  uint32_t    cb;                   /// scheduler event to post (0 = timer free)
+  uint64_t    due;                  /// earliest expiry (uptime ticks)
+  uint64_t    latest;               /// latest expiry: due + slack (uptime ticks)
+} LETIMER_TIMER_STRUCT;
+
+
+/*! Wake-up accounting for the low-energy timers */
+typedef struct {
+  uint32_t    expired;              /// timers expired
+  uint32_t    wakes;                /// COMP1 wake-ups taken to expire them
+  uint32_t    on_underflow;         /// timers expired by an underflow wake-up that happened anyway
+  uint32_t    saved;                /// wake-ups saved: expired - wakes
+} LETIMER_WAKE_STATS_STRUCT;
+
+
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
 void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_letimer_struct);
 void letimer_start(LETIMER_TypeDef *letimer, bool enable);
+void letimer_calibrate(uint32_t clock_mhz);
+uint32_t letimer_uptime(void);
+uint32_t letimer_uptime_s(void);
+void letimer_timer_start(uint32_t cb, uint32_t delay_ms, uint32_t slack_ms);
+void letimer_timer_stop(uint32_t cb);
+void letimer_wake_stats(LETIMER_WAKE_STATS_STRUCT *stats);
 
 
 #endif
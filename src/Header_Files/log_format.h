@@ -0,0 +1,151 @@
+/***************************************************************************//**
+ * @file
+ *   log_format.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   On-flash sample log format, shared by the firmware and host tools
+ *
+ * @details
+ *   The log is a ring of flash pages. Each page starts with a
+ *   LOG_PAGE_HEADER_STRUCT and holds a run of frames, and every page
+ *   decodes on its own:
+ *
+ *     frame   = len(1) | payload(len) | crc16(2, little endian) | 0xFF pad to 4
+ *     payload = mask(1) | zz(dt) | zz(dv) for each channel set in mask
+ *
+ *   zz() is a zigzag LEB128 varint. dt is the delta from the previous
+ *   record's time (the page header t0 for the first frame). dv is the delta
+ *   from that channel's previous value in the page (0 for the first). The
+ *   CRC (CRC-16/CCITT-FALSE) covers len and payload. A len of 0xFF is
+ *   erased flash: the end of the page.
+ *
+ *   A raw page (LOG_PAGE_MAGIC_RAW) carries the sensors' raw 16-bit codes
+ *   instead of centi-units and opens with one descriptor frame per channel,
+ *   so it still decodes on its own:
+ *
+ *     payload = LOG_MASK_DESC | ch (1) | zz(gain) | zz(offset) | zz(mode)
+ *               | zz(cal gain) | zz(cal offset)          if mode is linear
+ *               | zz(order) | zz(c0) .. zz(c[order])     if mode is poly
+ *
+ *   gain and offset are the datasheet conversion (CONV_COEF_STRUCT), the
+ *   rest the device calibration record (CONV_CAL_STRUCT); log_desc_apply()
+ *   turns a code into the centi-units a converted page would have held.
+ *
+ *   No Silicon Labs headers: this file and log_format.c build on a host.
+ ******************************************************************************/
+
+#ifndef LOG_FORMAT_HG
+#define LOG_FORMAT_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Silicon Labs included files
+
+// developer included files
+#include "convert.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* Pages */
+#define LOG_PAGE_SIZE         2048              // flash page size (EFM32PG12 FLASH_PAGE_SIZE)
+#define LOG_PAGE_MAGIC        0x31474C53        // "SLG1"
+#define LOG_PAGE_MAGIC_RAW    0x31524C53        // "SLR1": values are raw sensor codes
+#define LOG_ERASED_BYTE       0xFF              // erased flash
+/* Frames */
+#define LOG_CHANNELS          4                 // logged channels (Si7021 RH/T, SHTC3 RH/T)
+#define LOG_FRAME_MAX         24                // longest padded frame (len + 18 payload + crc, to 4)
+#define LOG_FRAME_OVERHEAD    3                 // len byte and crc
+#define LOG_FRAME_ALIGN       4                 // frames are padded to flash words
+#define LOG_CRC_INIT          0xFFFF            // CRC-16/CCITT-FALSE initial value
+#define LOG_CRC_POLY          0x1021            // CRC-16/CCITT-FALSE polynomial
+/* Descriptor frames (raw pages) */
+#define LOG_MASK_DESC         0x80              // mask byte of a descriptor frame; the low bits are its channel
+#define LOG_MASK_CHANNEL      0x0F              // channel of a descriptor frame
+#define LOG_DESC_FRAME_MAX    32                // longest padded descriptor frame (len + 29 payload + crc, to 4)
+/* Calibration modes in a descriptor (convert.h) */
+#define LOG_CAL_NONE          CONV_CAL_NONE         // datasheet formula only
+#define LOG_CAL_LINEAR        CONV_CAL_LINEAR       // y = gain * x + offset
+#define LOG_CAL_POLY          CONV_CAL_POLY         // polynomial in x / 100.00 units
+#define LOG_CAL_MAX_ORDER     CONV_CAL_MAX_ORDER    // highest polynomial order
+/* Decoder results */
+#define LOG_FRAME_END         0                 // erased flash or end of buffer
+#define LOG_FRAME_BAD         (-1)              // length or CRC check failed
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! Page header, at the start of every written page */
+typedef struct
+{
+    uint32_t                      magic;                  /// LOG_PAGE_MAGIC
+    uint32_t                      seq;                    /// page sequence number, +1 per page written
+    uint32_t                      t0;                     /// time of the first record in the page (in seconds)
+    uint32_t                      check;                  /// ~(magic + seq + t0)
+}LOG_PAGE_HEADER_STRUCT;
+
+
+/*! One decoded record */
+typedef struct
+{
+    uint32_t                      time;                   /// sample time (in seconds)
+    uint8_t                       mask;                   /// channels present (bit n = channel n); 0 for a descriptor frame
+    bool                          raw;                    /// True = values are raw codes (uint16_t) to convert with the page's descriptors
+    int16_t                       value[LOG_CHANNELS];    /// values, in centi-units (valid where mask is set)
+}LOG_RECORD_STRUCT;
+
+
+/*! How to turn one channel's raw codes into centi-units: the datasheet
+ conversion followed by the device calibration                          */
+typedef struct
+{
+    bool                          valid;                  /// True once the page's descriptor frame was read
+    CONV_COEF_STRUCT              conv;                   /// datasheet conversion
+    CONV_CAL_STRUCT               cal;                    /// device calibration record
+}LOG_DESC_STRUCT;
+
+
+/*! Delta state of a page, for encoding or decoding */
+typedef struct
+{
+    uint32_t                      time;                   /// previous record's time
+    int16_t                       value[LOG_CHANNELS];    /// previous value per channel
+    bool                          raw;                    /// True = a raw page
+    LOG_DESC_STRUCT               desc[LOG_CHANNELS];     /// raw page: descriptors read so far
+}LOG_DELTA_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+uint16_t log_crc16(uint16_t crc, const uint8_t *data, uint32_t len);
+bool log_page_valid(const LOG_PAGE_HEADER_STRUCT *header);
+bool log_page_raw(const LOG_PAGE_HEADER_STRUCT *header);
+void log_page_header(LOG_PAGE_HEADER_STRUCT *header, uint32_t seq, uint32_t t0, bool raw);
+void log_delta_reset(LOG_DELTA_STRUCT *delta, uint32_t t0, bool raw);
+uint32_t log_frame_encode(LOG_DELTA_STRUCT *delta, const LOG_RECORD_STRUCT *rec, uint8_t *frame);
+uint32_t log_desc_encode(const LOG_DESC_STRUCT *desc, uint32_t ch, uint8_t *frame);
+int32_t log_desc_apply(const LOG_DESC_STRUCT *desc, uint16_t code);
+uint32_t log_put_varint(uint8_t *buf, int32_t value);
+int32_t log_get_varint(const uint8_t *buf, uint32_t avail, int32_t *value);
+int32_t log_frame_decode(LOG_DELTA_STRUCT *delta, const uint8_t *frame, uint32_t avail,
+                         LOG_RECORD_STRUCT *rec);
+
+#endif
@@ -0,0 +1,74 @@
+/***************************************************************************//**
+ * @file
+ *   median.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Header file for the sliding-window median (spike rejection)
+ ******************************************************************************/
+
+#ifndef MEDIAN_HG
+#define MEDIAN_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Silicon Labs included files
+#include "em_assert.h"
+
+// developer included files
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* Window */
+#define MEDIAN_WINDOW_MIN     1                 // smallest window
+#define MEDIAN_WINDOW_MAX     31                // largest window; sizes the static arrays
+/* Benchmark; BENCH_MEDIAN builds */
+#define MEDIAN_BENCH_SAMPLES  1024              // updates timed per window size
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! Sliding median over the last `window` samples (two-heap "mediator").
+ The heap array holds a max-heap of the lower half at negative indices, the
+ median at index 0 and a min-heap of the upper half at positive indices,
+ all centred in heap[]; each update is O(log window)                     */
+typedef struct
+{
+    int32_t                       data[MEDIAN_WINDOW_MAX];/// circular buffer of samples, oldest overwritten first
+    int8_t                        pos[MEDIAN_WINDOW_MAX]; /// heap index of each data[] slot
+    int8_t                        heap[MEDIAN_WINDOW_MAX];/// data[] slot at each heap index, offset by `half`
+    uint8_t                       window;                 /// window length
+    uint8_t                       half;                   /// heap[] offset of heap index 0
+    uint8_t                       idx;                    /// next data[] slot to overwrite
+    uint8_t                       count;                  /// samples held (< window until the window fills)
+}MEDIAN_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void median_open(MEDIAN_STRUCT *median, uint8_t window);
+int32_t median_step(MEDIAN_STRUCT *median, int32_t sample);
+int32_t median_value(const MEDIAN_STRUCT *median);
+#ifdef BENCH_MEDIAN
+uint32_t median_bench(uint8_t window);
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+/***************************************************************************//**
+ * @file
+ *   rate_group.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Header file for multi-rate scheduling from a single timer base
+ ******************************************************************************/
+
+#ifndef RATE_GROUP_HG
+#define RATE_GROUP_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Silicon Labs included files
+#include "em_assert.h"
+
+// developer included files
+#include "scheduler.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define RATE_GROUPS_MAX       8                 // rate groups that can be open at once
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! A rate group: a scheduler event released every `period` base ticks, on
+ the ticks where (tick % period) == phase. Groups with the same period but
+ different phases land on different ticks, which spreads bus load    */
+typedef struct
+{
+    uint32_t                      cb;                     /// scheduler event posted on each release
+    uint32_t                      period;                 /// base ticks between releases (0 = slot unused)
+    uint32_t                      phase;                  /// tick within the period of each release (< period)
+    uint32_t                      wait;                   /// base ticks until the next release
+    bool                          enabled;                /// False = ticks pass without releases
+    uint32_t                      releases;               /// times released
+}RATE_GROUP_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void rate_group_open(void);
+uint32_t rate_group_add(uint32_t period, uint32_t phase, uint32_t cb);
+void rate_group_set(uint32_t group, uint32_t period, uint32_t phase);
+void rate_group_enable(uint32_t group, bool enable);
+void rate_group_tick(void);
+uint32_t rate_group_ticks(void);
+uint32_t rate_group_releases(uint32_t group);
+
+#endif
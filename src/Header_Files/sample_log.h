@@ -0,0 +1,73 @@
+/***************************************************************************//**
+ * @file
+ *   sample_log.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Header file for the on-flash sample log and its time index
+ ******************************************************************************/
+
+#ifndef SAMPLE_LOG_HG
+#define SAMPLE_LOG_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+
+// Silicon Labs included files
+#include "em_msc.h"
+#include "em_assert.h"
+
+// developer included files
+#include "log_format.h"
+#include "letimer.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* Flash region; the linker script must keep the application image below it */
+#define SAMPLE_LOG_PAGES      128               // pages in the log ring (256 KB)
+#define SAMPLE_LOG_BASE       (FLASH_BASE + FLASH_SIZE - (SAMPLE_LOG_PAGES * FLASH_PAGE_SIZE)) // top of main flash
+#define SAMPLE_LOG_NO_PAGE    0xFFFFFFFF        // index entry of a page with no valid header
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! Incremental range query. Owned by the caller; advanced a few frames per
+ call to sample_log_query_next() so a long query never delays sampling  */
+typedef struct
+{
+    uint32_t                      from;                   /// start of the range (log time, in seconds)
+    uint32_t                      to;                     /// end of the range, inclusive
+    uint32_t                      page;                   /// physical page being read
+    uint32_t                      seq;                    /// sequence number the page had when the query reached it
+    uint32_t                      offset;                 /// byte offset of the next frame in the page
+    LOG_DELTA_STRUCT              delta;                  /// decoder state of the page
+    bool                          done;                   /// True once the range is exhausted
+}SAMPLE_LOG_QUERY_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void sample_log_open(const LOG_DESC_STRUCT *desc);
+uint32_t sample_log_time(void);
+void sample_log_append(const LOG_RECORD_STRUCT *rec);
+void sample_log_close_page(void);
+void sample_log_query_open(SAMPLE_LOG_QUERY_STRUCT *query, uint32_t from, uint32_t to);
+uint32_t sample_log_query_next(SAMPLE_LOG_QUERY_STRUCT *query, LOG_RECORD_STRUCT *out, uint32_t max);
+
+#endif
@@ -26,6 +26,8 @@
 #include "em_emu.h"
 
 // developer included files
+#include "irq_prio.h"
+#include "hotpath.h"
 
 
 //*******************************************************
@@ -48,7 +50,7 @@
 // function prototypes
 //***********************************************************************************
 void scheduler_open(void);
-void add_scheduled_event(uint32_t event);
+HOTPATH_DECLARATOR void add_scheduled_event(uint32_t event);
 void remove_scheduled_event(uint32_t event);
 uint32_t get_scheduled_events(void);
 
@@ -24,6 +24,9 @@
 /* Developer include statements */
 #include "HW_delay.h"
 #include "i2c.h"
+#include "calibration.h"
+#include "convert.h"
+#include "snapshot.h"
 
 //***********************************************************************************
 // defined macros
@@ -40,6 +43,12 @@
 /* Device Frequencies */
 #define SHTC3_SCL_CLK_FREQ_FM     I2C_FREQ_FAST_MAX   // Frequency of SCL clock in fast-mode (device max is 400kHz)
 #define SHTC3_REF_FREQ            0                   // Set to zero to use I2C frequency
+/* Fixed point conversion, in centi-units (SHTC3 DS 5.11) */
+#define SHTC3_RH_GAIN             10000u              // 100.00 %RH per full-scale code
+#define SHTC3_T_GAIN              17500u              // 175.00 C per full-scale code
+#define SHTC3_T_OFFSET            4500                // 45.00 C
+#define SHTC3_RH_COEF             { SHTC3_RH_GAIN, 0 }                // CONV_COEF_STRUCT initialiser for RH codes
+#define SHTC3_T_COEF              { SHTC3_T_GAIN, SHTC3_T_OFFSET }    // CONV_COEF_STRUCT initialiser for temperature codes
 /* Bit Masks [read_result] */
 #define SHTC3_RESET_READ_RESULT   0x00                // Reset read result to zero
 #define SHTC3_RESET_WRITE_DATA    0X00
@@ -47,6 +56,8 @@
 #define SHTC3_ZERO_BYTES          0                   // expect zero bytes for either read or write
 #define SHTC3_TX_2_BYTES          2                   // expect two bytes from a write
 #define SHTC3_REQ_6_BYTES         6                   // expect six bytes from a read
+/* Synchronous transfers */
+#define SHTC3_SYNC_TIMEOUT        20                  // Time to wait for a synchronous write (in milli-seconds)
 
 
 //***********************************************************************************
@@ -83,16 +94,19 @@ typedef enum
 //***********************************************************************************
 /* Peripheral functions */
 void shtc3_open(I2C_TypeDef *i2c);
+void shtc3_acquire(I2C_TypeDef *i2c);
+void shtc3_release(I2C_TypeDef *i2c);
 /* Read/Write functions */
 void shtc3_write(I2C_TypeDef *i2c, SHTC3_CMD_Typedef cmd, uint32_t shtc3_cb);
+bool shtc3_write_sync(I2C_TypeDef *i2c, SHTC3_CMD_Typedef cmd, uint32_t timeout_ms);
 void shtc3_read(I2C_TypeDef *i2c, bool checksum, uint32_t shtc3_cb);
 /* Conversion functions */
 void shtc3_parse_measurement_data_RH_first(void);
+void shtc3_sample_missed(void);
 /* Accessor functions */
-float shtc3_get_rh(void);
-float shtc3_get_temp(void);
-/* Modifier functions */
-void shtc3_set_rh(float rh);
-void shtc3_set_temp(float temp);
+void shtc3_snapshot(SNAPSHOT_STRUCT *snap);
+float shtc3_convert_rh(const SNAPSHOT_STRUCT *snap, SNAPSHOT_VALUES_STRUCT *values);
+float shtc3_convert_temp(const SNAPSHOT_STRUCT *snap, SNAPSHOT_VALUES_STRUCT *values);
+bool shtc3_responding(void);
 
 #endif
@@ -25,6 +25,9 @@
 // developer included files
 #include "HW_delay.h"
 #include "i2c.h"
+#include "calibration.h"
+#include "convert.h"
+#include "snapshot.h"
 
 
 //***********************************************************************************
@@ -56,10 +59,19 @@
 #define SI7021_REFFREQ            0         // Set to zero to use I2C frequency
 /* Device specific address */
 #define SI7021_ADDR               0x40      // Si7021 peripheral device address
+/* Fixed point conversion, in centi-units (Si7021-A20: 5.1.1 & 5.1.2) */
+#define SI7021_RH_GAIN            12500u    // 125.00 %RH per full-scale code
+#define SI7021_RH_OFFSET          600       // 6.00 %RH
+#define SI7021_T_GAIN             17571u    // 175.71 C per full-scale code
+#define SI7021_T_OFFSET           4685      // 46.85 C
+#define SI7021_RH_COEF            { SI7021_RH_GAIN, SI7021_RH_OFFSET }  // CONV_COEF_STRUCT initialiser for RH codes
+#define SI7021_T_COEF             { SI7021_T_GAIN, SI7021_T_OFFSET }    // CONV_COEF_STRUCT initialiser for temperature codes
 /* Bit Masks [read_result] */
 #define SI7021_RESET_READ_RESULT  0x00      // Use when resetting the read_result static variable
 /* Bit Masks [write_data] */
 #define SI7021_RESET_WRITE_DATA   0x00      // Use when resetting the write_data static variable
+/* Bit Masks [user_reg] */
+#define SI7021_USER_REG_RES_MASK  0x81      // measurement resolution bits of User Register 1 (D7, D0)
 /* Number of bytes I2C should expect */
 #define SI7021_TX_1_BYTE          1         // number of bytes to expect from a write (transmit single bytes)
 #define SI7021_REQ_1_BYTE         1         // expect one byte from a read
@@ -140,9 +152,12 @@ void si7021_i2c_write(I2C_TypeDef *i2c, SI7021_CMD_Typedef cmd, uint8_t ctrl, ui
 /* Conversion functions */
 void si7021_parse_RH_data(void);
 void si7021_parse_temp_data(void);
+void si7021_sample_missed(void);
 /* Accessor member functions */
 uint8_t si7021_store_user_reg(void);
-float si7021_get_rh();
-float si7021_get_temp();
+void si7021_snapshot(SNAPSHOT_STRUCT *snap);
+float si7021_convert_rh(const SNAPSHOT_STRUCT *snap, SNAPSHOT_VALUES_STRUCT *values);
+float si7021_convert_temp(const SNAPSHOT_STRUCT *snap, SNAPSHOT_VALUES_STRUCT *values);
+bool si7021_responding(void);
 
 #endif
@@ -53,6 +53,8 @@
 
 
 // developer included files
+#include "irq_prio.h"
+#include "bench.h"
 
 
 //*******************************************************
@@ -84,6 +86,7 @@ void sleep_block_mode(uint32_t EM);
 void sleep_unblock_mode(uint32_t EM);
 void enter_sleep(void);
 uint32_t current_block_energy_mode(void);
+uint32_t sleep_wakeup_count(uint32_t EM);
 
 
 #endif
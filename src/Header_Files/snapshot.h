@@ -0,0 +1,91 @@
+/***************************************************************************//**
+ * @file
+ *   snapshot.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Header file for sequence-locked sensor snapshots
+ ******************************************************************************/
+
+#ifndef SNAPSHOT_HG
+#define SNAPSHOT_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Silicon Labs included files
+#include "em_device.h"
+#include "em_assert.h"
+
+// developer included files
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define SNAPSHOT_SEQ_BUSY     0x1u              // sequence is odd while a publish is in progress
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+/*! Enumerated snapshot states */
+typedef enum
+{
+  snapshotEmpty,        /*! Nothing published since open */
+  snapshotOk,           /*! The codes are from the last sample */
+  snapshotMissed        /*! The last sample was missed; the codes are from the one before */
+}SNAPSHOT_STATUS_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! One sensor sample: an RH/temperature pair that always belongs together */
+typedef struct
+{
+    uint32_t                      seq;                    /// publish sequence (even; 0 = never published)
+    uint32_t                      time;                   /// letimer_uptime() of the sample the codes are from
+    SNAPSHOT_STATUS_Typedef       status;                 /// outcome of the last sample
+    uint16_t                      rh_code;                /// raw relative humidity code
+    uint16_t                      temp_code;              /// raw temperature code
+}SNAPSHOT_STRUCT;
+
+
+/*! A snapshot's codes converted to units. Kept by the reader: each quantity
+ is converted the first time it is read, once per snapshot            */
+typedef struct
+{
+    uint32_t                      rh_seq;                 /// sequence of the snapshot rh is from (0 = none)
+    uint32_t                      temp_seq;               /// sequence of the snapshot temp is from (0 = none)
+    float                         rh;                     /// percent relative humidity
+    float                         temp;                   /// temperature, Celsius
+}SNAPSHOT_VALUES_STRUCT;
+
+
+/*! A sequence lock around the published snapshot. One writer; readers copy
+ and retry if the sequence moved or was odd while they copied    */
+typedef struct
+{
+    volatile uint32_t             seq;                    /// bumped before and after every publish
+    SNAPSHOT_STRUCT               data;                   /// last published snapshot
+}SNAPSHOT_LOCK_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void snapshot_open(SNAPSHOT_LOCK_STRUCT *lock);
+void snapshot_publish(SNAPSHOT_LOCK_STRUCT *lock, const SNAPSHOT_STRUCT *snap);
+void snapshot_read(const SNAPSHOT_LOCK_STRUCT *lock, SNAPSHOT_STRUCT *snap);
+const SNAPSHOT_STRUCT *snapshot_last(const SNAPSHOT_LOCK_STRUCT *lock);
+
+#endif
@@ -0,0 +1,63 @@
+/***************************************************************************//**
+ * @file
+ *   trace.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Header file for the RAM event trace ring
+ ******************************************************************************/
+
+#ifndef TRACE_HG
+#define TRACE_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Silicon Labs included files
+#include "em_core.h"
+
+// developer included files
+#include "irq_prio.h"
+#include "trace_format.h"
+#include "letimer.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define TRACE_BLOCKS          16                // blocks in the ring (4 KB)
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! One trace block as laid out in RAM and in a dump */
+typedef struct
+{
+    TRACE_BLOCK_HEADER_STRUCT     header;                 /// block header
+    uint8_t                       payload[TRACE_BLOCK_PAYLOAD]; /// encoded events
+}TRACE_BLOCK_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void trace_open(void);
+void trace_event(TRACE_KIND_Typedef kind, int32_t arg);
+void trace_mark(TRACE_KIND_Typedef kind);
+const void *trace_buffer(uint32_t *size);
+
+#endif
@@ -0,0 +1,135 @@
+/***************************************************************************//**
+ * @file
+ *   trace_format.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Binary event trace format, shared by the firmware and host tools
+ *
+ * @details
+ *   The trace is a ring of fixed-size blocks in RAM, dumped as-is. Each
+ *   block is a TRACE_BLOCK_HEADER_STRUCT followed by up to
+ *   TRACE_BLOCK_PAYLOAD bytes of events:
+ *
+ *     event = kind(1, bit 7 set if an arg follows) | zz(dt) | [zz(arg)]
+ *
+ *   zz() is the zigzag LEB128 varint of log_format.h. dt is LETIMER ticks
+ *   since the previous event in the block (since the header t0 for the
+ *   first). The header CRC (CRC-16/CCITT-FALSE) covers the len bytes of
+ *   payload and is kept current as events are added, so the block being
+ *   written validates too. Most events take 2 or 3 bytes.
+ *
+ *   Besides the I2C bus events, the scheduler, the sleep routines and the
+ *   timer interrupts log their activity, so one dump gives the whole
+ *   timeline: what woke the core, which callback ran, and how deep it went
+ *   back to sleep.
+ *
+ *   No Silicon Labs headers: this file and trace_format.c build on a host.
+ ******************************************************************************/
+
+#ifndef TRACE_FORMAT_HG
+#define TRACE_FORMAT_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+
+// Silicon Labs included files
+
+// developer included files
+#include "log_format.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* Blocks */
+#define TRACE_BLOCK_SIZE      256               // bytes per block, header included
+#define TRACE_BLOCK_MAGIC     0x31435254        // "TRC1"
+#define TRACE_BLOCK_PAYLOAD   (TRACE_BLOCK_SIZE - sizeof(TRACE_BLOCK_HEADER_STRUCT))
+/* Events */
+#define TRACE_EVENT_MAX       11                // longest event: kind + two 5-byte varints
+#define TRACE_KIND_MASK       0x3F              // kind bits of the first byte
+#define TRACE_HAS_ARG         0x80              // first byte flag: an argument follows
+/* I2C event arguments */
+#define TRACE_I2C_ARG(bus, byte)  ((int32_t)(((bus) << 8) | ((byte) & 0xFF))) // bus index and data byte
+#define TRACE_I2C_BUS(arg)        ((uint32_t)(arg) >> 8)                      // bus index of an I2C event
+#define TRACE_I2C_BYTE(arg)       ((uint32_t)(arg) & 0xFF)                    // data byte of an I2C event
+/* Sensor health event arguments */
+#define TRACE_HEALTH_ARG(id, state) ((int32_t)(((id) << 8) | ((state) & 0xFF)))  // sensor id and new health state
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+/*! Enumerated trace event kinds */
+typedef enum
+{
+  traceI2cStart         = 0x01, /*! START + address/rw byte sent; arg TRACE_I2C_ARG(bus, header byte) */
+  traceI2cTx            = 0x02, /*! Data byte written to TXDATA; arg TRACE_I2C_ARG(bus, byte) */
+  traceI2cAck           = 0x03, /*! ACK interrupt; arg TRACE_I2C_ARG(bus, 0) */
+  traceI2cNack          = 0x04, /*! NACK interrupt; arg TRACE_I2C_ARG(bus, 0) */
+  traceI2cRxData        = 0x05, /*! RXDATAV interrupt; arg TRACE_I2C_ARG(bus, received byte) */
+  traceI2cMstop         = 0x06, /*! MSTOP interrupt; arg TRACE_I2C_ARG(bus, 0) */
+  traceI2cArbLost       = 0x07, /*! Arbitration lost; arg TRACE_I2C_ARG(bus, 0) */
+  traceI2cBusErr        = 0x08, /*! Bus error; arg TRACE_I2C_ARG(bus, 0) */
+  traceSchedPost        = 0x09, /*! Event added to the scheduler; arg event bits */
+  traceSchedTake        = 0x0A, /*! Event removed from the scheduler (its callback ran); arg event bits */
+  traceIrq              = 0x0B, /*! Interrupt handler entered; arg TRACE_IRQ_Typedef */
+  traceSleep            = 0x0C, /*! Core going to sleep; arg energy mode (1 to 3) */
+  traceWake             = 0x0D, /*! Core woke from sleep; no arg */
+  traceEmBlock          = 0x0E, /*! sleep_block_mode(); arg energy mode */
+  traceEmUnblock        = 0x0F, /*! sleep_unblock_mode(); arg energy mode */
+  traceHealth           = 0x10, /*! Sensor health state changed; arg TRACE_HEALTH_ARG(sensor, HEALTH_STATE_Typedef) */
+  traceKinds                    /*! One past the last kind */
+}TRACE_KIND_Typedef;
+
+
+/*! Interrupt sources of traceIrq (I2C interrupts log their own kinds) */
+typedef enum
+{
+  traceIrqLetimer0      = 0,    /*! LETIMER0: period underflow and COMP interrupts */
+  traceIrqTimer1        = 1,    /*! TIMER1: I2C backoff and sync wait timer */
+  traceIrqs                     /*! One past the last source */
+}TRACE_IRQ_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! Block header */
+typedef struct
+{
+    uint32_t                      magic;                  /// TRACE_BLOCK_MAGIC
+    uint32_t                      seq;                    /// block sequence number, +1 per block
+    uint32_t                      t0;                     /// LETIMER ticks at the block's first event
+    uint16_t                      len;                    /// payload bytes used
+    uint16_t                      crc;                    /// CRC-16 of the used payload
+}TRACE_BLOCK_HEADER_STRUCT;
+
+
+/*! One decoded event */
+typedef struct
+{
+    uint32_t                      time;                   /// LETIMER ticks
+    uint8_t                       kind;                   /// TRACE_KIND_Typedef
+    bool                          has_arg;                /// True if arg is present
+    int32_t                       arg;                    /// kind-specific argument
+}TRACE_EVENT_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+bool trace_block_valid(const TRACE_BLOCK_HEADER_STRUCT *header, const uint8_t *payload);
+uint32_t trace_event_encode(uint8_t *buf, uint32_t dt, uint8_t kind, bool has_arg, int32_t arg);
+int32_t trace_event_decode(const uint8_t *buf, uint32_t avail, uint32_t *time, TRACE_EVENT_STRUCT *event);
+const char *trace_kind_name(uint8_t kind);
+
+#endif
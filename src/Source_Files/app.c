@@ -24,10 +24,39 @@
 // static/private data
 //***********************************************************************************
 static float app_si7021_rh;
-static float app_si7021_temp;
 static uint8_t app_si7021_user_reg;
 static float app_shtc3_rh;
+#ifndef LOG_RAW_CODES
+static float app_si7021_temp;
 static float app_shtc3_temp;
+#endif
+static FILTER_STRUCT app_filter[calChannels];
+static MEDIAN_STRUCT app_median[calChannels];
+#ifndef LOG_RAW_CODES
+static ARCHIVE_STRUCT app_archive[APP_ARCHIVES];
+static const CAL_CHANNEL_Typedef app_archive_channel[APP_ARCHIVES] = APP_ARCHIVE_CHANNELS;
+#endif
+static LOG_RECORD_STRUCT app_log_rec;
+#if defined(LOG_RAW_CODES) || defined(BENCH_CONV)
+static const CONV_COEF_STRUCT app_conv[calChannels] = { SI7021_RH_COEF, SI7021_T_COEF,
+                                                        SHTC3_RH_COEF, SHTC3_T_COEF };
+#endif
+#ifdef BENCH_CONV
+static CONV_BENCH_STRUCT app_conv_bench[calChannels];   // conv_bench() per channel, read with the debugger
+#endif
+#ifdef BENCH_MEDIAN
+static uint32_t app_median_bench[APP_MEDIAN_BENCHES];   // median_bench() cycles per update per window, read with the debugger
+#endif
+#ifdef LOG_RAW_CODES
+static LOG_DESC_STRUCT app_log_desc[LOG_CHANNELS];
+static uint32_t app_log_cal_changes;    // cal_changes_get() when the descriptors were built
+#endif
+static HEALTH_STRUCT app_health[appSensors];
+static uint32_t app_rate[appRates];     // rate group handles
+static APP_SAMPLE_STRUCT app_sample[appSensors];
+static SNAPSHOT_VALUES_STRUCT app_values[appSensors];   // last snapshot converted, per sensor
+static const uint32_t app_sample_deadline_cb[appSensors] = { SI7021_DEADLINE_CB, SHTC3_DEADLINE_CB };
+static const uint32_t app_sample_deadline_ms[appSensors] = { APP_SI7021_LATENCY_MS, APP_SHTC3_LATENCY_MS };
 
 //***********************************************************************************
 // static/private functions
@@ -35,6 +64,29 @@ static float app_shtc3_temp;
 static void app_letimer_pwm_open(float period, float act_period,
                                  uint32_t out0_route, uint32_t out1_route,
                                  bool out0_en, bool out1_en, bool out_en);
+static void app_filter_open(void);
+static float app_filter_sample(CAL_CHANNEL_Typedef channel, float value);
+#ifndef LOG_RAW_CODES
+static void app_archive_sample(CAL_CHANNEL_Typedef channel, int32_t centi);
+#endif
+static void app_log_flush(void);
+static const LOG_DESC_STRUCT *app_log_desc_open(void);
+#ifdef BENCH_CONV
+static void app_conv_bench_run(void);
+static void app_sample_bench(APP_SENSOR_Typedef sensor, uint32_t start);
+#endif
+#ifdef BENCH_MEDIAN
+static void app_median_bench_run(void);
+#endif
+#ifdef LOG_RAW_CODES
+static void app_log_code(CAL_CHANNEL_Typedef channel, uint16_t code);
+#endif
+static void app_health_open(void);
+static void app_sample_report(APP_SENSOR_Typedef sensor, bool ok);
+static void app_sample_start(APP_SENSOR_Typedef sensor, bool periodic);
+static void app_sample_serve(APP_SENSOR_Typedef sensor);
+static void app_sample_idle(APP_SENSOR_Typedef sensor);
+static void app_rate_open(void);
 
 
 //***********************************************************************************
@@ -56,14 +108,36 @@ static void app_letimer_pwm_open(float period, float act_period,
  ******************************************************************************/
 void app_peripheral_setup(void)
 {
+  hotpath_open();
+#ifdef BENCH_ISR
+  bench_isr_open();
+#endif
+#ifdef BENCH_CONV
+  app_conv_bench_run();
+#endif
+#ifdef BENCH_MEDIAN
+  app_median_bench_run();
+#endif
   cmu_open();
   gpio_open();
   sleep_open();
   scheduler_open();
+  cal_open();
+  sample_log_open(app_log_desc_open());
+  app_filter_open();
+  app_health_open();
+  app_rate_open();
   app_letimer_pwm_open(PWM_PER, PWM_ACT_PER, PWM_ROUTE_0, PWM_ROUTE_1, false, false, true);
   letimer_start(LETIMER0, true);
-  si7021_i2c_open(I2C0, writeReg1, measureResRH8_T12);
+  trace_open();
+  si7021_i2c_open(I2C0, writeReg1, APP_SI7021_RES);
   shtc3_open(I2C1);
+
+  // the Si7021's opening register write runs on into its first sample
+  app_sample[appSensorSi7021].busy = true;
+
+  // correct the period for the ULFRCO from the first cycle
+  cmu_ulfrco_cal_start(CMU_CAL_CB);
 }
 
 
@@ -123,6 +197,757 @@ void app_letimer_pwm_open(float period, float act_period,
 }
 
 
+/***************************************************************************//**
+ * @brief
+ *   Selects the filter coefficients for a sensor channel
+ *
+ * @details
+ *   May be called at run time; the channel's filter restarts from its next
+ *   sample.
+ *
+ * @param[in] channel
+ *   Sensor channel to filter.
+ *
+ * @param[in] coef
+ *   Coefficients, e.g. filter_preset(filterPresetFir5Binomial).
+ ******************************************************************************/
+void app_filter_select(CAL_CHANNEL_Typedef channel, const FILTER_COEF_STRUCT *coef)
+{
+  EFM_ASSERT(channel < calChannels);
+
+  filter_select(&app_filter[channel], coef);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Opens a filter on every sensor channel
+ *
+ * @details
+ *   Every channel starts with an APP_MEDIAN_WINDOW median followed by
+ *   APP_FILTER_PRESET.
+ ******************************************************************************/
+void app_filter_open(void)
+{
+  uint32_t channel;
+
+  // log record channels are the calibration channels
+  EFM_ASSERT(calChannels == LOG_CHANNELS);
+
+  for(channel = 0; channel < calChannels; channel++)
+  {
+    median_open(&app_median[channel], APP_MEDIAN_WINDOW);
+    filter_select(&app_filter[channel], filter_preset(APP_FILTER_PRESET));
+  }
+
+#ifndef LOG_RAW_CODES
+  for(channel = 0; channel < APP_ARCHIVES; channel++)
+  {
+    archive_open(&app_archive[channel]);
+  }
+#endif
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Runs one converted sample through its channel's filter
+ *
+ * @details
+ *   A sliding median removes single wild readings first, so the linear
+ *   filter never smears a spike across its output. Both work in
+ *   centi-units, which is the resolution the drivers convert at, so the
+ *   round trip loses nothing.
+ *
+ * @param[in] channel
+ *   Sensor channel.
+ *
+ * @param[in] value
+ *   Converted sample.
+ *
+ * @return
+ *   Returns the filtered sample.
+ ******************************************************************************/
+float app_filter_sample(CAL_CHANNEL_Typedef channel, float value)
+{
+  // round to the nearest centi-unit
+  int32_t centi = (int32_t)((value * CAL_CENTI) + ((value < 0) ? -0.5f : 0.5f));
+
+#ifndef LOG_RAW_CODES
+  // log the unfiltered value; app_log_flush() writes the record
+  app_log_rec.mask |= (1 << channel);
+  app_log_rec.value[channel] = (int16_t)centi;
+#endif
+
+  // reject spikes, then smooth
+  centi = median_step(&app_median[channel], centi);
+  centi = filter_step(&app_filter[channel], centi);
+
+#ifndef LOG_RAW_CODES
+  // keep the filtered value in the history archive
+  app_archive_sample(channel, centi);
+#endif
+
+  return (float)centi / CAL_CENTI;
+}
+
+
+#ifndef LOG_RAW_CODES
+/***************************************************************************//**
+ * @brief
+ *   Adds a filtered sample to its channel's history archive, if it has one
+ *
+ * @param[in] channel
+ *   Sensor channel.
+ *
+ * @param[in] centi
+ *   Filtered sample, in centi-units.
+ ******************************************************************************/
+void app_archive_sample(CAL_CHANNEL_Typedef channel, int32_t centi)
+{
+  uint32_t i;
+
+  for(i = 0; i < APP_ARCHIVES; i++)
+  {
+    if(app_archive_channel[i] == channel)
+    {
+      archive_add(&app_archive[i], letimer_uptime_s(), (int16_t)centi);
+    }
+  }
+}
+#endif
+
+
+/***************************************************************************//**
+ * @brief
+ *   Writes the channels sampled since the last flush as one log record
+ *
+ * @details
+ *   Called once per sensor completion, so both channels of a sensor share a
+ *   record and a timestamp. In a raw log, a calibration change rebuilds the
+ *   descriptors and starts a page that carries them.
+ ******************************************************************************/
+void app_log_flush(void)
+{
+  if(app_log_rec.mask)
+  {
+#ifdef LOG_RAW_CODES
+    if(cal_changes_get() != app_log_cal_changes)
+    {
+      app_log_desc_open();
+      sample_log_close_page();
+    }
+#endif
+    app_log_rec.time = sample_log_time();
+    sample_log_append(&app_log_rec);
+    app_log_rec.mask = 0;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Builds the log's conversion descriptors
+ *
+ * @details
+ *   With LOG_RAW_CODES the log carries raw codes and the gateway converts:
+ *   each channel's datasheet conversion and calibration record go at the
+ *   head of every page. Called again by app_log_flush() when a record
+ *   changes.
+ *
+ * @return
+ *   Returns the descriptors, or NULL to log centi-units.
+ ******************************************************************************/
+const LOG_DESC_STRUCT *app_log_desc_open(void)
+{
+#ifdef LOG_RAW_CODES
+  uint32_t channel;
+
+  app_log_cal_changes = cal_changes_get();
+
+  for(channel = 0; channel < calChannels; channel++)
+  {
+    app_log_desc[channel].valid = true;
+    app_log_desc[channel].conv = app_conv[channel];
+    cal_get(channel, &app_log_desc[channel].cal);
+  }
+
+  return app_log_desc;
+#else
+  return NULL;
+#endif
+}
+
+
+#ifdef BENCH_CONV
+/***************************************************************************//**
+ * @brief
+ *   Benchmarks the batch conversion of every channel at start-up
+ *
+ * @details
+ *   BENCH_CONV builds only. Times conv_batch() against conv_batch_ref()
+ *   and compares them over every raw code with each channel's datasheet
+ *   coefficients; the results stay in app_conv_bench for the debugger,
+ *   and a mismatch asserts.
+ ******************************************************************************/
+void app_conv_bench_run(void)
+{
+  uint32_t channel;
+
+  for(channel = 0; channel < calChannels; channel++)
+  {
+    conv_bench(&app_conv[channel], &app_conv_bench[channel]);
+    EFM_ASSERT(app_conv_bench[channel].match);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Counts the cycles of one periodic sample's processing
+ *
+ * @details
+ *   BENCH_CONV builds only. Called at the end of the sample path with the
+ *   cycle count read before the snapshot; app_sample_stats() reports the
+ *   totals. Comparing a build with and without LOG_RAW_CODES gives the
+ *   per-sample cost of converting on the node.
+ *
+ * @param[in] sensor
+ *   Sensor the sample is from.
+ *
+ * @param[in] start
+ *   BENCH_CYCLES() before the snapshot was read.
+ ******************************************************************************/
+void app_sample_bench(APP_SENSOR_Typedef sensor, uint32_t start)
+{
+  APP_SAMPLE_STATS_STRUCT *stats = &app_sample[sensor].stats;
+  uint32_t cycles = BENCH_CYCLES() - start;
+
+  stats->periodic++;
+  stats->cycles += cycles;
+  if(cycles > stats->cycles_max)
+  {
+    stats->cycles_max = cycles;
+  }
+}
+#endif
+
+
+#ifdef BENCH_MEDIAN
+/***************************************************************************//**
+ * @brief
+ *   Benchmarks the sliding median at start-up
+ *
+ * @details
+ *   BENCH_MEDIAN builds only. Times median_step() for every window from
+ *   APP_MEDIAN_BENCH_MIN to APP_MEDIAN_BENCH_MAX; the mean cycles per
+ *   update stay in app_median_bench for the debugger, so the cost of a
+ *   wider APP_MEDIAN_WINDOW can be read off before choosing it.
+ ******************************************************************************/
+void app_median_bench_run(void)
+{
+  uint32_t window;
+
+  for(window = APP_MEDIAN_BENCH_MIN; window <= APP_MEDIAN_BENCH_MAX; window++)
+  {
+    app_median_bench[window - APP_MEDIAN_BENCH_MIN] = median_bench((uint8_t)window);
+  }
+}
+#endif
+
+
+#ifdef LOG_RAW_CODES
+/***************************************************************************//**
+ * @brief
+ *   Logs a raw code for its channel
+ *
+ * @details
+ *   Raw logs only (LOG_RAW_CODES); app_log_flush() writes the record.
+ *
+ * @param[in] channel
+ *   Sensor channel.
+ *
+ * @param[in] code
+ *   Raw measurement code.
+ ******************************************************************************/
+void app_log_code(CAL_CHANNEL_Typedef channel, uint16_t code)
+{
+  app_log_rec.mask |= (1 << channel);
+  app_log_rec.value[channel] = (int16_t)code;
+}
+#endif
+
+
+#ifndef LOG_RAW_CODES
+/***************************************************************************//**
+ * @brief
+ *   Reads a channel's history
+ *
+ * @details
+ *   Picks the finest archive level that reaches back to `from` (1 minute
+ *   buckets for the last day, hourly for the last month) and returns its
+ *   buckets overlapping [from, to], oldest first, in centi-units. Not in
+ *   LOG_RAW_CODES builds: the history is read from the log on the host.
+ *
+ * @param[in] channel
+ *   Sensor channel; must be one of APP_ARCHIVE_CHANNELS.
+ *
+ * @param[in] from
+ *   Start of the range (letimer_uptime_s() seconds).
+ *
+ * @param[in] to
+ *   End of the range, inclusive (letimer_uptime_s() seconds).
+ *
+ * @param[out] out
+ *   Buckets (avg/min/max; ARCHIVE_EMPTY where no samples arrived).
+ *
+ * @param[in] max
+ *   Capacity of out.
+ *
+ * @param[out] start
+ *   Start time of the first bucket.
+ *
+ * @param[out] step
+ *   Bucket width (in seconds).
+ *
+ * @return
+ *   Returns the number of buckets written to out.
+ ******************************************************************************/
+uint32_t app_history(CAL_CHANNEL_Typedef channel, uint32_t from, uint32_t to,
+                     ARCHIVE_BUCKET_STRUCT *out, uint32_t max, uint32_t *start, uint32_t *step)
+{
+  uint32_t i;
+
+  for(i = 0; i < APP_ARCHIVES; i++)
+  {
+    if(app_archive_channel[i] == channel)
+    {
+      return archive_query(&app_archive[i], ARCHIVE_AUTO_LEVEL, from, to, out, max, start, step);
+    }
+  }
+
+  // channel is not archived
+  EFM_ASSERT(false);
+  return 0;
+}
+#endif
+
+
+/***************************************************************************//**
+ * @brief
+ *   Opens a health tracker for every sensor
+ *
+ * @details
+ *   Also clears the sensors' sample chains, on-demand requests and
+ *   converted snapshots.
+ ******************************************************************************/
+void app_health_open(void)
+{
+  uint32_t sensor;
+
+  memset(app_sample, 0, sizeof(app_sample));
+  memset(app_values, 0, sizeof(app_values));
+
+  for(sensor = 0; sensor < appSensors; sensor++)
+  {
+    health_open(&app_health[sensor], (uint8_t)sensor);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reports the outcome of a sample
+ *
+ * @details
+ *   Ends the sensor's sample chain: feeds the health tracker, on a miss
+ *   marks the sensor's snapshot so its readers know the values are from an
+ *   older sample, and answers any on-demand requests waiting on the sample.
+ *   A good sample must be published before it is reported.
+ *
+ * @param[in] sensor
+ *   Sensor that was sampled.
+ *
+ * @param[in] ok
+ *   True if the sensor answered every transaction of the sample.
+ ******************************************************************************/
+void app_sample_report(APP_SENSOR_Typedef sensor, bool ok)
+{
+  health_report(&app_health[sensor], ok);
+
+  if(!ok)
+  {
+    if(sensor == appSensorSi7021)
+    {
+      si7021_sample_missed();
+    }
+    else
+    {
+      shtc3_sample_missed();
+    }
+  }
+
+  app_sample[sensor].busy = false;
+  app_sample_serve(sensor);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reads a sensor's health
+ *
+ * @details
+ *   A failed sensor is skipped by the measurement cycle and only probed,
+ *   with exponential backoff, until it answers again.
+ *
+ * @param[in] sensor
+ *   Sensor to check.
+ *
+ * @return
+ *   Returns the sensor's health state.
+ ******************************************************************************/
+HEALTH_STATE_Typedef app_sensor_health(APP_SENSOR_Typedef sensor)
+{
+  EFM_ASSERT(sensor < appSensors);
+
+  return health_state(&app_health[sensor]);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reads a sensor's last sample
+ *
+ * @param[in] sensor
+ *   Sensor to read.
+ *
+ * @param[out] snap
+ *   The sensor's last published snapshot (codes, timestamp and status).
+ ******************************************************************************/
+void app_sensor_snapshot(APP_SENSOR_Typedef sensor, SNAPSHOT_STRUCT *snap)
+{
+  EFM_ASSERT(sensor < appSensors);
+
+  if(sensor == appSensorSi7021)
+  {
+    si7021_snapshot(snap);
+  }
+  else
+  {
+    shtc3_snapshot(snap);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns a sensor's snapshot relative humidity
+ *
+ * @details
+ *   The conversion is kept per sensor and per quantity, so a snapshot read
+ *   by the periodic path and by on-demand requesters is converted once, and
+ *   the temperature is not converted for a reader that only wants RH.
+ *   Called from scheduler callbacks only.
+ *
+ * @param[in] sensor
+ *   Sensor the snapshot is from.
+ *
+ * @param[in] snap
+ *   Snapshot taken with app_sensor_snapshot().
+ *
+ * @return
+ *   Percent relative humidity.
+ ******************************************************************************/
+float app_sensor_rh(APP_SENSOR_Typedef sensor, const SNAPSHOT_STRUCT *snap)
+{
+  EFM_ASSERT(sensor < appSensors);
+
+  if(sensor == appSensorSi7021)
+  {
+    return si7021_convert_rh(snap, &app_values[sensor]);
+  }
+
+  return shtc3_convert_rh(snap, &app_values[sensor]);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns a sensor's snapshot temperature
+ *
+ * @details
+ *   As app_sensor_rh(), for the temperature.
+ *
+ * @param[in] sensor
+ *   Sensor the snapshot is from.
+ *
+ * @param[in] snap
+ *   Snapshot taken with app_sensor_snapshot().
+ *
+ * @return
+ *   Temperature, Celsius.
+ ******************************************************************************/
+float app_sensor_temp(APP_SENSOR_Typedef sensor, const SNAPSHOT_STRUCT *snap)
+{
+  EFM_ASSERT(sensor < appSensors);
+
+  if(sensor == appSensorSi7021)
+  {
+    return si7021_convert_temp(snap, &app_values[sensor]);
+  }
+
+  return shtc3_convert_temp(snap, &app_values[sensor]);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Requests a sample now, without waiting for the sensor's rate group
+ *
+ * @details
+ *   Posts cb once the sensor has a sample no older than
+ *   APP_SAMPLE_FRESH_MS, then the requester reads it with
+ *   app_sensor_snapshot() and app_sensor_rh()/app_sensor_temp():
+ *   - a fresh enough snapshot answers at once;
+ *   - a sample already in flight answers when it completes;
+ *   - otherwise a sample starts now, ahead of the next rate group release.
+ *
+ *   The sensor's transactions are in the bus's urgent class. cb is posted
+ *   no later than the sensor's deadline (APP_SI7021_LATENCY_MS,
+ *   APP_SHTC3_LATENCY_MS); a sample that has not completed by then
+ *   leaves the older snapshot, which its timestamp shows. A failed sensor
+ *   is left to its health probes and answers at once with its last
+ *   snapshot (snapshotMissed).
+ *
+ *   The rate groups are not touched, so the periodic samples stay on their
+ *   phase; an on-demand sample is not filtered or logged.
+ *
+ * @param[in] sensor
+ *   Sensor to sample.
+ *
+ * @param[in] cb
+ *   Scheduler event to post when the request is answered.
+ ******************************************************************************/
+void app_sample_now(APP_SENSOR_Typedef sensor, uint32_t cb)
+{
+  APP_SAMPLE_STRUCT *req;
+  SNAPSHOT_STRUCT snap;
+
+  EFM_ASSERT((sensor < appSensors) && cb);
+
+  req = &app_sample[sensor];
+  req->stats.requests++;
+
+  // fresh enough: answer from the snapshot; its timestamp and status
+  // are enough to tell, the requester converts it if it wants it
+  app_sensor_snapshot(sensor, &snap);
+  if((snap.status == snapshotOk) && ((letimer_uptime() - snap.time) <= APP_SAMPLE_FRESH_MS))
+  {
+    req->stats.cached++;
+    add_scheduled_event(cb);
+    return;
+  }
+
+  if(health_state(&app_health[sensor]) == healthFailed)
+  {
+    req->stats.unavailable++;
+    add_scheduled_event(cb);
+    return;
+  }
+
+  // the first waiting request starts the clock
+  if(!req->cb)
+  {
+    req->start = letimer_uptime();
+    letimer_timer_start(app_sample_deadline_cb[sensor], app_sample_deadline_ms[sensor], 0);
+  }
+  req->cb |= cb;
+
+  // a sample in flight answers this request too
+  if(!req->busy)
+  {
+    app_sample_start(sensor, false);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reads a sensor's sampling statistics
+ *
+ * @param[in] sensor
+ *   Sensor to read.
+ *
+ * @param[out] stats
+ *   Request counts and response latencies since open, and in BENCH_CONV
+ *   builds the periodic sample path's cycles.
+ ******************************************************************************/
+void app_sample_stats(APP_SENSOR_Typedef sensor, APP_SAMPLE_STATS_STRUCT *stats)
+{
+  EFM_ASSERT(sensor < appSensors);
+
+  *stats = app_sample[sensor].stats;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a sensor's sample chain
+ *
+ * @param[in] sensor
+ *   Sensor to sample.
+ *
+ * @param[in] periodic
+ *   True if the sample feeds the filters and the log.
+ ******************************************************************************/
+void app_sample_start(APP_SENSOR_Typedef sensor, bool periodic)
+{
+  app_sample[sensor].busy = true;
+  app_sample[sensor].periodic = periodic;
+
+  if(sensor == appSensorSi7021)
+  {
+    // measure relative humidity; the temperature is read from the same measurement
+    si7021_i2c_read(I2C0, measureRH_NHMM, false, SI7021_HUM_READ_CB);
+  }
+  else
+  {
+    // own the SHTC3's bus for the whole sequence, then wake it up
+    shtc3_acquire(I2C1);
+    shtc3_write(I2C1, wakeup, SHTC3_WAKEUP_CB);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Answers a sensor's waiting on-demand requests
+ *
+ * @details
+ *   Called when the sample completes or the deadline expires, whichever
+ *   is first; records the response latency from the oldest request.
+ *
+ * @param[in] sensor
+ *   Sensor whose requests to answer.
+ ******************************************************************************/
+void app_sample_serve(APP_SENSOR_Typedef sensor)
+{
+  APP_SAMPLE_STRUCT *req = &app_sample[sensor];
+  uint32_t latency;
+
+  if(!req->cb)
+  {
+    return;
+  }
+
+  letimer_timer_stop(app_sample_deadline_cb[sensor]);
+
+  latency = letimer_uptime() - req->start;
+  req->stats.latency_last = latency;
+  if(latency > req->stats.latency_max)
+  {
+    req->stats.latency_max = latency;
+  }
+
+  if(latency >= app_sample_deadline_ms[sensor])
+  {
+    req->stats.late++;
+  }
+  else
+  {
+    req->stats.converted++;
+  }
+
+  add_scheduled_event(req->cb);
+  req->cb = 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Ends a chain on a sensor that did not take a sample
+ *
+ * @details
+ *   The Si7021's register check holds the bus like a sample; requests, or
+ *   a rate group release, that waited on it start their own sample.
+ *
+ * @param[in] sensor
+ *   Sensor whose chain ended.
+ ******************************************************************************/
+void app_sample_idle(APP_SENSOR_Typedef sensor)
+{
+  app_sample[sensor].busy = false;
+
+  if(app_sample[sensor].cb || app_sample[sensor].periodic)
+  {
+    app_sample_start(sensor, app_sample[sensor].periodic);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Opens the rate groups
+ *
+ * @details
+ *   Every periodic job runs off the LETIMER0 underflow; each group is a
+ *   multiple of PWM_PER with its own phase.
+ ******************************************************************************/
+void app_rate_open(void)
+{
+  rate_group_open();
+
+  app_rate[appRateShtc3] = rate_group_add(APP_SHTC3_PERIOD, APP_SHTC3_PHASE, SHTC3_SAMPLE_CB);
+  app_rate[appRateSi7021] = rate_group_add(APP_SI7021_PERIOD, APP_SI7021_PHASE, SI7021_SAMPLE_CB);
+  app_rate[appRateMinute] = rate_group_add(APP_MINUTE_PERIOD, APP_MINUTE_PHASE, APP_MINUTE_CB);
+  app_rate[appRateHour] = rate_group_add(APP_HOUR_PERIOD, APP_HOUR_PHASE, APP_HOUR_CB);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Changes the period and phase of a rate group
+ *
+ * @details
+ *   Takes effect from the next LETIMER0 underflow. A sensor's health
+ *   backoff counts its own samples, so it scales with the new period.
+ *
+ * @param[in] rate
+ *   Rate group to change.
+ *
+ * @param[in] period
+ *   LETIMER0 periods between releases (at least 1).
+ *
+ * @param[in] phase
+ *   LETIMER0 period within the group's period on which it is released
+ *   (< period).
+ ******************************************************************************/
+void app_rate_set(APP_RATE_Typedef rate, uint32_t period, uint32_t phase)
+{
+  EFM_ASSERT(rate < appRates);
+
+  rate_group_set(app_rate[rate], period, phase);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Enables or disables a rate group
+ *
+ * @param[in] rate
+ *   Rate group to change.
+ *
+ * @param[in] enable
+ *   True = release on schedule; False = skip releases, keeping the phase.
+ ******************************************************************************/
+void app_rate_enable(APP_RATE_Typedef rate, bool enable)
+{
+  EFM_ASSERT(rate < appRates);
+
+  rate_group_enable(app_rate[rate], enable);
+}
+
+
 /******************************************************************************
  ***************************** CALLBACK FUNCTIONS *****************************
  ******************************************************************************/
@@ -133,19 +958,65 @@ void app_letimer_pwm_open(float period, float act_period,
  *   Handles the scheduling of the LETIMER0 underflow call back
  *
  * @details
- *   When the LETIMER0 underflows, sends a measurement packet to the SI7021
- *   and a wakeup packet to the SHTC3
+ *   The LETIMER0 underflow is the base tick of every rate group; the
+ *   groups due on this tick post their own callbacks.
  ******************************************************************************/
 void scheduled_letimer0_uf_cb(void)
 {
   // remove LETIMER0 underflow callback even from scheduler
   remove_scheduled_event(LETIMER0_UF_CB);
 
-  // measure relative humidity using Si7021
-  si7021_i2c_read(I2C0, measureRH_NHMM, false, SI7021_HUM_READ_CB);
+  rate_group_tick();
+}
+
 
-  // wakeup SHTC3
-  shtc3_write(I2C1, wakeup, SHTC3_WAKEUP_CB);
+/***************************************************************************//**
+ * @brief
+ *   Handles the scheduling of the Si7021 rate group callback
+ *
+ * @details
+ *   Sends a measurement packet to the Si7021, unless it has failed and its
+ *   next health probe is not due yet. A sample already in flight (on
+ *   demand) is taken over as this period's sample instead.
+ ******************************************************************************/
+void scheduled_si7021_sample_cb(void)
+{
+  // remove event from scheduler
+  remove_scheduled_event(SI7021_SAMPLE_CB);
+
+  if(app_sample[appSensorSi7021].busy)
+  {
+      app_sample[appSensorSi7021].periodic = true;
+  }
+  else if(health_sample_due(&app_health[appSensorSi7021]))
+  {
+      app_sample_start(appSensorSi7021, true);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Handles the scheduling of the SHTC3 rate group callback
+ *
+ * @details
+ *   Sends a wakeup packet to the SHTC3, unless it has failed and its next
+ *   health probe is not due yet. A sample already in flight (on demand) is
+ *   taken over as this period's sample instead.
+ ******************************************************************************/
+void scheduled_shtc3_sample_cb(void)
+{
+  // remove event from scheduler
+  remove_scheduled_event(SHTC3_SAMPLE_CB);
+
+  if(app_sample[appSensorShtc3].busy)
+  {
+      app_sample[appSensorShtc3].periodic = true;
+  }
+  else if(health_sample_due(&app_health[appSensorShtc3]))
+  {
+      app_sample_start(appSensorShtc3, true);
+  }
 }
 
 
@@ -167,15 +1038,18 @@ void scheduled_si7021_hum_read_cb(void)
   // remove event from scheduler
   remove_scheduled_event(SI7021_HUM_READ_CB);
 
+  // a Si7021 that stopped answering ends the sample here
+  if(!si7021_responding())
+  {
+      app_sample_report(appSensorSi7021, false);
+      return;
+  }
+
+  // hold the RH code until its temperature arrives
   si7021_parse_RH_data();
 
   // read temperature from previous previous RH measurement
   si7021_i2c_read(I2C0, MeasureTFromPrevRH, false, SI7021_TEMP_READ_CB);
-
-  timer_delay(80);
-
-  // parse temperature measurement code
-  si7021_parse_temp_data();
 }
 
 
@@ -187,26 +1061,57 @@ void scheduled_si7021_hum_read_cb(void)
  *   Once relative humidity and temperature measurements have been received,
  *   this callback function will store the converted values in static private
  *   variables in the application layer. Then drives an LED on the EFM32
- *   if the relative humidity threshold is reached.
+ *   if the relative humidity threshold is reached. A LOG_RAW_CODES build
+ *   logs both codes and converts and filters the RH only, for the LED.
  ******************************************************************************/
 void scheduled_si7021_temp_read_cb(void)
 {
   // remove event from scheduler
   remove_scheduled_event(SI7021_TEMP_READ_CB);
 
-  // atomic operation
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
-
-  // store measurements
-  app_si7021_rh = si7021_get_rh();
-  app_si7021_temp = si7021_get_temp();
+  // the sample is complete once the temperature read has answered
+  if(!si7021_responding())
+  {
+      app_sample_report(appSensorSi7021, false);
+      return;
+  }
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // publish the RH/temperature pair; this answers any on-demand requests
+  si7021_parse_temp_data();
+  app_sample_report(appSensorSi7021, true);
+
+  // an on-demand sample is not filtered or logged, so both keep the rate group's cadence
+  if(!app_sample[appSensorSi7021].periodic)
+  {
+      return;
+  }
+
+#ifdef BENCH_CONV
+  uint32_t bench_start = BENCH_CYCLES();
+#endif
+
+  // take the pair back as one snapshot
+  SNAPSHOT_STRUCT snap;
+  app_sensor_snapshot(appSensorSi7021, &snap);
+#ifdef LOG_RAW_CODES
+  // the gateway converts; temperature is not used here and is logged as a code
+  app_log_code(calSi7021RH, snap.rh_code);
+  app_log_code(calSi7021Temp, snap.temp_code);
+#endif
+
+  // filter so the LED threshold does not react to single-sample noise
+  app_si7021_rh = app_filter_sample(calSi7021RH, app_sensor_rh(appSensorSi7021, &snap));
+#ifndef LOG_RAW_CODES
+  app_si7021_temp = app_filter_sample(calSi7021Temp, app_sensor_temp(appSensorSi7021, &snap));
+#endif
+  app_log_flush();
 
   // drive LED
   drive_leds(app_si7021_rh, LED0_PORT, LED0_PIN);
+
+#ifdef BENCH_CONV
+  app_sample_bench(appSensorSi7021, bench_start);
+#endif
 }
 
 
@@ -227,15 +1132,15 @@ void scheduled_si7021_write_reg_cb(void)
   // read from user register
   si7021_i2c_read(I2C0, readReg1, false, SI7021_READ_REG_CB);
 
-  // atomic operation
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
 
   // store user register settings
   app_si7021_user_reg = si7021_store_user_reg();
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // allow interrupts
+  IRQ_EXIT_MASK();
 }
 
 
@@ -253,28 +1158,8 @@ void scheduled_si7021_read_reg_cb(void)
   // remove event from scheduler
   remove_scheduled_event(SI7021_READ_REG_CB);
 
-  // measure relative humidity using Si7021
-  si7021_i2c_read(I2C0, measureRH_NHMM, false, SI7021_HUM_READ_CB);
-
-  timer_delay(80);
-
-  // parse RH measurement code
-  si7021_parse_RH_data();
-}
-
-
-/***************************************************************************//**
- * @brief
- *   Handles the scheduling of the SHTC3 open callback
- *
- * @details
- *  Just removes scheduled callback event after the SHTC3 has been opened and put
- *  to sleep.
- ******************************************************************************/
-void scheduled_shtc3_open_cb(void)
-{
-  // remove event from scheduler
-  remove_scheduled_event(SHTC3_OPEN_CB);
+  // measure relative humidity using Si7021; parsed by the RH read callback
+  app_sample_start(appSensorSi7021, true);
 }
 
 
@@ -309,6 +1194,14 @@ void scheduled_shtc3_wakeup_cb(void)
   // remove event from scheduler
   remove_scheduled_event(SHTC3_WAKEUP_CB);
 
+  // an SHTC3 that does not wake up ends the sample here
+  if(!shtc3_responding())
+  {
+      app_sample_report(appSensorShtc3, false);
+      shtc3_release(I2C1);
+      return;
+  }
+
   shtc3_write(I2C1, readRHFirst_LPM, SHTC3_MEASUREMENT_CB);
 }
 
@@ -326,6 +1219,13 @@ void scheduled_shtc3_measurement_cb(void)
   // remove event from scheduler
   remove_scheduled_event(SHTC3_MEASUREMENT_CB);
 
+  if(!shtc3_responding())
+  {
+      app_sample_report(appSensorShtc3, false);
+      shtc3_release(I2C1);
+      return;
+  }
+
   shtc3_read(I2C1, false, SHTC3_READ_REQ_CB);
 }
 
@@ -337,30 +1237,205 @@ void scheduled_shtc3_measurement_cb(void)
  * @details
  *   Following the a read transaction (which scheduled a sleep callback),
  *   a sleep packet is sent to put the SHTC3 back to sleep. The SHTC3 should
- *   be put to sleep following every transaction.
+ *   be put to sleep following every transaction. A LOG_RAW_CODES build logs
+ *   both codes and converts and filters the RH only, for the LED; the
+ *   temperature and the history archive are left to the host.
  ******************************************************************************/
 void scheduled_shtc3_read_req_cb(void)
 {
   // remove event from scheduler
   remove_scheduled_event(SHTC3_READ_REQ_CB);
 
-  // parse measured data;
+  // the measurement never became ready; still put the SHTC3 back to sleep
+  if(!shtc3_responding())
+  {
+      app_sample_report(appSensorShtc3, false);
+      shtc3_write(I2C1, sleep, SHTC3_SLEEP_CB);
+      shtc3_release(I2C1);
+      return;
+  }
+
+  // publish the measured pair; this answers any on-demand requests
   shtc3_parse_measurement_data_RH_first();
+  app_sample_report(appSensorShtc3, true);
 
-  // atomic operation
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // transmit a sleep command; the sequence gives up the bus once it is sent
+  shtc3_write(I2C1, sleep, SHTC3_SLEEP_CB);
+  shtc3_release(I2C1);
+
+  // an on-demand sample is not filtered or logged, so both keep the rate group's cadence
+  if(!app_sample[appSensorShtc3].periodic)
+  {
+      return;
+  }
+
+#ifdef BENCH_CONV
+  uint32_t bench_start = BENCH_CYCLES();
+#endif
+
+  // take the pair back as one snapshot
+  SNAPSHOT_STRUCT snap;
+  app_sensor_snapshot(appSensorShtc3, &snap);
+#ifdef LOG_RAW_CODES
+  // the gateway converts; temperature is not used here and is logged as a code
+  app_log_code(calShtc3RH, snap.rh_code);
+  app_log_code(calShtc3Temp, snap.temp_code);
+#endif
+
+  // filter so the LED threshold does not react to single-sample noise
+  app_shtc3_rh = app_filter_sample(calShtc3RH, app_sensor_rh(appSensorShtc3, &snap));
+#ifndef LOG_RAW_CODES
+  app_shtc3_temp = app_filter_sample(calShtc3Temp, app_sensor_temp(appSensorShtc3, &snap));
+#endif
+  app_log_flush();
 
-  app_shtc3_rh = shtc3_get_rh();
-  app_shtc3_temp = shtc3_get_temp();
+  drive_leds(app_shtc3_rh, LED1_PORT, LED1_PIN);
 
-  timer_delay(80);
+#ifdef BENCH_CONV
+  app_sample_bench(appSensorShtc3, bench_start);
+#endif
+}
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
 
-  drive_leds(app_shtc3_rh, LED1_PORT, LED1_PIN);
+/***************************************************************************//**
+ * @brief
+ *   Handles the scheduling of the ULFRCO measurement callback
+ *
+ * @details
+ *   Corrects the LETIMER0 period with the measured ULFRCO frequency, so the
+ *   sample period and the uptime timestamps stay accurate as it drifts.
+ ******************************************************************************/
+void scheduled_cmu_cal_cb(void)
+{
+  // remove event from scheduler
+  remove_scheduled_event(CMU_CAL_CB);
 
-  // transmit a sleep command
-  shtc3_write(I2C1, sleep, SHTC3_SLEEP_CB);
+  letimer_calibrate(cmu_ulfrco_mhz());
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Handles the scheduling of the minute rate group callback
+ *
+ * @details
+ *   The ULFRCO drifts with temperature; it is measured again every minute.
+ ******************************************************************************/
+void scheduled_app_minute_cb(void)
+{
+  // remove event from scheduler
+  remove_scheduled_event(APP_MINUTE_CB);
+
+  cmu_ulfrco_cal_start(CMU_CAL_CB);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Handles the scheduling of the hour rate group callback
+ *
+ * @details
+ *   Reads the Si7021's user register back. A brown-out or a glitch resets
+ *   the part to its default resolution, which nothing else would notice.
+ *   A failed Si7021 is left to its health probes, and a check that would
+ *   overlap an on-demand sample waits for the next hour.
+ ******************************************************************************/
+void scheduled_app_hour_cb(void)
+{
+  // remove event from scheduler
+  remove_scheduled_event(APP_HOUR_CB);
+
+  if((health_state(&app_health[appSensorSi7021]) != healthFailed) &&
+     !app_sample[appSensorSi7021].busy)
+  {
+      // the check holds the Si7021 like a sample
+      app_sample[appSensorSi7021].busy = true;
+      app_sample[appSensorSi7021].periodic = false;
+      si7021_i2c_read(I2C0, readReg1, false, SI7021_CHECK_REG_CB);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Handles the scheduling of the Si7021 configuration check callback
+ *
+ * @details
+ *   Rewrites the measurement resolution if the user register lost it; the
+ *   write chain reads the register back and takes a sample, as at open.
+ *   A check the Si7021 does not answer is not a missed sample, so it is
+ *   not reported to the health tracker.
+ ******************************************************************************/
+void scheduled_si7021_check_reg_cb(void)
+{
+  // remove event from scheduler
+  remove_scheduled_event(SI7021_CHECK_REG_CB);
+
+  if(!si7021_responding())
+  {
+      app_sample_idle(appSensorSi7021);
+      return;
+  }
+
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
+
+  // store user register settings
+  app_si7021_user_reg = si7021_store_user_reg();
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+
+  if((app_si7021_user_reg & SI7021_USER_REG_RES_MASK) != APP_SI7021_RES)
+  {
+      si7021_i2c_write(I2C0, writeReg1, APP_SI7021_RES, SI7021_WRITE_REG_CB);
+      return;
+  }
+
+  app_sample_idle(appSensorSi7021);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Handles the scheduling of the Si7021 on-demand deadline callback
+ *
+ * @details
+ *   The on-demand sample did not complete in time; its requesters are
+ *   answered with the last snapshot. A deadline posted just before the
+ *   sample completed, or for an earlier request, is ignored.
+ ******************************************************************************/
+void scheduled_si7021_deadline_cb(void)
+{
+  // remove event from scheduler
+  remove_scheduled_event(SI7021_DEADLINE_CB);
+
+  if(app_sample[appSensorSi7021].cb &&
+     ((letimer_uptime() - app_sample[appSensorSi7021].start) >= APP_SI7021_LATENCY_MS))
+  {
+      app_sample_serve(appSensorSi7021);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Handles the scheduling of the SHTC3 on-demand deadline callback
+ *
+ * @details
+ *   The on-demand sample did not complete in time; its requesters are
+ *   answered with the last snapshot. A deadline posted just before the
+ *   sample completed, or for an earlier request, is ignored.
+ ******************************************************************************/
+void scheduled_shtc3_deadline_cb(void)
+{
+  // remove event from scheduler
+  remove_scheduled_event(SHTC3_DEADLINE_CB);
+
+  if(app_sample[appSensorShtc3].cb &&
+     ((letimer_uptime() - app_sample[appSensorShtc3].start) >= APP_SHTC3_LATENCY_MS))
+  {
+      app_sample_serve(appSensorShtc3);
+  }
 }
@@ -0,0 +1,356 @@
+/***************************************************************************//**
+ * @file
+ *   archive.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Multi-resolution round-robin history archive
+ *
+ * @details
+ *   Every sample is folded into the open bucket of every level (running
+ *   sum, min and max), so an update is O(levels). When a sample falls past
+ *   the end of a level's open bucket, that bucket is consolidated into the
+ *   level's ring, overwriting the oldest, and buckets for any gap are
+ *   written as ARCHIVE_EMPTY. Bucket times are implied by their ring
+ *   position relative to the open bucket, so no timestamps are stored.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "archive.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+static const uint32_t archive_step[ARCHIVE_LEVELS] = { ARCHIVE_L0_STEP, ARCHIVE_L1_STEP };
+static const uint16_t archive_rows[ARCHIVE_LEVELS] = { ARCHIVE_L0_ROWS, ARCHIVE_L1_ROWS };
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static void archive_push(ARCHIVE_STRUCT *archive, ARCHIVE_LEVEL_STRUCT *lvl, bool empty);
+static void archive_reset_open(ARCHIVE_LEVEL_STRUCT *lvl, uint32_t start);
+static void archive_open_bucket(const ARCHIVE_LEVEL_STRUCT *lvl, ARCHIVE_BUCKET_STRUCT *bucket);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Opens an empty archive.
+ *
+ * @param[in] archive
+ *  Archive (statically allocated by the caller).
+ ******************************************************************************/
+void archive_open(ARCHIVE_STRUCT *archive)
+{
+  uint16_t base = 0;
+  uint32_t i;
+
+  memset(archive, 0, sizeof(ARCHIVE_STRUCT));
+
+  for(i = 0; i < ARCHIVE_LEVELS; i++)
+  {
+    archive->level[i].step = archive_step[i];
+    archive->level[i].rows = archive_rows[i];
+    archive->level[i].base = base;
+    archive->level[i].head = archive_rows[i] - 1;
+    base += archive_rows[i];
+  }
+
+  EFM_ASSERT(base == ARCHIVE_ROWS);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Adds a sample to every level.
+ *
+ * @details
+ *  O(levels) per sample, except after a gap, when each level writes one
+ *  empty bucket per missed step (at most its ring length).
+ *
+ * @param[in] archive
+ *  Archive.
+ *
+ * @param[in] now
+ *  Sample time (in seconds, e.g. letimer_uptime_s()); must not go backwards.
+ *
+ * @param[in] sample
+ *  Sample value.
+ ******************************************************************************/
+void archive_add(ARCHIVE_STRUCT *archive, uint32_t now, int16_t sample)
+{
+  ARCHIVE_LEVEL_STRUCT *lvl;
+  uint32_t start;
+  uint32_t gap;
+  uint32_t i;
+
+  for(i = 0; i < ARCHIVE_LEVELS; i++)
+  {
+    lvl = &archive->level[i];
+    start = now - (now % lvl->step);
+
+    if(!archive->started)
+    {
+      archive_reset_open(lvl, start);
+    }
+    else if(start > lvl->open_start)
+    {
+      // close the open bucket, then mark any skipped buckets empty
+      archive_push(archive, lvl, (lvl->n == 0));
+      gap = ((start - lvl->open_start) / lvl->step) - 1;
+      if(gap > lvl->rows)
+      {
+        gap = lvl->rows;
+      }
+      while(gap--)
+      {
+        archive_push(archive, lvl, true);
+      }
+      archive_reset_open(lvl, start);
+    }
+
+    // fold the sample into the open bucket
+    lvl->sum += sample;
+    if(sample < lvl->min)
+    {
+      lvl->min = sample;
+    }
+    if(sample > lvl->max)
+    {
+      lvl->max = sample;
+    }
+    lvl->n++;
+  }
+
+  archive->started = true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Finds the finest level that still holds a given time.
+ *
+ * @param[in] archive
+ *  Archive.
+ *
+ * @param[in] from
+ *  Oldest time of interest (in seconds).
+ *
+ * @return
+ *  Returns the level index (the coarsest level if none reaches back that far).
+ ******************************************************************************/
+uint8_t archive_pick_level(const ARCHIVE_STRUCT *archive, uint32_t from)
+{
+  const ARCHIVE_LEVEL_STRUCT *lvl;
+  uint8_t i;
+
+  for(i = 0; i < (ARCHIVE_LEVELS - 1); i++)
+  {
+    lvl = &archive->level[i];
+    if(from >= (lvl->open_start - (lvl->filled * lvl->step)))
+    {
+      break;
+    }
+  }
+
+  return i;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads the buckets of one level that overlap a time range, oldest first.
+ *
+ * @details
+ *  The bucket still being filled is included as the newest, consolidated
+ *  so far. Buckets with no samples read as ARCHIVE_EMPTY. Bucket k of the
+ *  result starts at *start + k * *step.
+ *
+ * @param[in] archive
+ *  Archive.
+ *
+ * @param[in] level
+ *  Level to read, or ARCHIVE_AUTO_LEVEL for archive_pick_level(from).
+ *
+ * @param[in] from
+ *  Start of the range (in seconds).
+ *
+ * @param[in] to
+ *  End of the range, inclusive (in seconds).
+ *
+ * @param[out] out
+ *  Buckets.
+ *
+ * @param[in] max
+ *  Capacity of out.
+ *
+ * @param[out] start
+ *  Start time of the first bucket returned.
+ *
+ * @param[out] step
+ *  Bucket width of the level read.
+ *
+ * @return
+ *  Returns the number of buckets written to out.
+ ******************************************************************************/
+uint32_t archive_query(const ARCHIVE_STRUCT *archive, uint8_t level, uint32_t from, uint32_t to,
+                       ARCHIVE_BUCKET_STRUCT *out, uint32_t max, uint32_t *start, uint32_t *step)
+{
+  const ARCHIVE_LEVEL_STRUCT *lvl;
+  uint32_t oldest;
+  uint32_t newest;
+  uint32_t t;
+  uint32_t k;
+  uint32_t count = 0;
+
+  if(level == ARCHIVE_AUTO_LEVEL)
+  {
+    level = archive_pick_level(archive, from);
+  }
+  EFM_ASSERT(level < ARCHIVE_LEVELS);
+
+  lvl = &archive->level[level];
+  *step = lvl->step;
+  *start = 0;
+
+  if(!archive->started)
+  {
+    return 0;
+  }
+
+  // clamp the range to what the level holds
+  oldest = lvl->open_start - (lvl->filled * lvl->step);
+  newest = lvl->open_start + lvl->step - 1;
+  t = (from > oldest) ? (from - (from % lvl->step)) : oldest;
+  if(to > newest)
+  {
+    to = newest;
+  }
+
+  *start = t;
+  while((t <= to) && (count < max))
+  {
+    if(t == lvl->open_start)
+    {
+      archive_open_bucket(lvl, &out[count]);
+    }
+    else
+    {
+      // k buckets older than the newest closed one
+      k = ((lvl->open_start - t) / lvl->step) - 1;
+      out[count] = archive->bucket[lvl->base + ((lvl->head + lvl->rows - k) % lvl->rows)];
+    }
+    count++;
+    t += lvl->step;
+  }
+
+  return count;
+}
+
+
+/******************************************************************************
+ ***************************** PRIVATE FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes a level's open bucket (or an empty bucket) into its ring.
+ *
+ * @param[in] archive
+ *  Archive.
+ *
+ * @param[in] lvl
+ *  Level.
+ *
+ * @param[in] empty
+ *  True = write ARCHIVE_EMPTY instead of the open bucket.
+ ******************************************************************************/
+void archive_push(ARCHIVE_STRUCT *archive, ARCHIVE_LEVEL_STRUCT *lvl, bool empty)
+{
+  ARCHIVE_BUCKET_STRUCT *bucket;
+
+  lvl->head = (lvl->head + 1) % lvl->rows;
+  bucket = &archive->bucket[lvl->base + lvl->head];
+
+  if(empty)
+  {
+    bucket->avg = ARCHIVE_EMPTY;
+    bucket->min = ARCHIVE_EMPTY;
+    bucket->max = ARCHIVE_EMPTY;
+  }
+  else
+  {
+    archive_open_bucket(lvl, bucket);
+  }
+
+  if(lvl->filled < lvl->rows)
+  {
+    lvl->filled++;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts a new open bucket.
+ *
+ * @param[in] lvl
+ *  Level.
+ *
+ * @param[in] start
+ *  Start time of the bucket (in seconds).
+ ******************************************************************************/
+void archive_reset_open(ARCHIVE_LEVEL_STRUCT *lvl, uint32_t start)
+{
+  lvl->open_start = start;
+  lvl->sum = 0;
+  lvl->min = INT16_MAX;
+  lvl->max = INT16_MIN;
+  lvl->n = 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Consolidates a level's open bucket.
+ *
+ * @param[in] lvl
+ *  Level.
+ *
+ * @param[out] bucket
+ *  Consolidated bucket (ARCHIVE_EMPTY if it has no samples yet).
+ ******************************************************************************/
+void archive_open_bucket(const ARCHIVE_LEVEL_STRUCT *lvl, ARCHIVE_BUCKET_STRUCT *bucket)
+{
+  int32_t half;
+
+  if(lvl->n == 0)
+  {
+    bucket->avg = ARCHIVE_EMPTY;
+    bucket->min = ARCHIVE_EMPTY;
+    bucket->max = ARCHIVE_EMPTY;
+    return;
+  }
+
+  // round the mean half away from zero
+  half = (lvl->sum < 0) ? -(int32_t)(lvl->n / 2) : (int32_t)(lvl->n / 2);
+  bucket->avg = (int16_t)((lvl->sum + half) / (int32_t)lvl->n);
+  bucket->min = lvl->min;
+  bucket->max = lvl->max;
+}
@@ -0,0 +1,193 @@
+/***************************************************************************//**
+ * @file
+ *   bench.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Interrupt handler and wake-up latency benchmark (DWT cycle counter)
+ *
+ * @details
+ *   Built with BENCH_ISR, each handler brackets itself with BENCH_ISR_ENTER()
+ *   and BENCH_ISR_EXIT() and enter_sleep() marks the cycle count with
+ *   BENCH_SLEEP() before the core sleeps. The first handler after a mark
+ *   is the one that woke the core, and its entry minus the mark is the
+ *   wake-up latency. Comparing a normal build against one with
+ *   HOTPATH_IN_FLASH gives the effect of running the hot paths from RAM.
+ *
+ *   The entry and exit hooks always run from RAM, so their own cost is the
+ *   same in both builds. On the replay host BENCH_CYCLES() is a host clock.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "bench.h"
+#include "em_ramfunc.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+static BENCH_ISR_STRUCT bench_isr[benchIsrs];
+static uint32_t bench_sleep_start;    // cycle count at the last BENCH_SLEEP()
+static volatile bool bench_asleep;    // True until the next handler runs
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Opens the ISR benchmark.
+ *
+ * @details
+ *  Enables the cycle counter, clears the statistics and starts the flash
+ *  cache hit and miss counters.
+ ******************************************************************************/
+void bench_isr_open(void)
+{
+  BENCH_OPEN();
+
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  memset(bench_isr, 0, sizeof(bench_isr));
+  bench_asleep = false;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+
+  MSC->CACHECMD = MSC_CACHECMD_STARTPC;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Marks the entry of a handler.
+ *
+ * @details
+ *  If the core slept since the last handler, this one woke it: its
+ *  wake-up latency is recorded.
+ *
+ * @param[in] isr
+ *  Handler being entered.
+ *
+ * @return
+ *  Returns the cycle count to pass to bench_isr_exit().
+ ******************************************************************************/
+SL_RAMFUNC_DEFINITION_BEGIN
+uint32_t bench_isr_enter(BENCH_ISR_Typedef isr)
+{
+  uint32_t start = BENCH_CYCLES();
+  uint32_t wake;
+
+  if(bench_asleep)
+  {
+      bench_asleep = false;
+      wake = start - bench_sleep_start;
+      bench_isr[isr].wakes++;
+      bench_isr[isr].wake_cycles += wake;
+      if(wake > bench_isr[isr].wake_max)
+      {
+          bench_isr[isr].wake_max = wake;
+      }
+  }
+
+  return start;
+}
+SL_RAMFUNC_DEFINITION_END
+
+
+/***************************************************************************//**
+ * @brief
+ *  Marks the exit of a handler.
+ *
+ * @param[in] isr
+ *  Handler being left.
+ *
+ * @param[in] start
+ *  Cycle count from bench_isr_enter().
+ ******************************************************************************/
+SL_RAMFUNC_DEFINITION_BEGIN
+void bench_isr_exit(BENCH_ISR_Typedef isr, uint32_t start)
+{
+  uint32_t cycles = BENCH_CYCLES() - start;
+
+  bench_isr[isr].count++;
+  bench_isr[isr].cycles += cycles;
+  if(cycles > bench_isr[isr].max)
+  {
+      bench_isr[isr].max = cycles;
+  }
+}
+SL_RAMFUNC_DEFINITION_END
+
+
+/***************************************************************************//**
+ * @brief
+ *  Marks the cycle count just before the core sleeps.
+ ******************************************************************************/
+void bench_sleep(void)
+{
+  bench_sleep_start = BENCH_CYCLES();
+  bench_asleep = true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads one handler's statistics.
+ *
+ * @param[in] isr
+ *  Handler.
+ *
+ * @param[out] stats
+ *  Copy of the statistics since bench_isr_open().
+ ******************************************************************************/
+void bench_isr_get(BENCH_ISR_Typedef isr, BENCH_ISR_STRUCT *stats)
+{
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  *stats = bench_isr[isr];
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads the flash cache counters.
+ *
+ * @details
+ *  Fetches from RAM do not go through the cache, so moving the hot paths
+ *  shows up as fewer misses as well as fewer cycles.
+ *
+ * @param[out] hits
+ *  Cache hits since bench_isr_open().
+ *
+ * @param[out] misses
+ *  Cache misses since bench_isr_open().
+ ******************************************************************************/
+void bench_cache_get(uint32_t *hits, uint32_t *misses)
+{
+  *hits = MSC->CACHEHITS;
+  *misses = MSC->CACHEMISSES;
+}
@@ -0,0 +1,345 @@
+/***************************************************************************//**
+ * @file
+ *   calibration.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Per-sensor calibration records, stored in the user data page and applied
+ *   by the sensor drivers when converting raw measurement codes
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "calibration.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+static CAL_BLOCK_STRUCT cal_block;
+static uint32_t cal_changes;          // records changed since open
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static uint32_t cal_check(const CAL_BLOCK_STRUCT *block);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Loads the calibration records.
+ *
+ * @details
+ *  Copies the block stored in the user data page into RAM. If the page is
+ *  erased or the block fails its check, every channel falls back to the
+ *  datasheet conversion (calModeNone).
+ ******************************************************************************/
+void cal_open(void)
+{
+  const CAL_BLOCK_STRUCT *stored = (const CAL_BLOCK_STRUCT *)CAL_FLASH_ADDR;
+
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
+
+  if((stored->magic == CAL_MAGIC) && (stored->check == cal_check(stored)))
+  {
+    cal_block = *stored;
+  }
+  else
+  {
+    memset(&cal_block, 0, sizeof(cal_block));
+    cal_block.magic = CAL_MAGIC;
+  }
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Applies a channel's calibration to a converted value.
+ *
+ * @details
+ *  Called from the driver conversion functions; the arithmetic is
+ *  conv_calibrate(), which the host runs on raw log pages too.
+ *
+ * @param[in] channel
+ *  Calibrated channel.
+ *
+ * @param[in] value
+ *  Datasheet conversion of the raw code, in centi-units.
+ *
+ * @return
+ *  Corrected value, in centi-units.
+ ******************************************************************************/
+int32_t cal_apply(CAL_CHANNEL_Typedef channel, int32_t value)
+{
+  return conv_calibrate(&cal_block.record[channel], value);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Sets a linear correction for a channel.
+ *
+ * @details
+ *  Takes effect immediately; call cal_store() to make it persistent.
+ *
+ * @param[in] channel
+ *  Calibrated channel.
+ *
+ * @param[in] gain
+ *  Q16 gain (CAL_ONE is unity).
+ *
+ * @param[in] offset
+ *  Offset in centi-units, added after the gain.
+ ******************************************************************************/
+void cal_set_linear(CAL_CHANNEL_Typedef channel, int32_t gain, int32_t offset)
+{
+  EFM_ASSERT(channel < calChannels);
+
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
+
+  cal_block.record[channel].mode = calModeLinear;
+  cal_block.record[channel].gain = gain;
+  cal_block.record[channel].offset = offset;
+  cal_changes++;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Fits a linear correction through two reference points.
+ *
+ * @details
+ *  Used at install time: record the device's converted reading at two
+ *  reference conditions (e.g. two salt solutions) and the reference values.
+ *  All arguments in centi-units.
+ *
+ * @param[in] channel
+ *  Calibrated channel.
+ *
+ * @param[in] raw_lo
+ *  Device reading at the low reference point.
+ *
+ * @param[in] ref_lo
+ *  Low reference value.
+ *
+ * @param[in] raw_hi
+ *  Device reading at the high reference point.
+ *
+ * @param[in] ref_hi
+ *  High reference value.
+ ******************************************************************************/
+void cal_set_2point(CAL_CHANNEL_Typedef channel, int32_t raw_lo, int32_t ref_lo,
+                    int32_t raw_hi, int32_t ref_hi)
+{
+  // two distinct readings are required for a slope
+  EFM_ASSERT(raw_hi != raw_lo);
+
+  int32_t gain = (int32_t)(((int64_t)(ref_hi - ref_lo) << CAL_Q) / (raw_hi - raw_lo));
+  int32_t offset = ref_lo - (int32_t)(((int64_t)gain * raw_lo) >> CAL_Q);
+
+  cal_set_linear(channel, gain, offset);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Sets a polynomial correction for a channel.
+ *
+ * @details
+ *  y = c0 + c1*u + ... + cn*u^n, with u = value / CAL_POLY_SCALE. The
+ *  coefficients are Q16 centi-units, so the identity is c1 =
+ *  CAL_POLY_SCALE * CAL_ONE with every other coefficient zero. Takes effect
+ *  immediately; call cal_store() to make it persistent.
+ *
+ * @param[in] channel
+ *  Calibrated channel.
+ *
+ * @param[in] order
+ *  Polynomial order, at most CAL_MAX_ORDER.
+ *
+ * @param[in] coef
+ *  order + 1 coefficients, c0 first.
+ ******************************************************************************/
+void cal_set_poly(CAL_CHANNEL_Typedef channel, uint32_t order, const int32_t *coef)
+{
+  EFM_ASSERT(channel < calChannels);
+  EFM_ASSERT(order <= CAL_MAX_ORDER);
+
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
+
+  cal_block.record[channel].mode = calModePoly;
+  cal_block.record[channel].order = order;
+  memset(cal_block.record[channel].coef, 0, sizeof(cal_block.record[channel].coef));
+  memcpy(cal_block.record[channel].coef, coef, (order + 1) * sizeof(int32_t));
+  cal_changes++;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Removes a channel's correction so it reports the datasheet conversion.
+ *
+ * @param[in] channel
+ *  Calibrated channel.
+ ******************************************************************************/
+void cal_clear(CAL_CHANNEL_Typedef channel)
+{
+  EFM_ASSERT(channel < calChannels);
+
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
+
+  memset(&cal_block.record[channel], 0, sizeof(CAL_RECORD_STRUCT));
+  cal_changes++;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes the current records to the user data page.
+ *
+ * @details
+ *  Erases and rewrites the page, then reads it back. Intended for install
+ *  time only; the page endurance is limited and the CPU stalls during the
+ *  erase.
+ *
+ * @return
+ *  Returns true if the stored block matches the records in RAM.
+ ******************************************************************************/
+bool cal_store(void)
+{
+  MSC_Status_TypeDef status;
+  CAL_BLOCK_STRUCT block;
+
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
+
+  cal_block.magic = CAL_MAGIC;
+  cal_block.check = cal_check(&cal_block);
+  block = cal_block;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+
+  MSC_Init();
+  status = MSC_ErasePage((uint32_t *)CAL_FLASH_ADDR);
+  if(status == mscReturnOk)
+  {
+    status = MSC_WriteWord((uint32_t *)CAL_FLASH_ADDR, &block, sizeof(block));
+  }
+  MSC_Deinit();
+
+  return (status == mscReturnOk) &&
+         (memcmp((const void *)CAL_FLASH_ADDR, &block, sizeof(block)) == 0);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Accessor for a channel's calibration record.
+ *
+ * @param[in] channel
+ *  Calibrated channel.
+ *
+ * @param[out] record
+ *  Copy of the record.
+ ******************************************************************************/
+void cal_get(CAL_CHANNEL_Typedef channel, CAL_RECORD_STRUCT *record)
+{
+  EFM_ASSERT(channel < calChannels);
+
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
+
+  *record = cal_block.record[channel];
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Counts the record changes since cal_open().
+ *
+ * @details
+ *  Bumped by every cal_set_linear(), cal_set_poly() and cal_clear(), so a
+ *  copy of the records (e.g. the raw log's descriptors) can tell it is
+ *  stale without comparing them.
+ *
+ * @return
+ *  Returns the number of changes.
+ ******************************************************************************/
+uint32_t cal_changes_get(void)
+{
+  return cal_changes;
+}
+
+
+/******************************************************************************
+ ***************************** PRIVATE FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Computes the check word of a calibration block.
+ *
+ * @details
+ *  Complement of the 32-bit word sum of everything before the check word,
+ *  so an erased (all ones) page never validates.
+ *
+ * @param[in] block
+ *  Block to check.
+ *
+ * @return
+ *  Returns the check word.
+ ******************************************************************************/
+uint32_t cal_check(const CAL_BLOCK_STRUCT *block)
+{
+  const uint32_t *word = (const uint32_t *)block;
+  uint32_t sum = 0;
+  uint32_t i;
+
+  for(i = 0; i < (offsetof(CAL_BLOCK_STRUCT, check) / sizeof(uint32_t)); i++)
+  {
+    sum += word[i];
+  }
+
+  return ~sum;
+}
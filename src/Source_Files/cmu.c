@@ -8,6 +8,10 @@
  * @brief
  *   Driver for enabling the required oscillators and routing the
  *   clock tree to the LETIMER0.
+ *
+ * @details
+ *   Also measures the ULFRCO against the HFRCO with the CMU calibration
+ *   counter, so the LETIMER0 period can be corrected for ULFRCO drift.
  ******************************************************************************/
 
 //***********************************************************************************
@@ -19,6 +23,9 @@
 //***********************************************************************************
 // static/private data
 //***********************************************************************************
+static uint32_t cmu_cal_cb;                 // scheduled callback for a finished measurement
+static volatile uint32_t cmu_ulfrco_rate;   // last measured ULFRCO frequency (mHz)
+static volatile bool cmu_cal_busy;          // a measurement is counting
 
 
 //***********************************************************************************
@@ -69,4 +76,118 @@ void cmu_open(void){
 
     // enable global low frequency clock
     CMU_ClockEnable(cmuClock_CORELE, true);
+
+    // until the first measurement, assume the ULFRCO is on frequency
+    cmu_ulfrco_rate = CMU_ULFRCO_HZ * 1000;
+
+    // the CALRDY interrupt only schedules a callback
+    NVIC_SetPriority(CMU_IRQn, IRQ_PRIO_LETIMER);
+    NVIC_EnableIRQ(CMU_IRQn);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a measurement of the ULFRCO
+ *
+ * @details
+ *   The calibration counter has no ULFRCO selection, so the ULFRCO is put on
+ *   CLKOUT0 and carried over PRS to the down counter. The down counter runs
+ *   for CMU_ULFRCO_CAL_CYCLES ULFRCO cycles while the up counter counts HFRCO
+ *   cycles; CALRDY then schedules cb and cmu_ulfrco_mhz() has the result.
+ *
+ * @note
+ *   The HFRCO stops in EM2, so EM2 is blocked until the measurement is done.
+ *   emlib's CMU_CalibrateConfig() cannot select PRS, so CALCTRL is written
+ *   directly.
+ *
+ * @param[in] cb
+ *   Scheduler event posted when the measurement is done.
+ *
+ ******************************************************************************/
+void cmu_ulfrco_cal_start(uint32_t cb)
+{
+  // a measurement already running reports to its own callback
+  if(cmu_cal_busy)
+  {
+      return;
+  }
+
+  cmu_cal_busy = true;
+  cmu_cal_cb = cb;
+
+  // ULFRCO -> CLKOUT0 -> PRS channel
+  CMU_ClockEnable(cmuClock_PRS, true);
+  CMU->CTRL = (CMU->CTRL & ~_CMU_CTRL_CLKOUTSEL0_MASK) | CMU_CTRL_CLKOUTSEL0_ULFRCO;
+  PRS_SourceSignalSet(CMU_ULFRCO_CAL_PRS_CH, PRS_CH_CTRL_SOURCESEL_CMU,
+                      PRS_CH_CTRL_SIGSEL_CMUCLKOUT0, prsEdgeOff);
+
+  // down counter: ULFRCO over PRS; up counter: HFRCO
+  CMU->CALCTRL = CMU_CALCTRL_DOWNSEL_PRS
+               | (CMU_ULFRCO_CAL_PRS_CH << _CMU_CALCTRL_PRSDOWNSEL_SHIFT)
+               | CMU_CALCTRL_UPSEL_HFRCO;
+  CMU->CALCNT = CMU_ULFRCO_CAL_CYCLES;
+
+  // keep the HFRCO running until CALRDY
+  sleep_block_mode(CMU_ULFRCO_CAL_EM);
+
+  CMU->IFC = CMU_IFC_CALRDY | CMU_IFC_CALOF;
+  CMU->IEN |= CMU_IEN_CALRDY;
+  CMU_CalibrateStart();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the last measured ULFRCO frequency
+ *
+ * @return
+ *   ULFRCO frequency in mHz; CMU_ULFRCO_HZ until the first measurement.
+ *
+ ******************************************************************************/
+uint32_t cmu_ulfrco_mhz(void)
+{
+  return cmu_ulfrco_rate;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Driver to handle all CMU interrupts
+ *
+ * @details
+ *   Handles the end of a ULFRCO measurement: converts the HFRCO count to a
+ *   ULFRCO frequency, releases the energy mode and schedules the callback.
+ *   A count that overflowed is discarded and the previous rate kept.
+ ******************************************************************************/
+void CMU_IRQHandler(void)
+{
+  uint32_t int_flag;
+  uint32_t overflow;
+  uint32_t count;
+
+  BENCH_ISR_ENTER(benchIsrCmu);
+
+  int_flag = (CMU->IF) & (CMU->IEN);
+  overflow = CMU->IF & CMU_IF_CALOF;
+  CMU->IFC = int_flag | overflow;
+
+  if(int_flag & CMU_IF_CALRDY)
+  {
+      CMU->IEN &= ~CMU_IEN_CALRDY;
+
+      // HFRCO cycles in CMU_ULFRCO_CAL_CYCLES ULFRCO cycles
+      count = CMU->CALCNT;
+      if(count && !overflow)
+      {
+          cmu_ulfrco_rate = (uint32_t)(((uint64_t)CMU_HFRCOBandGet() *
+                                        CMU_ULFRCO_CAL_CYCLES * 1000) / count);
+      }
+
+      cmu_cal_busy = false;
+      sleep_unblock_mode(CMU_ULFRCO_CAL_EM);
+      add_scheduled_event(cmu_cal_cb);
+  }
+
+  BENCH_ISR_EXIT(benchIsrCmu);
 }
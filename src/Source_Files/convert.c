@@ -0,0 +1,306 @@
+/***************************************************************************//**
+ * @file
+ *   convert.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Batch conversion of buffered raw measurement codes to fixed point
+ *
+ * @details
+ *   Codes are held structure-of-arrays (one array per quantity), so two
+ *   neighbouring codes share one 32-bit word and the Cortex-M4 packed
+ *   16-bit instructions convert them together. On targets without the DSP
+ *   extension, and on a host, conv_batch() is the plain C reference, which
+ *   the packed kernel matches bit for bit.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "convert.h"
+
+#if defined(__arm__)
+#include "em_core.h"
+#include "bench.h"
+#endif
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+#if defined(__arm__)
+static uint32_t conv_bench_code[CONV_BENCH_SAMPLES / 2];   // packed codes, word aligned
+static uint32_t conv_bench_out[CONV_BENCH_SAMPLES / 2];    // packed results from conv_batch()
+static uint32_t conv_bench_ref[CONV_BENCH_SAMPLES / 2];    // packed results from conv_batch_ref()
+#endif
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Converts one raw code.
+ *
+ * @details
+ *  The scalar conversion used by the sensor drivers, and the definition the
+ *  batch kernel must match.
+ *
+ * @param[in] coef
+ *  Conversion coefficients for the quantity.
+ *
+ * @param[in] code
+ *  Raw measurement code.
+ *
+ * @return
+ *  Returns the converted value, in centi-units.
+ ******************************************************************************/
+int16_t conv_sample(const CONV_COEF_STRUCT *coef, uint16_t code)
+{
+  return (int16_t)((int32_t)((coef->gain * code) >> CONV_CODE_BITS) - coef->offset);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Applies a channel's calibration to a converted value.
+ *
+ * @details
+ *  Integer only, so it costs a few cycles per sample: a linear record is one
+ *  64-bit multiply, a polynomial record is one multiply per order (Horner).
+ *  The node's cal_apply() and the host's raw-page decoder both run this, so
+ *  a raw page converts to the values a converted page would have held, bit
+ *  for bit.
+ *
+ * @param[in] cal
+ *  Calibration of the value's channel.
+ *
+ * @param[in] value
+ *  Datasheet conversion of the raw code, in centi-units.
+ *
+ * @return
+ *  Returns the corrected value, in centi-units.
+ ******************************************************************************/
+int32_t conv_calibrate(const CONV_CAL_STRUCT *cal, int32_t value)
+{
+  int32_t u;
+  int32_t acc;
+  int32_t k;
+
+  switch(cal->mode)
+  {
+    case CONV_CAL_LINEAR:
+      return (int32_t)(((int64_t)cal->gain * value) >> CONV_CAL_Q) + cal->offset;
+
+    case CONV_CAL_POLY:
+      // normalise the input to Q16 without a divide
+      u = (int32_t)(((int64_t)value * CONV_CAL_POLY_RECIP) >> CONV_CAL_Q);
+
+      // Horner's method, Q16 throughout
+      acc = cal->coef[cal->order];
+      for(k = (int32_t)cal->order - 1; k >= 0; k--)
+      {
+        acc = (int32_t)(((int64_t)acc * u) >> CONV_CAL_Q) + cal->coef[k];
+      }
+
+      // round back to centi-units
+      return (acc + (1 << (CONV_CAL_Q - 1))) >> CONV_CAL_Q;
+
+    default:
+      return value;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Converts a buffer of raw codes, one at a time.
+ *
+ * @details
+ *  Host-buildable reference for conv_batch().
+ *
+ * @param[in] coef
+ *  Conversion coefficients for the quantity.
+ *
+ * @param[in] code
+ *  Raw measurement codes.
+ *
+ * @param[out] out
+ *  Converted values, in centi-units.
+ *
+ * @param[in] n
+ *  Number of codes.
+ ******************************************************************************/
+void conv_batch_ref(const CONV_COEF_STRUCT *coef, const uint16_t *code, int16_t *out, uint32_t n)
+{
+  uint32_t i;
+
+  for(i = 0; i < n; i++)
+  {
+    out[i] = conv_sample(coef, code[i]);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Converts a buffer of raw codes, two per step.
+ *
+ * @details
+ *  There is no packed multiply-high on the M4, and __SMLAD sums its two
+ *  lanes, so each lane is multiplied with __SMULWB/__SMULWT and everything
+ *  else is packed:
+ *
+ *    s  = code - 32768                 (one EOR flips both lanes to signed)
+ *    p  = (2 * gain * s) >> 16         (__SMULWB, __SMULWT)
+ *    y  = ((p + gain) >> 1) - offset   (__PKHBT, __SHADD16, __SSUB16)
+ *
+ *  gain * code = gain * s + gain * 32768, so y equals conv_sample() exactly
+ *  for every code, odd gains included. About eight instructions per pair,
+ *  one load and one store. Buffers must be word aligned; an odd trailing
+ *  code is converted by conv_sample().
+ *
+ * @param[in] coef
+ *  Conversion coefficients for the quantity; gain must be <= 32767.
+ *
+ * @param[in] code
+ *  Raw measurement codes (word aligned).
+ *
+ * @param[out] out
+ *  Converted values, in centi-units (word aligned).
+ *
+ * @param[in] n
+ *  Number of codes.
+ ******************************************************************************/
+void conv_batch(const CONV_COEF_STRUCT *coef, const uint16_t *code, int16_t *out, uint32_t n)
+{
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+  const uint32_t *pair_in = (const uint32_t *)code;
+  uint32_t *pair_out = (uint32_t *)out;
+  int32_t gain2 = (int32_t)(coef->gain << 1);
+  uint32_t gain_pair = coef->gain | (coef->gain << CONV_LANE_SHIFT);
+  uint32_t offset_pair = ((uint32_t)coef->offset & 0xFFFF) | ((uint32_t)coef->offset << CONV_LANE_SHIFT);
+  uint32_t pairs = n >> 1;
+  uint32_t s;
+  uint32_t p;
+  uint32_t i;
+
+  // unaligned buffers cannot be read as pairs
+  if((((uintptr_t)code | (uintptr_t)out) & 0x3) != 0)
+  {
+    conv_batch_ref(coef, code, out, n);
+    return;
+  }
+
+  for(i = 0; i < pairs; i++)
+  {
+    s = pair_in[i] ^ CONV_SIGN_FLIP;
+    p = __PKHBT(__SMULWB(gain2, s), __SMULWT(gain2, s), CONV_LANE_SHIFT);
+    pair_out[i] = __SSUB16(__SHADD16(p, gain_pair), offset_pair);
+  }
+
+  // odd trailing code
+  if(n & 1)
+  {
+    out[n - 1] = conv_sample(coef, code[n - 1]);
+  }
+#else
+  conv_batch_ref(coef, code, out, n);
+#endif
+}
+
+
+#if defined(__arm__)
+/***************************************************************************//**
+ * @brief
+ *  Measures conv_batch() against conv_batch_ref().
+ *
+ * @details
+ *  Converts CONV_BENCH_SAMPLES pseudo-random codes with each path, timed
+ *  with the DWT cycle counter with interrupts disabled, and compares the
+ *  outputs. Cycles per sample is cycles / samples. Then, untimed and with
+ *  interrupts allowed, compares the two paths over every code, so a
+ *  kernel that is off for a few codes cannot pass on a lucky sample.
+ *
+ * @param[in] coef
+ *  Conversion coefficients for the quantity.
+ *
+ * @param[out] result
+ *  Cycle counts and whether the outputs matched.
+ ******************************************************************************/
+void conv_bench(const CONV_COEF_STRUCT *coef, CONV_BENCH_STRUCT *result)
+{
+  uint32_t seed = 0x1234ABCD;
+  uint32_t start;
+  uint32_t base;
+  uint32_t i;
+
+  // spread the codes over the full range
+  for(i = 0; i < (CONV_BENCH_SAMPLES / 2); i++)
+  {
+    seed = (seed * 1664525) + 1013904223;
+    conv_bench_code[i] = seed;
+  }
+
+  // enable the cycle counter
+  BENCH_OPEN();
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  start = BENCH_CYCLES();
+  conv_batch(coef, (const uint16_t *)conv_bench_code, (int16_t *)conv_bench_out, CONV_BENCH_SAMPLES);
+  result->batch_cycles = BENCH_CYCLES() - start;
+
+  start = BENCH_CYCLES();
+  conv_batch_ref(coef, (const uint16_t *)conv_bench_code, (int16_t *)conv_bench_ref, CONV_BENCH_SAMPLES);
+  result->ref_cycles = BENCH_CYCLES() - start;
+
+  // allow interrupts
+  CORE_EXIT_CRITICAL();
+
+  result->samples = CONV_BENCH_SAMPLES;
+  result->match = true;
+  for(i = 0; i < (CONV_BENCH_SAMPLES / 2); i++)
+  {
+    if(conv_bench_out[i] != conv_bench_ref[i])
+    {
+      result->match = false;
+    }
+  }
+
+  // every code, two to a word
+  for(base = 0; base < CONV_CODES; base += CONV_BENCH_SAMPLES)
+  {
+    for(i = 0; i < (CONV_BENCH_SAMPLES / 2); i++)
+    {
+      conv_bench_code[i] = (base + (2 * i)) | ((base + (2 * i) + 1) << CONV_LANE_SHIFT);
+    }
+    conv_batch(coef, (const uint16_t *)conv_bench_code, (int16_t *)conv_bench_out, CONV_BENCH_SAMPLES);
+    conv_batch_ref(coef, (const uint16_t *)conv_bench_code, (int16_t *)conv_bench_ref, CONV_BENCH_SAMPLES);
+    for(i = 0; i < (CONV_BENCH_SAMPLES / 2); i++)
+    {
+      if(conv_bench_out[i] != conv_bench_ref[i])
+      {
+        result->match = false;
+      }
+    }
+  }
+  result->codes = CONV_CODES;
+}
+#endif
@@ -0,0 +1,262 @@
+/***************************************************************************//**
+ * @file
+ *   filter.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Per-channel FIR/IIR filter stage for sensor samples (fixed point)
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "filter.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+/* Built-in coefficient sets, indexed by FILTER_PRESET_Typedef. Biquad sets
+   have b1 adjusted so the DC gain is exactly one */
+static const FILTER_COEF_STRUCT filter_presets[filterPresets] =
+{
+  [filterPresetNone]         = { filterTypeNone,   0, { 0 } },
+  [filterPresetFir5Binomial] = { filterTypeFir,    5, { 1024, 4096, 6144, 4096, 1024 } },
+  [filterPresetFir8Average]  = { filterTypeFir,    8, { 2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048 } },
+  [filterPresetBiquadLp10]   = { filterTypeBiquad, 0, { 1105, 2210, 1105, -18727, 6763 } },
+  [filterPresetBiquadLp20]   = { filterTypeBiquad, 0, { 329, 658, 329, -25576, 10508 } },
+  [filterPresetBiquadLp50]   = { filterTypeBiquad, 0, { 59, 119, 59, -29863, 13716 } },
+};
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static void filter_prime(FILTER_STRUCT *filter, int32_t sample);
+static int32_t filter_fir(FILTER_STRUCT *filter, int32_t sample);
+static int32_t filter_biquad(FILTER_STRUCT *filter, int32_t sample);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Looks up a built-in coefficient set.
+ *
+ * @param[in] preset
+ *  Preset to look up.
+ *
+ * @return
+ *  Returns a pointer to the preset's coefficients.
+ ******************************************************************************/
+const FILTER_COEF_STRUCT *filter_preset(FILTER_PRESET_Typedef preset)
+{
+  EFM_ASSERT(preset < filterPresets);
+
+  return &filter_presets[preset];
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Selects the coefficients a filter runs with.
+ *
+ * @details
+ *  May be called at any time. The history is discarded and the next sample
+ *  re-seeds it, so switching never produces a step from stale state.
+ *
+ * @param[in] filter
+ *  Filter instance.
+ *
+ * @param[in] coef
+ *  Coefficients (a preset, or a caller-owned set that outlives the filter).
+ ******************************************************************************/
+void filter_select(FILTER_STRUCT *filter, const FILTER_COEF_STRUCT *coef)
+{
+  EFM_ASSERT(coef->taps <= FILTER_FIR_TAPS_MAX);
+
+  memset(filter, 0, sizeof(FILTER_STRUCT));
+  filter->coef = coef;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Runs one sample through a filter.
+ *
+ * @details
+ *  Called once per sample in the measurement completion path. The first
+ *  sample after filter_select() fills the history with itself, so the output
+ *  starts at the first reading instead of ramping up from zero.
+ *
+ * @param[in] filter
+ *  Filter instance.
+ *
+ * @param[in] sample
+ *  New sample, in centi-units.
+ *
+ * @return
+ *  Returns the filtered value, in centi-units.
+ ******************************************************************************/
+int32_t filter_step(FILTER_STRUCT *filter, int32_t sample)
+{
+  if(!filter->primed)
+  {
+    filter_prime(filter, sample);
+  }
+
+  switch(filter->coef->type)
+  {
+    case filterTypeFir:
+      filter->out = filter_fir(filter, sample);
+      break;
+
+    case filterTypeBiquad:
+      filter->out = filter_biquad(filter, sample);
+      break;
+
+    default:
+      filter->out = sample;
+      break;
+  }
+
+  return filter->out;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Accessor for a filter's latest output.
+ *
+ * @param[in] filter
+ *  Filter instance.
+ *
+ * @return
+ *  Returns the latest filtered value, in centi-units.
+ ******************************************************************************/
+int32_t filter_output(const FILTER_STRUCT *filter)
+{
+  return filter->out;
+}
+
+
+/******************************************************************************
+ ***************************** PRIVATE FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Seeds the filter state as if the input had always been sample.
+ *
+ * @param[in] filter
+ *  Filter instance.
+ *
+ * @param[in] sample
+ *  First sample, in centi-units.
+ ******************************************************************************/
+void filter_prime(FILTER_STRUCT *filter, int32_t sample)
+{
+  uint32_t i;
+
+  for(i = 0; i < FILTER_FIR_TAPS_MAX; i++)
+  {
+    filter->x[i] = sample;
+  }
+  filter->y[0] = sample;
+  filter->y[1] = sample;
+  filter->err = 0;
+  filter->head = 0;
+  filter->out = sample;
+  filter->primed = true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  FIR step over the circular history buffer.
+ *
+ * @details
+ *  The newest sample overwrites the oldest; coef[0] weights the newest.
+ *
+ * @param[in] filter
+ *  Filter instance.
+ *
+ * @param[in] sample
+ *  New sample, in centi-units.
+ *
+ * @return
+ *  Returns the rounded output, in centi-units.
+ ******************************************************************************/
+int32_t filter_fir(FILTER_STRUCT *filter, int32_t sample)
+{
+  const int16_t *coef = filter->coef->coef;
+  uint32_t idx;
+  uint32_t k;
+  int32_t acc = 1 << (FILTER_Q - 1);
+
+  // advance the head and store the newest sample
+  filter->head = (filter->head + 1) % FILTER_FIR_TAPS_MAX;
+  filter->x[filter->head] = sample;
+
+  // walk backwards in time from the newest sample
+  idx = filter->head;
+  for(k = 0; k < filter->coef->taps; k++)
+  {
+    acc += coef[k] * filter->x[idx];
+    idx = (idx + FILTER_FIR_TAPS_MAX - 1) % FILTER_FIR_TAPS_MAX;
+  }
+
+  return acc >> FILTER_Q;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Biquad step (direct form I).
+ *
+ * @details
+ *  The low-pass presets put their poles close to z = 1, which multiplies
+ *  any rounding bias by up to 1 / (1 + a1 + a2). The bits lost by the final
+ *  shift are carried into the next step (error feedback), so a constant
+ *  input settles to exactly itself.
+ *
+ * @param[in] filter
+ *  Filter instance.
+ *
+ * @param[in] sample
+ *  New sample, in centi-units.
+ *
+ * @return
+ *  Returns the output, in centi-units.
+ ******************************************************************************/
+int32_t filter_biquad(FILTER_STRUCT *filter, int32_t sample)
+{
+  const int16_t *c = filter->coef->coef;
+  int64_t acc;
+  int32_t y;
+
+  acc = ((int64_t)c[0] * sample) + ((int64_t)c[1] * filter->x[0]) + ((int64_t)c[2] * filter->x[1])
+      - ((int64_t)c[3] * filter->y[0]) - ((int64_t)c[4] * filter->y[1]) + filter->err;
+
+  y = (int32_t)(acc >> FILTER_Q);
+  filter->err = (int32_t)(acc - ((int64_t)y << FILTER_Q));
+
+  // shift the delay lines
+  filter->x[1] = filter->x[0];
+  filter->x[0] = sample;
+  filter->y[1] = filter->y[0];
+  filter->y[0] = y;
+
+  return y;
+}
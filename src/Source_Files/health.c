@@ -0,0 +1,212 @@
+/***************************************************************************//**
+ * @file
+ *   health.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Per-sensor health tracking with exponential probe backoff
+ *
+ * @details
+ *   Each sample cycle ends in health_report() with whether the sensor
+ *   answered. A sensor that misses a sample is degraded but still sampled;
+ *   after HEALTH_FAIL_MISSES misses in a row it is failed and the sample
+ *   pipeline skips it. A failed sensor is probed with one ordinary sample
+ *   after `backoff` cycles: if it answers it is healthy again, if not the
+ *   backoff doubles, up to HEALTH_BACKOFF_MAX.
+ *
+ *   healthy  -- miss -->                       degraded
+ *   degraded -- ok -->                         healthy
+ *   degraded -- HEALTH_FAIL_MISSES misses -->  failed
+ *   failed   -- backoff cycles skipped -->     probing
+ *   probing  -- ok -->                         healthy
+ *   probing  -- miss -->                       failed, backoff doubled
+ *
+ *   Called from scheduler callbacks only, so nothing here needs masking.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "health.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static void health_set_state(HEALTH_STRUCT *health, HEALTH_STATE_Typedef state);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Opens a health tracker.
+ *
+ * @details
+ *  The sensor starts healthy: it is sampled from the first cycle and fails
+ *  within HEALTH_FAIL_MISSES cycles if it is not there.
+ *
+ * @param[in] health
+ *  Tracker instance (statically allocated by the caller).
+ *
+ * @param[in] id
+ *  Sensor id for the trace.
+ ******************************************************************************/
+void health_open(HEALTH_STRUCT *health, uint8_t id)
+{
+  memset(health, 0, sizeof(HEALTH_STRUCT));
+  health->id = id;
+  health->state = healthHealthy;
+  health->backoff = HEALTH_BACKOFF_MIN;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Decides whether the sensor is sampled this cycle.
+ *
+ * @details
+ *  Called once per sample cycle. A failed sensor counts its backoff down
+ *  and becomes a probe when it expires; the probe is an ordinary sample.
+ *
+ * @param[in] health
+ *  Tracker instance.
+ *
+ * @return
+ *  Returns true if the sensor should be sampled.
+ ******************************************************************************/
+bool health_sample_due(HEALTH_STRUCT *health)
+{
+  if(health->state != healthFailed)
+  {
+    return true;
+  }
+
+  if(health->wait > 1)
+  {
+    health->wait--;
+    health->skipped++;
+    return false;
+  }
+
+  health->probes++;
+  health_set_state(health, healthProbing);
+
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reports the outcome of a sample.
+ *
+ * @param[in] health
+ *  Tracker instance.
+ *
+ * @param[in] ok
+ *  True if the sensor answered every transaction of the sample.
+ ******************************************************************************/
+void health_report(HEALTH_STRUCT *health, bool ok)
+{
+  if(ok)
+  {
+    health->misses = 0;
+    health->backoff = HEALTH_BACKOFF_MIN;
+    health_set_state(health, healthHealthy);
+    return;
+  }
+
+  if(health->misses < UINT8_MAX)
+  {
+    health->misses++;
+  }
+
+  switch(health->state)
+  {
+    case healthHealthy:
+    case healthDegraded:
+      if(health->misses < HEALTH_FAIL_MISSES)
+      {
+        health_set_state(health, healthDegraded);
+        break;
+      }
+
+      health->failures++;
+      health->backoff = HEALTH_BACKOFF_MIN;
+      health->wait = health->backoff;
+      health_set_state(health, healthFailed);
+      break;
+
+    case healthProbing:
+      // still gone: wait twice as long before the next probe
+      if(health->backoff < HEALTH_BACKOFF_MAX)
+      {
+        health->backoff *= 2;
+      }
+      health->wait = health->backoff;
+      health_set_state(health, healthFailed);
+      break;
+
+    default:
+      // a failed sensor is not sampled, so it cannot miss; entering the
+      // default indicates a report without health_sample_due()
+      EFM_ASSERT(false);
+      break;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads a sensor's health state.
+ *
+ * @param[in] health
+ *  Tracker instance.
+ *
+ * @return
+ *  Returns the current state.
+ ******************************************************************************/
+HEALTH_STATE_Typedef health_state(const HEALTH_STRUCT *health)
+{
+  return health->state;
+}
+
+
+/******************************************************************************
+ ***************************** PRIVATE FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Changes state, logging the change to the trace.
+ *
+ * @param[in] health
+ *  Tracker instance.
+ *
+ * @param[in] state
+ *  New state.
+ ******************************************************************************/
+void health_set_state(HEALTH_STRUCT *health, HEALTH_STATE_Typedef state)
+{
+  if(health->state != state)
+  {
+    health->state = state;
+    trace_event(traceHealth, TRACE_HEALTH_ARG(health->id, state));
+  }
+}
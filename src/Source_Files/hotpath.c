@@ -0,0 +1,74 @@
+/***************************************************************************//**
+ * @file
+ *   hotpath.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Flash instruction cache setup for the code left in flash
+ *
+ * @details
+ *   The IRQ handlers, the I2C state machine and the scheduler post run from
+ *   RAM (hotpath.h). What they call into (trace, sleep blocks, sensor
+ *   parsing, emlib) stays in flash and is served by the instruction cache.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "hotpath.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+/***************************************************************************//**
+ * @brief
+ *   Configures the flash instruction cache
+ *
+ * @details
+ *   Enabled:
+ *   - Instruction cache (IFCDIS clear)
+ *   - Caching in interrupt context (ICCDIS clear); the handlers are in RAM,
+ *     but the flash code they call is as hot as they are
+ *   - Prefetch of the next flash word, for the straight-line code the
+ *     handlers call (trace encoding, CRC)
+ *
+ *   Unchanged:
+ *   - Automatic invalidate on flash writes (AIDIS clear); the sample log
+ *     and calibration store write flash at run time
+ *   - Wait states, set by emlib for the HFCLK frequency
+ *
+ * @note
+ *   Call before the peripherals are opened, so their first interrupts run
+ *   with the cache configured.
+ *
+ ******************************************************************************/
+void hotpath_open(void)
+{
+  uint32_t readctrl;
+
+  readctrl = MSC->READCTRL;
+
+  // cache on, also for interrupt context
+  readctrl &= ~(MSC_READCTRL_IFCDIS | MSC_READCTRL_ICCDIS | MSC_READCTRL_AIDIS);
+
+  // prefetch for sequential flash code
+  readctrl |= MSC_READCTRL_PREFETCH;
+
+  MSC->READCTRL = readctrl;
+
+  // start from an empty cache
+  MSC->CACHECMD = MSC_CACHECMD_INVCACHE;
+}
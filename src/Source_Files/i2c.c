@@ -20,6 +20,14 @@
 //***********************************************************************************
 static volatile I2C_SM_STRUCT i2c0_sm;
 static volatile I2C_SM_STRUCT i2c1_sm;
+static uint32_t i2c_backoff_seed;       // xorshift state for randomised retry backoff
+static bool i2c_backoff_running;        // true while the backoff timer is clocked and counting
+static I2C_QUEUE_STRUCT i2c0_queue;
+static I2C_QUEUE_STRUCT i2c1_queue;
+static I2C_PRIO_STATS_STRUCT i2c_prio_stats[i2cPrioClasses];
+static I2C_CONTEXT_STRUCT i2c0_context;
+static I2C_CONTEXT_STRUCT i2c1_context;
+static I2C_TIMER_CONTEXT_STRUCT i2c_timer_context;
 
 
 //***********************************************************************************
@@ -27,11 +35,34 @@ static volatile I2C_SM_STRUCT i2c1_sm;
 //***********************************************************************************
 /* I2C bus functions */
 static void i2c_bus_reset(I2C_TypeDef *i2c);
+static void i2c_trace(I2C_TypeDef *i2c, TRACE_KIND_Typedef kind, uint32_t byte);
 /* Interrupt driven static state machine functions */
-static void i2cn_ack_sm(volatile I2C_SM_STRUCT *i2c_sm);
-static void i2cn_nack_sm(volatile I2C_SM_STRUCT *i2c_sm);
-static void i2cn_rxdata_sm(volatile I2C_SM_STRUCT *i2c_sm);
-static void i2cn_mstop_sm(volatile I2C_SM_STRUCT *i2c_sm);
+static HOTPATH_DECLARATOR void i2cn_ack_sm(volatile I2C_SM_STRUCT *i2c_sm);
+static HOTPATH_DECLARATOR void i2cn_nack_sm(volatile I2C_SM_STRUCT *i2c_sm, uint32_t cc);
+static HOTPATH_DECLARATOR void i2cn_rxdata_sm(volatile I2C_SM_STRUCT *i2c_sm);
+static HOTPATH_DECLARATOR void i2cn_mstop_sm(volatile I2C_SM_STRUCT *i2c_sm);
+static void i2cn_bus_fault_sm(volatile I2C_SM_STRUCT *i2c_sm, uint32_t cc);
+/* arbitration loss / bus error retry functions */
+static void i2c_save_start(volatile I2C_SM_STRUCT *i2c_sm);
+static void i2c_restart(volatile I2C_SM_STRUCT *i2c_sm);
+static void i2c_nack_retry(volatile I2C_SM_STRUCT *i2c_sm);
+static bool i2c_nack_give_up(volatile I2C_SM_STRUCT *i2c_sm);
+static void i2c_timer_arm(uint32_t cc, uint32_t us);
+static void i2c_timer_disarm(uint32_t cc);
+static uint32_t i2c_backoff_rand(void);
+/* transaction queue functions */
+static volatile I2C_SM_STRUCT *i2c_get_sm(I2C_TypeDef *i2c);
+static I2C_QUEUE_STRUCT *i2c_get_queue(I2C_TypeDef *i2c);
+static bool i2c_may_start(I2C_QUEUE_STRUCT *queue, volatile I2C_SM_STRUCT *i2c_sm);
+static void i2c_start(volatile I2C_SM_STRUCT *i2c_sm, I2C_QUEUE_STRUCT *queue);
+static void i2c_dispatch(volatile I2C_SM_STRUCT *i2c_sm, I2C_QUEUE_STRUCT *queue);
+static void i2c_submit(volatile I2C_SM_STRUCT *i2c_sm);
+static void i2c_cancel(I2C_TypeDef *i2c, volatile bool *done);
+static I2C_CLAIM_STRUCT *i2c_get_claim(I2C_QUEUE_STRUCT *queue, uint32_t token);
+static bool i2c_claim_done(I2C_QUEUE_STRUCT *queue, I2C_CLAIM_STRUCT *claim);
+
+static I2C_CONTEXT_STRUCT *i2c_get_context(I2C_TypeDef *i2c);
+static void i2c_clock_enable(I2C_TypeDef *i2c, bool enable);
 /* static transmission functions */
 static void tx_cmd_msb(volatile I2C_SM_STRUCT *i2c_sm);
 static uint8_t i2c_split_tx(volatile uint32_t *cmd);
@@ -70,21 +101,9 @@ void i2c_open(I2C_TypeDef *i2c, I2C_OPEN_STRUCT *app_i2c_open)
   // instantiate a local I2C_Init struct
   I2C_Init_TypeDef i2c_init_values;
 
-  // if the address of i2c is equal to the base address of the
-  // I2C0 base peripheral ...
-  if(i2c == I2C0)
-  {
-      // ... enable I2C0 clock
-      CMU_ClockEnable(cmuClock_I2C0, true);
-  }
-
-  // if the address of i2c is equal to the base address of the
-  // I2C1 base peripheral ...
-  if(i2c == I2C1)
-  {
-      // ... enable I2C1 clock
-      CMU_ClockEnable(cmuClock_I2C1, true);
-  }
+  // enable the I2Cn clock
+  i2c_clock_enable(i2c, true);
+  i2c_get_context(i2c)->suspended = false;
 
   // if START interrupt flag not set ...
   if(!(i2c->IF & I2C_IFS_START))
@@ -109,6 +128,23 @@ void i2c_open(I2C_TypeDef *i2c, I2C_OPEN_STRUCT *app_i2c_open)
   // initialize I2C peripheral
   I2C_Init(i2c, &i2c_init_values);
 
+  // treat the bus as idle after a period of inactivity so a START
+  // is not held off forever by another master that went away
+  i2c->CTRL |= I2C_BUS_IDLE_TIMEOUT;
+
+  // nothing queued and no sequence owns the bus
+  i2c_get_queue(i2c)->claims = 0;
+
+  // bus interrupts are the most urgent tier (enabled on submit)
+  NVIC_SetPriority((i2c == I2C0) ? I2C0_IRQn : I2C1_IRQn, IRQ_PRIO_I2C);
+
+  // seed the backoff generator from the unique ID so two nodes
+  // sharing a bus do not retry in lock-step
+  if(i2c_backoff_seed == 0)
+  {
+      i2c_backoff_seed = (DEVINFO->UNIQUEL ^ DEVINFO->UNIQUEH) | 1;
+  }
+
   // set route location for SDA and SCL
   i2c->ROUTELOC0 |= app_i2c_open->sda_loc;
   i2c->ROUTELOC0 |= app_i2c_open->scl_loc;
@@ -119,6 +155,9 @@ void i2c_open(I2C_TypeDef *i2c, I2C_OPEN_STRUCT *app_i2c_open)
 
   // reset the I2C bus
   i2c_bus_reset(i2c);
+
+  // idle until the first submission
+  i2c_suspend(i2c);
 }
 
 
@@ -132,7 +171,11 @@ void i2c_open(I2C_TypeDef *i2c, I2C_OPEN_STRUCT *app_i2c_open)
  *  Initializes an I2C state machine.
  *
  * @details
- *  Initializes and starts the requested I2C state machine.
+ *  Submits a transaction to its bus. If the bus is free (and not owned by
+ *  another sequence, see i2c_acquire()) the transaction is started right
+ *  away; otherwise it is queued behind its priority class and started by
+ *  the MSTOP state at the next STOP boundary. The caller never spins on
+ *  a busy bus.
  *
  * @param[in] i2c_sm
  *  Pointer to desired I2C state machine, which has previously been
@@ -140,57 +183,181 @@ void i2c_open(I2C_TypeDef *i2c, I2C_OPEN_STRUCT *app_i2c_open)
  ******************************************************************************/
 void i2c_init_sm(volatile I2C_SM_STRUCT *i2c_sm)
 {
+  // submit the transaction; the state machine runs from here in the
+  // I2C interrupts, so the caller returns at once
+  i2c_submit(i2c_sm);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Runs an I2C transaction to completion.
+ *
+ * @details
+ *  Submits the transaction like i2c_init_sm() and parks the core in EM1
+ *  until its MSTOP sets the completion flag, so init and diagnostic code
+ *  can be written linearly without a callback bit per step and without
+ *  spinning in EM0. The I2C and backoff timer interrupts wake the core;
+ *  the sync channel of the backoff timer bounds each sleep so the timeout
+ *  is honoured even when the bus is silent.
+ *
+ *  On timeout the transaction is cancelled: it is removed from the queue,
+ *  or aborted with a bus reset if it already started.
+ *
+ * @note
+ *  Must be called from thread (main loop) context, never from an ISR.
+ *
+ * @param[in] i2c_sm
+ *  Pointer to desired I2C state machine, which has previously been
+ *  initialized. i2c_cb may be I2C_NO_CB.
+ *
+ * @param[in] timeout_ms
+ *  Time, in milliseconds, to wait for completion.
+ *
+ * @return
+ *  True if the transaction completed; false on timeout.
+ ******************************************************************************/
+bool i2c_transfer_sync(volatile I2C_SM_STRUCT *i2c_sm, uint32_t timeout_ms)
+{
+  volatile bool done = false;
+  uint32_t timeout = (timeout_ms * LETIMER_HZ) / 1000;
+  uint32_t start;
+  uint32_t elapsed;
+
+  // point the completion flag at this stack frame
+  i2c_sm->done = &done;
+
+  // submit the transaction
+  start = letimer_uptime();
+  i2c_submit(i2c_sm);
+
+  // make atomic by disallowing interrupts; PRIMASK rather than BASEPRI,
+  // since WFI does not wake on an interrupt BASEPRI masks
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  while(!done)
+  {
+      elapsed = letimer_uptime() - start;
+
+      // give up on timeout
+      if(elapsed >= timeout)
+      {
+          i2c_cancel(i2c_sm->I2Cn, &done);
+          break;
+      }
+
+      // bound the sleep so the timeout is checked even on a silent bus
+      if(((timeout - elapsed) * 1000) / LETIMER_HZ < I2C_SYNC_POLL_MS)
+      {
+          i2c_timer_arm(I2C_SYNC_CC, (((timeout - elapsed) * 1000) / LETIMER_HZ) * 1000);
+      }
+      else
+      {
+          i2c_timer_arm(I2C_SYNC_CC, I2C_SYNC_POLL_MS * 1000);
+      }
+
+      // WFI wakes on a pending interrupt even while masked; it is serviced
+      // as soon as interrupts are allowed again
+      EMU_EnterEM1();
+      CORE_EXIT_CRITICAL();
+      CORE_ENTER_CRITICAL();
+  }
+
+  // exit core critical to allow interrupts
+  CORE_EXIT_CRITICAL();
+
+  // stop the timeout channel
+  i2c_timer_disarm(I2C_SYNC_CC);
+
+  return done;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Submits an I2C transaction to its bus.
+ *
+ * @details
+ *  Starts the transaction right away if the bus is free, otherwise
+ *  queues it behind its priority class. Each driver has one transaction
+ *  in flight at a time, so I2C_QUEUE_DEPTH is never reached; a full
+ *  queue is a logic error and the transaction is dropped rather than
+ *  waited on, since the ISR that drains it may be the one masked.
+ *
+ * @param[in] i2c_sm
+ *  Pointer to desired I2C state machine, which has previously been
+ *  initialized.
+ ******************************************************************************/
+static void i2c_submit(volatile I2C_SM_STRUCT *i2c_sm)
+{
+  volatile I2C_SM_STRUCT *bus_sm = i2c_get_sm(i2c_sm->I2Cn);
+  I2C_QUEUE_STRUCT *queue = i2c_get_queue(i2c_sm->I2Cn);
+  I2C_CLAIM_STRUCT *claim;
+
   // the I2C peripheral cannot cannot go below EM2
   sleep_block_mode(I2C_EM_BLOCK);
 
-  // set busy bit
+  // set busy bit and time stamp the submission
   i2c_sm->busy = I2C_BUS_BUSY;
+  i2c_sm->submit_time = letimer_uptime();
 
-  // enable interrupts
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  // wake the peripheral if it went idle and enable interrupts; under the
+  // mask so an MSTOP cannot suspend it in between
+  i2c_resume(i2c_sm->I2Cn);
   i2c_sm->I2Cn->IEN = I2C_IEN_MASK;
 
-  // if starting the I2C0 peripheral ...
-  if(i2c_sm->I2Cn == I2C0)
+  // count the transaction against its sequence's claim
+  claim = i2c_get_claim(queue, i2c_sm->token);
+  EFM_ASSERT(claim || (i2c_sm->token == I2C_NO_TOKEN));
+  if(claim)
   {
-      // halt until bus is ready
-      while(i2c0_sm.busy);
-
-      // make atomic by disallowing interrupts
-      CORE_DECLARE_IRQ_STATE;
-      CORE_ENTER_CRITICAL();
+      claim->pending++;
+  }
 
-      // initialize I2C0 state machine
-      i2c0_sm = *i2c_sm;
+  // if the bus is free and this transaction may use it ...
+  if(!bus_sm->busy && i2c_may_start(queue, i2c_sm))
+  {
+      // ... initialize the state machine and start it now
+      *bus_sm = *i2c_sm;
+      i2c_start(bus_sm, queue);
+  }
+  // ... else queue it behind its priority class
+  else if(queue->count[i2c_sm->prio] < I2C_QUEUE_DEPTH)
+  {
+      queue->pending[i2c_sm->prio][queue->count[i2c_sm->prio]++] = *i2c_sm;
+  }
+  // ... else the class queue is full. Sized for every driver's transaction
+  // in flight, so this is a logic error. EFM_ASSERT for debugging.
+  else
+  {
+      EFM_ASSERT(false);
+      if(claim)
+      {
+          claim->pending--;
+      }
+      i2c_sm->busy = I2C_BUS_READY;
+      sleep_unblock_mode(I2C_EM_BLOCK);
+  }
 
-      // exit core critical to allow interrupts
-      CORE_EXIT_CRITICAL();
-      CORE_EXIT_CRITICAL();
+  // allow interrupts
+  IRQ_EXIT_MASK();
 
+  // if starting the I2C0 peripheral ...
+  if(i2c_sm->I2Cn == I2C0)
+  {
       NVIC_EnableIRQ(I2C0_IRQn);
   }
 
   // if starting the I2C1 peripheral ...
   if(i2c_sm->I2Cn == I2C1)
   {
-      // halt until bus is ready
-      while(i2c1_sm.busy);
-
-      // make atomic by disallowing interrupts
-      CORE_DECLARE_IRQ_STATE;
-      CORE_ENTER_CRITICAL();
-
-      // initialize I2C1 state machine
-      i2c1_sm = *i2c_sm;
-
-      // exit core critical to allow interrupts
-      CORE_EXIT_CRITICAL();
-      CORE_EXIT_CRITICAL();
-
       NVIC_EnableIRQ(I2C1_IRQn);
   }
-
-  // 80ms timer delay to ensure RWM sync
-  timer_delay(I2C_80MS_DELAY);
 }
 
 
@@ -227,6 +394,7 @@ void i2c_tx_req(volatile I2C_SM_STRUCT *i2c_sm, I2C_RW_Typedef rw)
 
   // transmit header packet
   *i2c_sm->txdata = req_packet;
+  i2c_trace(i2c_sm->I2Cn, traceI2cStart, req_packet);
 }
 
 
@@ -394,6 +562,7 @@ void i2c_tx_cmd(volatile I2C_SM_STRUCT *i2c_sm, uint32_t tx_cmd)
 {
   // transmit command via TXDATA
   *i2c_sm->txdata = tx_cmd;
+  i2c_trace(i2c_sm->I2Cn, traceI2cTx, tx_cmd);
 }
 
 
@@ -452,6 +621,25 @@ void i2c_bus_reset(I2C_TypeDef *i2c)
 }
 
 
+/***************************************************************************//**
+ * @brief
+ *  Records an I2C bus event in the trace ring.
+ *
+ * @param[in] i2c
+ *  I2C peripheral the event happened on.
+ *
+ * @param[in] kind
+ *  Event kind.
+ *
+ * @param[in] byte
+ *  Byte sent or received (0 if none).
+ ******************************************************************************/
+void i2c_trace(I2C_TypeDef *i2c, TRACE_KIND_Typedef kind, uint32_t byte)
+{
+  trace_event(kind, TRACE_I2C_ARG((i2c == I2C1) ? 1u : 0u, byte));
+}
+
+
 /******************************************************************************
  ***************************** INTERRUPT HANDLERS *****************************
  ******************************************************************************/
@@ -462,40 +650,60 @@ void i2c_bus_reset(I2C_TypeDef *i2c)
  *  I2C0 peripheral IRQ Handler
  *
  * @details
- *  Handles ACK, NACK, RXDATAV, and MSTOP interrupts for the I2C0 peripheral
+ *  Handles ACK, NACK, RXDATAV, and MSTOP interrupts for the I2C0 peripheral.
+ *  An arbitration loss or bus error pre-empts all other flags.
  ******************************************************************************/
+HOTPATH_DEFINITION_BEGIN
 void I2C0_IRQHandler(void)
 {
+  BENCH_ISR_ENTER(benchIsrI2c0);
+
   // save flags that are both enabled and raised
   uint32_t intflags = (I2C0->IF & I2C0->IEN);
 
   // lower flags
   I2C0->IFC = intflags;
 
+  // handle ARBLOST / BUSERR; any other flags belong to the aborted transfer
+  if(intflags & I2C_IF_BUS_FAULT)
+  {
+      i2c_trace(I2C0, (intflags & I2C_IF_ARBLOST) ? traceI2cArbLost : traceI2cBusErr, 0);
+      i2cn_bus_fault_sm(&i2c0_sm, I2C0_BACKOFF_CC);
+      BENCH_ISR_EXIT(benchIsrI2c0);
+      return;
+  }
+
   // handle ACK
   if(intflags & I2C_IF_ACK)
   {
+      i2c_trace(I2C0, traceI2cAck, 0);
       i2cn_ack_sm(&i2c0_sm);
   }
 
   // handle NACK
   if(intflags & I2C_IF_NACK)
   {
-      i2cn_nack_sm(&i2c0_sm);
+      i2c_trace(I2C0, traceI2cNack, 0);
+      i2cn_nack_sm(&i2c0_sm, I2C0_BACKOFF_CC);
   }
 
   // handle RXDATAV
   if(intflags & I2C_IF_RXDATAV)
   {
+      i2c_trace(I2C0, traceI2cRxData, I2C0->RXDATAP);
       i2cn_rxdata_sm(&i2c0_sm);
   }
 
   // handle MSTOP
   if(intflags & I2C_IF_MSTOP)
   {
+      i2c_trace(I2C0, traceI2cMstop, 0);
       i2cn_mstop_sm(&i2c0_sm);
   }
+
+  BENCH_ISR_EXIT(benchIsrI2c0);
 }
+HOTPATH_DEFINITION_END
 
 
 /***************************************************************************//**
@@ -503,40 +711,60 @@ void I2C0_IRQHandler(void)
  *  I2C1 peripheral IRQ Handler
  *
  * @details
- *  Handles ACK, NACK, RXDATAV, and MSTOP interrupts for the I2C1 peripheral
+ *  Handles ACK, NACK, RXDATAV, and MSTOP interrupts for the I2C1 peripheral.
+ *  An arbitration loss or bus error pre-empts all other flags.
  ******************************************************************************/
+HOTPATH_DEFINITION_BEGIN
 void I2C1_IRQHandler(void)
 {
+  BENCH_ISR_ENTER(benchIsrI2c1);
+
   // save flags that are both enabled and raised
   uint32_t intflags = (I2C1->IF & I2C1->IEN);
 
   // lower flags
   I2C1->IFC = intflags;
 
+  // handle ARBLOST / BUSERR; any other flags belong to the aborted transfer
+  if(intflags & I2C_IF_BUS_FAULT)
+  {
+      i2c_trace(I2C1, (intflags & I2C_IF_ARBLOST) ? traceI2cArbLost : traceI2cBusErr, 0);
+      i2cn_bus_fault_sm(&i2c1_sm, I2C1_BACKOFF_CC);
+      BENCH_ISR_EXIT(benchIsrI2c1);
+      return;
+  }
+
   // handle ACK
   if(intflags & I2C_IF_ACK)
   {
+    i2c_trace(I2C1, traceI2cAck, 0);
     i2cn_ack_sm(&i2c1_sm);
   }
 
   // handle NACK
   if(intflags & I2C_IF_NACK)
   {
-      i2cn_nack_sm(&i2c1_sm);
+      i2c_trace(I2C1, traceI2cNack, 0);
+      i2cn_nack_sm(&i2c1_sm, I2C1_BACKOFF_CC);
   }
 
   // handle RXDATA
   if(intflags & I2C_IF_RXDATAV)
   {
+      i2c_trace(I2C1, traceI2cRxData, I2C1->RXDATAP);
       i2cn_rxdata_sm(&i2c1_sm);
   }
 
   // handle MSTOP
   if(intflags & I2C_IF_MSTOP)
   {
+      i2c_trace(I2C1, traceI2cMstop, 0);
       i2cn_mstop_sm(&i2c1_sm);
   }
+
+  BENCH_ISR_EXIT(benchIsrI2c1);
 }
+HOTPATH_DEFINITION_END
 
 
 /******************************************************************************
@@ -556,11 +784,12 @@ void I2C1_IRQHandler(void)
  *  Pointer to desired I2C state machine, which has previously been
  *  initialized.
  ******************************************************************************/
+HOTPATH_DEFINITION_BEGIN
 void i2cn_ack_sm(volatile I2C_SM_STRUCT *i2c_sm)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   switch(i2c_sm->curr_state)
   {
@@ -679,12 +908,10 @@ void i2cn_ack_sm(volatile I2C_SM_STRUCT *i2c_sm)
       break;
   }
 
-  // 80ms timer delay for RWM sync
-  timer_delay(80);
-
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // allow interrupts
+  IRQ_EXIT_MASK();
 }
+HOTPATH_DEFINITION_END
 
 
 /***************************************************************************//**
@@ -695,15 +922,44 @@ void i2cn_ack_sm(volatile I2C_SM_STRUCT *i2c_sm)
  *  State machine function for a NACK interrupt. Handles NACKs for the
  *  Request Resource, Command Transmit, and Data Request states.
  *
+ *  NACKs are retried, but not forever: a missing or wedged device is given
+ *  up on after I2C_NACK_LIMIT address/command NACKs, and a conversion poll
+ *  after I2C_POLL_TIMEOUT_MS (see i2c_nack_give_up()).
+ *
+ *  The handler never waits: the re-send is armed on the bus's backoff timer
+ *  channel and issued from TIMER1_IRQHandler by i2c_nack_retry(), so the
+ *  I2C tier (shared by both buses) is only masked for the bookkeeping.
+ *
  * @param[in] i2c_sm
  *  Pointer to desired I2C state machine, which has previously been
  *  initialized.
+ *
+ * @param[in] cc
+ *  Backoff timer compare channel belonging to this I2C peripheral.
  ******************************************************************************/
-void i2cn_nack_sm(volatile I2C_SM_STRUCT *i2c_sm)
+HOTPATH_DEFINITION_BEGIN
+void i2cn_nack_sm(volatile I2C_SM_STRUCT *i2c_sm, uint32_t cc)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  // a device that stops answering is given up on; the STOP completes the
+  // transaction so the bus is freed and the caller learns the outcome
+  if(i2c_nack_give_up(i2c_sm))
+  {
+      i2c_sm->abandoned = true;
+
+      // change state
+      i2c_sm->curr_state = mStop;
+
+      // transmit stop
+      i2c_tx_stop(i2c_sm);
+
+      // allow interrupts
+      IRQ_EXIT_MASK();
+      return;
+  }
 
   switch(i2c_sm->curr_state)
   {
@@ -718,38 +974,30 @@ void i2cn_nack_sm(volatile I2C_SM_STRUCT *i2c_sm)
           break;
       }
 
-      // send repeated start command
-      i2c_tx_req(i2c_sm, i2cWriteBit);
+      // re-send the request packet after the retry gap
+      i2c_sm->nack_retry = true;
+      i2c_timer_arm(cc, I2C_NACK_RETRY_US);
       break;
 
 
     case commandTx:
-      // set CMD CONT register
-      i2c_tx_cont(i2c_sm);
-
-      // re-send command
-      i2c_tx_cmd(i2c_sm, i2c_sm->tx_cmd);
+      // re-send the command after the retry gap
+      i2c_sm->nack_retry = true;
+      i2c_timer_arm(cc, I2C_NACK_RETRY_US);
       break;
 
 
     case dataReq:
-      if(i2c_sm->read_operation)
-      {
-          // re-send repeated start command
-          i2c_tx_req(i2c_sm, i2cReadBit);
-      }
-      else
+      if(!i2c_sm->read_operation && (i2c_sm->num_bytes == 2))
       {
-          if(i2c_sm->num_bytes == 2)
-          {
-              // change state
-              i2c_sm->curr_state = commandTx;
-          }
-          else
-          {
-              i2c_tx_req(i2c_sm, i2cWriteBit);
-          }
+          // change state
+          i2c_sm->curr_state = commandTx;
+          break;
       }
+
+      // re-send the request packet after the retry gap
+      i2c_sm->nack_retry = true;
+      i2c_timer_arm(cc, I2C_NACK_RETRY_US);
       break;
 
 
@@ -759,12 +1007,10 @@ void i2cn_nack_sm(volatile I2C_SM_STRUCT *i2c_sm)
       EFM_ASSERT(false);
   }
 
-  // 80ms timer delay for RWM sync
-  timer_delay(I2C_80MS_DELAY);
-
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // allow interrupts
+  IRQ_EXIT_MASK();
 }
+HOTPATH_DEFINITION_END
 
 
 /***************************************************************************//**
@@ -779,11 +1025,12 @@ void i2cn_nack_sm(volatile I2C_SM_STRUCT *i2c_sm)
  *  Pointer to desired I2C state machine, which has previously been
  *  initialized.
  ******************************************************************************/
+HOTPATH_DEFINITION_BEGIN
 void i2cn_rxdata_sm(volatile I2C_SM_STRUCT *i2c_sm)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   switch(i2c_sm->curr_state)
   {
@@ -893,12 +1140,10 @@ void i2cn_rxdata_sm(volatile I2C_SM_STRUCT *i2c_sm)
       break;
   }
 
-  // 80ms timer delay for RWM sync
-  timer_delay(13);
-
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // allow interrupts
+  IRQ_EXIT_MASK();
 }
+HOTPATH_DEFINITION_END
 
 
 /***************************************************************************//**
@@ -907,29 +1152,64 @@ void i2cn_rxdata_sm(volatile I2C_SM_STRUCT *i2c_sm)
  *
  * @details
  *  State machine function for an MSTOP. Handles MSTOPs for the MSTOP state.
- *  Since this is the end of an I2C transaction this function also releases
- *  the bus (unless a state machine has a hold), unblocks EM2, and
- *  schedules callbacks.
+ *  Since this is the end of an I2C transaction this function also resets
+ *  the bus (unless a sequence owns it and goes on), unblocks EM2,
+ *  schedules callbacks and starts the next queued transaction.
  *
  * @param[in] i2c_sm
  *  Pointer to desired I2C state machine, which has previously been
  *  initialized.
  ******************************************************************************/
+HOTPATH_DEFINITION_BEGIN
 void i2cn_mstop_sm(volatile I2C_SM_STRUCT *i2c_sm)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  I2C_QUEUE_STRUCT *queue = i2c_get_queue(i2c_sm->I2Cn);
+  I2C_CLAIM_STRUCT *claim;
+  bool owner;
+
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   switch(i2c_sm->curr_state)
   {
     case mStop:
-      if(!(i2c_sm->lock_sm))
+      claim = i2c_get_claim(queue, i2c_sm->token);
+      owner = (claim != NULL) && (claim == &queue->claim[0]);
+
+      if(claim)
+      {
+          claim->pending--;
+      }
+
+      // the owner's transactions keep the bus, without a reset, until its
+      // sequence ends; anything else (an urgent transaction that split the
+      // sequence included) is followed by a reset
+      if(owner && !i2c_claim_done(queue, claim))
+      {
+          queue->hold_split = i2c_sm->split_ok;
+      }
+      else
       {
           // reset the I2C bus
           i2c_bus_reset(i2c_sm->I2Cn);
       }
 
+      // transaction completed; clear retry count
+      i2c_sm->retries = 0;
+
+      // report the outcome
+      if(i2c_sm->result)
+      {
+          *i2c_sm->result = i2c_sm->abandoned ? i2cResultNoAck : i2cResultOk;
+      }
+
+      // wake a synchronous caller
+      if(i2c_sm->done)
+      {
+          *i2c_sm->done = true;
+      }
+
       // clear I2C State Machine busy bit
       i2c_sm->busy = I2C_BUS_READY;
 
@@ -938,6 +1218,9 @@ void i2cn_mstop_sm(volatile I2C_SM_STRUCT *i2c_sm)
 
       // unblock sleep
       sleep_unblock_mode(I2C_EM_BLOCK);
+
+      // STOP boundary: start the highest priority waiting transaction
+      i2c_dispatch(i2c_sm, queue);
       break;
 
     default:
@@ -946,10 +1229,1016 @@ void i2cn_mstop_sm(volatile I2C_SM_STRUCT *i2c_sm)
       EFM_ASSERT(false);
   }
 
-  // 80ms timer delay for RWM sync
-  timer_delay(13);
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+HOTPATH_DEFINITION_END
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+
+
+/***************************************************************************//**
+ * @brief
+ *  I2C arbitration lost / bus error state machine
+ *
+ * @details
+ *  Another master won arbitration or a misplaced START/STOP was seen on the
+ *  bus. The peripheral has already released SDA/SCL, so the transfer is
+ *  aborted and the whole transaction is re-issued after a randomised,
+ *  binary exponential backoff. The bus stays busy (and EM2 stays blocked)
+ *  for the state machine until the retry completes; nothing is handed back
+ *  to the caller. The contention window is capped rather than giving up so
+ *  a collision can never wedge the state machine.
+ *
+ * @param[in] i2c_sm
+ *  Pointer to desired I2C state machine, which has previously been
+ *  initialized.
+ *
+ * @param[in] cc
+ *  Backoff timer compare channel belonging to this I2C peripheral.
+ ******************************************************************************/
+static void i2cn_bus_fault_sm(volatile I2C_SM_STRUCT *i2c_sm, uint32_t cc)
+{
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  // abort whatever is left of the transfer and drop any queued byte
+  i2c_sm->I2Cn->CMD = I2C_CMD_ABORT;
+  i2c_sm->I2Cn->CMD = I2C_CMD_CLEARTX;
+
+  // a fault while only the bus reset STOP is outstanding still completes
+  if(i2c_sm->curr_state == mStop)
+  {
+      i2c_sm->I2Cn->IFS = I2C_IF_MSTOP;
+      IRQ_EXIT_MASK();
+      return;
+  }
+
+  // widen the contention window on every consecutive loss
+  if(i2c_sm->retries < I2C_BACKOFF_MAX_EXP)
+  {
+      i2c_sm->retries++;
+  }
+
+  // wait a random number of slots in [1, 2^retries] before retrying the
+  // whole transaction; this replaces a NACK retry that was still armed
+  i2c_sm->nack_retry = false;
+  i2c_timer_arm(cc, ((i2c_backoff_rand() & ((1u << i2c_sm->retries) - 1)) + 1) * I2C_BACKOFF_SLOT_US);
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/******************************************************************************
+ **************************** RETRY/BACKOFF FUNCTIONS *************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Saves the starting point of a transaction.
+ *
+ * @details
+ *  The state machine consumes tx_cmd, bytes_tx and num_bytes as it runs.
+ *  Their initial values are kept so the whole transaction can be replayed
+ *  after an arbitration loss or bus error.
+ *
+ * @param[in] i2c_sm
+ *  Pointer to desired I2C state machine, which has previously been
+ *  initialized.
+ ******************************************************************************/
+static void i2c_save_start(volatile I2C_SM_STRUCT *i2c_sm)
+{
+  i2c_sm->start_state = i2c_sm->curr_state;
+  i2c_sm->start_tx_cmd = i2c_sm->tx_cmd;
+  i2c_sm->start_bytes_tx = i2c_sm->bytes_tx;
+  i2c_sm->start_num_bytes = i2c_sm->num_bytes;
+  i2c_sm->retries = 0;
+  i2c_sm->abandoned = false;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Decides whether a NACKed transaction should be given up on.
+ *
+ * @details
+ *  A read header NACKed in the Data Request state is a conversion poll: the
+ *  device is busy and answers once its measurement is ready, so it gets
+ *  I2C_POLL_TIMEOUT_MS from the start of the transaction. Any other NACK
+ *  means the address or a command was not acknowledged; a part that is
+ *  missing, unpowered or wedged does that every time, so I2C_NACK_LIMIT of
+ *  them end the transaction instead of holding the bus forever.
+ *
+ * @param[in] i2c_sm
+ *  Pointer to desired I2C state machine, which has previously been
+ *  initialized.
+ *
+ * @return
+ *  Returns true if the transaction should be abandoned.
+ ******************************************************************************/
+static bool i2c_nack_give_up(volatile I2C_SM_STRUCT *i2c_sm)
+{
+  if((i2c_sm->curr_state == dataReq) && i2c_sm->read_operation)
+  {
+      return (letimer_uptime() - i2c_sm->start_time) >=
+             ((I2C_POLL_TIMEOUT_MS * LETIMER_HZ) / 1000);
+  }
+
+  i2c_sm->nacks++;
+
+  return i2c_sm->nacks >= I2C_NACK_LIMIT;
 }
 
+
+/***************************************************************************//**
+ * @brief
+ *  Re-issues a transaction from its beginning.
+ *
+ * @details
+ *  Restores the saved starting point, discards partially received data
+ *  and transmits the initial request packet again.
+ *
+ * @param[in] i2c_sm
+ *  Pointer to desired I2C state machine, which has previously been
+ *  initialized.
+ ******************************************************************************/
+static void i2c_restart(volatile I2C_SM_STRUCT *i2c_sm)
+{
+  // restore starting point
+  i2c_sm->curr_state = i2c_sm->start_state;
+  i2c_sm->tx_cmd = i2c_sm->start_tx_cmd;
+  i2c_sm->bytes_tx = i2c_sm->start_bytes_tx;
+  i2c_sm->num_bytes = i2c_sm->start_num_bytes;
+
+  // the device gets its full NACK allowance again; a re-sent command
+  // also restarts its conversion
+  i2c_sm->nacks = 0;
+  i2c_sm->nack_retry = false;
+  i2c_sm->start_time = letimer_uptime();
+
+  // received bytes are OR'd into place, so clear anything partial
+  if(i2c_sm->read_operation)
+  {
+      *i2c_sm->data = 0;
+
+      if(i2c_sm->checksum)
+      {
+          *i2c_sm->crc_data = 0;
+      }
+  }
+
+  // transmit start
+  i2c_tx_req(i2c_sm, i2c_sm->req_rw);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Re-sends the packet a device NACKed.
+ *
+ * @details
+ *  Issued from the backoff timer once I2C_NACK_RETRY_US has passed (see
+ *  i2cn_nack_sm()). Unlike i2c_restart() the transaction carries on from
+ *  the NACKed packet and keeps its NACK count and poll start time.
+ *
+ * @param[in] i2c_sm
+ *  Pointer to desired I2C state machine, which has previously been
+ *  initialized.
+ ******************************************************************************/
+static void i2c_nack_retry(volatile I2C_SM_STRUCT *i2c_sm)
+{
+  i2c_sm->nack_retry = false;
+
+  switch(i2c_sm->curr_state)
+  {
+    case reqRes:
+      // send repeated start command
+      i2c_tx_req(i2c_sm, i2cWriteBit);
+      break;
+
+
+    case commandTx:
+      // set CMD CONT register
+      i2c_tx_cont(i2c_sm);
+
+      // re-send command
+      i2c_tx_cmd(i2c_sm, i2c_sm->tx_cmd);
+      break;
+
+
+    case dataReq:
+      // re-send repeated start command
+      i2c_tx_req(i2c_sm, i2c_sm->read_operation ? i2cReadBit : i2cWriteBit);
+      break;
+
+
+    default:
+      // only the states above arm a NACK retry
+      EFM_ASSERT(false);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Arms a delay on one compare channel of the backoff timer.
+ *
+ * @details
+ *  The backoff timer free-runs while any channel is armed. Backoff retries
+ *  are issued from the timer interrupt so no CPU time or bus time is spent
+ *  while waiting; the sync channel only wakes the core.
+ *
+ * @param[in] cc
+ *  Compare channel to arm (one per I2C peripheral, plus the sync channel).
+ *
+ * @param[in] us
+ *  Delay in micro-seconds; must fit in one 16-bit timer period.
+ ******************************************************************************/
+static void i2c_timer_arm(uint32_t cc, uint32_t us)
+{
+  uint32_t ticks;
+
+  // if the timer is not already running for the other peripheral ...
+  if(!i2c_backoff_running)
+  {
+      // ... start it free running
+      CMU_ClockEnable(I2C_BACKOFF_CLK, true);
+
+      // configured before: write back the context cached when it stopped
+      if(i2c_timer_context.saved)
+      {
+          I2C_BACKOFF_TIMER->CTRL = i2c_timer_context.ctrl;
+          I2C_BACKOFF_TIMER->TOP = i2c_timer_context.top;
+          for(uint32_t n = 0; n < I2C_BACKOFF_CCS; n++)
+          {
+              I2C_BACKOFF_TIMER->CC[n].CTRL = i2c_timer_context.cc_ctrl[n];
+          }
+      }
+      // first use: full initialization
+      else
+      {
+          TIMER_Init_TypeDef backoff_init = TIMER_INIT_DEFAULT;
+          TIMER_InitCC_TypeDef backoff_cc_init = TIMER_INITCC_DEFAULT;
+
+          backoff_init.enable = false;
+          backoff_init.prescale = I2C_BACKOFF_PRESCALE;
+          TIMER_Init(I2C_BACKOFF_TIMER, &backoff_init);
+
+          backoff_cc_init.mode = timerCCModeCompare;
+          TIMER_InitCC(I2C_BACKOFF_TIMER, I2C0_BACKOFF_CC, &backoff_cc_init);
+          TIMER_InitCC(I2C_BACKOFF_TIMER, I2C1_BACKOFF_CC, &backoff_cc_init);
+          TIMER_InitCC(I2C_BACKOFF_TIMER, I2C_SYNC_CC, &backoff_cc_init);
+          TIMER_TopSet(I2C_BACKOFF_TIMER, I2C_BACKOFF_TOP);
+
+          NVIC_SetPriority(I2C_BACKOFF_IRQn, IRQ_PRIO_BACKOFF);
+          NVIC_EnableIRQ(I2C_BACKOFF_IRQn);
+      }
+
+      TIMER_Enable(I2C_BACKOFF_TIMER, true);
+      i2c_backoff_running = true;
+  }
+
+  // convert micro-seconds to timer ticks
+  ticks = (us * ((CMU_ClockFreqGet(cmuClock_HFPER) / I2C_BACKOFF_DIV) / 1000)) / 1000;
+
+  // arm the compare channel
+  TIMER_CompareSet(I2C_BACKOFF_TIMER, cc,
+                   (TIMER_CounterGet(I2C_BACKOFF_TIMER) + ticks + 1) & I2C_BACKOFF_TOP);
+  TIMER_IntClear(I2C_BACKOFF_TIMER, TIMER_IF_CC0 << cc);
+  TIMER_IntEnable(I2C_BACKOFF_TIMER, TIMER_IF_CC0 << cc);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Returns a pseudo-random number for backoff.
+ *
+ * @details
+ *  32-bit xorshift; cheap enough to run inside the fault interrupt.
+ *
+ * @return
+ *  Next pseudo-random number.
+ ******************************************************************************/
+static uint32_t i2c_backoff_rand(void)
+{
+  uint32_t x = i2c_backoff_seed;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+
+  i2c_backoff_seed = x;
+
+  return x;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Backoff timer IRQ Handler
+ *
+ * @details
+ *  Re-issues the transaction of each I2C peripheral whose backoff expired
+ *  and stops the timer once no peripheral is waiting.
+ ******************************************************************************/
+HOTPATH_DEFINITION_BEGIN
+void TIMER1_IRQHandler(void)
+{
+  BENCH_ISR_ENTER(benchIsrTimer1);
+
+  // save flags that are both enabled and raised
+  uint32_t intflags = TIMER_IntGetEnabled(I2C_BACKOFF_TIMER);
+
+  trace_event(traceIrq, traceIrqTimer1);
+
+  // lower flags and disarm the channels that fired; the sync channel
+  // needs no handling, waking the core is enough
+  TIMER_IntClear(I2C_BACKOFF_TIMER, intflags);
+  TIMER_IntDisable(I2C_BACKOFF_TIMER, intflags);
+
+  // restarting a bus touches its state machine: mask the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  // retry I2C0
+  if(intflags & (TIMER_IF_CC0 << I2C0_BACKOFF_CC))
+  {
+      if(i2c0_sm.nack_retry)
+      {
+          i2c_nack_retry(&i2c0_sm);
+      }
+      else
+      {
+          i2c_restart(&i2c0_sm);
+      }
+  }
+
+  // retry I2C1
+  if(intflags & (TIMER_IF_CC0 << I2C1_BACKOFF_CC))
+  {
+      if(i2c1_sm.nack_retry)
+      {
+          i2c_nack_retry(&i2c1_sm);
+      }
+      else
+      {
+          i2c_restart(&i2c1_sm);
+      }
+  }
+
+  // stop the timer once no channel is armed
+  i2c_timer_disarm(I2C_SYNC_CC_NONE);
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+
+  BENCH_ISR_EXIT(benchIsrTimer1);
+}
+HOTPATH_DEFINITION_END
+
+
+/***************************************************************************//**
+ * @brief
+ *  Disarms one compare channel of the backoff timer.
+ *
+ * @details
+ *  Stops the timer and gates its clock once no channel is armed, caching
+ *  its register context for the next i2c_timer_arm().
+ *
+ * @param[in] cc
+ *  Compare channel to disarm, or I2C_SYNC_CC_NONE to only stop an idle
+ *  timer.
+ ******************************************************************************/
+static void i2c_timer_disarm(uint32_t cc)
+{
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  if(i2c_backoff_running)
+  {
+      if(cc != I2C_SYNC_CC_NONE)
+      {
+          TIMER_IntDisable(I2C_BACKOFF_TIMER, TIMER_IF_CC0 << cc);
+      }
+
+      if(!(I2C_BACKOFF_TIMER->IEN & ((TIMER_IF_CC0 << I2C0_BACKOFF_CC) |
+                                     (TIMER_IF_CC0 << I2C1_BACKOFF_CC) |
+                                     (TIMER_IF_CC0 << I2C_SYNC_CC))))
+      {
+          TIMER_Enable(I2C_BACKOFF_TIMER, false);
+
+          // cache the configuration so the next arm skips TIMER_Init()
+          i2c_timer_context.ctrl = I2C_BACKOFF_TIMER->CTRL;
+          i2c_timer_context.top = I2C_BACKOFF_TIMER->TOP;
+          for(uint32_t n = 0; n < I2C_BACKOFF_CCS; n++)
+          {
+              i2c_timer_context.cc_ctrl[n] = I2C_BACKOFF_TIMER->CC[n].CTRL;
+          }
+          i2c_timer_context.saved = true;
+
+          CMU_ClockEnable(I2C_BACKOFF_CLK, false);
+          i2c_backoff_running = false;
+      }
+  }
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/******************************************************************************
+ *************************** TRANSACTION QUEUE FUNCTIONS **********************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Returns the private state machine of an I2C peripheral.
+ *
+ * @param[in] i2c
+ *  Desired I2Cn peripheral (either I2C0 or I2C1)
+ *
+ * @return
+ *  Pointer to i2c0_sm or i2c1_sm.
+ ******************************************************************************/
+static volatile I2C_SM_STRUCT *i2c_get_sm(I2C_TypeDef *i2c)
+{
+  EFM_ASSERT((i2c == I2C0) || (i2c == I2C1));
+
+  return (i2c == I2C0) ? &i2c0_sm : &i2c1_sm;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Returns the private transaction queue of an I2C peripheral.
+ *
+ * @param[in] i2c
+ *  Desired I2Cn peripheral (either I2C0 or I2C1)
+ *
+ * @return
+ *  Pointer to i2c0_queue or i2c1_queue.
+ ******************************************************************************/
+static I2C_QUEUE_STRUCT *i2c_get_queue(I2C_TypeDef *i2c)
+{
+  EFM_ASSERT((i2c == I2C0) || (i2c == I2C1));
+
+  return (i2c == I2C0) ? &i2c0_queue : &i2c1_queue;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Determines whether a transaction may start on a free bus.
+ *
+ * @details
+ *  While a sequence owns the bus only transactions carrying its token may
+ *  start, unless the sequence is at a safe split point and the transaction
+ *  is urgent. Transactions of sequences still waiting for the bus queue
+ *  behind the owner like everybody else.
+ *
+ * @param[in] queue
+ *  Transaction queue of the bus.
+ *
+ * @param[in] i2c_sm
+ *  Transaction that wants the bus.
+ *
+ * @return
+ *  True if the transaction may start.
+ ******************************************************************************/
+static bool i2c_may_start(I2C_QUEUE_STRUCT *queue, volatile I2C_SM_STRUCT *i2c_sm)
+{
+  return (queue->claims == 0) ||
+         (queue->claim[0].token == i2c_sm->token) ||
+         (queue->hold_split && (i2c_sm->prio == i2cPrioUrgent));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts a transaction that has been copied into a bus state machine.
+ *
+ * @details
+ *  Records the queueing delay against the transaction's priority class,
+ *  saves the starting point for arbitration loss retries and transmits
+ *  the initial request packet.
+ *
+ * @param[in] i2c_sm
+ *  Pointer to i2c0_sm or i2c1_sm.
+ *
+ * @param[in] queue
+ *  Transaction queue of the bus.
+ ******************************************************************************/
+static void i2c_start(volatile I2C_SM_STRUCT *i2c_sm, I2C_QUEUE_STRUCT *queue)
+{
+  I2C_PRIO_STATS_STRUCT *stats = &i2c_prio_stats[i2c_sm->prio];
+  uint32_t wait = letimer_uptime() - i2c_sm->submit_time;
+
+  // latency statistics
+  stats->started++;
+  stats->total_wait += wait;
+  if(wait > stats->max_wait)
+  {
+      stats->max_wait = wait;
+  }
+
+  // count an overtake if an older lower priority transaction is still waiting
+  for(uint32_t prio = i2c_sm->prio + 1; prio < i2cPrioClasses; prio++)
+  {
+      if(queue->count[prio] &&
+         ((int32_t)(queue->pending[prio][0].submit_time - i2c_sm->submit_time) < 0))
+      {
+          stats->jumped++;
+          break;
+      }
+  }
+
+  // start the transaction
+  i2c_sm->busy = I2C_BUS_BUSY;
+  i2c_save_start(i2c_sm);
+  i2c_restart(i2c_sm);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts the next queued transaction at a STOP boundary.
+ *
+ * @details
+ *  Classes are served in priority order and each class in FIFO order.
+ *  Transactions that may not start yet (the bus is owned by another
+ *  sequence) are skipped and stay queued. A bus left with no work and no
+ *  owner is suspended (see i2c_suspend()).
+ *
+ * @param[in] i2c_sm
+ *  Pointer to i2c0_sm or i2c1_sm; must not be busy.
+ *
+ * @param[in] queue
+ *  Transaction queue of the bus.
+ ******************************************************************************/
+static void i2c_dispatch(volatile I2C_SM_STRUCT *i2c_sm, I2C_QUEUE_STRUCT *queue)
+{
+  for(uint32_t prio = 0; prio < i2cPrioClasses; prio++)
+  {
+      for(uint32_t n = 0; n < queue->count[prio]; n++)
+      {
+          if(i2c_may_start(queue, &queue->pending[prio][n]))
+          {
+              // take the transaction out of the queue
+              *i2c_sm = queue->pending[prio][n];
+              queue->count[prio]--;
+              for(; n < queue->count[prio]; n++)
+              {
+                  queue->pending[prio][n] = queue->pending[prio][n + 1];
+              }
+
+              i2c_start(i2c_sm, queue);
+              return;
+          }
+      }
+  }
+
+  // nothing left to start and no sequence holding the bus: go idle
+  if(queue->claims == 0)
+  {
+      i2c_suspend(i2c_sm->I2Cn);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Cancels a synchronous transaction that timed out.
+ *
+ * @details
+ *  The completion flag lives on the caller's stack, so no reference to it
+ *  may survive. A queued transaction is dropped; a running one is aborted
+ *  with a bus reset, the bus is released and the next queued transaction
+ *  is started. Its callback is not scheduled.
+ *
+ * @param[in] i2c
+ *  Desired I2Cn peripheral (either I2C0 or I2C1)
+ *
+ * @param[in] done
+ *  Completion flag of the transaction to cancel.
+ ******************************************************************************/
+static void i2c_cancel(I2C_TypeDef *i2c, volatile bool *done)
+{
+  volatile I2C_SM_STRUCT *bus_sm = i2c_get_sm(i2c);
+  I2C_QUEUE_STRUCT *queue = i2c_get_queue(i2c);
+  I2C_CLAIM_STRUCT *claim;
+
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  // running: abort and release the bus
+  if(bus_sm->busy && (bus_sm->done == done))
+  {
+      bus_sm->done = NULL;
+      i2c_timer_disarm((i2c == I2C0) ? I2C0_BACKOFF_CC : I2C1_BACKOFF_CC);
+      i2c_bus_reset(i2c);
+      claim = i2c_get_claim(queue, bus_sm->token);
+      if(claim)
+      {
+          claim->pending--;
+          i2c_claim_done(queue, claim);
+      }
+      bus_sm->busy = I2C_BUS_READY;
+      sleep_unblock_mode(I2C_EM_BLOCK);
+      i2c_dispatch(bus_sm, queue);
+  }
+
+  // queued: drop it
+  for(uint32_t prio = 0; prio < i2cPrioClasses; prio++)
+  {
+      for(uint32_t n = 0; n < queue->count[prio]; n++)
+      {
+          if(queue->pending[prio][n].done == done)
+          {
+              claim = i2c_get_claim(queue, queue->pending[prio][n].token);
+              if(claim)
+              {
+                  claim->pending--;
+                  i2c_claim_done(queue, claim);
+              }
+
+              queue->count[prio]--;
+              for(; n < queue->count[prio]; n++)
+              {
+                  queue->pending[prio][n] = queue->pending[prio][n + 1];
+              }
+              sleep_unblock_mode(I2C_EM_BLOCK);
+          }
+      }
+  }
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/******************************************************************************
+ ************************** BUS OWNERSHIP FUNCTIONS ***************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Claims a bus for a sequence of transactions.
+ *
+ * @details
+ *  Returns at once with a token. Claims own the bus one at a time, in the
+ *  order they were made; while a claim owns it only transactions carrying
+ *  its token start (see i2c_may_start()), so a sequence such as the SHTC3's
+ *  wakeup -> measure -> read -> sleep cannot be interleaved. Transactions
+ *  submitted with a token that does not own the bus yet simply queue
+ *  until it does. The bus is reset once, when the sequence ends, instead
+ *  of after every transaction.
+ *
+ *  Each driver holds at most one claim per bus, so I2C_CLAIM_DEPTH is
+ *  never reached. If it is (a logic error) the caller gets I2C_NO_TOKEN
+ *  and its transactions run unowned rather than wait here for a claim
+ *  to end.
+ *
+ * @param[in] i2c
+ *  Desired I2Cn peripheral (either I2C0 or I2C1)
+ *
+ * @return
+ *  Returns the token to put in each transaction's state machine, or
+ *  I2C_NO_TOKEN if every claim slot is taken.
+ ******************************************************************************/
+uint32_t i2c_acquire(I2C_TypeDef *i2c)
+{
+  I2C_QUEUE_STRUCT *queue = i2c_get_queue(i2c);
+  uint32_t token;
+
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  // every slot taken is a logic error. EFM_ASSERT for debugging.
+  if(queue->claims >= I2C_CLAIM_DEPTH)
+  {
+      EFM_ASSERT(false);
+      IRQ_EXIT_MASK();
+      return I2C_NO_TOKEN;
+  }
+
+  // never hand out I2C_NO_TOKEN
+  queue->next_token++;
+  if(queue->next_token == I2C_NO_TOKEN)
+  {
+      queue->next_token++;
+  }
+  token = queue->next_token;
+
+  queue->claim[queue->claims].token = token;
+  queue->claim[queue->claims].pending = 0;
+  queue->claim[queue->claims].released = false;
+  queue->claims++;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+
+  return token;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Ends a sequence's claim on a bus.
+ *
+ * @details
+ *  May be called right after the sequence's last transaction is submitted:
+ *  the claim ends, and the bus passes to the next claim, at that
+ *  transaction's MSTOP. With nothing left in flight it ends now.
+ *
+ * @param[in] i2c
+ *  Desired I2Cn peripheral (either I2C0 or I2C1)
+ *
+ * @param[in] token
+ *  Token returned by i2c_acquire().
+ ******************************************************************************/
+void i2c_release(I2C_TypeDef *i2c, uint32_t token)
+{
+  volatile I2C_SM_STRUCT *bus_sm = i2c_get_sm(i2c);
+  I2C_QUEUE_STRUCT *queue = i2c_get_queue(i2c);
+  I2C_CLAIM_STRUCT *claim;
+  bool owner;
+
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  claim = i2c_get_claim(queue, token);
+  EFM_ASSERT(claim != NULL);
+
+  if(claim)
+  {
+      owner = (claim == &queue->claim[0]);
+      claim->released = true;
+
+      // the owner's last MSTOP skipped the reset; pay it now and hand the
+      // idle bus to whoever waited
+      if(i2c_claim_done(queue, claim) && owner && !bus_sm->busy)
+      {
+          // a sequence that never submitted finds the bus suspended
+          i2c_resume(i2c);
+          i2c_bus_reset(i2c);
+          i2c_dispatch(bus_sm, queue);
+      }
+  }
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Finds the claim a token belongs to.
+ *
+ * @param[in] queue
+ *  Transaction queue of the bus.
+ *
+ * @param[in] token
+ *  Token of a transaction (I2C_NO_TOKEN if none).
+ *
+ * @return
+ *  Returns the claim, or NULL if the token has none.
+ ******************************************************************************/
+static I2C_CLAIM_STRUCT *i2c_get_claim(I2C_QUEUE_STRUCT *queue, uint32_t token)
+{
+  if(token == I2C_NO_TOKEN)
+  {
+      return NULL;
+  }
+
+  for(uint32_t n = 0; n < queue->claims; n++)
+  {
+      if(queue->claim[n].token == token)
+      {
+          return &queue->claim[n];
+      }
+  }
+
+  return NULL;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Ends a claim once it is released and its last transaction completed.
+ *
+ * @details
+ *  Ending the owner's claim passes the bus to the next claim, which starts
+ *  with no split point.
+ *
+ * @param[in] queue
+ *  Transaction queue of the bus.
+ *
+ * @param[in] claim
+ *  Claim to check.
+ *
+ * @return
+ *  Returns true if the claim ended.
+ ******************************************************************************/
+static bool i2c_claim_done(I2C_QUEUE_STRUCT *queue, I2C_CLAIM_STRUCT *claim)
+{
+  uint32_t n = (uint32_t)(claim - queue->claim);
+
+  if(!claim->released || claim->pending)
+  {
+      return false;
+  }
+
+  // a new owner has not reached a split point yet
+  if(n == 0)
+  {
+      queue->hold_split = false;
+  }
+
+  // drop it, keeping the remaining claims in order
+  queue->claims--;
+  for(; n < queue->claims; n++)
+  {
+      queue->claim[n] = queue->claim[n + 1];
+  }
+
+  return true;
+}
+
+
+/******************************************************************************
+ ************************** SUSPEND/RESUME FUNCTIONS **************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Disables an idle I2C peripheral and gates its clock.
+ *
+ * @details
+ *  The registers i2c_open() configured are cached first, so i2c_resume()
+ *  brings the peripheral back in a handful of writes instead of another
+ *  I2C_Init() and bus reset. The driver suspends a bus itself once its
+ *  queue drains with no sequence holding it, and resumes it on submit.
+ *  The HF peripheral clocks stop in EM2 anyway, so the saving is the
+ *  I2C clock tree while the core runs or sleeps in EM1.
+ *
+ * @param[in] i2c
+ *  Desired I2Cn peripheral (either I2C0 or I2C1); must not be busy.
+ ******************************************************************************/
+void i2c_suspend(I2C_TypeDef *i2c)
+{
+  I2C_CONTEXT_STRUCT *context = i2c_get_context(i2c);
+
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  if(!context->suspended)
+  {
+      // suspending mid-transaction would strand the bus
+      EFM_ASSERT(!i2c_get_sm(i2c)->busy);
+
+      // cache the configuration
+      context->ctrl = i2c->CTRL;
+      context->clkdiv = i2c->CLKDIV;
+      context->routeloc0 = i2c->ROUTELOC0;
+      context->routepen = i2c->ROUTEPEN;
+
+      // disable, then gate the clock
+      i2c->CTRL = context->ctrl & ~I2C_CTRL_EN;
+      i2c_clock_enable(i2c, false);
+      context->suspended = true;
+  }
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Restores a suspended I2C peripheral.
+ *
+ * @details
+ *  Writes back the cached context and aborts, so the re-enabled
+ *  peripheral treats the bus as idle at once rather than after the bus
+ *  idle timeout. Does nothing if the peripheral is not suspended.
+ *
+ * @param[in] i2c
+ *  Desired I2Cn peripheral (either I2C0 or I2C1)
+ ******************************************************************************/
+void i2c_resume(I2C_TypeDef *i2c)
+{
+  I2C_CONTEXT_STRUCT *context = i2c_get_context(i2c);
+
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  if(context->suspended)
+  {
+      i2c_clock_enable(i2c, true);
+
+      // restore the configuration; CTRL last as it re-enables
+      i2c->CLKDIV = context->clkdiv;
+      i2c->ROUTELOC0 = context->routeloc0;
+      i2c->ROUTEPEN = context->routepen;
+      i2c->IFC = _I2C_IFC_MASK;
+      i2c->CTRL = context->ctrl;
+
+      // bus idle without waiting for the timeout (TRM 16.5.2)
+      i2c->CMD = I2C_CMD_ABORT;
+      context->suspended = false;
+  }
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Returns the private register context of an I2C peripheral.
+ *
+ * @param[in] i2c
+ *  Desired I2Cn peripheral (either I2C0 or I2C1)
+ *
+ * @return
+ *  Pointer to i2c0_context or i2c1_context.
+ ******************************************************************************/
+static I2C_CONTEXT_STRUCT *i2c_get_context(I2C_TypeDef *i2c)
+{
+  EFM_ASSERT((i2c == I2C0) || (i2c == I2C1));
+
+  return (i2c == I2C0) ? &i2c0_context : &i2c1_context;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Gates or ungates the clock of an I2C peripheral.
+ *
+ * @param[in] i2c
+ *  Desired I2Cn peripheral (either I2C0 or I2C1)
+ *
+ * @param[in] enable
+ *  True to clock the peripheral.
+ ******************************************************************************/
+static void i2c_clock_enable(I2C_TypeDef *i2c, bool enable)
+{
+  // if the address of i2c is equal to the base address of the
+  // I2C0 base peripheral ...
+  if(i2c == I2C0)
+  {
+      CMU_ClockEnable(cmuClock_I2C0, enable);
+  }
+
+  // if the address of i2c is equal to the base address of the
+  // I2C1 base peripheral ...
+  if(i2c == I2C1)
+  {
+      CMU_ClockEnable(cmuClock_I2C1, enable);
+  }
+}
+
+
+/******************************************************************************
+ ************************* PUBLIC ACCESSOR FUNCTIONS **************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Accessor function for the per priority class latency statistics.
+ *
+ * @details
+ *  Latency is measured from submission to i2c_init_sm() until the START
+ *  of the transaction, in LETIMER ticks, and is shared by both buses.
+ *
+ * @param[in] prio
+ *  Priority class to read.
+ *
+ * @param[out] stats
+ *  Copy of the statistics.
+ ******************************************************************************/
+void i2c_get_prio_stats(I2C_PRIO_Typedef prio, I2C_PRIO_STATS_STRUCT *stats)
+{
+  EFM_ASSERT(prio < i2cPrioClasses);
+
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  *stats = i2c_prio_stats[prio];
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
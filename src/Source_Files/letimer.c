@@ -13,17 +13,33 @@
 // Include files
 //***********************************************************************************
 #include "letimer.h"
+#include "trace.h"
 
 
 //***********************************************************************************
 // static/private data
 //***********************************************************************************
 static uint32_t scheduled_uf_cb;      // scheduled underflow callback
+static float letimer_period;          // period (in seconds)
+static float letimer_active_period;   // active period (in seconds)
+static uint32_t letimer_nominal_cnt;  // uptime ticks per underflow (period * LETIMER_HZ)
+static uint32_t letimer_period_cnt;   // LETIMER0 ticks in the running period
+static uint32_t letimer_comp0_cnt;    // LETIMER0 ticks COMP0 loads at the next underflow
+static volatile uint32_t letimer_period_milli;  // target period in 1/1000 LETIMER0 ticks
+static volatile uint32_t letimer_active_cnt;    // COMP1 for the measured clock
+static uint32_t letimer_period_frac;  // period remainder carried to the next period (1/1000 ticks)
+static volatile uint32_t letimer_uf_count;  // LETIMER0 underflows since open
+static LETIMER_TIMER_STRUCT letimer_timer[LETIMER_TIMERS];  // low-energy one-shot timers
+static LETIMER_WAKE_STATS_STRUCT letimer_wake;              // wake-up accounting for the timers
 
 
 //***********************************************************************************
 // static/private functions
 //***********************************************************************************
+static uint64_t letimer_uptime_ticks(void);
+static HOTPATH_DECLARATOR void letimer_next_period(void);
+static void letimer_timer_service(bool wake);
+static void letimer_timer_plan(void);
 
 
 //***********************************************************************************
@@ -99,10 +115,23 @@ void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_let
 	period_cnt = app_letimer_struct->period * LETIMER_HZ;
 	period_active_cnt = app_letimer_struct->active_period * LETIMER_HZ;
 
-	// set compare registers
-	LETIMER_CompareSet(letimer, COMP0, period_cnt);
+	// set compare registers; the counter runs COMP0 down to 0, COMP0 + 1 ticks
+	LETIMER_CompareSet(letimer, COMP0, period_cnt - 1);
 	LETIMER_CompareSet(letimer, COMP1, period_active_cnt);
 
+	// track the period for the uptime time base and for letimer_calibrate()
+	letimer_period = app_letimer_struct->period;
+	letimer_active_period = app_letimer_struct->active_period;
+	letimer_nominal_cnt = period_cnt;
+	letimer_period_cnt = period_cnt;
+	letimer_comp0_cnt = period_cnt;
+	letimer_period_milli = period_cnt * 1000;
+	letimer_active_cnt = period_active_cnt;
+	letimer_period_frac = 0;
+	letimer_uf_count = 0;
+	memset(letimer_timer, 0, sizeof(letimer_timer));
+	memset(&letimer_wake, 0, sizeof(letimer_wake));
+
 	// set repeat mode bits for PWM mode
 	LETIMER_RepeatSet(letimer, REP0, REP_PWM_MODE);
 	LETIMER_RepeatSet(letimer, REP1, REP_PWM_MODE);
@@ -115,6 +144,7 @@ void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_let
 	letimer->IFC &= ~_LETIMER_IFC_RESETVALUE; // clear all five IFC bits (TRM 20.5.11)
 
 	// Enable Interrupts
+  NVIC_SetPriority(LETIMER0_IRQn, IRQ_PRIO_LETIMER);  // least urgent tier
   NVIC_EnableIRQ(LETIMER0_IRQn);    // enable NVIC IRQ for LETIMER0
 
 	// enable underflow interrupts
@@ -185,6 +215,396 @@ void letimer_start(LETIMER_TypeDef *letimer, bool enable)
   }
 }
 
+/***************************************************************************//**
+ * @brief
+ *   Corrects the LETIMER0 period for the measured clock frequency
+ *
+ * @details
+ *   LETIMER_HZ is nominal; the ULFRCO drifts with temperature and from part
+ *   to part. Given its measured frequency, the period and active period are
+ *   recomputed in real ticks and take effect from the next underflow. A
+ *   period that is not a whole number of ticks is dithered: the remainder
+ *   is carried into the next period, so the sample rate is exact on average.
+ *
+ * @note
+ *   The uptime stays in nominal LETIMER_HZ ticks; see letimer_uptime().
+ *
+ * @param[in] clock_mhz
+ *   Measured LETIMER0 clock frequency, in mHz (cmu_ulfrco_mhz()).
+ *
+ ******************************************************************************/
+void letimer_calibrate(uint32_t clock_mhz)
+{
+  uint32_t period_milli;
+  uint32_t active_cnt;
+
+  EFM_ASSERT(clock_mhz);
+
+  period_milli = (uint32_t)(letimer_period * clock_mhz);
+  active_cnt = (uint32_t)(letimer_active_period * clock_mhz / 1000);
+
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
+
+  letimer_period_milli = period_milli;
+  letimer_active_cnt = active_cnt;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the LETIMER0 uptime
+ *
+ * @details
+ *   Monotonic time base built from the LETIMER0 underflow count and the
+ *   current counter value. Runs in every energy mode the LETIMER runs in,
+ *   so it keeps counting while the core sleeps.
+ *
+ * @note
+ *   An underflow that has happened but has not yet been serviced is
+ *   accounted for, so the result never steps backwards.
+ *
+ *   Every period counts as period * LETIMER_HZ ticks however many real ticks
+ *   letimer_calibrate() gave it, and the running period is scaled to match,
+ *   so the uptime follows the calibrated clock rather than the ULFRCO.
+ *
+ * @return
+ *   Uptime in LETIMER ticks (1/LETIMER_HZ seconds)
+ *
+******************************************************************************/
+uint32_t letimer_uptime(void)
+{
+  return (uint32_t)letimer_uptime_ticks();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the LETIMER0 uptime in whole seconds
+ *
+ * @details
+ *   Same time base as letimer_uptime(), but computed in 64 bits so it does
+ *   not wrap after 2^32 ticks (about 49 days at LETIMER_HZ). For long
+ *   horizons such as the history archive.
+ *
+ * @return
+ *   Uptime in seconds
+ *
+******************************************************************************/
+uint32_t letimer_uptime_s(void)
+{
+  return (uint32_t)(letimer_uptime_ticks() / LETIMER_HZ);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a low-energy one-shot timer
+ *
+ * @details
+ *   The timer's event is posted once, anywhere from delay_ms to
+ *   delay_ms + slack_ms from now. Timers are expired on the LETIMER0
+ *   underflow, which wakes the core every period anyway, and otherwise by
+ *   a COMP1 wake-up at the earliest latest-expiry of the armed timers; every
+ *   timer whose window has opened by then expires on the same wake-up. The
+ *   more slack a timer allows, the more often it rides along for free.
+ *
+ * @note
+ *   COMP1 doubles as the wake-up compare, so the PWM outputs must not be
+ *   routed while timers are in use. Restarting a timer for the same event
+ *   replaces it.
+ *
+ * @param[in] cb
+ *   Scheduler event to post on expiry.
+ *
+ * @param[in] delay_ms
+ *   Earliest expiry, in milliseconds from now.
+ *
+ * @param[in] slack_ms
+ *   How much later than delay_ms the event may be posted, in milliseconds.
+ *
+******************************************************************************/
+void letimer_timer_start(uint32_t cb, uint32_t delay_ms, uint32_t slack_ms)
+{
+  LETIMER_TIMER_STRUCT *timer = NULL;
+  uint64_t now;
+  uint32_t i;
+
+  EFM_ASSERT(cb && !LETIMER0->ROUTEPEN);
+
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
+
+  // the event's own timer if it has one, else a free one
+  for(i = 0; i < LETIMER_TIMERS; i++)
+  {
+    if(letimer_timer[i].cb == cb)
+    {
+      timer = &letimer_timer[i];
+      break;
+    }
+    if(!timer && !letimer_timer[i].cb)
+    {
+      timer = &letimer_timer[i];
+    }
+  }
+
+  // more timers than LETIMER_TIMERS
+  EFM_ASSERT(timer);
+
+  now = letimer_uptime_ticks();
+  timer->cb = cb;
+  timer->due = now + (((uint64_t)delay_ms * LETIMER_HZ) / 1000);
+  timer->latest = timer->due + (((uint64_t)slack_ms * LETIMER_HZ) / 1000);
+
+  letimer_timer_plan();
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Stops a low-energy one-shot timer
+ *
+ * @details
+ *   Nothing happens if the event has no timer or it has already expired.
+ *
+ * @param[in] cb
+ *   Scheduler event the timer was started for.
+ *
+******************************************************************************/
+void letimer_timer_stop(uint32_t cb)
+{
+  uint32_t i;
+
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
+
+  for(i = 0; i < LETIMER_TIMERS; i++)
+  {
+    if(letimer_timer[i].cb == cb)
+    {
+      letimer_timer[i].cb = 0;
+    }
+  }
+
+  letimer_timer_plan();
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reads the low-energy timers' wake-up accounting
+ *
+ * @details
+ *   Without slack every timer would wake the core on its own; saved is how
+ *   many of those wake-ups were shared with another timer or with the
+ *   underflow.
+ *
+ * @param[out] stats
+ *   Counters since letimer_pwm_open().
+ *
+******************************************************************************/
+void letimer_wake_stats(LETIMER_WAKE_STATS_STRUCT *stats)
+{
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
+
+  *stats = letimer_wake;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+
+  stats->saved = stats->expired - stats->wakes;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reads the LETIMER0 uptime
+ *
+ * @details
+ *   Shared by letimer_uptime() and letimer_uptime_s().
+ *
+ * @return
+ *   Uptime in LETIMER ticks, 64-bit
+ *
+******************************************************************************/
+uint64_t letimer_uptime_ticks(void)
+{
+  uint32_t uf;
+  uint32_t cnt;
+  uint32_t period;
+
+  // make atomic by masking the LETIMER tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_LETIMER);
+
+  uf = letimer_uf_count;
+  cnt = LETIMER0->CNT;
+  period = letimer_period_cnt;
+
+  // underflow pending but not yet counted; re-read the reloaded counter
+  if(LETIMER0->IF & LETIMER_IF_UF)
+  {
+      uf++;
+      cnt = LETIMER0->CNT;
+      period = letimer_comp0_cnt;
+  }
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+
+  // counter counts down from COMP0; scale the elapsed real ticks to nominal
+  return ((uint64_t)uf * letimer_nominal_cnt) +
+         (((uint64_t)(period - 1 - cnt) * letimer_nominal_cnt) / period);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Starts bookkeeping for the period the counter just reloaded
+ *
+ * @details
+ *   Called from the underflow interrupt. The counter has just loaded COMP0,
+ *   so the running period is the one programmed last time; COMP0 and COMP1
+ *   are then set for the period after it from letimer_calibrate()'s values.
+ *   Writing them here, a full period before the next reload, cannot race it.
+ *
+******************************************************************************/
+HOTPATH_DEFINITION_BEGIN
+void letimer_next_period(void)
+{
+  uint32_t ticks;
+
+  letimer_period_cnt = letimer_comp0_cnt;
+
+  // whole ticks for the next period; carry the fraction
+  letimer_period_frac += letimer_period_milli;
+  ticks = letimer_period_frac / 1000;
+  letimer_period_frac -= ticks * 1000;
+
+  LETIMER_CompareSet(LETIMER0, COMP0, ticks - 1);
+  LETIMER_CompareSet(LETIMER0, COMP1, letimer_active_cnt);
+  letimer_comp0_cnt = ticks;
+}
+HOTPATH_DEFINITION_END
+
+
+/***************************************************************************//**
+ * @brief
+ *   Expires the low-energy timers whose windows have opened
+ *
+ * @details
+ *   Called from the LETIMER0 interrupt, then plans the next wake-up.
+ *
+ * @param[in] wake
+ *   True when the interrupt is a COMP1 wake-up taken for the timers; false
+ *   on an underflow, which would have woken the core anyway.
+ *
+******************************************************************************/
+void letimer_timer_service(bool wake)
+{
+  uint64_t now = letimer_uptime_ticks();
+  uint32_t expired = 0;
+  uint32_t i;
+
+  for(i = 0; i < LETIMER_TIMERS; i++)
+  {
+    if(letimer_timer[i].cb && (letimer_timer[i].due <= now))
+    {
+      add_scheduled_event(letimer_timer[i].cb);
+      letimer_timer[i].cb = 0;
+      expired++;
+    }
+  }
+
+  letimer_wake.expired += expired;
+  if(expired && wake)
+  {
+    letimer_wake.wakes++;
+  }
+  else
+  {
+    letimer_wake.on_underflow += expired;
+  }
+
+  letimer_timer_plan();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Programs the COMP1 wake-up for the armed low-energy timers
+ *
+ * @details
+ *   The wake-up goes at the earliest latest-expiry, the last moment every
+ *   armed timer is still on time, so as many windows as possible have
+ *   opened when it fires. If the next underflow comes first, it serves the
+ *   timers and no wake-up is armed. COMP1 matches in the running period
+ *   only; a later deadline is planned again at the next underflow.
+ *
+ * @note
+ *   Caller masks the LETIMER tier.
+ *
+******************************************************************************/
+void letimer_timer_plan(void)
+{
+  uint64_t latest = UINT64_MAX;
+  uint64_t start;
+  uint32_t elapsed;
+  uint32_t target;
+  uint32_t i;
+
+  for(i = 0; i < LETIMER_TIMERS; i++)
+  {
+    if(letimer_timer[i].cb && (letimer_timer[i].latest < latest))
+    {
+      latest = letimer_timer[i].latest;
+    }
+  }
+
+  // no deadline before the next underflow: nothing to wake for
+  start = (uint64_t)letimer_uf_count * letimer_nominal_cnt;
+  if(latest >= (start + letimer_nominal_cnt))
+  {
+    LETIMER0->IEN &= ~LETIMER_IEN_COMP1;
+    return;
+  }
+
+  // counter value at the deadline, rounded late so the deadline has passed
+  // when COMP1 matches; the counter counts down from period - 1
+  elapsed = 0;
+  if(latest > start)
+  {
+    elapsed = (uint32_t)((((latest - start) * letimer_period_cnt) + letimer_nominal_cnt - 1) / letimer_nominal_cnt);
+  }
+  target = (elapsed < letimer_period_cnt) ? (letimer_period_cnt - 1 - elapsed) : 0;
+
+  LETIMER_CompareSet(LETIMER0, COMP1, target);
+  LETIMER0->IFC = LETIMER_IFC_COMP1;
+  LETIMER0->IEN |= LETIMER_IEN_COMP1;
+
+  // already at or past the deadline: take the wake-up now
+  if(LETIMER0->CNT <= target)
+  {
+    LETIMER0->IFS = LETIMER_IFS_COMP1;
+  }
+}
+
+
 /***************************************************************************//**
  * @brief
  *   Driver to handle all LETIMER0 interrupts
@@ -194,20 +614,37 @@ void letimer_start(LETIMER_TypeDef *letimer, bool enable)
  *   The corresponding event to the event scheduler and asserts the correct
  *   flag has been lowered.
 ******************************************************************************/
+HOTPATH_DEFINITION_BEGIN
 void LETIMER0_IRQHandler(void)
 {
+  BENCH_ISR_ENTER(benchIsrLetimer0);
+
   // interrupt flag to store the source interrupt
   uint32_t int_flag;
   int_flag = (LETIMER0->IF) & (LETIMER0->IEN);
 
+  trace_event(traceIrq, traceIrqLetimer0);
+
   // clear LETIMER0 interrupt flag;
   LETIMER0->IFC = int_flag;
 
   // handle UF interrupt source
   if(int_flag & LETIMER_IF_UF)
   {
+      letimer_uf_count++;
+      letimer_next_period();
       add_scheduled_event(scheduled_uf_cb);
       // assert to ensure flag is cleared
       EFM_ASSERT(!(LETIMER0->IF & LETIMER_IF_UF));
   }
+
+  // expire the low-energy timers; a COMP1 without an underflow is a
+  // wake-up taken for them alone
+  if(int_flag & (LETIMER_IF_UF | LETIMER_IF_COMP1))
+  {
+      letimer_timer_service(!(int_flag & LETIMER_IF_UF));
+  }
+
+  BENCH_ISR_EXIT(benchIsrLetimer0);
 }
+HOTPATH_DEFINITION_END
@@ -0,0 +1,526 @@
+/***************************************************************************//**
+ * @file
+ *   log_format.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Frame encoding and decoding for the on-flash sample log
+ *
+ * @details
+ *   Shared by the firmware (sample_log.c) and the host decoder
+ *   (tools/logdump.c); see log_format.h for the layout.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "log_format.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static int32_t log_desc_decode(LOG_DELTA_STRUCT *delta, const uint8_t *frame, uint32_t payload);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  CRC-16/CCITT-FALSE.
+ *
+ * @details
+ *  Byte at a time with shifts instead of a table (the polynomial's taps
+ *  at bits 12, 5 and 0 fold into three shifted XORs): no flash for a
+ *  table, and several times faster than bitwise on the node and the host.
+ *
+ * @param[in] crc
+ *  Running CRC (LOG_CRC_INIT to start).
+ *
+ * @param[in] data
+ *  Bytes to add.
+ *
+ * @param[in] len
+ *  Number of bytes.
+ *
+ * @return
+ *  Returns the updated CRC.
+ ******************************************************************************/
+uint16_t log_crc16(uint16_t crc, const uint8_t *data, uint32_t len)
+{
+  uint32_t i;
+  uint32_t x;
+
+  for(i = 0; i < len; i++)
+  {
+    x = ((crc >> 8) ^ data[i]) & 0xFF;
+    x ^= x >> 4;
+    crc = (uint16_t)((crc << 8) ^ (x << 12) ^ (x << 5) ^ x);
+  }
+
+  return crc;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Checks a page header.
+ *
+ * @param[in] header
+ *  Header as read from the start of a page.
+ *
+ * @return
+ *  Returns true if the page holds log data, converted or raw.
+ ******************************************************************************/
+bool log_page_valid(const LOG_PAGE_HEADER_STRUCT *header)
+{
+  return ((header->magic == LOG_PAGE_MAGIC) || (header->magic == LOG_PAGE_MAGIC_RAW)) &&
+         (header->check == ~(header->magic + header->seq + header->t0));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Checks whether a valid page holds raw codes.
+ *
+ * @param[in] header
+ *  Header as read from the start of a page.
+ *
+ * @return
+ *  Returns true for a raw page.
+ ******************************************************************************/
+bool log_page_raw(const LOG_PAGE_HEADER_STRUCT *header)
+{
+  return header->magic == LOG_PAGE_MAGIC_RAW;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Builds a page header.
+ *
+ * @param[out] header
+ *  Header.
+ *
+ * @param[in] seq
+ *  Page sequence number.
+ *
+ * @param[in] t0
+ *  Time of the page's first record.
+ *
+ * @param[in] raw
+ *  True for a page of raw codes.
+ ******************************************************************************/
+void log_page_header(LOG_PAGE_HEADER_STRUCT *header, uint32_t seq, uint32_t t0, bool raw)
+{
+  header->magic = raw ? LOG_PAGE_MAGIC_RAW : LOG_PAGE_MAGIC;
+  header->seq = seq;
+  header->t0 = t0;
+  header->check = ~(header->magic + header->seq + header->t0);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Resets the delta state at the start of a page.
+ *
+ * @param[out] delta
+ *  Delta state.
+ *
+ * @param[in] t0
+ *  Page header t0.
+ *
+ * @param[in] raw
+ *  True for a raw page (log_page_raw()).
+ ******************************************************************************/
+void log_delta_reset(LOG_DELTA_STRUCT *delta, uint32_t t0, bool raw)
+{
+  memset(delta, 0, sizeof(LOG_DELTA_STRUCT));
+  delta->time = t0;
+  delta->raw = raw;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Encodes one record as a frame.
+ *
+ * @param[in] delta
+ *  Delta state of the page being written; updated.
+ *
+ * @param[in] rec
+ *  Record.
+ *
+ * @param[out] frame
+ *  Frame, padded to LOG_FRAME_ALIGN (at least LOG_FRAME_MAX bytes).
+ *
+ * @return
+ *  Returns the padded frame length.
+ ******************************************************************************/
+uint32_t log_frame_encode(LOG_DELTA_STRUCT *delta, const LOG_RECORD_STRUCT *rec, uint8_t *frame)
+{
+  uint32_t len = 1;
+  uint32_t ch;
+  uint16_t crc;
+
+  frame[len++] = rec->mask;
+  len += log_put_varint(&frame[len], (int32_t)(rec->time - delta->time));
+  delta->time = rec->time;
+
+  for(ch = 0; ch < LOG_CHANNELS; ch++)
+  {
+    if(rec->mask & (1 << ch))
+    {
+      len += log_put_varint(&frame[len], rec->value[ch] - delta->value[ch]);
+      delta->value[ch] = rec->value[ch];
+    }
+  }
+
+  // payload length, then the CRC over length and payload
+  frame[0] = (uint8_t)(len - 1);
+  crc = log_crc16(LOG_CRC_INIT, frame, len);
+  frame[len++] = (uint8_t)crc;
+  frame[len++] = (uint8_t)(crc >> 8);
+
+  // pad to a flash word
+  while(len % LOG_FRAME_ALIGN)
+  {
+    frame[len++] = LOG_ERASED_BYTE;
+  }
+
+  return len;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Encodes one channel's descriptor as a frame.
+ *
+ * @details
+ *  Written after the header of a raw page, one per channel, ahead of its
+ *  records. Carries no time, so the page's delta state is untouched.
+ *
+ * @param[in] desc
+ *  Descriptor of the channel.
+ *
+ * @param[in] ch
+ *  Channel.
+ *
+ * @param[out] frame
+ *  Frame, padded to LOG_FRAME_ALIGN (at least LOG_DESC_FRAME_MAX bytes).
+ *
+ * @return
+ *  Returns the padded frame length.
+ ******************************************************************************/
+uint32_t log_desc_encode(const LOG_DESC_STRUCT *desc, uint32_t ch, uint8_t *frame)
+{
+  uint32_t len = 1;
+  uint32_t k;
+  uint16_t crc;
+
+  frame[len++] = (uint8_t)(LOG_MASK_DESC | ch);
+  len += log_put_varint(&frame[len], (int32_t)desc->conv.gain);
+  len += log_put_varint(&frame[len], desc->conv.offset);
+  len += log_put_varint(&frame[len], (int32_t)desc->cal.mode);
+
+  if(desc->cal.mode == LOG_CAL_LINEAR)
+  {
+    len += log_put_varint(&frame[len], desc->cal.gain);
+    len += log_put_varint(&frame[len], desc->cal.offset);
+  }
+  else if(desc->cal.mode == LOG_CAL_POLY)
+  {
+    len += log_put_varint(&frame[len], (int32_t)desc->cal.order);
+    for(k = 0; k <= desc->cal.order; k++)
+    {
+      len += log_put_varint(&frame[len], desc->cal.coef[k]);
+    }
+  }
+
+  // payload length, then the CRC over length and payload
+  frame[0] = (uint8_t)(len - 1);
+  crc = log_crc16(LOG_CRC_INIT, frame, len);
+  frame[len++] = (uint8_t)crc;
+  frame[len++] = (uint8_t)(crc >> 8);
+
+  // pad to a flash word
+  while(len % LOG_FRAME_ALIGN)
+  {
+    frame[len++] = LOG_ERASED_BYTE;
+  }
+
+  return len;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Decodes one frame.
+ *
+ * @param[in] delta
+ *  Delta state of the page being read; updated only for a good frame.
+ *
+ * @param[in] frame
+ *  Start of the frame.
+ *
+ * @param[in] avail
+ *  Bytes left in the page from frame.
+ *
+ * @param[out] rec
+ *  Decoded record. A descriptor frame is stored in the delta state and
+ *  returns a record with an empty mask, which readers skip.
+ *
+ * @return
+ *  Returns the padded frame length, LOG_FRAME_END at erased flash or the end
+ *  of the page, or LOG_FRAME_BAD if the frame is damaged (the rest of the
+ *  page cannot be trusted).
+ ******************************************************************************/
+int32_t log_frame_decode(LOG_DELTA_STRUCT *delta, const uint8_t *frame, uint32_t avail,
+                         LOG_RECORD_STRUCT *rec)
+{
+  uint32_t payload;
+  uint32_t pos = 2;
+  uint32_t total;
+  uint32_t ch;
+  int32_t used;
+  int32_t v;
+  uint16_t crc;
+
+  if((avail < LOG_FRAME_ALIGN) || (frame[0] == LOG_ERASED_BYTE))
+  {
+    return LOG_FRAME_END;
+  }
+
+  payload = frame[0];
+  total = (payload + LOG_FRAME_OVERHEAD + LOG_FRAME_ALIGN - 1) & ~(uint32_t)(LOG_FRAME_ALIGN - 1);
+  if((payload == 0) || (total > avail) ||
+     (total > ((frame[1] & LOG_MASK_DESC) ? LOG_DESC_FRAME_MAX : LOG_FRAME_MAX)))
+  {
+    return LOG_FRAME_BAD;
+  }
+
+  crc = log_crc16(LOG_CRC_INIT, frame, payload + 1);
+  if((frame[payload + 1] != (uint8_t)crc) || (frame[payload + 2] != (uint8_t)(crc >> 8)))
+  {
+    return LOG_FRAME_BAD;
+  }
+
+  memset(rec, 0, sizeof(LOG_RECORD_STRUCT));
+  rec->raw = delta->raw;
+
+  // descriptor: no record, only decoder state
+  if(frame[1] & LOG_MASK_DESC)
+  {
+    rec->time = delta->time;
+    return (log_desc_decode(delta, frame, payload) < 0) ? LOG_FRAME_BAD : (int32_t)total;
+  }
+
+  rec->mask = frame[1];
+
+  used = log_get_varint(&frame[pos], payload + 1 - pos, &v);
+  if(used <= 0)
+  {
+    return LOG_FRAME_BAD;
+  }
+  pos += used;
+  rec->time = delta->time + (uint32_t)v;
+
+  for(ch = 0; ch < LOG_CHANNELS; ch++)
+  {
+    if(rec->mask & (1 << ch))
+    {
+      used = log_get_varint(&frame[pos], payload + 1 - pos, &v);
+      if(used <= 0)
+      {
+        return LOG_FRAME_BAD;
+      }
+      pos += used;
+      rec->value[ch] = (int16_t)(delta->value[ch] + v);
+    }
+  }
+
+  // commit the deltas only once the whole frame decoded
+  delta->time = rec->time;
+  for(ch = 0; ch < LOG_CHANNELS; ch++)
+  {
+    if(rec->mask & (1 << ch))
+    {
+      delta->value[ch] = rec->value[ch];
+    }
+  }
+
+  return (int32_t)total;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Converts one raw code of a raw page to centi-units.
+ *
+ * @details
+ *  The scalar path; host tools converting a whole page use conv_batch()
+ *  and conv_calibrate() instead.
+ *
+ * @param[in] desc
+ *  Descriptor of the code's channel.
+ *
+ * @param[in] code
+ *  Raw code.
+ *
+ * @return
+ *  Returns the calibrated value, in centi-units.
+ ******************************************************************************/
+int32_t log_desc_apply(const LOG_DESC_STRUCT *desc, uint16_t code)
+{
+  return conv_calibrate(&desc->cal, conv_sample(&desc->conv, code));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes a zigzag LEB128 varint.
+ *
+ * @return
+ *  Returns the number of bytes written (1 to 5).
+ ******************************************************************************/
+uint32_t log_put_varint(uint8_t *buf, int32_t value)
+{
+  uint32_t zz = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+  uint32_t n = 0;
+
+  while(zz >= 0x80)
+  {
+    buf[n++] = (uint8_t)(zz | 0x80);
+    zz >>= 7;
+  }
+  buf[n++] = (uint8_t)zz;
+
+  return n;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads a zigzag LEB128 varint.
+ *
+ * @return
+ *  Returns the number of bytes read, or 0 if it runs past avail.
+ ******************************************************************************/
+int32_t log_get_varint(const uint8_t *buf, uint32_t avail, int32_t *value)
+{
+  uint32_t zz = 0;
+  uint32_t n = 0;
+  uint32_t shift = 0;
+
+  do
+  {
+    if((n >= avail) || (shift > 28))
+    {
+      return 0;
+    }
+    zz |= (uint32_t)(buf[n] & 0x7F) << shift;
+    shift += 7;
+  }
+  while(buf[n++] & 0x80);
+
+  *value = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+
+  return (int32_t)n;
+}
+
+
+/******************************************************************************
+ ***************************** PRIVATE FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Decodes the payload of a descriptor frame into the delta state.
+ *
+ * @param[in] delta
+ *  Delta state of the page being read; updated only for a good frame.
+ *
+ * @param[in] frame
+ *  Start of the frame; length and CRC already checked.
+ *
+ * @param[in] payload
+ *  Payload length.
+ *
+ * @return
+ *  Returns 0, or LOG_FRAME_BAD if the payload does not parse.
+ ******************************************************************************/
+int32_t log_desc_decode(LOG_DELTA_STRUCT *delta, const uint8_t *frame, uint32_t payload)
+{
+  LOG_DESC_STRUCT desc;
+  uint32_t ch = frame[1] & LOG_MASK_CHANNEL;
+  uint32_t pos = 2;
+  int32_t field[LOG_CAL_MAX_ORDER + 5];
+  uint32_t fields = 3;
+  uint32_t n;
+  int32_t used;
+
+  if(ch >= LOG_CHANNELS)
+  {
+    return LOG_FRAME_BAD;
+  }
+
+  // gain, offset and mode, then as many fields as the mode needs
+  for(n = 0; n < fields; n++)
+  {
+    used = log_get_varint(&frame[pos], payload + 1 - pos, &field[n]);
+    if(used <= 0)
+    {
+      return LOG_FRAME_BAD;
+    }
+    pos += used;
+
+    if(n == 2)
+    {
+      fields += (field[2] == LOG_CAL_LINEAR) ? 2 : (field[2] == LOG_CAL_POLY) ? 1 : 0;
+    }
+    else if((n == 3) && (field[2] == LOG_CAL_POLY))
+    {
+      if((field[3] < 0) || (field[3] > LOG_CAL_MAX_ORDER))
+      {
+        return LOG_FRAME_BAD;
+      }
+      fields += (uint32_t)field[3] + 1;
+    }
+  }
+
+  memset(&desc, 0, sizeof(desc));
+  desc.valid = true;
+  desc.conv.gain = (uint32_t)field[0];
+  desc.conv.offset = field[1];
+  desc.cal.mode = (uint32_t)field[2];
+  if(desc.cal.mode == LOG_CAL_LINEAR)
+  {
+    desc.cal.gain = field[3];
+    desc.cal.offset = field[4];
+  }
+  else if(desc.cal.mode == LOG_CAL_POLY)
+  {
+    desc.cal.order = (uint32_t)field[3];
+    memcpy(desc.cal.coef, &field[4], (desc.cal.order + 1) * sizeof(int32_t));
+  }
+
+  delta->desc[ch] = desc;
+
+  return 0;
+}
@@ -0,0 +1,362 @@
+/***************************************************************************//**
+ * @file
+ *   median.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Sliding-window median for rejecting single-sample spikes
+ *
+ * @details
+ *   Two heaps share one array around the median: heap index 0 is the
+ *   median, -1, -2, ... a max-heap of the smaller samples and 1, 2, ... a
+ *   min-heap of the larger ones (children of i are 2i and 2i+1, or 2i and
+ *   2i-1 on the negative side). Each slot of the circular sample buffer
+ *   knows its heap index, so the outgoing sample is replaced in place and
+ *   sifted up or down: O(log window) per update, no allocation.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "median.h"
+
+#ifdef BENCH_MEDIAN
+#include "em_core.h"
+#include "bench.h"
+#endif
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define HEAP(m, i)            ((m)->heap[(i) + (m)->half])  // data[] slot at heap index i
+#define HEAP_VAL(m, i)        ((m)->data[HEAP(m, i)])       // sample at heap index i
+#define MIN_COUNT(m)          (((m)->count - 1) / 2)        // samples in the min-heap
+#define MAX_COUNT(m)          ((m)->count / 2)              // samples in the max-heap
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+#ifdef BENCH_MEDIAN
+static MEDIAN_STRUCT median_bench_sm;
+#endif
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static void median_exchange(MEDIAN_STRUCT *median, int32_t i, int32_t j);
+static bool median_cmp_exchange(MEDIAN_STRUCT *median, int32_t i, int32_t j);
+static void median_min_sort_down(MEDIAN_STRUCT *median, int32_t i);
+static void median_max_sort_down(MEDIAN_STRUCT *median, int32_t i);
+static bool median_min_sort_up(MEDIAN_STRUCT *median, int32_t i);
+static bool median_max_sort_up(MEDIAN_STRUCT *median, int32_t i);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Opens a sliding median.
+ *
+ * @details
+ *  Lays the data slots out alternately on either side of the median so the
+ *  first `window` samples fill both heaps evenly.
+ *
+ * @param[in] median
+ *  Median instance (statically allocated by the caller).
+ *
+ * @param[in] window
+ *  Window length, MEDIAN_WINDOW_MIN to MEDIAN_WINDOW_MAX; odd lengths give
+ *  a true sample as the median, even lengths the mean of the middle two.
+ ******************************************************************************/
+void median_open(MEDIAN_STRUCT *median, uint8_t window)
+{
+  int32_t slot;
+
+  EFM_ASSERT((window >= MEDIAN_WINDOW_MIN) && (window <= MEDIAN_WINDOW_MAX));
+
+  memset(median, 0, sizeof(MEDIAN_STRUCT));
+  median->window = window;
+  median->half = window / 2;
+
+  // slot 0 -> 0, slot 1 -> -1, slot 2 -> 1, slot 3 -> -2, ...
+  for(slot = window - 1; slot >= 0; slot--)
+  {
+    median->pos[slot] = ((slot + 1) / 2) * ((slot & 1) ? -1 : 1);
+    HEAP(median, median->pos[slot]) = slot;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Adds a sample, dropping the oldest once the window is full.
+ *
+ * @param[in] median
+ *  Median instance.
+ *
+ * @param[in] sample
+ *  New sample.
+ *
+ * @return
+ *  Returns the median of the samples in the window.
+ ******************************************************************************/
+int32_t median_step(MEDIAN_STRUCT *median, int32_t sample)
+{
+  bool is_new = (median->count < median->window);
+  int32_t p = median->pos[median->idx];
+  int32_t old = median->data[median->idx];
+
+  // overwrite the oldest sample in place
+  median->data[median->idx] = sample;
+  median->idx = (median->idx + 1) % median->window;
+  median->count += is_new;
+
+  // new sample is in the min-heap
+  if(p > 0)
+  {
+    if(!is_new && (old < sample))
+    {
+      median_min_sort_down(median, p * 2);
+    }
+    else if(median_min_sort_up(median, p))
+    {
+      median_max_sort_down(median, -1);
+    }
+  }
+  // new sample is in the max-heap
+  else if(p < 0)
+  {
+    if(!is_new && (sample < old))
+    {
+      median_max_sort_down(median, p * 2);
+    }
+    else if(median_max_sort_up(median, p))
+    {
+      median_min_sort_down(median, 1);
+    }
+  }
+  // new sample is the median
+  else
+  {
+    if(MAX_COUNT(median))
+    {
+      median_max_sort_down(median, -1);
+    }
+    if(MIN_COUNT(median))
+    {
+      median_min_sort_down(median, 1);
+    }
+  }
+
+  return median_value(median);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Accessor for the current median.
+ *
+ * @param[in] median
+ *  Median instance.
+ *
+ * @return
+ *  Returns the median of the samples in the window (0 if empty).
+ ******************************************************************************/
+int32_t median_value(const MEDIAN_STRUCT *median)
+{
+  int32_t v = HEAP_VAL(median, 0);
+
+  // even count: mean of the two middle samples
+  if((median->count & 1) == 0)
+  {
+    v = (v + HEAP_VAL(median, -1)) / 2;
+  }
+
+  return v;
+}
+
+
+#ifdef BENCH_MEDIAN
+/***************************************************************************//**
+ * @brief
+ *  Measures the cost of median_step().
+ *
+ * @details
+ *  BENCH_MEDIAN builds only. Fills the window, then times
+ *  MEDIAN_BENCH_SAMPLES updates of pseudo-random samples with the DWT
+ *  cycle counter, interrupts disabled. Call for each window size of
+ *  interest (see app_median_bench_run()).
+ *
+ * @param[in] window
+ *  Window length.
+ *
+ * @return
+ *  Returns the mean cycles per update.
+ ******************************************************************************/
+uint32_t median_bench(uint8_t window)
+{
+  uint32_t seed = 0x1234ABCD;
+  uint32_t start;
+  uint32_t cycles;
+  uint32_t i;
+
+  median_open(&median_bench_sm, window);
+  for(i = 0; i < window; i++)
+  {
+    seed = (seed * 1664525) + 1013904223;
+    median_step(&median_bench_sm, (int32_t)(seed >> 16));
+  }
+
+  // enable the cycle counter
+  BENCH_OPEN();
+
+  // make atomic by disallowing interrupts
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  start = BENCH_CYCLES();
+  for(i = 0; i < MEDIAN_BENCH_SAMPLES; i++)
+  {
+    seed = (seed * 1664525) + 1013904223;
+    median_step(&median_bench_sm, (int32_t)(seed >> 16));
+  }
+  cycles = BENCH_CYCLES() - start;
+
+  // allow interrupts
+  CORE_EXIT_CRITICAL();
+
+  return cycles / MEDIAN_BENCH_SAMPLES;
+}
+#endif
+
+
+/******************************************************************************
+ ***************************** PRIVATE FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Swaps two heap entries and updates their slots' positions.
+ ******************************************************************************/
+void median_exchange(MEDIAN_STRUCT *median, int32_t i, int32_t j)
+{
+  int8_t t = HEAP(median, i);
+
+  HEAP(median, i) = HEAP(median, j);
+  HEAP(median, j) = t;
+  median->pos[HEAP(median, i)] = i;
+  median->pos[HEAP(median, j)] = j;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Swaps heap entries i and j if the sample at i is less than the one at j.
+ *
+ * @return
+ *  Returns true if they were swapped.
+ ******************************************************************************/
+bool median_cmp_exchange(MEDIAN_STRUCT *median, int32_t i, int32_t j)
+{
+  if(HEAP_VAL(median, i) < HEAP_VAL(median, j))
+  {
+    median_exchange(median, i, j);
+    return true;
+  }
+
+  return false;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Sifts the min-heap down from child index i, keeping the smallest child
+ *  above its parent.
+ ******************************************************************************/
+void median_min_sort_down(MEDIAN_STRUCT *median, int32_t i)
+{
+  for(; i <= MIN_COUNT(median); i *= 2)
+  {
+    // pick the smaller of the two children
+    if((i > 1) && (i < MIN_COUNT(median)) && (HEAP_VAL(median, i + 1) < HEAP_VAL(median, i)))
+    {
+      ++i;
+    }
+    if(!median_cmp_exchange(median, i, i / 2))
+    {
+      break;
+    }
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Sifts the max-heap down from child index i, keeping the largest child
+ *  above its parent.
+ ******************************************************************************/
+void median_max_sort_down(MEDIAN_STRUCT *median, int32_t i)
+{
+  for(; i >= -MAX_COUNT(median); i *= 2)
+  {
+    // pick the larger of the two children
+    if((i < -1) && (i > -MAX_COUNT(median)) && (HEAP_VAL(median, i) < HEAP_VAL(median, i - 1)))
+    {
+      --i;
+    }
+    if(!median_cmp_exchange(median, i / 2, i))
+    {
+      break;
+    }
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Sifts the min-heap up from index i.
+ *
+ * @return
+ *  Returns true if the entry reached the median position.
+ ******************************************************************************/
+bool median_min_sort_up(MEDIAN_STRUCT *median, int32_t i)
+{
+  while((i > 0) && median_cmp_exchange(median, i, i / 2))
+  {
+    i /= 2;
+  }
+
+  return (i == 0);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Sifts the max-heap up from index i.
+ *
+ * @return
+ *  Returns true if the entry reached the median position.
+ ******************************************************************************/
+bool median_max_sort_up(MEDIAN_STRUCT *median, int32_t i)
+{
+  while((i < 0) && median_cmp_exchange(median, i / 2, i))
+  {
+    i /= 2;
+  }
+
+  return (i == 0);
+}
@@ -0,0 +1,251 @@
+/***************************************************************************//**
+ * @file
+ *   rate_group.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Multi-rate scheduling from a single timer base
+ *
+ * @details
+ *   One periodic timer (LETIMER0) drives rate_group_tick() once per period;
+ *   every group is a multiple of that base tick. A group is released on
+ *   the ticks where (tick % period) == phase, by posting its scheduler
+ *   event, so a 3 s sensor, a 30 s sensor and hourly housekeeping all run
+ *   off the same low-energy timer and never need a timer of their own.
+ *
+ *   Each group counts down to its next release instead of dividing the
+ *   tick count every tick. Changing a group's period or phase recomputes
+ *   the countdown from the tick count, so a group stays phase-locked to the
+ *   base however often it is reconfigured, and a disabled group keeps
+ *   counting so it comes back on its old phase.
+ *
+ *   Called from scheduler callbacks only, so nothing here needs masking.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "rate_group.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+static RATE_GROUP_STRUCT rate_group[RATE_GROUPS_MAX];
+static uint32_t rate_group_tick_count;          // base ticks since rate_group_open()
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static uint32_t rate_group_wait(uint32_t period, uint32_t phase);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Opens the rate groups.
+ *
+ * @details
+ *  Closes every group and restarts the base tick count at 0.
+ ******************************************************************************/
+void rate_group_open(void)
+{
+  memset(rate_group, 0, sizeof(rate_group));
+  rate_group_tick_count = 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Adds a rate group.
+ *
+ * @details
+ *  The group is enabled and first released on the next tick that matches
+ *  its phase.
+ *
+ * @param[in] period
+ *  Base ticks between releases (at least 1).
+ *
+ * @param[in] phase
+ *  Tick within the period on which the group is released (< period).
+ *
+ * @param[in] cb
+ *  Scheduler event to post on each release.
+ *
+ * @return
+ *  Returns the group's handle for rate_group_set() and rate_group_enable().
+ ******************************************************************************/
+uint32_t rate_group_add(uint32_t period, uint32_t phase, uint32_t cb)
+{
+  uint32_t group;
+
+  for(group = 0; group < RATE_GROUPS_MAX; group++)
+  {
+    if(rate_group[group].period == 0)
+    {
+      break;
+    }
+  }
+
+  // more groups than RATE_GROUPS_MAX
+  EFM_ASSERT(group < RATE_GROUPS_MAX);
+
+  rate_group[group].cb = cb;
+  rate_group[group].enabled = true;
+  rate_group[group].releases = 0;
+  rate_group_set(group, period, phase);
+
+  return group;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Changes a group's period and phase.
+ *
+ * @details
+ *  Takes effect from the next tick; the next release is the first tick
+ *  that matches the new phase.
+ *
+ * @param[in] group
+ *  Handle from rate_group_add().
+ *
+ * @param[in] period
+ *  Base ticks between releases (at least 1).
+ *
+ * @param[in] phase
+ *  Tick within the period on which the group is released (< period).
+ ******************************************************************************/
+void rate_group_set(uint32_t group, uint32_t period, uint32_t phase)
+{
+  EFM_ASSERT(group < RATE_GROUPS_MAX);
+  EFM_ASSERT((period > 0) && (phase < period));
+
+  rate_group[group].period = period;
+  rate_group[group].phase = phase;
+  rate_group[group].wait = rate_group_wait(period, phase);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Enables or disables a group.
+ *
+ * @details
+ *  A disabled group keeps its phase; it is simply not released.
+ *
+ * @param[in] group
+ *  Handle from rate_group_add().
+ *
+ * @param[in] enable
+ *  True = release on schedule; False = skip releases.
+ ******************************************************************************/
+void rate_group_enable(uint32_t group, bool enable)
+{
+  EFM_ASSERT((group < RATE_GROUPS_MAX) && rate_group[group].period);
+
+  rate_group[group].enabled = enable;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Advances the base tick and releases the groups that are due.
+ *
+ * @details
+ *  Called once per base timer period. Groups due on the same tick are
+ *  posted together and run in the scheduler's order.
+ ******************************************************************************/
+void rate_group_tick(void)
+{
+  RATE_GROUP_STRUCT *rg;
+  uint32_t group;
+
+  rate_group_tick_count++;
+
+  for(group = 0; group < RATE_GROUPS_MAX; group++)
+  {
+    rg = &rate_group[group];
+    if((rg->period == 0) || (--rg->wait != 0))
+    {
+      continue;
+    }
+
+    rg->wait = rg->period;
+    if(rg->enabled)
+    {
+      rg->releases++;
+      add_scheduled_event(rg->cb);
+    }
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads the base tick count.
+ *
+ * @return
+ *  Returns the base ticks since rate_group_open().
+ ******************************************************************************/
+uint32_t rate_group_ticks(void)
+{
+  return rate_group_tick_count;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads how many times a group has been released.
+ *
+ * @param[in] group
+ *  Handle from rate_group_add().
+ *
+ * @return
+ *  Returns the group's release count.
+ ******************************************************************************/
+uint32_t rate_group_releases(uint32_t group)
+{
+  EFM_ASSERT(group < RATE_GROUPS_MAX);
+
+  return rate_group[group].releases;
+}
+
+
+/******************************************************************************
+ ***************************** PRIVATE FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Computes the ticks from now to a group's next release.
+ *
+ * @param[in] period
+ *  Base ticks between releases.
+ *
+ * @param[in] phase
+ *  Tick within the period on which the group is released.
+ *
+ * @return
+ *  Returns the ticks until the first tick after now with
+ *  (tick % period) == phase (1 to period).
+ ******************************************************************************/
+uint32_t rate_group_wait(uint32_t period, uint32_t phase)
+{
+  uint32_t next = (rate_group_tick_count + 1) % period;
+
+  return ((phase + period - next) % period) + 1;
+}
@@ -0,0 +1,435 @@
+/***************************************************************************//**
+ * @file
+ *   sample_log.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   On-flash sample log with a sparse time index for range queries
+ *
+ * @details
+ *   Records are delta-compressed frames (log_format.h) appended to a ring of
+ *   flash pages. The index is one entry per page, its sequence number and
+ *   first timestamp, rebuilt from the page headers at open. Because every
+ *   page decodes on its own, a range query binary-searches the index for
+ *   the page holding its start and decodes forward from there, never
+ *   touching older pages.
+ *
+ *   Log time is seconds of logged operation: letimer_uptime_s() plus the
+ *   time of the last record found at open, so it keeps increasing across
+ *   resets and the index stays sorted.
+ *
+ *   Opened with descriptors, the log is raw: records carry the sensors' raw
+ *   codes and every page opens with the session's descriptors, so the host
+ *   converts (tools/dump.c) and the node logs without converting.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "sample_log.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define PAGE_ADDR(p)          (SAMPLE_LOG_BASE + ((p) * FLASH_PAGE_SIZE))  // address of physical page p
+#define PAGE_HEADER(p)        ((const LOG_PAGE_HEADER_STRUCT *)PAGE_ADDR(p))
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+static uint32_t sample_log_seq[SAMPLE_LOG_PAGES];   // index: sequence number per page (SAMPLE_LOG_NO_PAGE if unused)
+static uint32_t sample_log_t0[SAMPLE_LOG_PAGES];    // index: first timestamp per page
+static uint32_t sample_log_oldest;                  // physical page holding the oldest records
+static uint32_t sample_log_used;                    // pages holding records
+static uint32_t sample_log_head;                    // physical page being written
+static uint32_t sample_log_head_off;                // byte offset of the next frame in the head page
+static uint32_t sample_log_epoch;                   // log time at letimer_uptime_s() == 0
+static LOG_DELTA_STRUCT sample_log_delta;           // encoder state of the head page
+static const LOG_DESC_STRUCT *sample_log_desc;      // per-channel descriptors of a raw log (NULL: converted)
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static uint32_t sample_log_physical(uint32_t logical);
+static void sample_log_new_page(uint32_t t0);
+static void sample_log_scan_head(void);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Opens the sample log.
+ *
+ * @details
+ *  Reads every page header to rebuild the time index, then decodes the
+ *  newest page to find where to append and the last logged time.
+ *
+ * @param[in] desc
+ *  LOG_CHANNELS descriptors to log raw codes, or NULL to log centi-units.
+ *  Must stay valid while the log is open.
+ ******************************************************************************/
+void sample_log_open(const LOG_DESC_STRUCT *desc)
+{
+  const LOG_PAGE_HEADER_STRUCT *header;
+  uint32_t newest_seq = 0;
+  uint32_t oldest_seq = SAMPLE_LOG_NO_PAGE;
+  uint32_t p;
+
+  // the format's page size must be the device's
+  EFM_ASSERT(LOG_PAGE_SIZE == FLASH_PAGE_SIZE);
+
+  sample_log_used = 0;
+  sample_log_oldest = 0;
+  sample_log_head = 0;
+  sample_log_head_off = 0;
+  sample_log_epoch = 0;
+  sample_log_desc = desc;
+
+  for(p = 0; p < SAMPLE_LOG_PAGES; p++)
+  {
+    header = PAGE_HEADER(p);
+    if(log_page_valid(header))
+    {
+      sample_log_seq[p] = header->seq;
+      sample_log_t0[p] = header->t0;
+      sample_log_used++;
+
+      if(header->seq >= newest_seq)
+      {
+        newest_seq = header->seq;
+        sample_log_head = p;
+      }
+      if(header->seq < oldest_seq)
+      {
+        oldest_seq = header->seq;
+        sample_log_oldest = p;
+      }
+    }
+    else
+    {
+      sample_log_seq[p] = SAMPLE_LOG_NO_PAGE;
+    }
+  }
+
+  if(sample_log_used)
+  {
+    sample_log_scan_head();
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Returns the current log time.
+ *
+ * @return
+ *  Log time (in seconds), continuous across resets.
+ ******************************************************************************/
+uint32_t sample_log_time(void)
+{
+  return sample_log_epoch + letimer_uptime_s();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Appends a record.
+ *
+ * @details
+ *  Encodes and writes one frame. When the head page is full the next page
+ *  is erased (dropping the oldest page once the ring is full) and started
+ *  with a header carrying this record's time, which is its index entry.
+ *
+ * @param[in] rec
+ *  Record; its time must not be earlier than the previous record's.
+ ******************************************************************************/
+void sample_log_append(const LOG_RECORD_STRUCT *rec)
+{
+  uint8_t frame[LOG_FRAME_MAX];
+  uint32_t len;
+
+  if((sample_log_head_off == 0) || ((sample_log_head_off + LOG_FRAME_MAX) > FLASH_PAGE_SIZE))
+  {
+    sample_log_new_page(rec->time);
+  }
+
+  len = log_frame_encode(&sample_log_delta, rec, frame);
+
+  MSC_Init();
+  MSC_WriteWord((uint32_t *)(PAGE_ADDR(sample_log_head) + sample_log_head_off), frame, len);
+  MSC_Deinit();
+
+  sample_log_head_off += len;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Closes the head page.
+ *
+ * @details
+ *  For a raw log whose descriptors changed: the next record starts a new
+ *  page, which opens with the descriptors as they are then, so no page
+ *  mixes codes for two calibrations.
+ ******************************************************************************/
+void sample_log_close_page(void)
+{
+  sample_log_head_off = FLASH_PAGE_SIZE;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts a range query.
+ *
+ * @details
+ *  Binary-searches the index for the last page whose first timestamp is at
+ *  or before `from`; records before `from` in that page are skipped as the
+ *  query runs. No frames are decoded here.
+ *
+ * @param[out] query
+ *  Query state.
+ *
+ * @param[in] from
+ *  Start of the range (log time, in seconds).
+ *
+ * @param[in] to
+ *  End of the range, inclusive.
+ ******************************************************************************/
+void sample_log_query_open(SAMPLE_LOG_QUERY_STRUCT *query, uint32_t from, uint32_t to)
+{
+  uint32_t lo = 0;
+  uint32_t hi = sample_log_used;
+  uint32_t mid;
+
+  query->from = from;
+  query->to = to;
+  query->done = (sample_log_used == 0) || (from > to);
+
+  // first logical page with t0 > from, then step back one
+  while(lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if(sample_log_t0[sample_log_physical(mid)] <= from)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  query->page = sample_log_physical((lo > 0) ? (lo - 1) : 0);
+  query->seq = sample_log_seq[query->page];
+  query->offset = sizeof(LOG_PAGE_HEADER_STRUCT);
+  log_delta_reset(&query->delta, sample_log_t0[query->page], log_page_raw(PAGE_HEADER(query->page)));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Advances a range query.
+ *
+ * @details
+ *  Decodes at most `max` frames, so the caller bounds the work per call
+ *  (e.g. one call per scheduler pass). If the ring overwrote the page the
+ *  query was reading, it resumes at the oldest page.
+ *
+ * @param[in] query
+ *  Query state.
+ *
+ * @param[out] out
+ *  Records in the range, oldest first. Records of raw pages hold codes
+ *  (rec.raw); convert them with query->delta.desc.
+ *
+ * @param[in] max
+ *  Capacity of out, and the frame budget of this call.
+ *
+ * @return
+ *  Returns the number of records written to out; query->done is set once
+ *  the range is exhausted.
+ ******************************************************************************/
+uint32_t sample_log_query_next(SAMPLE_LOG_QUERY_STRUCT *query, LOG_RECORD_STRUCT *out, uint32_t max)
+{
+  LOG_RECORD_STRUCT rec;
+  uint32_t budget = max;
+  uint32_t count = 0;
+  int32_t len;
+
+  while(!query->done && budget)
+  {
+    // page recycled under the query
+    if(sample_log_seq[query->page] != query->seq)
+    {
+      query->page = sample_log_oldest;
+      query->seq = sample_log_seq[query->page];
+      query->offset = sizeof(LOG_PAGE_HEADER_STRUCT);
+      log_delta_reset(&query->delta, sample_log_t0[query->page], log_page_raw(PAGE_HEADER(query->page)));
+    }
+
+    len = log_frame_decode(&query->delta,
+                           (const uint8_t *)(PAGE_ADDR(query->page) + query->offset),
+                           FLASH_PAGE_SIZE - query->offset, &rec);
+    budget--;
+
+    if(len > 0)
+    {
+      query->offset += len;
+      if(rec.mask == 0)
+      {
+        // descriptor frame: nothing to return
+      }
+      else if(rec.time > query->to)
+      {
+        query->done = true;
+      }
+      else if(rec.time >= query->from)
+      {
+        out[count++] = rec;
+      }
+    }
+    // end of page (or a damaged frame): move on, or stop at the head
+    else if(query->page == sample_log_head)
+    {
+      query->done = true;
+    }
+    else
+    {
+      query->page = (query->page + 1) % SAMPLE_LOG_PAGES;
+      query->seq = sample_log_seq[query->page];
+      query->offset = sizeof(LOG_PAGE_HEADER_STRUCT);
+      log_delta_reset(&query->delta, sample_log_t0[query->page], log_page_raw(PAGE_HEADER(query->page)));
+    }
+  }
+
+  return count;
+}
+
+
+/******************************************************************************
+ ***************************** PRIVATE FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Maps a logical page (0 = oldest) to its physical page.
+ ******************************************************************************/
+uint32_t sample_log_physical(uint32_t logical)
+{
+  return (sample_log_oldest + logical) % SAMPLE_LOG_PAGES;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Erases the next page and starts it with a header.
+ *
+ * @param[in] t0
+ *  Time of the first record to go in the page.
+ ******************************************************************************/
+void sample_log_new_page(uint32_t t0)
+{
+  LOG_PAGE_HEADER_STRUCT header;
+  uint8_t frame[LOG_DESC_FRAME_MAX];
+  uint32_t seq = 0;
+  uint32_t next = 0;
+  uint32_t off;
+  uint32_t len;
+  uint32_t ch;
+
+  if(sample_log_used)
+  {
+    seq = sample_log_seq[sample_log_head] + 1;
+    next = (sample_log_head + 1) % SAMPLE_LOG_PAGES;
+  }
+
+  // ring full: the page to erase is the oldest
+  if(sample_log_used == SAMPLE_LOG_PAGES)
+  {
+    sample_log_oldest = (sample_log_oldest + 1) % SAMPLE_LOG_PAGES;
+    sample_log_used--;
+  }
+  else if(sample_log_used == 0)
+  {
+    sample_log_oldest = next;
+  }
+
+  // drop the index entry before the page is erased
+  sample_log_seq[next] = SAMPLE_LOG_NO_PAGE;
+
+  log_page_header(&header, seq, t0, sample_log_desc != NULL);
+  off = sizeof(header);
+
+  MSC_Init();
+  MSC_ErasePage((uint32_t *)PAGE_ADDR(next));
+  MSC_WriteWord((uint32_t *)PAGE_ADDR(next), &header, sizeof(header));
+
+  // a raw page carries the descriptors, so it decodes on its own
+  for(ch = 0; sample_log_desc && (ch < LOG_CHANNELS); ch++)
+  {
+    len = log_desc_encode(&sample_log_desc[ch], ch, frame);
+    MSC_WriteWord((uint32_t *)(PAGE_ADDR(next) + off), frame, len);
+    off += len;
+  }
+  MSC_Deinit();
+
+  sample_log_seq[next] = seq;
+  sample_log_t0[next] = t0;
+  sample_log_used++;
+  sample_log_head = next;
+  sample_log_head_off = off;
+  log_delta_reset(&sample_log_delta, t0, sample_log_desc != NULL);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Decodes the head page to find the append offset and the last logged time.
+ *
+ * @details
+ *  A damaged frame (e.g. power lost mid-write) closes the page; the next
+ *  append starts a new one. Raw pages are closed too, so every raw page
+ *  carries the descriptors of the session that wrote it, and so is a page
+ *  of the other format.
+ ******************************************************************************/
+void sample_log_scan_head(void)
+{
+  LOG_RECORD_STRUCT rec;
+  uint32_t offset = sizeof(LOG_PAGE_HEADER_STRUCT);
+  bool raw = log_page_raw(PAGE_HEADER(sample_log_head));
+  int32_t len;
+
+  log_delta_reset(&sample_log_delta, sample_log_t0[sample_log_head], raw);
+
+  do
+  {
+    len = log_frame_decode(&sample_log_delta, (const uint8_t *)(PAGE_ADDR(sample_log_head) + offset),
+                           FLASH_PAGE_SIZE - offset, &rec);
+    if(len > 0)
+    {
+      offset += len;
+    }
+  }
+  while(len > 0);
+
+  sample_log_head_off = ((len == LOG_FRAME_BAD) || raw || sample_log_desc) ? FLASH_PAGE_SIZE : offset;
+
+  // continue log time after the last record
+  sample_log_epoch = sample_log_delta.time + 1;
+}
@@ -13,6 +13,7 @@
 // included header file
 //*******************************************************
 #include "scheduler.h"
+#include "trace.h"
 
 
 //*******************************************************
@@ -43,15 +44,15 @@ static uint32_t event_scheduled;
 ******************************************************************************/
 void scheduler_open(void)
 {
-  // make atomic
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   // initialize events to zero
   event_scheduled = CLEAR_SCHEDULED_EVENTS;
 
   // allow interrupts
-  CORE_EXIT_CRITICAL();
+  IRQ_EXIT_MASK();
 }
 
 
@@ -71,18 +72,22 @@ void scheduler_open(void)
  *    32-bit unsigned integer value pertaining to the event to be scheduled
  *
 ******************************************************************************/
+HOTPATH_DEFINITION_BEGIN
 void add_scheduled_event(uint32_t event)
 {
-  // make atomic
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   // add event
   event_scheduled |= event;
 
   // allow interrupts
-  CORE_EXIT_CRITICAL();
+  IRQ_EXIT_MASK();
+
+  trace_event(traceSchedPost, (int32_t)event);
 }
+HOTPATH_DEFINITION_END
 
 
 /***************************************************************************//**
@@ -104,15 +109,18 @@ void add_scheduled_event(uint32_t event)
 ******************************************************************************/
 void remove_scheduled_event(uint32_t event)
 {
-  // make atomic
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   // remove event
   event_scheduled &= ~(event);
 
   // allow interrupts
-  CORE_EXIT_CRITICAL();
+  IRQ_EXIT_MASK();
+
+  // callbacks remove their own event first, so this marks the callback running
+  trace_event(traceSchedTake, (int32_t)event);
 }
 
 
@@ -21,15 +21,21 @@
 static volatile uint32_t shtc3_read_result;
 static volatile uint32_t shtc3_write_data;
 static volatile uint16_t shtc3_crc_data;
-static volatile float shtc3_rh;
-static volatile float shtc3_temp;
+static SNAPSHOT_LOCK_STRUCT shtc3_snapshot_lock;
+static volatile I2C_RESULT_Typedef shtc3_result;
+static uint32_t shtc3_token;
+static const CONV_COEF_STRUCT shtc3_rh_coef = SHTC3_RH_COEF;
+static const CONV_COEF_STRUCT shtc3_temp_coef = SHTC3_T_COEF;
 
 //***********************************************************************************
 // static/global functions
 //***********************************************************************************
-static bool check_lock(SHTC3_CMD_Typedef cmd);
-static uint16_t shtc3_calc_rh(uint16_t data);
-static uint16_t shtc3_calc_temp(uint16_t data);
+static bool check_split(SHTC3_CMD_Typedef cmd);
+static I2C_PRIO_Typedef check_prio(SHTC3_CMD_Typedef cmd);
+static void shtc3_write_init(volatile I2C_SM_STRUCT *i2c_start_sm, I2C_TypeDef *i2c,
+                             SHTC3_CMD_Typedef cmd, uint32_t shtc3_cb);
+static int32_t shtc3_calc_rh(uint16_t data);
+static int32_t shtc3_calc_temp(uint16_t data);
 
 //***********************************************************************************
 // function definitions
@@ -78,12 +84,61 @@ void shtc3_open(I2C_TypeDef *i2c)
   // open I2C peripheral
   i2c_open(i2c, &app_i2c_open);
 
+  // nothing sampled yet
+  snapshot_open(&shtc3_snapshot_lock);
+
   /* TODO: configure HW_delay for micro-second delays */
   // timer delay of 1ms (Max required is 240 micro-seconds; DS 3.1)
   timer_delay(1);
 
-  // transmit sleep command
-  shtc3_write(I2C1, sleep, SHTC3_OPEN_CB);
+  // transmit sleep command and wait for it
+  shtc3_write_sync(I2C1, sleep, SHTC3_SYNC_TIMEOUT);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Takes ownership of the SHTC3's bus for a measurement sequence.
+ *
+ * @details
+ *  Every SHTC3 transaction submitted until shtc3_release() carries the
+ *  token, so wakeup -> measure -> read -> sleep runs without another
+ *  driver's transactions in between and with one bus reset at the end.
+ *  Does not wait: if another sequence owns the bus, the SHTC3's
+ *  transactions queue until it is released. Does nothing if the SHTC3
+ *  already owns a token.
+ *
+ * @param[in] i2c
+ *  I2C peripheral to use {Can use I2C0 or I2C1).
+ ******************************************************************************/
+void shtc3_acquire(I2C_TypeDef *i2c)
+{
+  if(shtc3_token == I2C_NO_TOKEN)
+  {
+      shtc3_token = i2c_acquire(i2c);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Gives up ownership of the SHTC3's bus.
+ *
+ * @details
+ *  Call after the sequence's last transaction is submitted, or when the
+ *  sequence is cut short; the bus passes on once that transaction
+ *  completes.
+ *
+ * @param[in] i2c
+ *  I2C peripheral to use {Can use I2C0 or I2C1).
+ ******************************************************************************/
+void shtc3_release(I2C_TypeDef *i2c)
+{
+  if(shtc3_token != I2C_NO_TOKEN)
+  {
+      i2c_release(i2c, shtc3_token);
+      shtc3_token = I2C_NO_TOKEN;
+  }
 }
 
 
@@ -97,7 +152,7 @@ void shtc3_open(I2C_TypeDef *i2c)
  *  Starts a write transaction over the I2C bus.
  *
  * @details
- *  initialized an I2C state machine and transmits a write request packet.
+ *  initialized an I2C state machine and submits a write request packet.
  *
  * @param[in] i2c
  *  I2C peripheral to use {Can use I2C0 or I2C1).
@@ -110,47 +165,55 @@ void shtc3_open(I2C_TypeDef *i2c)
  ******************************************************************************/
 void shtc3_write(I2C_TypeDef *i2c, SHTC3_CMD_Typedef cmd, uint32_t shtc3_cb)
 {
-  // atomic operation
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  volatile I2C_SM_STRUCT i2c_start_sm;
 
-  // reset read_result
-  shtc3_read_result = SHTC3_RESET_READ_RESULT;
+  // initialize local I2C state machine
+  shtc3_write_init(&i2c_start_sm, i2c, cmd, shtc3_cb);
 
-  bool lock = check_lock(cmd);
+  // start I2C protocol; transmits start once the bus is available
+  i2c_init_sm(&i2c_start_sm);
+}
 
-  // initialize local I2C state machine
-  volatile I2C_SM_STRUCT i2c_start_sm;
-  i2c_start_sm.I2Cn = i2c;
-  i2c_start_sm.curr_state = reqRes;
-  i2c_start_sm.slave_addr = SHTC3_ADDR;
-  i2c_start_sm.read_operation = false;
-  i2c_start_sm.rxdata = &i2c->RXDATA;
-  i2c_start_sm.txdata = &i2c->TXDATA;
-  i2c_start_sm.data = &shtc3_write_data;
-  i2c_start_sm.tx_cmd = ((uint16_t)cmd);
-  i2c_start_sm.bytes_req = SHTC3_ZERO_BYTES;
-  i2c_start_sm.bytes_tx = SHTC3_TX_2_BYTES;
-  i2c_start_sm.num_bytes = SHTC3_TX_2_BYTES;
-  i2c_start_sm.i2c_cb = shtc3_cb;
-  i2c_start_sm.lock_sm = lock;
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+/***************************************************************************//**
+ * @brief
+ *  Performs a write transaction over the I2C bus and waits for it.
+ *
+ * @details
+ *  Same transaction as shtc3_write(), but the core sleeps in EM1 until it
+ *  completes instead of a callback being scheduled. Intended for init and
+ *  diagnostic code.
+ *
+ * @param[in] i2c
+ *  I2C peripheral to use {Can use I2C0 or I2C1).
+ *
+ * @param[in] cmd
+ *  Enumerated command for transmit to SHTC3.
+ *
+ * @param[in] timeout_ms
+ *  Time, in milliseconds, to wait for completion.
+ *
+ * @return
+ *  True if the write completed and the SHTC3 acknowledged it; false on
+ *  timeout or if the SHTC3 did not answer.
+ ******************************************************************************/
+bool shtc3_write_sync(I2C_TypeDef *i2c, SHTC3_CMD_Typedef cmd, uint32_t timeout_ms)
+{
+  volatile I2C_SM_STRUCT i2c_start_sm;
 
-  // start I2C protocol
-  i2c_init_sm(&i2c_start_sm);
+  // initialize local I2C state machine
+  shtc3_write_init(&i2c_start_sm, i2c, cmd, I2C_NO_CB);
 
-  // transmit start
-  i2c_tx_req(&i2c_start_sm, i2cWriteBit);
+  // run I2C protocol to completion
+  return i2c_transfer_sync(&i2c_start_sm, timeout_ms) && shtc3_responding();
 }
 
 
 void shtc3_read(I2C_TypeDef *i2c, bool checksum, uint32_t shtc3_cb)
 {
-  // atomic operation
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   // reset read_result
   shtc3_read_result = SHTC3_RESET_READ_RESULT;
@@ -170,16 +233,19 @@ void shtc3_read(I2C_TypeDef *i2c, bool checksum, uint32_t shtc3_cb)
   i2c_start_sm.bytes_tx = SHTC3_ZERO_BYTES;
   i2c_start_sm.num_bytes = SHTC3_REQ_6_BYTES;
   i2c_start_sm.i2c_cb = shtc3_cb;
-  i2c_start_sm.lock_sm = false;
-
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
-
-  // start I2C protocol
+  i2c_start_sm.token = shtc3_token;
+  i2c_start_sm.req_rw = i2cReadBit;
+  i2c_start_sm.prio = i2cPrioUrgent;
+  i2c_start_sm.split_ok = false;
+  i2c_start_sm.done = NULL;
+  i2c_start_sm.result = &shtc3_result;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+
+  // start I2C protocol; polls for measurement completion once the bus
+  // is available
   i2c_init_sm(&i2c_start_sm);
-
-  // Poll for measurement completion
-  i2c_tx_req(&i2c_start_sm, i2cReadBit);
 }
 
 
@@ -200,29 +266,57 @@ void shtc3_read(I2C_TypeDef *i2c, bool checksum, uint32_t shtc3_cb)
  *
  *  This private function is used after one of the enumerated "relative humidity
  *  first" commands. The 2-MSBytes are RH data; the 2-LSBytes are temperature data.
+ *
+ *  Both codes are published together as one snapshot. Only the codes are
+ *  published; they are converted by the reader (see shtc3_convert_rh()), once
+ *  per sample, so a sample nobody reads costs no conversion.
  ******************************************************************************/
 void shtc3_parse_measurement_data_RH_first(void)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  SNAPSHOT_STRUCT snap;
+  uint32_t result;
+
+  memset(&snap, 0, sizeof(snap));
+
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  result = shtc3_read_result;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
 
   // manipulate binary shift truncation to split
   // data into MSB (index 1) and LSB (index 0)
   uint16_t split[2];
-  split[1] = (((uint32_t)shtc3_read_result) >> 16);
-  split[0] = ((((uint32_t)shtc3_read_result) << 16) >> 16);
+  split[1] = (result >> 16);
+  split[0] = ((result << 16) >> 16);
 
-  // calculate measurements
-  float rh = shtc3_calc_rh(split[1]);
-  float temp = shtc3_calc_temp(split[0]);
+  snap.rh_code = split[1];
+  snap.temp_code = split[0];
+  snap.time = letimer_uptime();
+  snap.status = snapshotOk;
 
-  // modify private variables
-  shtc3_set_rh(rh);
-  shtc3_set_temp(temp);
+  snapshot_publish(&shtc3_snapshot_lock, &snap);
+}
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+
+/***************************************************************************//**
+ * @brief
+ *  Records a missed sample.
+ *
+ * @details
+ *  Republishes the last codes and their timestamp with snapshotMissed, so
+ *  readers see the sensor did not answer and how old the values are.
+ ******************************************************************************/
+void shtc3_sample_missed(void)
+{
+  SNAPSHOT_STRUCT snap = *snapshot_last(&shtc3_snapshot_lock);
+
+  snap.status = snapshotMissed;
+
+  snapshot_publish(&shtc3_snapshot_lock, &snap);
 }
 
 
@@ -231,151 +325,282 @@ void shtc3_parse_measurement_data_RH_first(void)
  ******************************************************************************/
 
 
-float shtc3_get_rh()
+/***************************************************************************//**
+ * @brief
+ *  Accessor function for the last published sample.
+ *
+ * @details
+ *  Lock-free: the RH and temperature always come from the same sample,
+ *  and no interrupts are masked. Only the codes are copied; the status
+ *  and timestamp tell whether the sample is worth converting (see
+ *  shtc3_convert_rh()).
+ *
+ * @param[out] snap
+ *  The last sample's codes, its timestamp and status.
+ ******************************************************************************/
+void shtc3_snapshot(SNAPSHOT_STRUCT *snap)
+{
+  snapshot_read(&shtc3_snapshot_lock, snap);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Returns a snapshot's relative humidity.
+ *
+ * @details
+ *  Converts and calibrates the RH code, unless the reader's values already
+ *  hold it for this snapshot (same sequence): a reader that looks at one
+ *  sample several times converts it once, and a reader that only wants
+ *  RH never converts the temperature.
+ *
+ * @param[in] snap
+ *  Snapshot taken with shtc3_snapshot().
+ *
+ * @param[in,out] values
+ *  The reader's converted values; kept by the reader between calls.
+ *
+ * @return
+ *  Percent relative humidity.
+ ******************************************************************************/
+float shtc3_convert_rh(const SNAPSHOT_STRUCT *snap, SNAPSHOT_VALUES_STRUCT *values)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // converted already
+  if(values->rh_seq != snap->seq)
+  {
+    values->rh = (float)shtc3_calc_rh(snap->rh_code) / CAL_CENTI;
+    values->rh_seq = snap->seq;
+  }
+
+  return values->rh;
+}
 
-  float rh = shtc3_rh;
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+/***************************************************************************//**
+ * @brief
+ *  Returns a snapshot's temperature.
+ *
+ * @details
+ *  As shtc3_convert_rh(), for the temperature code.
+ *
+ * @param[in] snap
+ *  Snapshot taken with shtc3_snapshot().
+ *
+ * @param[in,out] values
+ *  The reader's converted values; kept by the reader between calls.
+ *
+ * @return
+ *  Temperature, Celsius.
+ ******************************************************************************/
+float shtc3_convert_temp(const SNAPSHOT_STRUCT *snap, SNAPSHOT_VALUES_STRUCT *values)
+{
+  // converted already
+  if(values->temp_seq != snap->seq)
+  {
+    values->temp = (float)shtc3_calc_temp(snap->temp_code) / CAL_CENTI;
+    values->temp_seq = snap->seq;
+  }
 
-  return rh;
+  return values->temp;
 }
 
 
-float shtc3_get_temp()
+/***************************************************************************//**
+ * @brief
+ *  Accessor function for the outcome of the last transaction.
+ *
+ * @details
+ *  False once the SHTC3 stopped answering and the I2C driver gave up on a
+ *  transaction; the application's health tracking is driven by this.
+ *
+ * @return
+ *  Returns true if the SHTC3 answered its last transaction.
+ ******************************************************************************/
+bool shtc3_responding(void)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
-  float temp = shtc3_temp;
+  bool ok = (shtc3_result == i2cResultOk);
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // allow interrupts
+  IRQ_EXIT_MASK();
 
-  return temp;
+  return ok;
 }
 
 
 /******************************************************************************
- ************************ PUBLIC MODIFIER FUNCTIONS ***************************
+ ***************************** PRIVATE FUNCTIONS ******************************
  ******************************************************************************/
 
 
 /***************************************************************************//**
  * @brief
- *  Private function to store percent relative humidity data in private
- *  data member.
+ *  Converts a raw relative humidity measurement code to percent humidity
  *
  * @details
- *  Stores calculated data in private data member for easy access.
+ *  Converts in fixed point and applies the device calibration record.
+ *
+ * @return
+ *  Returns relative humidity in centi-percent.
  ******************************************************************************/
-void shtc3_set_rh(float rh)
+int32_t shtc3_calc_rh(uint16_t data)
 {
-  shtc3_rh = rh;
+  // convert raw measurement code to % RH, in centi-units
+  int32_t rh = conv_sample(&shtc3_rh_coef, data);
 
-  // delay to avoid RMW errors
-  timer_delay(80);
+  // apply this device's calibration
+  return cal_apply(calShtc3RH, rh);
 }
 
 
 /***************************************************************************//**
  * @brief
- *  Private function to store temperature (Celsius) data in private
- *  data member.
+ *  Converts a raw temperature measurement code to temperature (Celsius)
  *
  * @details
- *  Stores calculated data in private data member for easy access.
+ *  Converts in fixed point and applies the device calibration record.
+ *
+ * @return
+ *  Returns temperature in centi-degrees Celsius.
  ******************************************************************************/
-void shtc3_set_temp(float temp)
+int32_t shtc3_calc_temp(uint16_t data)
 {
-  shtc3_temp = temp;
+  // Convert raw measurement code to temperature (Celsius), in centi-units
+  int32_t temp = conv_sample(&shtc3_temp_coef, data);
 
-  // delay for RMW errors
-  timer_delay(80);
+  // apply this device's calibration
+  return cal_apply(calShtc3Temp, temp);
 }
 
 
-/******************************************************************************
- ***************************** PRIVATE FUNCTIONS ******************************
- ******************************************************************************/
-
 
 /***************************************************************************//**
  * @brief
- *  Converts a raw relative humidity measurement code to percent humidity
+ *  Private function which determines whether a command is a safe split point.
  *
  * @details
- *  Stores calculated data in private data member for easy access.
+ *  After wakeup and after a measurement command the SHTC3 is busy on its
+ *  own, so urgent traffic for another device may be slotted in without
+ *  breaking the sequence that owns the bus.
+ *
+ * @param[in] cmd
+ *  Enumerated command to check.
+ *
+ * @return split
+ *  Returns whether the owning sequence may be split after the command.
  ******************************************************************************/
-uint16_t shtc3_calc_rh(uint16_t data)
+bool check_split(SHTC3_CMD_Typedef cmd)
 {
-  // convert raw measurement code to % RH
-  float rh =  (100 * (((float)data) / 65536));
+  bool split;
 
-  return rh;
+  switch(cmd)
+  {
+    case wakeup:
+    case readRHFirst_LPM:
+      split = true;
+      break;
+    default:
+      split = false;
+      break;
+  }
+
+  return split;
 }
 
 
 /***************************************************************************//**
  * @brief
- *  Converts a raw temperature measurement code to temperature (Celsius)
+ *  Private function which initializes a write state machine.
  *
  * @details
- *  Stores calculated data in private data member for easy access.
+ *  Transactions carry the SHTC3's bus token while it owns the bus (see
+ *  shtc3_acquire()).
+ *
+ * @param[out] i2c_start_sm
+ *  Local I2C state machine to initialize.
+ *
+ * @param[in] i2c
+ *  I2C peripheral to use {Can use I2C0 or I2C1).
+ *
+ * @param[in] cmd
+ *  Enumerated command for transmit to SHTC3.
+ *
+ * @param[in] shtc3_cb
+ *  Callback event to schedule.
  ******************************************************************************/
-uint16_t shtc3_calc_temp(uint16_t data)
+void shtc3_write_init(volatile I2C_SM_STRUCT *i2c_start_sm, I2C_TypeDef *i2c,
+                      SHTC3_CMD_Typedef cmd, uint32_t shtc3_cb)
 {
-  // Convert raw measurement code to temperature (Celsius)
-  float temp =  (175 * ((float)(data) / 65536)) - 45;
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
-  return temp;
-}
+  // reset read_result
+  shtc3_read_result = SHTC3_RESET_READ_RESULT;
 
+  bool split = check_split(cmd);
+
+  // initialize local I2C state machine
+  i2c_start_sm->I2Cn = i2c;
+  i2c_start_sm->curr_state = reqRes;
+  i2c_start_sm->slave_addr = SHTC3_ADDR;
+  i2c_start_sm->read_operation = false;
+  i2c_start_sm->rxdata = &i2c->RXDATA;
+  i2c_start_sm->txdata = &i2c->TXDATA;
+  i2c_start_sm->data = &shtc3_write_data;
+  i2c_start_sm->tx_cmd = ((uint16_t)cmd);
+  i2c_start_sm->bytes_req = SHTC3_ZERO_BYTES;
+  i2c_start_sm->bytes_tx = SHTC3_TX_2_BYTES;
+  i2c_start_sm->num_bytes = SHTC3_TX_2_BYTES;
+  i2c_start_sm->i2c_cb = shtc3_cb;
+  i2c_start_sm->token = shtc3_token;
+  i2c_start_sm->req_rw = i2cWriteBit;
+  i2c_start_sm->prio = check_prio(cmd);
+  i2c_start_sm->split_ok = split;
+  i2c_start_sm->done = NULL;
+  i2c_start_sm->result = &shtc3_result;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
 
 
 /***************************************************************************//**
  * @brief
- *  Private function which determines whether the I2C state machine requires
- *  locking.
+ *  Private function which determines the bus priority class of a command.
  *
  * @details
- *  Locking refers to whether or not the mStop state, in the state machine,
- *  is allows to reset the bus. Locking is usually reserved for transactions
- *  which require more than one request.
+ *  The wakeup -> measure -> read chain feeds the measurement and is time
+ *  critical. Sleep and reset are power management; ID reads are
+ *  housekeeping.
  *
  * @param[in] cmd
- *  Enumerated command to determine whether the I2C state machine requires
- *  locking.
+ *  Enumerated command to determine the priority class.
  *
- * @return lock
- *  Returns whether or not a command requires locking the state machine.
+ * @return prio
+ *  Returns the priority class of the transaction.
  ******************************************************************************/
-bool check_lock(SHTC3_CMD_Typedef cmd)
+I2C_PRIO_Typedef check_prio(SHTC3_CMD_Typedef cmd)
 {
-  bool lock;
+  I2C_PRIO_Typedef prio;
 
   switch(cmd)
   {
     case sleep:
-      lock = false;
-      break;
-    case wakeup:
-      lock = true;
+    case softReset:
+      prio = i2cPrioNormal;
       break;
-    case readRHFirst_LPM:
-      lock = true;
+    case read_id_reg:
+      prio = i2cPrioHousekeeping;
       break;
     default:
-      // if default case is reached, the command has not
-      // yet been implemented.
-      EFM_ASSERT(false);
+      // wakeup and measurement commands
+      prio = i2cPrioUrgent;
       break;
   }
 
-  return lock;
+  return prio;
 }
@@ -20,16 +20,20 @@
 static volatile uint32_t si7021_read_result;
 static volatile uint32_t si7021_write_data;
 static volatile uint16_t si7021_crc_data;
-static volatile float si7021_rh;
-static volatile float si7021_temp;
+static uint16_t si7021_rh_code;             // RH code waiting for its temperature
+static SNAPSHOT_LOCK_STRUCT si7021_snapshot_lock;
 static volatile uint8_t si7021_user_reg_data;
+static volatile I2C_RESULT_Typedef si7021_result;
+static const CONV_COEF_STRUCT si7021_rh_coef = SI7021_RH_COEF;
+static const CONV_COEF_STRUCT si7021_temp_coef = SI7021_T_COEF;
 
 //***********************************************************************************
 // static/private functions
 //***********************************************************************************
 static uint8_t req_bytes(uint8_t cmd);
-static void si7021_calc_RH(void);
-static void si7021_calc_temp(void);
+static I2C_PRIO_Typedef cmd_prio(uint8_t cmd);
+static int32_t si7021_calc_RH(uint16_t code);
+static int32_t si7021_calc_temp(uint16_t code);
 
 //***********************************************************************************
 // function definitions
@@ -85,6 +89,9 @@ void si7021_i2c_open(I2C_TypeDef *i2c,
   // open I2C peripheral
   i2c_open(i2c, &app_i2c_open);
 
+  // nothing sampled yet
+  snapshot_open(&si7021_snapshot_lock);
+
   // timer delay of 1ms (Max required is 240 micro-seconds; DS 3.1)
   timer_delay(80);
 
@@ -103,8 +110,8 @@ void si7021_i2c_open(I2C_TypeDef *i2c,
  *  Starts a read transaction over I2C bus.
  *
  * @details
- *  Initializes an I2C state machine and transmits the initial
- *  request packet.
+ *  Initializes an I2C state machine and submits it to the bus. The initial
+ *  request packet is transmitted as soon as the bus is available.
  *
  * @param[in] i2c
  *  Desired I2Cn peripheral (either I2C0 or I2C1).
@@ -117,9 +124,9 @@ void si7021_i2c_open(I2C_TypeDef *i2c,
  ******************************************************************************/
 void si7021_i2c_read(I2C_TypeDef *i2c, SI7021_CMD_Typedef cmd, bool checksum, uint32_t si7021_cb)
 {
-  // atomic operation
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   // reset read_result
   si7021_read_result = SI7021_RESET_READ_RESULT;
@@ -143,16 +150,18 @@ void si7021_i2c_read(I2C_TypeDef *i2c, SI7021_CMD_Typedef cmd, bool checksum, ui
   i2c_start_sm.bytes_tx = SI7021_TX_1_BYTE;
   i2c_start_sm.num_bytes = bytes;
   i2c_start_sm.i2c_cb = si7021_cb;
-  i2c_start_sm.lock_sm = false;
+  i2c_start_sm.token = I2C_NO_TOKEN;
+  i2c_start_sm.req_rw = i2cWriteBit;
+  i2c_start_sm.prio = cmd_prio(cmd);
+  i2c_start_sm.split_ok = false;
+  i2c_start_sm.done = NULL;
+  i2c_start_sm.result = &si7021_result;
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // allow interrupts
+  IRQ_EXIT_MASK();
 
-  // start I2C protocol
+  // start I2C protocol; transmits start once the bus is available
   i2c_init_sm(&i2c_start_sm);
-
-  // transmit start
-  i2c_tx_req(&i2c_start_sm, i2cWriteBit);
 }
 
 
@@ -177,9 +186,9 @@ void si7021_i2c_read(I2C_TypeDef *i2c, SI7021_CMD_Typedef cmd, bool checksum, ui
  ******************************************************************************/
 void si7021_i2c_write(I2C_TypeDef *i2c, SI7021_CMD_Typedef cmd, uint8_t ctrl, uint32_t si7021_cb)
 {
-  // atomic operation
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   si7021_write_data = ctrl;
 
@@ -196,16 +205,18 @@ void si7021_i2c_write(I2C_TypeDef *i2c, SI7021_CMD_Typedef cmd, uint8_t ctrl, ui
   i2c_start_sm.bytes_tx = SI7021_TX_1_BYTE;
   i2c_start_sm.num_bytes = SI7021_TX_1_BYTE;
   i2c_start_sm.i2c_cb = si7021_cb;
-  i2c_start_sm.lock_sm = false;
+  i2c_start_sm.token = I2C_NO_TOKEN;
+  i2c_start_sm.req_rw = i2cWriteBit;
+  i2c_start_sm.prio = cmd_prio(cmd);
+  i2c_start_sm.split_ok = false;
+  i2c_start_sm.done = NULL;
+  i2c_start_sm.result = &si7021_result;
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // allow interrupts
+  IRQ_EXIT_MASK();
 
-  // start I2C protocol
+  // start I2C protocol; transmits start once the bus is available
   i2c_init_sm(&i2c_start_sm);
-
-  // transmit start
-  i2c_tx_req(&i2c_start_sm, i2cWriteBit);
 }
 
 
@@ -219,18 +230,20 @@ void si7021_i2c_write(I2C_TypeDef *i2c, SI7021_CMD_Typedef cmd, uint8_t ctrl, ui
  *  Parses the raw relative humidity measurement code received from the Si7021.
  *
  * @details
- *  Calls private functions to calculate percent relative humidity.
+ *  The code is held back until the temperature from the same measurement
+ *  arrives (see si7021_parse_temp_data()), so the pair is published
+ *  together.
  ******************************************************************************/
 void si7021_parse_RH_data(void)
 {
-  // atomic operation
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
-  si7021_calc_RH();
+  si7021_rh_code = (uint16_t)si7021_read_result;
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // allow interrupts
+  IRQ_EXIT_MASK();
 }
 
 
@@ -239,21 +252,50 @@ void si7021_parse_RH_data(void)
  *  Parses the raw temperature measurement code received from the Si7021.
  *
  * @details
- *  Calls private functions to calculate temperature Celsius.
+ *  Completes the sample: publishes the temperature code with the RH code
+ *  it was measured with. Only the codes are published; they are converted
+ *  by the reader (see si7021_convert_rh()), once per sample, so a sample
+ *  nobody reads costs no conversion.
  ******************************************************************************/
 void si7021_parse_temp_data(void)
 {
-  // atomic operation
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  SNAPSHOT_STRUCT snap;
+
+  memset(&snap, 0, sizeof(snap));
+
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
-  si7021_calc_temp();
+  snap.temp_code = (uint16_t)si7021_read_result;
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // allow interrupts
+  IRQ_EXIT_MASK();
+
+  snap.rh_code = si7021_rh_code;
+  snap.time = letimer_uptime();
+  snap.status = snapshotOk;
+
+  snapshot_publish(&si7021_snapshot_lock, &snap);
 }
 
 
+/***************************************************************************//**
+ * @brief
+ *  Records a missed sample.
+ *
+ * @details
+ *  Republishes the last codes and their timestamp with snapshotMissed, so
+ *  readers see the sensor did not answer and how old the values are.
+ ******************************************************************************/
+void si7021_sample_missed(void)
+{
+  SNAPSHOT_STRUCT snap = *snapshot_last(&si7021_snapshot_lock);
+
+  snap.status = snapshotMissed;
+
+  snapshot_publish(&si7021_snapshot_lock, &snap);
+}
 
 
 /***************************************************************************//**
@@ -262,18 +304,18 @@ void si7021_parse_temp_data(void)
  *  (Si7021-A20 TRM: Section 5.1.1)
  *
  * @details
- *  Stores calculated data in private data member for easy access.
+ *  Converts in fixed point and applies the device calibration record.
+ *
+ * @return
+ *  Returns relative humidity in centi-percent.
  ******************************************************************************/
-void si7021_calc_RH(void)
+int32_t si7021_calc_RH(uint16_t code)
 {
-  // convert the stored RH code to percent humidity (Si7021-A20: 5.1.1)
-  float rh = ((125 * (((float)si7021_read_result) / 65536)) - 6);
-
-  // update static variable
-  si7021_rh = rh;
+  // convert the RH code to percent humidity (Si7021-A20: 5.1.1), in centi-units
+  int32_t rh = conv_sample(&si7021_rh_coef, code);
 
-  // delay to avoid RMW errors
-  timer_delay(80);
+  // apply this device's calibration
+  return cal_apply(calSi7021RH, rh);
 }
 
 
@@ -283,18 +325,18 @@ void si7021_calc_RH(void)
  *  (Si7021-A20 TRM: Section 5.1.1)
  *
  * @details
- *  Stores calculated data in private data member for easy access.
+ *  Converts in fixed point and applies the device calibration record.
+ *
+ * @return
+ *  Returns temperature in centi-degrees Celsius.
  ******************************************************************************/
-void si7021_calc_temp(void)
+int32_t si7021_calc_temp(uint16_t code)
 {
-  // convert stored temperature code to degrees (°C) (SI7021-A20: 5.1.2)
-  float temp = ((175.71 * (((float)si7021_read_result) / 65536)) - 46.85);
+  // convert the temperature code to degrees (°C) (SI7021-A20: 5.1.2), in centi-units
+  int32_t temp = conv_sample(&si7021_temp_coef, code);
 
-  // update static variable
-  si7021_temp = temp;
-
-  // delay to avoid RMW errors
-  timer_delay(80);
+  // apply this device's calibration
+  return cal_apply(calSi7021Temp, temp);
 }
 
 
@@ -308,14 +350,14 @@ void si7021_calc_temp(void)
  ******************************************************************************/
 uint8_t si7021_store_user_reg(void)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   si7021_user_reg_data = si7021_read_result;
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // allow interrupts
+  IRQ_EXIT_MASK();
 
   return si7021_user_reg_data;
 }
@@ -368,6 +410,45 @@ uint8_t req_bytes(uint8_t cmd)
 }
 
 
+/***************************************************************************//**
+ * @brief
+ *  Determines the bus priority class of an enumerated command.
+ *
+ * @details
+ *  Measurement traffic is time critical; register, ID and firmware
+ *  revision accesses are housekeeping and may wait behind it.
+ *
+ *  @param[in] cmd
+ *   8-bit command used to determine the priority class.
+ *
+ *  @return prio
+ *   Returns the priority class of the transaction
+ ******************************************************************************/
+I2C_PRIO_Typedef cmd_prio(uint8_t cmd)
+{
+  I2C_PRIO_Typedef prio;
+
+  switch(cmd)
+  {
+    case measureT_HMM:
+    case measureT_NHMM:
+    case measureRH_HMM:
+    case measureRH_NHMM:
+    case MeasureTFromPrevRH:
+      prio = i2cPrioUrgent;
+      break;
+    case reset:
+      prio = i2cPrioNormal;
+      break;
+    default:
+      prio = i2cPrioHousekeeping;
+      break;
+  }
+
+  return prio;
+}
+
+
 /******************************************************************************
  ************************* PUBLIC ACCESSOR FUNCTIONS **************************
  ******************************************************************************/
@@ -375,49 +456,105 @@ uint8_t req_bytes(uint8_t cmd)
 
 /***************************************************************************//**
  * @brief
- *  Accessor function for privately stored relative humidity data.
+ *  Accessor function for the last published sample.
+ *
+ * @details
+ *  Lock-free: the RH and temperature always come from the same sample,
+ *  and no interrupts are masked. Only the codes are copied; the status
+ *  and timestamp tell whether the sample is worth converting (see
+ *  si7021_convert_rh()).
+ *
+ * @param[out] snap
+ *  The last sample's codes, its timestamp and status.
+ ******************************************************************************/
+void si7021_snapshot(SNAPSHOT_STRUCT *snap)
+{
+  snapshot_read(&si7021_snapshot_lock, snap);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Returns a snapshot's relative humidity.
  *
  * @details
- *  Provides the application layer with read access to private data members.
+ *  Converts and calibrates the RH code, unless the reader's values already
+ *  hold it for this snapshot (same sequence): a reader that looks at one
+ *  sample several times converts it once, and a reader that only wants
+ *  RH never converts the temperature.
+ *
+ * @param[in] snap
+ *  Snapshot taken with si7021_snapshot().
+ *
+ * @param[in,out] values
+ *  The reader's converted values; kept by the reader between calls.
  *
  * @return
- *  Returns relative humidity data.
+ *  Percent relative humidity.
  ******************************************************************************/
-float si7021_get_rh()
+float si7021_convert_rh(const SNAPSHOT_STRUCT *snap, SNAPSHOT_VALUES_STRUCT *values)
 {
-  // atomic operation
-    CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
+  // converted already
+  if(values->rh_seq != snap->seq)
+  {
+    values->rh = (float)si7021_calc_RH(snap->rh_code) / CAL_CENTI;
+    values->rh_seq = snap->seq;
+  }
+
+  return values->rh;
+}
 
-    float rh = si7021_rh;
 
-    // exit core critical to allow interrupts
-    CORE_EXIT_CRITICAL();
+/***************************************************************************//**
+ * @brief
+ *  Returns a snapshot's temperature.
+ *
+ * @details
+ *  As si7021_convert_rh(), for the temperature code.
+ *
+ * @param[in] snap
+ *  Snapshot taken with si7021_snapshot().
+ *
+ * @param[in,out] values
+ *  The reader's converted values; kept by the reader between calls.
+ *
+ * @return
+ *  Temperature, Celsius.
+ ******************************************************************************/
+float si7021_convert_temp(const SNAPSHOT_STRUCT *snap, SNAPSHOT_VALUES_STRUCT *values)
+{
+  // converted already
+  if(values->temp_seq != snap->seq)
+  {
+    values->temp = (float)si7021_calc_temp(snap->temp_code) / CAL_CENTI;
+    values->temp_seq = snap->seq;
+  }
 
-    return rh;
+  return values->temp;
 }
 
 
 /***************************************************************************//**
  * @brief
- *  Accessor function for privately stored temperature data.
+ *  Accessor function for the outcome of the last transaction.
  *
  * @details
- *  Provides the application layer with read access to private data members.
+ *  False once the Si7021 stopped answering and the I2C driver gave up on
+ *  a transaction; the application's health tracking is driven by this.
  *
  * @return
- *  Returns temperature data.
+ *  Returns true if the Si7021 answered its last transaction.
  ******************************************************************************/
-float si7021_get_temp()
+bool si7021_responding(void)
 {
-  // atomic operation
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
-  float temp = si7021_temp;
+  bool ok = (si7021_result == i2cResultOk);
 
-  // exit core critical to allow interrupts
-  CORE_EXIT_CRITICAL();
+  // allow interrupts
+  IRQ_EXIT_MASK();
 
-  return temp;
+  return ok;
 }
@@ -37,12 +37,14 @@
 // included header file
 //*******************************************************
 #include "sleep_routines.h"
+#include "trace.h"
 
 
 //*******************************************************
 // static/private data
 //*******************************************************
 static int lowest_energy_mode[MAX_ENERGY_MODES];  // tracks the energy mode blocks for each state
+static uint32_t sleep_wakeups[MAX_ENERGY_MODES];   // wake-ups from each sleep mode
 
 
 //***********************************************************************************
@@ -63,15 +65,16 @@ static int lowest_energy_mode[MAX_ENERGY_MODES];  // tracks the energy mode bloc
 ******************************************************************************/
 void sleep_open(void)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   // reset array
   memset(lowest_energy_mode, EM0, sizeof(lowest_energy_mode));
+  memset(sleep_wakeups, 0, sizeof(sleep_wakeups));
 
   // allow interrupts
-  CORE_EXIT_CRITICAL();
+  IRQ_EXIT_MASK();
 }
 
 
@@ -93,18 +96,20 @@ void sleep_open(void)
 ******************************************************************************/
 void sleep_block_mode(uint32_t EM)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   // increment the energy mode
   lowest_energy_mode[EM]++;
 
   // allow interrupts
-  CORE_EXIT_CRITICAL();
+  IRQ_EXIT_MASK();
 
   // assert that the energy mode is less than the maximum energy mode
   EFM_ASSERT(lowest_energy_mode[EM] < MAX_ENERGY_MODES);
+
+  trace_event(traceEmBlock, EM);
 }
 
 
@@ -126,9 +131,9 @@ void sleep_block_mode(uint32_t EM)
 ******************************************************************************/
 void sleep_unblock_mode(uint32_t EM)
 {
-  // make atomic
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   if(lowest_energy_mode[EM] > EM0)
   {
@@ -139,7 +144,9 @@ void sleep_unblock_mode(uint32_t EM)
   EFM_ASSERT(lowest_energy_mode[EM] >= EM0);
 
   // allow interrupts
-  CORE_EXIT_CRITICAL();
+  IRQ_EXIT_MASK();
+
+  trace_event(traceEmUnblock, EM);
 }
 
 /***************************************************************************//**
@@ -156,16 +163,40 @@ void sleep_unblock_mode(uint32_t EM)
 ******************************************************************************/
 void enter_sleep(void)
 {
-  // make atomic
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  uint32_t mode;
+
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
   // FSM
-  if(lowest_energy_mode[EM0] > EM0){CORE_EXIT_CRITICAL(); return; }
-  else if(lowest_energy_mode[EM1] > EM0){ CORE_EXIT_CRITICAL(); return; }
-  else if(lowest_energy_mode[EM2] > EM0){ CORE_EXIT_CRITICAL(); EMU_EnterEM1(); return; }
-  else if(lowest_energy_mode[EM3] > EM0){ CORE_EXIT_CRITICAL(); EMU_EnterEM2(true); return; }
-  else{ CORE_EXIT_CRITICAL(); EMU_EnterEM3(true); return; }
+  if(lowest_energy_mode[EM0] > EM0){ mode = EM0; }
+  else if(lowest_energy_mode[EM1] > EM0){ mode = EM0; }
+  else if(lowest_energy_mode[EM2] > EM0){ mode = EM1; }
+  else if(lowest_energy_mode[EM3] > EM0){ mode = EM2; }
+  else{ mode = EM3; }
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+
+  // stay awake
+  if(mode == EM0)
+  {
+    return;
+  }
+
+  // the trace shows how deep the core went and for how long
+  trace_event(traceSleep, mode);
+  BENCH_SLEEP();
+
+  if(mode == EM1){ EMU_EnterEM1(); }
+  else if(mode == EM2){ EMU_EnterEM2(true); }
+  else{ EMU_EnterEM3(true); }
+
+  // only the main loop sleeps, so the count needs no masking
+  sleep_wakeups[mode]++;
+
+  trace_mark(traceWake);
 }
 
 
@@ -180,15 +211,37 @@ void enter_sleep(void)
 ******************************************************************************/
 uint32_t current_block_energy_mode(void)
 {
-  // make atomic by disallowing interrupts
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
 
-  // must call CORE_EXIT_CRITICAL after accessing/updating static data
+  // must call IRQ_EXIT_MASK after accessing/updating static data
   // but before returning. Otherwise
-  if(lowest_energy_mode[EM0] != EM0){ CORE_EXIT_CRITICAL(); return EM0; }
-  else if(lowest_energy_mode[EM1] != EM0){ CORE_EXIT_CRITICAL(); return EM1; }
-  else if(lowest_energy_mode[EM2] != EM0){ CORE_EXIT_CRITICAL(); return EM2; }
-  else if(lowest_energy_mode[EM3] != EM0){ CORE_EXIT_CRITICAL(); return EM3; }
-  else{ CORE_EXIT_CRITICAL(); return EM4;}
+  if(lowest_energy_mode[EM0] != EM0){ IRQ_EXIT_MASK(); return EM0; }
+  else if(lowest_energy_mode[EM1] != EM0){ IRQ_EXIT_MASK(); return EM1; }
+  else if(lowest_energy_mode[EM2] != EM0){ IRQ_EXIT_MASK(); return EM2; }
+  else if(lowest_energy_mode[EM3] != EM0){ IRQ_EXIT_MASK(); return EM3; }
+  else{ IRQ_EXIT_MASK(); return EM4;}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reads how many times the core woke from a sleep mode.
+ *
+ * @details
+ *   Every wake-up from EM2 or EM3 restarts the HF clocks and costs energy;
+ *   compare with letimer_wake_stats() to see what coalescing saved.
+ *
+ * @param[in] EM
+ *   Sleep mode (EM1 to EM3).
+ *
+ * @return
+ *   Wake-ups from that mode since sleep_open().
+******************************************************************************/
+uint32_t sleep_wakeup_count(uint32_t EM)
+{
+  EFM_ASSERT(EM < MAX_ENERGY_MODES);
+
+  return sleep_wakeups[EM];
 }
@@ -0,0 +1,150 @@
+/***************************************************************************//**
+ * @file
+ *   snapshot.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Sequence-locked sensor snapshots
+ *
+ * @details
+ *   A driver publishes each complete sample (RH code, temperature code,
+ *   timestamp, status) as one snapshot; readers always get a pair from the
+ *   same sample without masking interrupts, and the writer never waits.
+ *
+ *   The writer bumps the sequence to odd, copies the snapshot in, and bumps
+ *   it back to even. A reader copies the snapshot between two reads of the
+ *   sequence and retries if the sequence was odd or moved, i.e. a publish
+ *   overlapped the copy. The barriers keep the compiler (and the core) from
+ *   moving the copy outside the two sequence reads.
+ *
+ *   Each lock has one writer. A reader must never preempt its writer: it
+ *   would spin on an odd sequence the writer cannot finish. Readers at the
+ *   same or a lower priority than the writer are always safe.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "snapshot.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Opens a snapshot lock.
+ *
+ * @details
+ *  Nothing is published: readers get sequence 0 and snapshotEmpty until
+ *  the first publish.
+ *
+ * @param[in] lock
+ *  Lock instance (statically allocated by the driver).
+ ******************************************************************************/
+void snapshot_open(SNAPSHOT_LOCK_STRUCT *lock)
+{
+  memset(&lock->data, 0, sizeof(lock->data));
+  lock->data.status = snapshotEmpty;
+  lock->seq = 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Publishes a snapshot.
+ *
+ * @details
+ *  Never blocks. Called by the lock's one writer only.
+ *
+ * @param[in] lock
+ *  Lock instance.
+ *
+ * @param[in] snap
+ *  Snapshot to publish; its sequence is assigned here.
+ ******************************************************************************/
+void snapshot_publish(SNAPSHOT_LOCK_STRUCT *lock, const SNAPSHOT_STRUCT *snap)
+{
+  uint32_t seq = lock->seq;
+
+  // a second writer, or a publish that never finished
+  EFM_ASSERT(!(seq & SNAPSHOT_SEQ_BUSY));
+
+  lock->seq = seq + 1;
+  __DMB();
+
+  lock->data = *snap;
+  lock->data.seq = seq + 2;
+
+  __DMB();
+  lock->seq = seq + 2;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads the last published snapshot.
+ *
+ * @details
+ *  Copies the snapshot and retries if a publish overlapped the copy, so
+ *  the codes, timestamp and status always come from one publish.
+ *
+ * @param[in] lock
+ *  Lock instance.
+ *
+ * @param[out] snap
+ *  Consistent copy of the last published snapshot.
+ ******************************************************************************/
+void snapshot_read(const SNAPSHOT_LOCK_STRUCT *lock, SNAPSHOT_STRUCT *snap)
+{
+  uint32_t seq;
+
+  do
+  {
+    seq = lock->seq;
+    __DMB();
+
+    *snap = lock->data;
+
+    __DMB();
+  }while((seq & SNAPSHOT_SEQ_BUSY) || (seq != lock->seq));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads the writer's own last publish.
+ *
+ * @details
+ *  For the writer only: nothing else writes the lock, so it can look at
+ *  what it published without the sequence check.
+ *
+ * @param[in] lock
+ *  Lock instance.
+ *
+ * @return
+ *  Returns the last published snapshot.
+ ******************************************************************************/
+const SNAPSHOT_STRUCT *snapshot_last(const SNAPSHOT_LOCK_STRUCT *lock)
+{
+  return &lock->data;
+}
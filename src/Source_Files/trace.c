@@ -0,0 +1,199 @@
+/***************************************************************************//**
+ * @file
+ *   trace.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   RAM event trace ring
+ *
+ * @details
+ *   Events are appended to the current block (trace_format.h) and the
+ *   oldest block is reused when the ring wraps. The ring is a plain array,
+ *   so a debugger or an exporter can copy it out whole (trace_buffer()) and
+ *   the host decoder sorts the blocks by sequence number.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "trace.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+static TRACE_BLOCK_STRUCT trace_ring[TRACE_BLOCKS];
+static uint32_t trace_block;          // block being written
+static uint32_t trace_last;           // time of the last event in the block
+static bool trace_running;            // False until trace_open()
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static void trace_put(TRACE_KIND_Typedef kind, bool has_arg, int32_t arg);
+static void trace_next_block(uint32_t now);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Opens the trace ring.
+ *
+ * @details
+ *  Clears the ring and starts block 0. Events before this are dropped.
+ ******************************************************************************/
+void trace_open(void)
+{
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  memset(trace_ring, 0, sizeof(trace_ring));
+  trace_block = TRACE_BLOCKS - 1;
+  trace_ring[trace_block].header.seq = (uint32_t)-1;
+  trace_next_block(letimer_uptime());
+  trace_running = true;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Records an event.
+ *
+ * @details
+ *  Safe from interrupt context.
+ *
+ * @param[in] kind
+ *  Event kind.
+ *
+ * @param[in] arg
+ *  Kind-specific argument.
+ ******************************************************************************/
+void trace_event(TRACE_KIND_Typedef kind, int32_t arg)
+{
+  trace_put(kind, true, arg);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Records an event that carries no argument.
+ *
+ * @details
+ *  Safe from interrupt context; one byte shorter than trace_event().
+ *
+ * @param[in] kind
+ *  Event kind.
+ ******************************************************************************/
+void trace_mark(TRACE_KIND_Typedef kind)
+{
+  trace_put(kind, false, 0);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Locates the trace ring for export.
+ *
+ * @param[out] size
+ *  Size of the ring in bytes.
+ *
+ * @return
+ *  Returns the start of the ring; the bytes are a valid trace dump.
+ ******************************************************************************/
+const void *trace_buffer(uint32_t *size)
+{
+  *size = sizeof(trace_ring);
+
+  return trace_ring;
+}
+
+
+/******************************************************************************
+ ***************************** PRIVATE FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Appends an event to the current block.
+ *
+ * @details
+ *  A few bytes of encoding plus a CRC update over the same bytes.
+ *
+ * @param[in] kind
+ *  Event kind.
+ *
+ * @param[in] has_arg
+ *  True to encode arg.
+ *
+ * @param[in] arg
+ *  Kind-specific argument.
+ ******************************************************************************/
+void trace_put(TRACE_KIND_Typedef kind, bool has_arg, int32_t arg)
+{
+  TRACE_BLOCK_STRUCT *block;
+  uint32_t now;
+  uint32_t len;
+
+  if(!trace_running)
+  {
+    return;
+  }
+
+  // make atomic by masking the I2C tier
+  IRQ_DECLARE_MASK_STATE;
+  IRQ_ENTER_MASK(IRQ_PRIO_I2C);
+
+  now = letimer_uptime();
+  block = &trace_ring[trace_block];
+  if(((uint32_t)block->header.len + TRACE_EVENT_MAX) > TRACE_BLOCK_PAYLOAD)
+  {
+    trace_next_block(now);
+    block = &trace_ring[trace_block];
+  }
+
+  len = trace_event_encode(&block->payload[block->header.len], now - trace_last, kind, has_arg, arg);
+  block->header.crc = log_crc16(block->header.crc, &block->payload[block->header.len], len);
+  block->header.len += len;
+  trace_last = now;
+
+  // allow interrupts
+  IRQ_EXIT_MASK();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts the next block in the ring, overwriting the oldest.
+ *
+ * @param[in] now
+ *  Block start time (LETIMER ticks).
+ ******************************************************************************/
+void trace_next_block(uint32_t now)
+{
+  uint32_t seq = trace_ring[trace_block].header.seq + 1;
+
+  trace_block = (trace_block + 1) % TRACE_BLOCKS;
+  trace_ring[trace_block].header.magic = TRACE_BLOCK_MAGIC;
+  trace_ring[trace_block].header.seq = seq;
+  trace_ring[trace_block].header.t0 = now;
+  trace_ring[trace_block].header.len = 0;
+  trace_ring[trace_block].header.crc = LOG_CRC_INIT;
+  trace_last = now;
+}
@@ -0,0 +1,196 @@
+/***************************************************************************//**
+ * @file
+ *   trace_format.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Event encoding and decoding for the binary event trace
+ *
+ * @details
+ *   Shared by the firmware (trace.c) and the host tools; see
+ *   trace_format.h for the layout.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#include "trace_format.h"
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+static const char *const trace_kind_names[traceKinds] =
+{
+  [0]               = "none",
+  [traceI2cStart]   = "i2c_start",
+  [traceI2cTx]      = "i2c_tx",
+  [traceI2cAck]     = "i2c_ack",
+  [traceI2cNack]    = "i2c_nack",
+  [traceI2cRxData]  = "i2c_rxdata",
+  [traceI2cMstop]   = "i2c_mstop",
+  [traceI2cArbLost] = "i2c_arblost",
+  [traceI2cBusErr]  = "i2c_buserr",
+  [traceSchedPost]  = "sched_post",
+  [traceSchedTake]  = "sched_take",
+  [traceIrq]        = "irq",
+  [traceSleep]      = "sleep",
+  [traceWake]       = "wake",
+  [traceEmBlock]    = "em_block",
+  [traceEmUnblock]  = "em_unblock",
+  [traceHealth]     = "health",
+};
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Checks a block header against its payload.
+ *
+ * @param[in] header
+ *  Block header.
+ *
+ * @param[in] payload
+ *  Block payload (immediately after the header).
+ *
+ * @return
+ *  Returns true if the block holds trace events and its CRC matches.
+ ******************************************************************************/
+bool trace_block_valid(const TRACE_BLOCK_HEADER_STRUCT *header, const uint8_t *payload)
+{
+  return (header->magic == TRACE_BLOCK_MAGIC) &&
+         (header->len <= TRACE_BLOCK_PAYLOAD) &&
+         (header->crc == log_crc16(LOG_CRC_INIT, payload, header->len));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Encodes one event.
+ *
+ * @param[out] buf
+ *  Output (at least TRACE_EVENT_MAX bytes).
+ *
+ * @param[in] dt
+ *  Ticks since the previous event in the block.
+ *
+ * @param[in] kind
+ *  Event kind.
+ *
+ * @param[in] has_arg
+ *  True to encode arg.
+ *
+ * @param[in] arg
+ *  Kind-specific argument.
+ *
+ * @return
+ *  Returns the encoded length.
+ ******************************************************************************/
+uint32_t trace_event_encode(uint8_t *buf, uint32_t dt, uint8_t kind, bool has_arg, int32_t arg)
+{
+  uint32_t len = 1;
+
+  buf[0] = (kind & TRACE_KIND_MASK) | (has_arg ? TRACE_HAS_ARG : 0);
+  len += log_put_varint(&buf[len], (int32_t)dt);
+  if(has_arg)
+  {
+    len += log_put_varint(&buf[len], arg);
+  }
+
+  return len;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Decodes one event.
+ *
+ * @param[in] buf
+ *  Start of the event.
+ *
+ * @param[in] avail
+ *  Payload bytes left from buf.
+ *
+ * @param[in] time
+ *  Previous event's time (the block t0 for the first); advanced.
+ *
+ * @param[out] event
+ *  Decoded event.
+ *
+ * @return
+ *  Returns the encoded length, or 0 if the event is truncated.
+ ******************************************************************************/
+int32_t trace_event_decode(const uint8_t *buf, uint32_t avail, uint32_t *time, TRACE_EVENT_STRUCT *event)
+{
+  int32_t len = 1;
+  int32_t used;
+  int32_t dt;
+
+  if(avail < 2)
+  {
+    return 0;
+  }
+
+  event->kind = buf[0] & TRACE_KIND_MASK;
+  event->has_arg = (buf[0] & TRACE_HAS_ARG) != 0;
+  event->arg = 0;
+
+  used = log_get_varint(&buf[len], avail - len, &dt);
+  if(used == 0)
+  {
+    return 0;
+  }
+  len += used;
+
+  if(event->has_arg)
+  {
+    used = log_get_varint(&buf[len], avail - len, &event->arg);
+    if(used == 0)
+    {
+      return 0;
+    }
+    len += used;
+  }
+
+  *time += (uint32_t)dt;
+  event->time = *time;
+
+  return len;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Names an event kind.
+ *
+ * @param[in] kind
+ *  Event kind.
+ *
+ * @return
+ *  Returns a short lower-case name ("unknown" for unassigned kinds).
+ ******************************************************************************/
+const char *trace_kind_name(uint8_t kind)
+{
+  if((kind < traceKinds) && trace_kind_names[kind])
+  {
+    return trace_kind_names[kind];
+  }
+
+  return "unknown";
+}
@@ -0,0 +1,499 @@
+/***************************************************************************//**
+ * @file
+ *   dump.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Reads node dumps on a host
+ *
+ * @details
+ *   Pages/blocks are visited from the oldest valid one by sequence number,
+ *   wrapping, so records come out in the order they were written. A frame
+ *   that fails its CRC ends its page (the rest of it cannot be trusted);
+ *   a block that fails its CRC is skipped. Erased log pages and never
+ *   written trace blocks are not counted as damage. Trailing bytes short of
+ *   a page or block are ignored.
+ *
+ *   A raw-code log page is decoded whole into the iterator's batch, then
+ *   each channel's codes go through conv_batch() in one call and the
+ *   page's calibration is applied, so the node's conversion runs here at
+ *   host speed instead of once per sample on the node.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dump.h"
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static uint32_t dump_oldest_page(const uint8_t *map, uint32_t pages);
+static uint32_t dump_oldest_block(const uint8_t *map, uint32_t blocks);
+static void dump_log_page(DUMP_ITER_STRUCT *iter);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** PUBLIC FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Maps a dump read-only.
+ *
+ * @param[in] path
+ *  Dump file.
+ *
+ * @param[out] file
+ *  Mapping.
+ *
+ * @return
+ *  Returns false (after printing why) if the file cannot be mapped or is
+ *  empty.
+ ******************************************************************************/
+bool dump_open(const char *path, DUMP_FILE_STRUCT *file)
+{
+  struct stat st;
+  void *map;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if((fd < 0) || (fstat(fd, &st) != 0))
+  {
+    perror(path);
+    if(fd >= 0)
+    {
+      close(fd);
+    }
+    return false;
+  }
+  if(st.st_size == 0)
+  {
+    fprintf(stderr, "%s: empty dump\n", path);
+    close(fd);
+    return false;
+  }
+
+  map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED)
+  {
+    perror(path);
+    return false;
+  }
+  posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+  file->map = map;
+  file->size = (size_t)st.st_size;
+
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Unmaps a dump.
+ ******************************************************************************/
+void dump_close(DUMP_FILE_STRUCT *file)
+{
+  munmap((void *)file->map, file->size);
+  file->map = NULL;
+  file->size = 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Decides the dump type from the first valid page or block.
+ *
+ * @return
+ *  Returns dumpLog, dumpTrace or dumpAuto if neither is found.
+ ******************************************************************************/
+DUMP_Typedef dump_detect(const DUMP_FILE_STRUCT *file)
+{
+  if(dump_oldest_page(file->map, (uint32_t)(file->size / LOG_PAGE_SIZE)) != DUMP_NO_UNIT)
+  {
+    return dumpLog;
+  }
+  if(dump_oldest_block(file->map, (uint32_t)(file->size / TRACE_BLOCK_SIZE)) != DUMP_NO_UNIT)
+  {
+    return dumpTrace;
+  }
+
+  return dumpAuto;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts a walk over a sample log dump.
+ ******************************************************************************/
+void dump_log_begin(DUMP_ITER_STRUCT *iter, const DUMP_FILE_STRUCT *file)
+{
+  memset(iter, 0, sizeof(*iter));
+  iter->map = file->map;
+  iter->units = (uint32_t)(file->size / LOG_PAGE_SIZE);
+  iter->first = dump_oldest_page(iter->map, iter->units);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Returns the next record of a sample log dump.
+ *
+ * @param[in] iter
+ *  Walk started with dump_log_begin().
+ *
+ * @param[out] rec
+ *  Next record.
+ *
+ * @return
+ *  Returns false once every page has been decoded.
+ ******************************************************************************/
+bool dump_log_next(DUMP_ITER_STRUCT *iter, LOG_RECORD_STRUCT *rec)
+{
+  const LOG_PAGE_HEADER_STRUCT *header;
+  int32_t used;
+
+  if(iter->first == DUMP_NO_UNIT)
+  {
+    return false;
+  }
+
+  while(true)
+  {
+    // a raw page is served from its converted batch
+    if(iter->served < iter->count)
+    {
+      *rec = iter->batch[iter->served++];
+      iter->stats.records++;
+      return true;
+    }
+
+    if(iter->unit && iter->delta.raw)
+    {
+      dump_log_page(iter);
+      continue;
+    }
+
+    if(iter->unit)
+    {
+      used = log_frame_decode(&iter->delta, &iter->unit[iter->pos], LOG_PAGE_SIZE - iter->pos, rec);
+      if(used > 0)
+      {
+        iter->pos += (uint32_t)used;
+        if(rec->mask == 0)
+        {
+          // descriptor frame, not a record
+          continue;
+        }
+        iter->stats.records++;
+        return true;
+      }
+      if(used == LOG_FRAME_BAD)
+      {
+        iter->stats.bad_frames++;
+      }
+      iter->unit = NULL;
+    }
+
+    if(iter->next == iter->units)
+    {
+      return false;
+    }
+
+    header = (const LOG_PAGE_HEADER_STRUCT *)(iter->map + (size_t)((iter->first + iter->next++) % iter->units) * LOG_PAGE_SIZE);
+    if(!log_page_valid(header))
+    {
+      // an erased page is just unused, anything else is damage
+      if(header->magic != 0xFFFFFFFF)
+      {
+        iter->stats.bad_units++;
+      }
+      continue;
+    }
+    iter->stats.units++;
+    iter->unit = (const uint8_t *)header;
+    iter->pos = sizeof(LOG_PAGE_HEADER_STRUCT);
+    log_delta_reset(&iter->delta, header->t0, log_page_raw(header));
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Converts raw-code records to calibrated centi-units.
+ *
+ * @details
+ *  Each channel's codes are gathered and converted with one conv_batch()
+ *  call per DUMP_BATCH records, then calibrated with the channel's
+ *  descriptor. A channel without a descriptor cannot be converted and is
+ *  dropped from the records' masks. Records that are not raw are left
+ *  alone.
+ *
+ * @param[in] delta
+ *  Delta state of the page the records came from (holds the descriptors).
+ *
+ * @param[in,out] rec
+ *  Records to convert.
+ *
+ * @param[in] n
+ *  Number of records.
+ ******************************************************************************/
+void dump_log_convert(const LOG_DELTA_STRUCT *delta, LOG_RECORD_STRUCT *rec, uint32_t n)
+{
+  uint16_t code[DUMP_BATCH];
+  int16_t value[DUMP_BATCH];
+  uint32_t index[DUMP_BATCH];
+  const LOG_DESC_STRUCT *desc;
+  uint32_t base;
+  uint32_t end;
+  uint32_t ch;
+  uint32_t i;
+  uint32_t m;
+
+  for(base = 0; base < n; base += DUMP_BATCH)
+  {
+    end = ((n - base) > DUMP_BATCH) ? (base + DUMP_BATCH) : n;
+
+    for(ch = 0; ch < LOG_CHANNELS; ch++)
+    {
+      desc = &delta->desc[ch];
+
+      // gather the channel's codes
+      m = 0;
+      for(i = base; i < end; i++)
+      {
+        if(rec[i].raw && (rec[i].mask & (1u << ch)))
+        {
+          index[m] = i;
+          code[m++] = (uint16_t)rec[i].value[ch];
+        }
+      }
+      if(m == 0)
+      {
+        continue;
+      }
+
+      if(!desc->valid)
+      {
+        for(i = 0; i < m; i++)
+        {
+          rec[index[i]].mask &= (uint8_t)~(1u << ch);
+        }
+        continue;
+      }
+
+      // convert in bulk, calibrate and scatter back
+      conv_batch(&desc->conv, code, value, m);
+      for(i = 0; i < m; i++)
+      {
+        rec[index[i]].value[ch] = (int16_t)conv_calibrate(&desc->cal, value[i]);
+      }
+    }
+
+    for(i = base; i < end; i++)
+    {
+      rec[i].raw = false;
+    }
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts a walk over a trace dump.
+ ******************************************************************************/
+void dump_trace_begin(DUMP_ITER_STRUCT *iter, const DUMP_FILE_STRUCT *file)
+{
+  memset(iter, 0, sizeof(*iter));
+  iter->map = file->map;
+  iter->units = (uint32_t)(file->size / TRACE_BLOCK_SIZE);
+  iter->first = dump_oldest_block(iter->map, iter->units);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Returns the next event of a trace dump.
+ *
+ * @param[in] iter
+ *  Walk started with dump_trace_begin().
+ *
+ * @param[out] event
+ *  Next event.
+ *
+ * @return
+ *  Returns false once every block has been decoded.
+ ******************************************************************************/
+bool dump_trace_next(DUMP_ITER_STRUCT *iter, TRACE_EVENT_STRUCT *event)
+{
+  const TRACE_BLOCK_HEADER_STRUCT *header;
+  int32_t used;
+
+  if(iter->first == DUMP_NO_UNIT)
+  {
+    return false;
+  }
+
+  while(true)
+  {
+    if(iter->unit)
+    {
+      header = (const TRACE_BLOCK_HEADER_STRUCT *)iter->unit;
+      used = trace_event_decode((const uint8_t *)(header + 1) + iter->pos, header->len - iter->pos,
+                                &iter->time, event);
+      if(used > 0)
+      {
+        iter->pos += (uint32_t)used;
+        iter->stats.records++;
+        return true;
+      }
+      if(iter->pos != header->len)
+      {
+        iter->stats.bad_frames++;
+      }
+      iter->unit = NULL;
+    }
+
+    if(iter->next == iter->units)
+    {
+      return false;
+    }
+
+    header = (const TRACE_BLOCK_HEADER_STRUCT *)(iter->map + (size_t)((iter->first + iter->next++) % iter->units) * TRACE_BLOCK_SIZE);
+    if(!trace_block_valid(header, (const uint8_t *)(header + 1)))
+    {
+      // an all-zero block was never written, anything else is damage
+      if(header->magic != 0)
+      {
+        iter->stats.bad_units++;
+      }
+      continue;
+    }
+    iter->stats.units++;
+    iter->unit = (const uint8_t *)header;
+    iter->pos = 0;
+    iter->time = header->t0;
+  }
+}
+
+
+/******************************************************************************
+ ***************************** PRIVATE FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Finds the valid log page with the lowest sequence number.
+ *
+ * @return
+ *  Returns the page index, or DUMP_NO_UNIT if no page is valid.
+ ******************************************************************************/
+uint32_t dump_oldest_page(const uint8_t *map, uint32_t pages)
+{
+  const LOG_PAGE_HEADER_STRUCT *header;
+  uint32_t oldest = DUMP_NO_UNIT;
+  uint32_t seq = 0;
+
+  for(uint32_t i = 0; i < pages; i++)
+  {
+    header = (const LOG_PAGE_HEADER_STRUCT *)(map + (size_t)i * LOG_PAGE_SIZE);
+    if(log_page_valid(header) && ((oldest == DUMP_NO_UNIT) || (header->seq < seq)))
+    {
+      oldest = i;
+      seq = header->seq;
+    }
+  }
+
+  return oldest;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Finds the valid trace block with the lowest sequence number.
+ *
+ * @return
+ *  Returns the block index, or DUMP_NO_UNIT if no block is valid.
+ ******************************************************************************/
+uint32_t dump_oldest_block(const uint8_t *map, uint32_t blocks)
+{
+  const TRACE_BLOCK_HEADER_STRUCT *header;
+  uint32_t oldest = DUMP_NO_UNIT;
+  uint32_t seq = 0;
+
+  for(uint32_t i = 0; i < blocks; i++)
+  {
+    header = (const TRACE_BLOCK_HEADER_STRUCT *)(map + (size_t)i * TRACE_BLOCK_SIZE);
+    if(trace_block_valid(header, (const uint8_t *)(header + 1)) && ((oldest == DUMP_NO_UNIT) || (header->seq < seq)))
+    {
+      oldest = i;
+      seq = header->seq;
+    }
+  }
+
+  return oldest;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Decodes the rest of a raw-code page into the batch and converts it.
+ *
+ * @details
+ *  Descriptor frames are consumed by the decoder and not batched. A frame
+ *  that fails its CRC ends the page as in dump_log_next(); the records
+ *  before it are still converted and returned.
+ *
+ * @param[in] iter
+ *  Walk positioned on a raw page.
+ ******************************************************************************/
+void dump_log_page(DUMP_ITER_STRUCT *iter)
+{
+  LOG_RECORD_STRUCT *rec;
+  int32_t used;
+
+  iter->count = 0;
+  iter->served = 0;
+
+  while(iter->count < DUMP_BATCH)
+  {
+    rec = &iter->batch[iter->count];
+    used = log_frame_decode(&iter->delta, &iter->unit[iter->pos], LOG_PAGE_SIZE - iter->pos, rec);
+    if(used <= 0)
+    {
+      if(used == LOG_FRAME_BAD)
+      {
+        iter->stats.bad_frames++;
+      }
+      break;
+    }
+    iter->pos += (uint32_t)used;
+    if(rec->mask != 0)
+    {
+      iter->count++;
+    }
+  }
+  iter->unit = NULL;
+
+  dump_log_convert(&iter->delta, iter->batch, iter->count);
+  iter->stats.raw_records += iter->count;
+}
@@ -0,0 +1,106 @@
+/***************************************************************************//**
+ * @file
+ *   dump.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Header file for reading node dumps on a host
+ *
+ * @details
+ *   Maps a sample log or trace dump and walks it oldest first, one record
+ *   or event per call, straight out of the mapping. Raw-code log pages are
+ *   decoded a page at a time and converted in bulk. Shared by logdump and
+ *   fleetstat.
+ ******************************************************************************/
+
+#ifndef DUMP_HG
+#define DUMP_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// developer included files
+#include "log_format.h"
+#include "trace_format.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define DUMP_NO_UNIT          0xFFFFFFFF        // no valid page/block found
+#define DUMP_BATCH            (LOG_PAGE_SIZE / 8) // records a page can hold (shortest frame pads to 8 bytes)
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+/*! Dump types */
+typedef enum
+{
+  dumpAuto,         /*! Decide from the first valid page or block */
+  dumpLog,          /*! Sample log pages */
+  dumpTrace         /*! Trace blocks */
+}DUMP_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! Decode counters */
+typedef struct
+{
+    uint64_t                      units;                  /// valid pages or blocks decoded
+    uint64_t                      records;                /// records or events returned
+    uint64_t                      bad_units;              /// pages/blocks that failed their header or CRC check
+    uint64_t                      bad_frames;             /// frames that failed their CRC (rest of the page/block abandoned)
+    uint64_t                      raw_records;            /// log: records converted from raw codes
+}DUMP_STATS_STRUCT;
+
+
+/*! A mapped dump */
+typedef struct
+{
+    const uint8_t                *map;                    /// start of the mapping
+    size_t                        size;                   /// bytes mapped
+}DUMP_FILE_STRUCT;
+
+
+/*! Position in a dump; both walks use the same fields */
+typedef struct
+{
+    const uint8_t                *map;                    /// start of the dump
+    uint32_t                      units;                  /// pages or blocks in the dump
+    uint32_t                      first;                  /// oldest valid page/block (DUMP_NO_UNIT if none)
+    uint32_t                      next;                   /// pages/blocks started so far
+    const uint8_t                *unit;                   /// page/block being decoded (NULL between units)
+    uint32_t                      pos;                    /// decode offset in the unit
+    uint32_t                      time;                   /// trace: time of the previous event
+    LOG_DELTA_STRUCT              delta;                  /// log: delta state of the page
+    LOG_RECORD_STRUCT             batch[DUMP_BATCH];      /// log: converted records of a raw page
+    uint32_t                      count;                  /// log: records in batch
+    uint32_t                      served;                 /// log: records of batch returned so far
+    DUMP_STATS_STRUCT             stats;                  /// counters for this walk
+}DUMP_ITER_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+bool dump_open(const char *path, DUMP_FILE_STRUCT *file);
+void dump_close(DUMP_FILE_STRUCT *file);
+DUMP_Typedef dump_detect(const DUMP_FILE_STRUCT *file);
+void dump_log_begin(DUMP_ITER_STRUCT *iter, const DUMP_FILE_STRUCT *file);
+bool dump_log_next(DUMP_ITER_STRUCT *iter, LOG_RECORD_STRUCT *rec);
+void dump_log_convert(const LOG_DELTA_STRUCT *delta, LOG_RECORD_STRUCT *rec, uint32_t n);
+void dump_trace_begin(DUMP_ITER_STRUCT *iter, const DUMP_FILE_STRUCT *file);
+bool dump_trace_next(DUMP_ITER_STRUCT *iter, TRACE_EVENT_STRUCT *event);
+
+#endif
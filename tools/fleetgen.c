@@ -0,0 +1,633 @@
+/***************************************************************************//**
+ * @file
+ *   fleetgen.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Writes synthetic fleet dumps for fleetstat and logdump
+ *
+ * @details
+ *   For every node, <dir>/nodeNNNNN.log holds a wrapped sample log ring and
+ *   <dir>/nodeNNNNN.trace a wrapped trace ring, both in the on-node formats
+ *   (log_format.h, trace_format.h). Nodes differ on purpose: each gets its
+ *   own sensor offset (a few drift badly), NACK probability, fault rate and
+ *   log size, and some logs carry a corrupted frame, so every statistic
+ *   fleetstat reports has something to find. Every channel also gets a
+ *   calibration record (none, linear or polynomial), redrawn half way
+ *   through the log as if the node were recalibrated in the field; the
+ *   codes are picked so the calibrated values follow the generated ones.
+ *   The output depends only on the seed.
+ *
+ *   With -r the logs are written the way a LOG_RAW_CODES node writes them:
+ *   raw codes, each page opening with the descriptors in force. Each raw
+ *   <dir>/nodeNNNNN.log then comes with <dir>/nodeNNNNN.csv, the records
+ *   of the ring as the node converted them (cal_apply() of the datasheet
+ *   conversion) in logdump's CSV, so the host conversion is checked by
+ *     logdump node00000.log | cmp - node00000.csv
+ *
+ *   -e writes what each node was given, one CSV row per node, for
+ *   fleetstat -c to check its statistics against: the SHTC3 - Si7021 RH
+ *   and temperature offsets (centi-units), the NACK probability (percent),
+ *   the faults left in the trace ring and the damaged frames.
+ *
+ *   Build (Linux):
+ *     cc -O2 -I../src/Header_Files -o fleetgen fleetgen.c \
+ *        ../src/Source_Files/log_format.c ../src/Source_Files/trace_format.c \
+ *        ../src/Source_Files/convert.c -lm
+ *
+ *   Usage:
+ *     fleetgen [-r] [-e expected.csv] [-p log_pages] [-b trace_blocks] [-s seed] dir nodes
+ ******************************************************************************/
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+// developer included files
+#include "log_format.h"
+#include "trace_format.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define GEN_LOG_PAGES         128               // default log ring (SAMPLE_LOG_PAGES)
+#define GEN_TRACE_BLOCKS      16                // default trace ring (TRACE_BLOCKS)
+#define GEN_SAMPLE_S          3                 // seconds between log records (PWM_PER)
+#define GEN_SI7021_ADDR       0x40              // Si7021 7-bit address
+#define GEN_SHTC3_ADDR        0x70              // SHTC3 7-bit address
+#define GEN_PATH_MAX          4096              // longest output path
+#define GEN_PAGE_RECORDS      (LOG_PAGE_SIZE / 8) // records a page can hold (shortest frame pads to 8 bytes)
+#define GEN_CODE_MAX          0xFFFF            // largest raw code
+/* Datasheet conversions in log channel order (si7021.h, shtc3.h) */
+#define GEN_CONV              { { 12500u, 600 }, { 17571u, 4685 }, { 10000u, 0 }, { 17500u, 4500 } }
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! What makes one node different from the next */
+typedef struct
+{
+    uint32_t                      seed;                   /// xorshift state
+    int32_t                       rh_offset;              /// SHTC3 - Si7021 RH (centi)
+    int32_t                       t_offset;               /// SHTC3 - Si7021 temperature (centi)
+    uint32_t                      nack_pct;               /// chance a poll is NACKed (percent)
+    uint32_t                      fault_permille;         /// chance a transaction faults (per mille)
+    uint32_t                      pages;                  /// log pages written before the dump
+    bool                          corrupt;                /// damage one frame
+    CONV_CAL_STRUCT               cal[LOG_CHANNELS];      /// calibration in force, per channel
+    uint32_t                      faults;                 /// faults left in the trace ring
+}NODE_PARAM_STRUCT;
+
+
+/*! What a node converted for one ring page, for the -r reference CSV */
+typedef struct
+{
+    uint32_t                      count;                  /// records in the page
+    LOG_RECORD_STRUCT             rec[GEN_PAGE_RECORDS];  /// records, in centi-units
+}GEN_PAGE_STRUCT;
+
+
+/*! Trace ring being filled */
+typedef struct
+{
+    uint8_t                      *ring;                   /// blocks
+    uint32_t                      blocks;                 /// blocks in the ring
+    uint32_t                      block;                  /// block being written
+    uint32_t                      seq;                    /// its sequence number
+    uint32_t                      last;                   /// time of the previous event
+    uint32_t                      now;                    /// current time (ticks)
+    uint32_t                     *faults;                 /// faults per block
+}GEN_TRACE_STRUCT;
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static uint32_t gen_rand(uint32_t *seed);
+static void gen_log(const char *path, NODE_PARAM_STRUCT *param, uint32_t ring_pages, bool raw);
+static void gen_cal(NODE_PARAM_STRUCT *param);
+static uint16_t gen_code(const CONV_COEF_STRUCT *conv, const CONV_CAL_STRUCT *cal, int32_t value);
+static void gen_csv(const char *path, const GEN_PAGE_STRUCT *pages, uint32_t ring_pages,
+                    uint32_t first, uint32_t count, uint32_t skip);
+static void gen_trace(const char *path, NODE_PARAM_STRUCT *param, uint32_t blocks);
+static void gen_transaction(GEN_TRACE_STRUCT *trace, NODE_PARAM_STRUCT *param, uint32_t bus,
+                            uint32_t addr, uint32_t cmd, uint32_t rx);
+static void gen_event(GEN_TRACE_STRUCT *trace, TRACE_KIND_Typedef kind, uint32_t bus, uint32_t byte);
+static void gen_write(const char *path, const void *data, size_t size);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes the fleet.
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  uint32_t pages = GEN_LOG_PAGES;
+  uint32_t blocks = GEN_TRACE_BLOCKS;
+  uint32_t seed = 1;
+  bool raw = false;
+  FILE *expect = NULL;
+  NODE_PARAM_STRUCT param;
+  uint32_t nodes;
+  char path[GEN_PATH_MAX];
+  int opt;
+
+  while((opt = getopt(argc, argv, "re:p:b:s:")) != -1)
+  {
+    if(opt == 'r')          raw = true;
+    else if(opt == 'e')     expect = fopen(optarg, "w");
+    else if(opt == 'p')     pages = (uint32_t)atoi(optarg);
+    else if(opt == 'b')     blocks = (uint32_t)atoi(optarg);
+    else if(opt == 's')     seed = (uint32_t)atoi(optarg) | 1;
+    else
+    {
+      fprintf(stderr, "usage: %s [-r] [-e expected.csv] [-p log_pages] [-b trace_blocks] [-s seed] dir nodes\n", argv[0]);
+      return 2;
+    }
+    if((opt == 'e') && !expect)
+    {
+      perror(optarg);
+      return 1;
+    }
+  }
+  if((optind != argc - 2) || (pages < 2) || (blocks < 1))
+  {
+    fprintf(stderr, "usage: %s [-r] [-e expected.csv] [-p log_pages] [-b trace_blocks] [-s seed] dir nodes\n", argv[0]);
+    return 2;
+  }
+  nodes = (uint32_t)atoi(argv[optind + 1]);
+  if(expect)
+  {
+    fprintf(expect, "node,rh_offset,t_offset,nack_pct,faults,bad_frames\n");
+  }
+
+  for(uint32_t n = 0; n < nodes; n++)
+  {
+    memset(&param, 0, sizeof(param));
+    param.seed = seed ^ ((n + 1) * 2654435761u);
+    gen_rand(&param.seed);
+    param.rh_offset = (int32_t)(gen_rand(&param.seed) % 301) - 150;
+    param.t_offset = (int32_t)(gen_rand(&param.seed) % 61) - 30;
+    if((gen_rand(&param.seed) % 100) < 3)
+    {
+      // a drifting sensor
+      param.rh_offset += 800;
+    }
+    param.nack_pct = gen_rand(&param.seed) % 30;
+    param.fault_permille = ((gen_rand(&param.seed) % 100) < 10) ? (1 + gen_rand(&param.seed) % 20) : 0;
+    param.pages = pages / 4 + gen_rand(&param.seed) % (pages * 2);
+    param.corrupt = (gen_rand(&param.seed) % 100) < 5;
+    gen_cal(&param);
+
+    snprintf(path, sizeof(path), "%s/node%05u", argv[optind], n);
+    gen_log(path, &param, pages, raw);
+    snprintf(path, sizeof(path), "%s/node%05u.trace", argv[optind], n);
+    gen_trace(path, &param, blocks);
+
+    if(expect)
+    {
+      fprintf(expect, "node%05u,%d,%d,%u,%u,%u\n", n, param.rh_offset, param.t_offset, param.nack_pct,
+              param.faults, (param.corrupt && param.pages) ? 1u : 0u);
+    }
+  }
+
+  if(expect && fclose(expect))
+  {
+    perror("expected values");
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes a node's sample log ring.
+ *
+ * @details
+ *  param->pages pages are written in turn around a ring of ring_pages, the
+ *  way sample_log.c fills flash, so a large count leaves a wrapped ring and
+ *  a small one leaves erased pages. The calibration is redrawn half way;
+ *  like sample_log_close_page(), that starts a page.
+ *
+ *  Values are what the node logs: the generated value is turned into the
+ *  code that calibrates back to it, and that code is converted with
+ *  conv_sample() and conv_calibrate(). A raw log keeps the code instead,
+ *  and the converted records of the ring go to <path>.csv.
+ *
+ * @param[in] path
+ *  Output path without its extension.
+ ******************************************************************************/
+void gen_log(const char *path, NODE_PARAM_STRUCT *param, uint32_t ring_pages, bool raw)
+{
+  static const CONV_COEF_STRUCT conv[LOG_CHANNELS] = GEN_CONV;
+  uint8_t *ring = malloc((size_t)ring_pages * LOG_PAGE_SIZE);
+  GEN_PAGE_STRUCT *pages = raw ? calloc(ring_pages, sizeof(GEN_PAGE_STRUCT)) : NULL;
+  GEN_PAGE_STRUCT *ref = NULL;
+  LOG_PAGE_HEADER_STRUCT header;
+  LOG_DESC_STRUCT desc;
+  LOG_DELTA_STRUCT delta;
+  LOG_RECORD_STRUCT rec;
+  uint32_t corrupt = ring_pages;
+  uint32_t time = 1000;
+  int32_t value[LOG_CHANNELS];
+  int32_t rh = 4000;
+  int32_t t = 2200;
+  uint8_t *page;
+  uint16_t code;
+  char name[GEN_PATH_MAX + 8];
+  uint32_t pos;
+  uint32_t ch;
+
+  memset(ring, LOG_ERASED_BYTE, (size_t)ring_pages * LOG_PAGE_SIZE);
+  for(uint32_t p = 0; p < param->pages; p++)
+  {
+    if(p && (p == param->pages / 2))
+    {
+      // recalibrated in the field
+      gen_cal(param);
+    }
+
+    page = &ring[(size_t)(p % ring_pages) * LOG_PAGE_SIZE];
+    memset(page, LOG_ERASED_BYTE, LOG_PAGE_SIZE);
+    log_page_header(&header, p, time, raw);
+    memcpy(page, &header, sizeof(header));
+    log_delta_reset(&delta, time, raw);
+    pos = sizeof(header);
+
+    if(raw)
+    {
+      ref = &pages[p % ring_pages];
+      ref->count = 0;
+      for(ch = 0; ch < LOG_CHANNELS; ch++)
+      {
+        memset(&desc, 0, sizeof(desc));
+        desc.valid = true;
+        desc.conv = conv[ch];
+        desc.cal = param->cal[ch];
+        pos += log_desc_encode(&desc, ch, &page[pos]);
+      }
+    }
+
+    for( ; (pos + LOG_FRAME_MAX) <= LOG_PAGE_SIZE; time += GEN_SAMPLE_S)
+    {
+      // slow random walk, with sensor noise on top
+      rh += (int32_t)(gen_rand(&param->seed) % 21) - 10;
+      t += (int32_t)(gen_rand(&param->seed) % 5) - 2;
+      value[0] = rh + (int32_t)(gen_rand(&param->seed) % 31) - 15;
+      value[1] = t + (int32_t)(gen_rand(&param->seed) % 7) - 3;
+      value[2] = rh + param->rh_offset + (int32_t)(gen_rand(&param->seed) % 31) - 15;
+      value[3] = t + param->t_offset + (int32_t)(gen_rand(&param->seed) % 7) - 3;
+
+      rec.time = time;
+      rec.mask = 0x0F;
+      rec.raw = raw;
+      for(ch = 0; ch < LOG_CHANNELS; ch++)
+      {
+        code = gen_code(&conv[ch], &param->cal[ch], value[ch]);
+        value[ch] = conv_calibrate(&param->cal[ch], conv_sample(&conv[ch], code));
+        rec.value[ch] = raw ? (int16_t)code : (int16_t)value[ch];
+      }
+      pos += log_frame_encode(&delta, &rec, &page[pos]);
+
+      if(raw)
+      {
+        ref->rec[ref->count] = rec;
+        for(ch = 0; ch < LOG_CHANNELS; ch++)
+        {
+          ref->rec[ref->count].value[ch] = (int16_t)value[ch];
+        }
+        ref->count++;
+      }
+    }
+  }
+
+  if(param->corrupt && param->pages)
+  {
+    // a payload byte of the page's first frame: the page decodes no records
+    corrupt = gen_rand(&param->seed) % ((param->pages < ring_pages) ? param->pages : ring_pages);
+    ring[(size_t)corrupt * LOG_PAGE_SIZE + sizeof(header) + 2] ^= 0x04;
+  }
+
+  snprintf(name, sizeof(name), "%s.log", path);
+  gen_write(name, ring, (size_t)ring_pages * LOG_PAGE_SIZE);
+  if(raw)
+  {
+    snprintf(name, sizeof(name), "%s.csv", path);
+    gen_csv(name, pages, ring_pages, (param->pages > ring_pages) ? (param->pages % ring_pages) : 0,
+            (param->pages < ring_pages) ? param->pages : ring_pages, corrupt);
+  }
+  free(pages);
+  free(ring);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Draws a node's calibration records.
+ *
+ * @details
+ *  A third of the channels are uncalibrated; the rest get a linear record
+ *  (gain within 1 %, offset within 0.5 units) or a second order polynomial
+ *  near the identity.
+ ******************************************************************************/
+void gen_cal(NODE_PARAM_STRUCT *param)
+{
+  CONV_CAL_STRUCT *cal;
+
+  for(uint32_t ch = 0; ch < LOG_CHANNELS; ch++)
+  {
+    cal = &param->cal[ch];
+    memset(cal, 0, sizeof(CONV_CAL_STRUCT));
+    switch(gen_rand(&param->seed) % 3)
+    {
+      case 1:
+        cal->mode = CONV_CAL_LINEAR;
+        cal->gain = CONV_CAL_ONE + (int32_t)(gen_rand(&param->seed) % 1311) - 655;
+        cal->offset = (int32_t)(gen_rand(&param->seed) % 101) - 50;
+        break;
+      case 2:
+        cal->mode = CONV_CAL_POLY;
+        cal->order = 2;
+        cal->coef[0] = ((int32_t)(gen_rand(&param->seed) % 101) - 50) * CONV_CAL_ONE;
+        cal->coef[1] = CONV_CAL_POLY_SCALE * CONV_CAL_ONE + (int32_t)(gen_rand(&param->seed) % 6553601) - 3276800;
+        cal->coef[2] = ((int32_t)(gen_rand(&param->seed) % 201) - 100) * CONV_CAL_ONE;
+        break;
+      default:
+        cal->mode = CONV_CAL_NONE;
+        break;
+    }
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Finds the raw code a sensor reports for a calibrated value.
+ *
+ * @details
+ *  Undoes the calibration (Newton's method for a polynomial), then the
+ *  datasheet conversion. The node's conversion of the code lands within a
+ *  code's width of the value.
+ *
+ * @return
+ *  Returns the code, clamped to the code range.
+ ******************************************************************************/
+uint16_t gen_code(const CONV_COEF_STRUCT *conv, const CONV_CAL_STRUCT *cal, int32_t value)
+{
+  double x = value;
+  double u;
+  double f;
+  double df;
+  double code;
+  int32_t k;
+
+  if(cal->mode == CONV_CAL_LINEAR)
+  {
+    x = (double)(value - cal->offset) * CONV_CAL_ONE / cal->gain;
+  }
+  else if(cal->mode == CONV_CAL_POLY)
+  {
+    // y * 2^16 = c0 + c1 u + c2 u^2 + ..., u = x / CONV_CAL_POLY_SCALE
+    u = (double)value * CONV_CAL_ONE / cal->coef[1];
+    for(uint32_t i = 0; i < 4; i++)
+    {
+      f = cal->coef[cal->order];
+      df = 0.0;
+      for(k = (int32_t)cal->order - 1; k >= 0; k--)
+      {
+        df = df * u + f;
+        f = f * u + cal->coef[k];
+      }
+      u -= (f - (double)value * CONV_CAL_ONE) / df;
+    }
+    x = u * CONV_CAL_POLY_SCALE;
+  }
+
+  code = floor((x + conv->offset) * (1u << CONV_CODE_BITS) / conv->gain + 0.5);
+
+  return (uint16_t)((code < 0) ? 0 : (code > GEN_CODE_MAX) ? GEN_CODE_MAX : code);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes the converted records of a raw ring as logdump prints them.
+ *
+ * @param[in] first
+ *  Ring slot of the oldest page.
+ *
+ * @param[in] count
+ *  Pages in the ring.
+ *
+ * @param[in] skip
+ *  Ring slot whose page was damaged (no records), or ring_pages.
+ ******************************************************************************/
+void gen_csv(const char *path, const GEN_PAGE_STRUCT *pages, uint32_t ring_pages,
+             uint32_t first, uint32_t count, uint32_t skip)
+{
+  const LOG_RECORD_STRUCT *rec;
+  const GEN_PAGE_STRUCT *page;
+  uint32_t slot;
+  int32_t v;
+  FILE *f = fopen(path, "w");
+
+  if(!f)
+  {
+    perror(path);
+    exit(1);
+  }
+
+  fprintf(f, "time,si7021_rh,si7021_t,shtc3_rh,shtc3_t\n");
+  for(uint32_t p = 0; p < count; p++)
+  {
+    slot = (first + p) % ring_pages;
+    page = &pages[slot];
+    for(uint32_t r = 0; (slot != skip) && (r < page->count); r++)
+    {
+      rec = &page->rec[r];
+      fprintf(f, "%u", rec->time);
+      for(uint32_t ch = 0; ch < LOG_CHANNELS; ch++)
+      {
+        v = rec->value[ch];
+        fprintf(f, ",%s%d.%02d", (v < 0) ? "-" : "", abs(v) / 100, abs(v) % 100);
+      }
+      fprintf(f, "\n");
+    }
+  }
+
+  if(fclose(f))
+  {
+    perror(path);
+    exit(1);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes a node's trace ring.
+ *
+ * @details
+ *  Each measurement cycle is a command write to each sensor followed by
+ *  read polls that are NACKed while the conversion runs, then the data
+ *  read, as the drivers do it. The ring is filled twice over so it wraps;
+ *  the faults in the blocks that survive are left in param->faults.
+ ******************************************************************************/
+void gen_trace(const char *path, NODE_PARAM_STRUCT *param, uint32_t blocks)
+{
+  GEN_TRACE_STRUCT trace;
+  uint32_t target = 2 * blocks;
+
+  memset(&trace, 0, sizeof(trace));
+  trace.ring = calloc(blocks, TRACE_BLOCK_SIZE);
+  trace.faults = calloc(blocks, sizeof(uint32_t));
+  trace.blocks = blocks;
+  trace.block = blocks - 1;
+  trace.seq = (uint32_t)-1;
+  trace.now = 5000;
+
+  // start block 0
+  gen_event(&trace, traceKinds, 0, 0);
+  while(trace.seq < target)
+  {
+    gen_transaction(&trace, param, 0, GEN_SI7021_ADDR, 0xF5, 2);
+    gen_transaction(&trace, param, 1, GEN_SHTC3_ADDR, 0x78, 3);
+    trace.now += GEN_SAMPLE_S * 1000;
+  }
+
+  param->faults = 0;
+  for(uint32_t b = 0; b < blocks; b++)
+  {
+    param->faults += trace.faults[b];
+  }
+
+  gen_write(path, trace.ring, (size_t)blocks * TRACE_BLOCK_SIZE);
+  free(trace.faults);
+  free(trace.ring);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Adds one measurement: command write, NACKed polls, data read.
+ ******************************************************************************/
+void gen_transaction(GEN_TRACE_STRUCT *trace, NODE_PARAM_STRUCT *param, uint32_t bus,
+                     uint32_t addr, uint32_t cmd, uint32_t rx)
+{
+  if((gen_rand(&param->seed) % 1000) < param->fault_permille)
+  {
+    gen_event(trace, traceI2cStart, bus, addr << 1);
+    gen_event(trace, (gen_rand(&param->seed) & 1) ? traceI2cArbLost : traceI2cBusErr, bus, 0);
+    trace->faults[trace->block]++;
+    trace->now += 1;
+  }
+
+  gen_event(trace, traceI2cStart, bus, addr << 1);
+  gen_event(trace, traceI2cAck, bus, 0);
+  gen_event(trace, traceI2cTx, bus, cmd);
+  gen_event(trace, traceI2cAck, bus, 0);
+  gen_event(trace, traceI2cMstop, bus, 0);
+
+  while((gen_rand(&param->seed) % 100) < param->nack_pct)
+  {
+    trace->now += 5;
+    gen_event(trace, traceI2cStart, bus, (addr << 1) | 1);
+    gen_event(trace, traceI2cNack, bus, 0);
+    gen_event(trace, traceI2cMstop, bus, 0);
+  }
+
+  trace->now += 10;
+  gen_event(trace, traceI2cStart, bus, (addr << 1) | 1);
+  gen_event(trace, traceI2cAck, bus, 0);
+  for(uint32_t i = 0; i < rx; i++)
+  {
+    trace->now += (i & 1);
+    gen_event(trace, traceI2cRxData, bus, gen_rand(&param->seed));
+  }
+  gen_event(trace, traceI2cMstop, bus, 0);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Appends an event the way trace_event() does (traceKinds just starts the
+ *  first block).
+ ******************************************************************************/
+void gen_event(GEN_TRACE_STRUCT *trace, TRACE_KIND_Typedef kind, uint32_t bus, uint32_t byte)
+{
+  TRACE_BLOCK_HEADER_STRUCT *header = (TRACE_BLOCK_HEADER_STRUCT *)&trace->ring[(size_t)trace->block * TRACE_BLOCK_SIZE];
+  uint8_t *payload;
+  uint32_t len;
+
+  if((kind == traceKinds) || (((uint32_t)header->len + TRACE_EVENT_MAX) > TRACE_BLOCK_PAYLOAD))
+  {
+    trace->block = (trace->block + 1) % trace->blocks;
+    header = (TRACE_BLOCK_HEADER_STRUCT *)&trace->ring[(size_t)trace->block * TRACE_BLOCK_SIZE];
+    header->magic = TRACE_BLOCK_MAGIC;
+    header->seq = ++trace->seq;
+    header->t0 = trace->now;
+    header->len = 0;
+    header->crc = LOG_CRC_INIT;
+    trace->faults[trace->block] = 0;
+    trace->last = trace->now;
+    if(kind == traceKinds)
+    {
+      return;
+    }
+  }
+
+  payload = (uint8_t *)(header + 1);
+  len = trace_event_encode(&payload[header->len], trace->now - trace->last, kind, true, TRACE_I2C_ARG(bus, byte));
+  header->crc = log_crc16(header->crc, &payload[header->len], len);
+  header->len += len;
+  trace->last = trace->now;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  xorshift32.
+ ******************************************************************************/
+uint32_t gen_rand(uint32_t *seed)
+{
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+
+  return *seed;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes a file, or exits.
+ ******************************************************************************/
+void gen_write(const char *path, const void *data, size_t size)
+{
+  FILE *f = fopen(path, "wb");
+
+  if(!f || (fwrite(data, 1, size, f) != size) || fclose(f))
+  {
+    perror(path);
+    exit(1);
+  }
+}
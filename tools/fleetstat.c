@@ -0,0 +1,987 @@
+/***************************************************************************//**
+ * @file
+ *   fleetstat.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Parallel host aggregator for fleet dumps
+ *
+ * @details
+ *   Decodes many node dumps at once and reports per-node and fleet-wide
+ *   statistics:
+ *
+ *     - sensor disagreement: |Si7021 - SHTC3| for RH and temperature, from
+ *       sample log records that carry both sensors
+ *     - NACK rate: slave NACKs per I2C transaction, from traces
+ *     - energy per sample: I2C bus-active time (START to MSTOP) times the
+ *       supply voltage and active current (-v, -i), per read transaction
+ *     - fault snapshots: the events leading up to each arbitration loss or
+ *       bus error, the first FLEET_SNAPSHOTS per node
+ *
+ *   A node's dumps are named <node>.<anything> (e.g. node0042.log and
+ *   node0042.trace); the type of each is taken from its contents.
+ *
+ *   Files are decoded by a pool of threads with one deque of files each.
+ *   A worker takes its own work from the back of its deque, largest first,
+ *   and when that is empty steals from the front of the others', so uneven
+ *   dump sizes do not leave cores idle. Every worker aggregates into its
+ *   own partial (no sharing while decoding) and the partials are merged
+ *   once all files are done.
+ *
+ *   Build (Linux):
+ *     cc -O2 -pthread -I../src/Header_Files -o fleetstat fleetstat.c dump.c \
+ *        ../src/Source_Files/log_format.c ../src/Source_Files/trace_format.c \
+ *        ../src/Source_Files/convert.c -lm
+ *
+ *   Usage:
+ *     fleetstat [-j threads] [-n] [-c expected.csv] [-v volts] [-i active_ua] dump...
+ *
+ *   -n adds a CSV row per node on stdout ahead of the fleet summary.
+ *   fleetgen writes synthetic fleets to try it on; with the values it gave
+ *   each node (fleetgen -e), -c checks every node's statistics against
+ *   them and exits 1 if any is off: the mean SHTC3 - Si7021 difference
+ *   and the NACKs per read within FLEET_CHECK_SIGMAS standard errors, the
+ *   fault count and the damaged frames exactly.
+ ******************************************************************************/
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+// developer included files
+#include "dump.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+/* Log channels (log_format.h order) */
+#define CH_SI7021_RH          0
+#define CH_SI7021_T           1
+#define CH_SHTC3_RH           2
+#define CH_SHTC3_T            3
+/* Disagreement histogram */
+#define HIST_BIN_CENTI        5                 // bin width (0.05 units)
+#define HIST_BINS             400               // bins; the last also takes everything above 20 units
+/* Fault snapshots */
+#define FLEET_CONTEXT         8                 // events kept ahead of a fault
+#define FLEET_SNAPSHOTS       2                 // snapshots kept per node
+#define FLEET_SHOW_SNAPSHOTS  8                 // snapshots printed in the summary
+/* Energy model defaults */
+#define FLEET_VOLTS           3.3               // supply voltage
+#define FLEET_ACTIVE_UA       1200.0            // node + bus current while a transfer is in flight (EM1, in micro-amps)
+#define FLEET_TICK_S          0.001             // trace ticks (LETIMER_HZ)
+/* Check mode (-c) */
+#define FLEET_CHECK_SIGMAS    4.0               // allowed deviation of a sampled mean, in standard errors
+#define FLEET_CHECK_CENTI     2.0               // allowed offset error on top, from code quantisation (centi-units)
+/* I2C */
+#define I2C_BUSES             2                 // I2C0 and I2C1
+#define I2C_READ_BIT          0x01              // read bit of a START header byte
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+/*! Compared quantities */
+typedef enum
+{
+  pairRH,           /*! Relative humidity */
+  pairTemp,         /*! Temperature */
+  pairs             /*! Number of compared quantities */
+}PAIR_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! Disagreement between the two sensors for one quantity (centi-units) */
+typedef struct
+{
+    uint64_t                      n;                      /// records compared
+    double                        sum;                    /// sum of |difference|
+    uint32_t                      max;                    /// worst |difference|
+    double                        sum_diff;               /// sum of SHTC3 - Si7021
+    double                        sum_diff_sq;            /// sum of (SHTC3 - Si7021)^2
+}DISAGREE_STRUCT;
+
+
+/*! Events leading up to a fault */
+typedef struct
+{
+    TRACE_EVENT_STRUCT            fault;                  /// the fault itself
+    uint32_t                      count;                  /// events in context
+    TRACE_EVENT_STRUCT            context[FLEET_CONTEXT]; /// preceding events, oldest first
+}SNAPSHOT_STRUCT;
+
+
+/*! Everything known about one node; summed across partials */
+typedef struct
+{
+    DUMP_STATS_STRUCT             log;                    /// log decode counters
+    DUMP_STATS_STRUCT             trace;                  /// trace decode counters
+    DISAGREE_STRUCT               disagree[pairs];        /// sensor disagreement
+    uint64_t                      transactions;           /// I2C transactions (START from idle)
+    uint64_t                      reads;                  /// transactions that read data
+    uint64_t                      nacks;                  /// slave NACKs
+    uint64_t                      faults;                 /// arbitration losses + bus errors
+    uint64_t                      active_ticks;           /// bus-active time, START to MSTOP
+    uint32_t                      snapshots;              /// snapshots kept
+    SNAPSHOT_STRUCT               snapshot[FLEET_SNAPSHOTS]; /// first faults seen
+}NODE_STRUCT;
+
+
+/*! One worker's share of the aggregate */
+typedef struct
+{
+    NODE_STRUCT                  *node;                   /// per node, indexed like fleet_nodes
+    uint64_t                      hist[pairs][HIST_BINS]; /// fleet disagreement histograms
+    uint64_t                      bytes;                  /// dump bytes decoded
+    uint32_t                      files;                  /// files decoded
+    uint32_t                      unknown;                /// files with no valid page or block
+}PARTIAL_STRUCT;
+
+
+/*! One file to decode */
+typedef struct
+{
+    const char                   *path;                   /// dump file
+    uint32_t                      node;                   /// index into fleet_nodes
+    uint64_t                      size;                   /// bytes, for dealing out largest first
+}TASK_STRUCT;
+
+
+/*! A worker's deque of task indices; the owner works the back, thieves the front */
+typedef struct
+{
+    pthread_mutex_t               lock;                   /// guards head and tail
+    uint32_t                     *task;                   /// task indices
+    uint32_t                      head;                   /// next to steal
+    uint32_t                      tail;                   /// one past the next to pop
+}DEQUE_STRUCT;
+
+
+/*! Per worker thread state */
+typedef struct
+{
+    uint32_t                      id;                     /// worker index
+    pthread_t                     thread;                 /// thread handle
+    DEQUE_STRUCT                  deque;                  /// own work
+    PARTIAL_STRUCT                partial;                /// own aggregate
+    uint32_t                      stolen;                 /// tasks taken from other workers
+}WORKER_STRUCT;
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+static TASK_STRUCT *fleet_tasks;
+static uint32_t fleet_task_count;
+static char **fleet_nodes;              // sorted unique node names
+static uint32_t fleet_node_count;
+static WORKER_STRUCT *fleet_workers;
+static uint32_t fleet_worker_count;
+static double fleet_volts = FLEET_VOLTS;
+static double fleet_active_ua = FLEET_ACTIVE_UA;
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static void *worker_run(void *arg);
+static bool worker_take(WORKER_STRUCT *worker, uint32_t *task);
+static void decode_file(PARTIAL_STRUCT *partial, const TASK_STRUCT *task);
+static void decode_log(PARTIAL_STRUCT *partial, NODE_STRUCT *node, const DUMP_FILE_STRUCT *file);
+static void decode_trace(NODE_STRUCT *node, const DUMP_FILE_STRUCT *file);
+static void disagree_add(PARTIAL_STRUCT *partial, NODE_STRUCT *node, PAIR_Typedef pair, int32_t a, int32_t b);
+static void merge(PARTIAL_STRUCT *into, const PARTIAL_STRUCT *from);
+static void node_merge(NODE_STRUCT *into, const NODE_STRUCT *from);
+static void report(const PARTIAL_STRUCT *fleet, bool per_node);
+static double hist_percentile(const uint64_t *hist, double pct);
+static double uj_per_sample(uint64_t active_ticks, uint64_t reads);
+static uint32_t check(const PARTIAL_STRUCT *fleet, const char *path);
+static uint32_t check_offset(const char *name, const char *what, const DISAGREE_STRUCT *disagree,
+                             int32_t expected);
+static char *node_name(const char *path);
+static int name_cmp(const void *a, const void *b);
+static int task_cmp(const void *a, const void *b);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/***************************************************************************//**
+ * @brief
+ *  Aggregates the dumps named on the command line.
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  struct timespec t_start, t_end;
+  const char *expect = NULL;
+  uint32_t failed = 0;
+  bool per_node = false;
+  uint32_t stolen = 0;
+  uint32_t i, w;
+  char **names;
+  double secs;
+  char *name;
+  char **hit;
+  int opt;
+
+  fleet_worker_count = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+  while((opt = getopt(argc, argv, "j:nc:v:i:")) != -1)
+  {
+    if(opt == 'j')          fleet_worker_count = (uint32_t)atoi(optarg);
+    else if(opt == 'n')     per_node = true;
+    else if(opt == 'c')     expect = optarg;
+    else if(opt == 'v')     fleet_volts = atof(optarg);
+    else if(opt == 'i')     fleet_active_ua = atof(optarg);
+    else
+    {
+      fprintf(stderr, "usage: %s [-j threads] [-n] [-c expected.csv] [-v volts] [-i active_ua] dump...\n", argv[0]);
+      return 2;
+    }
+  }
+  if((optind == argc) || (fleet_worker_count == 0))
+  {
+    fprintf(stderr, "usage: %s [-j threads] [-n] [-c expected.csv] [-v volts] [-i active_ua] dump...\n", argv[0]);
+    return 2;
+  }
+
+  // name the nodes: sorted, unique
+  fleet_task_count = (uint32_t)(argc - optind);
+  fleet_tasks = calloc(fleet_task_count, sizeof(TASK_STRUCT));
+  names = calloc(fleet_task_count, sizeof(char *));
+  for(i = 0; i < fleet_task_count; i++)
+  {
+    names[i] = node_name(argv[optind + i]);
+  }
+  qsort(names, fleet_task_count, sizeof(char *), name_cmp);
+  fleet_nodes = calloc(fleet_task_count, sizeof(char *));
+  for(i = 0; i < fleet_task_count; i++)
+  {
+    if(fleet_node_count && !strcmp(fleet_nodes[fleet_node_count - 1], names[i]))
+    {
+      free(names[i]);
+      continue;
+    }
+    fleet_nodes[fleet_node_count++] = names[i];
+  }
+  free(names);
+
+  // one task per file, largest first
+  for(i = 0; i < fleet_task_count; i++)
+  {
+    FILE *f = fopen(argv[optind + i], "rb");
+
+    fleet_tasks[i].path = argv[optind + i];
+    name = node_name(fleet_tasks[i].path);
+    hit = bsearch(&name, fleet_nodes, fleet_node_count, sizeof(char *), name_cmp);
+    fleet_tasks[i].node = (uint32_t)(hit - fleet_nodes);
+    free(name);
+    if(f)
+    {
+      fseek(f, 0, SEEK_END);
+      fleet_tasks[i].size = (uint64_t)ftell(f);
+      fclose(f);
+    }
+  }
+  qsort(fleet_tasks, fleet_task_count, sizeof(TASK_STRUCT), task_cmp);
+
+  // deal the tasks out round robin and start the workers
+  if(fleet_worker_count > fleet_task_count)
+  {
+    fleet_worker_count = fleet_task_count;
+  }
+  fleet_workers = calloc(fleet_worker_count, sizeof(WORKER_STRUCT));
+  for(w = 0; w < fleet_worker_count; w++)
+  {
+    fleet_workers[w].id = w;
+    fleet_workers[w].partial.node = calloc(fleet_node_count, sizeof(NODE_STRUCT));
+    fleet_workers[w].deque.task = calloc(fleet_task_count / fleet_worker_count + 1, sizeof(uint32_t));
+    pthread_mutex_init(&fleet_workers[w].deque.lock, NULL);
+  }
+  // tasks are largest first; each deque is filled smallest at the front so
+  // owners start on their largest and thieves take the small ones that
+  // fill the gaps at the end
+  for(i = fleet_task_count; i-- > 0; )
+  {
+    DEQUE_STRUCT *deque = &fleet_workers[i % fleet_worker_count].deque;
+
+    deque->task[deque->tail++] = i;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t_start);
+  for(w = 0; w < fleet_worker_count; w++)
+  {
+    pthread_create(&fleet_workers[w].thread, NULL, worker_run, &fleet_workers[w]);
+  }
+  for(w = 0; w < fleet_worker_count; w++)
+  {
+    pthread_join(fleet_workers[w].thread, NULL);
+  }
+
+  // merge the partials into worker 0's
+  for(w = 1; w < fleet_worker_count; w++)
+  {
+    merge(&fleet_workers[0].partial, &fleet_workers[w].partial);
+    stolen += fleet_workers[w].stolen;
+  }
+  stolen += fleet_workers[0].stolen;
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+  report(&fleet_workers[0].partial, per_node);
+  if(expect)
+  {
+    failed = check(&fleet_workers[0].partial, expect);
+  }
+
+  secs = (double)(t_end.tv_sec - t_start.tv_sec) + (double)(t_end.tv_nsec - t_start.tv_nsec) * 1e-9;
+  fprintf(stderr, "%u files (%u unrecognised), %.1f MB in %.3f s on %u threads (%u stolen): %.1f MB/s\n",
+          fleet_workers[0].partial.files, fleet_workers[0].partial.unknown,
+          (double)fleet_workers[0].partial.bytes / 1e6, secs, fleet_worker_count, stolen,
+          (secs > 0) ? ((double)fleet_workers[0].partial.bytes / secs / 1e6) : 0.0);
+
+  return failed ? 1 : 0;
+}
+
+
+/******************************************************************************
+ ****************************** WORKER FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Worker thread: decodes files until there are none left anywhere.
+ ******************************************************************************/
+void *worker_run(void *arg)
+{
+  WORKER_STRUCT *worker = arg;
+  uint32_t task;
+
+  while(worker_take(worker, &task))
+  {
+    decode_file(&worker->partial, &fleet_tasks[task]);
+  }
+
+  return NULL;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Takes the next task: the back of the worker's own deque, else the front
+ *  of the next non-empty one.
+ *
+ * @details
+ *  No task ever creates another, so once every deque has been seen empty
+ *  there is nothing left to do.
+ *
+ * @return
+ *  Returns false when all deques are empty.
+ ******************************************************************************/
+bool worker_take(WORKER_STRUCT *worker, uint32_t *task)
+{
+  DEQUE_STRUCT *deque = &worker->deque;
+  bool found = false;
+
+  pthread_mutex_lock(&deque->lock);
+  if(deque->head != deque->tail)
+  {
+    *task = deque->task[--deque->tail];
+    found = true;
+  }
+  pthread_mutex_unlock(&deque->lock);
+
+  for(uint32_t i = 1; !found && (i < fleet_worker_count); i++)
+  {
+    deque = &fleet_workers[(worker->id + i) % fleet_worker_count].deque;
+    pthread_mutex_lock(&deque->lock);
+    if(deque->head != deque->tail)
+    {
+      *task = deque->task[deque->head++];
+      found = true;
+      worker->stolen++;
+    }
+    pthread_mutex_unlock(&deque->lock);
+  }
+
+  return found;
+}
+
+
+/******************************************************************************
+ ***************************** DECODER FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Decodes one file into a partial aggregate.
+ ******************************************************************************/
+void decode_file(PARTIAL_STRUCT *partial, const TASK_STRUCT *task)
+{
+  NODE_STRUCT *node = &partial->node[task->node];
+  DUMP_FILE_STRUCT file;
+
+  if(!dump_open(task->path, &file))
+  {
+    partial->unknown++;
+    return;
+  }
+
+  switch(dump_detect(&file))
+  {
+    case dumpLog:
+      decode_log(partial, node, &file);
+      break;
+    case dumpTrace:
+      decode_trace(node, &file);
+      break;
+    default:
+      fprintf(stderr, "%s: no valid log page or trace block\n", task->path);
+      partial->unknown++;
+      break;
+  }
+
+  partial->files++;
+  partial->bytes += file.size;
+  dump_close(&file);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Adds a node's sample log: sensor disagreement wherever a record carries
+ *  the same quantity from both sensors.
+ ******************************************************************************/
+void decode_log(PARTIAL_STRUCT *partial, NODE_STRUCT *node, const DUMP_FILE_STRUCT *file)
+{
+  const uint8_t rh = (1 << CH_SI7021_RH) | (1 << CH_SHTC3_RH);
+  const uint8_t t = (1 << CH_SI7021_T) | (1 << CH_SHTC3_T);
+  DUMP_ITER_STRUCT iter;
+  LOG_RECORD_STRUCT rec;
+
+  dump_log_begin(&iter, file);
+  while(dump_log_next(&iter, &rec))
+  {
+    if((rec.mask & rh) == rh)
+    {
+      disagree_add(partial, node, pairRH, rec.value[CH_SI7021_RH], rec.value[CH_SHTC3_RH]);
+    }
+    if((rec.mask & t) == t)
+    {
+      disagree_add(partial, node, pairTemp, rec.value[CH_SI7021_T], rec.value[CH_SHTC3_T]);
+    }
+  }
+
+  node->log.units += iter.stats.units;
+  node->log.records += iter.stats.records;
+  node->log.bad_units += iter.stats.bad_units;
+  node->log.bad_frames += iter.stats.bad_frames;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Adds a node's trace: transactions, NACKs, bus-active time and faults.
+ *
+ * @details
+ *  A transaction runs from a START on an idle bus to its MSTOP; a repeated
+ *  START inside it does not count again. A fault ends the transaction
+ *  without an MSTOP. The last FLEET_CONTEXT events are kept in a ring for
+ *  the snapshots.
+ ******************************************************************************/
+void decode_trace(NODE_STRUCT *node, const DUMP_FILE_STRUCT *file)
+{
+  TRACE_EVENT_STRUCT ring[FLEET_CONTEXT];
+  TRACE_EVENT_STRUCT event;
+  bool active[I2C_BUSES] = { false };
+  uint32_t start[I2C_BUSES] = { 0 };
+  DUMP_ITER_STRUCT iter;
+  SNAPSHOT_STRUCT *snap;
+  uint64_t seen = 0;
+  uint32_t bus;
+
+  dump_trace_begin(&iter, file);
+  while(dump_trace_next(&iter, &event))
+  {
+    if((event.kind >= traceI2cStart) && (event.kind <= traceI2cBusErr))
+    {
+      bus = TRACE_I2C_BUS(event.arg) % I2C_BUSES;
+      switch(event.kind)
+      {
+        case traceI2cStart:
+          if(!active[bus])
+          {
+            active[bus] = true;
+            start[bus] = event.time;
+            node->transactions++;
+          }
+          if(TRACE_I2C_BYTE(event.arg) & I2C_READ_BIT)
+          {
+            node->reads++;
+          }
+          break;
+        case traceI2cNack:
+          node->nacks++;
+          break;
+        case traceI2cMstop:
+          if(active[bus])
+          {
+            node->active_ticks += event.time - start[bus];
+            active[bus] = false;
+          }
+          break;
+        case traceI2cArbLost:
+        case traceI2cBusErr:
+          node->faults++;
+          if(active[bus])
+          {
+            node->active_ticks += event.time - start[bus];
+            active[bus] = false;
+          }
+          if(node->snapshots < FLEET_SNAPSHOTS)
+          {
+            snap = &node->snapshot[node->snapshots++];
+            snap->fault = event;
+            snap->count = (seen < FLEET_CONTEXT) ? (uint32_t)seen : FLEET_CONTEXT;
+            for(uint32_t i = 0; i < snap->count; i++)
+            {
+              snap->context[i] = ring[(seen - snap->count + i) % FLEET_CONTEXT];
+            }
+          }
+          break;
+        default:
+          break;
+      }
+    }
+
+    ring[seen++ % FLEET_CONTEXT] = event;
+  }
+
+  node->trace.units += iter.stats.units;
+  node->trace.records += iter.stats.records;
+  node->trace.bad_units += iter.stats.bad_units;
+  node->trace.bad_frames += iter.stats.bad_frames;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Adds one sensor comparison to a node and the fleet histogram.
+ ******************************************************************************/
+void disagree_add(PARTIAL_STRUCT *partial, NODE_STRUCT *node, PAIR_Typedef pair, int32_t a, int32_t b)
+{
+  uint32_t diff = (uint32_t)((a > b) ? (a - b) : (b - a));
+  uint32_t bin = diff / HIST_BIN_CENTI;
+
+  node->disagree[pair].n++;
+  node->disagree[pair].sum += diff;
+  node->disagree[pair].sum_diff += b - a;
+  node->disagree[pair].sum_diff_sq += (double)(b - a) * (b - a);
+  if(diff > node->disagree[pair].max)
+  {
+    node->disagree[pair].max = diff;
+  }
+  partial->hist[pair][(bin < HIST_BINS) ? bin : (HIST_BINS - 1)]++;
+}
+
+
+/******************************************************************************
+ ****************************** MERGE FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Folds one partial aggregate into another.
+ ******************************************************************************/
+void merge(PARTIAL_STRUCT *into, const PARTIAL_STRUCT *from)
+{
+  for(uint32_t i = 0; i < fleet_node_count; i++)
+  {
+    node_merge(&into->node[i], &from->node[i]);
+  }
+  for(uint32_t p = 0; p < pairs; p++)
+  {
+    for(uint32_t b = 0; b < HIST_BINS; b++)
+    {
+      into->hist[p][b] += from->hist[p][b];
+    }
+  }
+  into->bytes += from->bytes;
+  into->files += from->files;
+  into->unknown += from->unknown;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Folds one node's partial statistics into another's.
+ ******************************************************************************/
+void node_merge(NODE_STRUCT *into, const NODE_STRUCT *from)
+{
+  into->log.units += from->log.units;
+  into->log.records += from->log.records;
+  into->log.bad_units += from->log.bad_units;
+  into->log.bad_frames += from->log.bad_frames;
+  into->trace.units += from->trace.units;
+  into->trace.records += from->trace.records;
+  into->trace.bad_units += from->trace.bad_units;
+  into->trace.bad_frames += from->trace.bad_frames;
+  for(uint32_t p = 0; p < pairs; p++)
+  {
+    into->disagree[p].n += from->disagree[p].n;
+    into->disagree[p].sum += from->disagree[p].sum;
+    into->disagree[p].sum_diff += from->disagree[p].sum_diff;
+    into->disagree[p].sum_diff_sq += from->disagree[p].sum_diff_sq;
+    if(from->disagree[p].max > into->disagree[p].max)
+    {
+      into->disagree[p].max = from->disagree[p].max;
+    }
+  }
+  into->transactions += from->transactions;
+  into->reads += from->reads;
+  into->nacks += from->nacks;
+  into->faults += from->faults;
+  into->active_ticks += from->active_ticks;
+  for(uint32_t s = 0; (s < from->snapshots) && (into->snapshots < FLEET_SNAPSHOTS); s++)
+  {
+    into->snapshot[into->snapshots++] = from->snapshot[s];
+  }
+}
+
+
+/******************************************************************************
+ ***************************** REPORT FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Prints the merged aggregate.
+ ******************************************************************************/
+void report(const PARTIAL_STRUCT *fleet, bool per_node)
+{
+  static const char *const pair_names[pairs] = { "rh", "t" };
+  const NODE_STRUCT *node;
+  NODE_STRUCT total;
+  uint32_t shown = 0;
+  uint32_t worst = 0;
+  double rate;
+  double worst_rate = -1.0;
+
+  memset(&total, 0, sizeof(total));
+  if(per_node)
+  {
+    printf("node,log_pages,log_records,bad_pages,bad_frames,rh_mean,rh_max,t_mean,t_max,"
+           "transactions,nacks,nack_rate,faults,uj_per_sample\n");
+  }
+  for(uint32_t i = 0; i < fleet_node_count; i++)
+  {
+    node = &fleet->node[i];
+    node_merge(&total, node);
+    rate = node->transactions ? ((double)node->nacks / (double)node->transactions) : 0.0;
+    if(rate > worst_rate)
+    {
+      worst_rate = rate;
+      worst = i;
+    }
+    if(per_node)
+    {
+      printf("%s,%llu,%llu,%llu,%llu,%.2f,%.2f,%.2f,%.2f,%llu,%llu,%.4f,%llu,%.3f\n",
+             fleet_nodes[i],
+             (unsigned long long)node->log.units, (unsigned long long)node->log.records,
+             (unsigned long long)(node->log.bad_units + node->trace.bad_units),
+             (unsigned long long)(node->log.bad_frames + node->trace.bad_frames),
+             node->disagree[pairRH].n ? (node->disagree[pairRH].sum / node->disagree[pairRH].n / 100.0) : 0.0,
+             node->disagree[pairRH].max / 100.0,
+             node->disagree[pairTemp].n ? (node->disagree[pairTemp].sum / node->disagree[pairTemp].n / 100.0) : 0.0,
+             node->disagree[pairTemp].max / 100.0,
+             (unsigned long long)node->transactions, (unsigned long long)node->nacks, rate,
+             (unsigned long long)node->faults, uj_per_sample(node->active_ticks, node->reads));
+    }
+  }
+
+  printf("fleet: %u nodes, %llu log records, %llu trace events, %llu bad pages/blocks, %llu bad frames\n",
+         fleet_node_count, (unsigned long long)total.log.records, (unsigned long long)total.trace.records,
+         (unsigned long long)(total.log.bad_units + total.trace.bad_units),
+         (unsigned long long)(total.log.bad_frames + total.trace.bad_frames));
+  for(uint32_t p = 0; p < pairs; p++)
+  {
+    printf("disagreement %-2s: mean %.2f, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f (%llu records)\n",
+           pair_names[p],
+           total.disagree[p].n ? (total.disagree[p].sum / total.disagree[p].n / 100.0) : 0.0,
+           hist_percentile(fleet->hist[p], 0.50), hist_percentile(fleet->hist[p], 0.95),
+           hist_percentile(fleet->hist[p], 0.99), total.disagree[p].max / 100.0,
+           (unsigned long long)total.disagree[p].n);
+  }
+  printf("i2c: %llu transactions, %llu NACKs (rate %.4f, worst %s at %.4f), %llu faults\n",
+         (unsigned long long)total.transactions, (unsigned long long)total.nacks,
+         total.transactions ? ((double)total.nacks / (double)total.transactions) : 0.0,
+         fleet_node_count ? fleet_nodes[worst] : "-", (worst_rate > 0) ? worst_rate : 0.0,
+         (unsigned long long)total.faults);
+  printf("energy: %.3f uJ per sample (%.2f V, %.0f uA while the bus is active)\n",
+         uj_per_sample(total.active_ticks, total.reads), fleet_volts, fleet_active_ua);
+
+  for(uint32_t i = 0; (i < fleet_node_count) && (shown < FLEET_SHOW_SNAPSHOTS); i++)
+  {
+    node = &fleet->node[i];
+    for(uint32_t s = 0; (s < node->snapshots) && (shown < FLEET_SHOW_SNAPSHOTS); s++, shown++)
+    {
+      const SNAPSHOT_STRUCT *snap = &node->snapshot[s];
+
+      printf("fault %s t=%u %s bus %u:", fleet_nodes[i], snap->fault.time,
+             trace_kind_name(snap->fault.kind), TRACE_I2C_BUS(snap->fault.arg));
+      for(uint32_t c = 0; c < snap->count; c++)
+      {
+        printf(" %s/%02X@-%u", trace_kind_name(snap->context[c].kind),
+               TRACE_I2C_BYTE(snap->context[c].arg), snap->fault.time - snap->context[c].time);
+      }
+      printf("\n");
+    }
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reads a percentile off a disagreement histogram.
+ *
+ * @return
+ *  Returns the upper edge of the bin holding the percentile, in units.
+ ******************************************************************************/
+double hist_percentile(const uint64_t *hist, double pct)
+{
+  uint64_t n = 0;
+  uint64_t want;
+  uint64_t seen = 0;
+
+  for(uint32_t b = 0; b < HIST_BINS; b++)
+  {
+    n += hist[b];
+  }
+  if(n == 0)
+  {
+    return 0.0;
+  }
+
+  want = (uint64_t)ceil(pct * (double)n);
+  for(uint32_t b = 0; b < HIST_BINS; b++)
+  {
+    seen += hist[b];
+    if(seen >= want)
+    {
+      return (double)((b + 1) * HIST_BIN_CENTI) / 100.0;
+    }
+  }
+
+  return (double)(HIST_BINS * HIST_BIN_CENTI) / 100.0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Converts bus-active time into energy per read transaction.
+ *
+ * @return
+ *  Returns micro-joules per sample (0 if there were no reads).
+ ******************************************************************************/
+double uj_per_sample(uint64_t active_ticks, uint64_t reads)
+{
+  if(reads == 0)
+  {
+    return 0.0;
+  }
+
+  // V * uA * s = uJ
+  return fleet_volts * fleet_active_ua * ((double)active_ticks * FLEET_TICK_S) / (double)reads;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Checks every node against the values fleetgen gave it (fleetgen -e).
+ *
+ * @details
+ *  Prints a line per failed check and a summary. The offsets and the NACK
+ *  probability are sampled, so they pass within FLEET_CHECK_SIGMAS
+ *  standard errors of the sample; faults and damaged frames must match.
+ *
+ * @return
+ *  Returns the number of failed checks.
+ ******************************************************************************/
+uint32_t check(const PARTIAL_STRUCT *fleet, const char *path)
+{
+  FILE *f = fopen(path, "r");
+  const NODE_STRUCT *node;
+  unsigned long long faults, bad_frames;
+  uint32_t nodes = 0;
+  uint32_t failed = 0;
+  int rh_offset, t_offset;
+  unsigned nack_pct;
+  char line[256];
+  char name[64];
+  char *key = name;
+  char **hit;
+  double p, est, tol;
+
+  if(!f)
+  {
+    perror(path);
+    return 1;
+  }
+
+  while(fgets(line, sizeof(line), f))
+  {
+    // the header does not scan
+    if(sscanf(line, "%63[^,],%d,%d,%u,%llu,%llu", name, &rh_offset, &t_offset, &nack_pct,
+              &faults, &bad_frames) != 6)
+    {
+      continue;
+    }
+    nodes++;
+
+    hit = bsearch(&key, fleet_nodes, fleet_node_count, sizeof(char *), name_cmp);
+    if(!hit)
+    {
+      printf("check %s: no dumps\n", name);
+      failed++;
+      continue;
+    }
+    node = &fleet->node[hit - fleet_nodes];
+
+    failed += check_offset(name, "rh", &node->disagree[pairRH], rh_offset);
+    failed += check_offset(name, "t", &node->disagree[pairTemp], t_offset);
+
+    // every read START is NACKed with the node's probability
+    p = nack_pct / 100.0;
+    est = node->reads ? ((double)node->nacks / (double)node->reads) : 0.0;
+    tol = node->reads ? (FLEET_CHECK_SIGMAS * sqrt(p * (1.0 - p) / (double)node->reads)) : 0.0;
+    if(!node->reads || (fabs(est - p) > tol))
+    {
+      printf("check %s: %.4f NACKs per read (%llu reads), expected %.4f +/- %.4f\n",
+             name, est, (unsigned long long)node->reads, p, tol);
+      failed++;
+    }
+
+    if(node->faults != faults)
+    {
+      printf("check %s: %llu faults, expected %llu\n", name, (unsigned long long)node->faults, faults);
+      failed++;
+    }
+    if((node->log.bad_frames + node->trace.bad_frames) != bad_frames)
+    {
+      printf("check %s: %llu bad frames, expected %llu\n", name,
+             (unsigned long long)(node->log.bad_frames + node->trace.bad_frames), bad_frames);
+      failed++;
+    }
+  }
+  fclose(f);
+
+  printf("check: %u nodes, %u failed checks\n", nodes, failed);
+
+  return failed;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Checks a node's mean SHTC3 - Si7021 difference against its offset.
+ *
+ * @return
+ *  Returns 1 if the check failed, else 0.
+ ******************************************************************************/
+uint32_t check_offset(const char *name, const char *what, const DISAGREE_STRUCT *disagree,
+                      int32_t expected)
+{
+  double n = (double)disagree->n;
+  double mean;
+  double var;
+  double tol;
+
+  if(disagree->n < 2)
+  {
+    printf("check %s: no %s pairs\n", name, what);
+    return 1;
+  }
+
+  mean = disagree->sum_diff / n;
+  var = (disagree->sum_diff_sq - n * mean * mean) / (n - 1.0);
+  tol = FLEET_CHECK_SIGMAS * sqrt(((var > 0) ? var : 0.0) / n) + FLEET_CHECK_CENTI;
+  if(fabs(mean - expected) > tol)
+  {
+    printf("check %s: %s offset %.2f, expected %.2f +/- %.2f\n", name, what, mean / 100.0,
+           expected / 100.0, tol / 100.0);
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/******************************************************************************
+ ***************************** HELPER FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Takes the node name from a dump path: the file name up to its first dot.
+ *
+ * @return
+ *  Returns a new string.
+ ******************************************************************************/
+char *node_name(const char *path)
+{
+  const char *base = strrchr(path, '/');
+  size_t len;
+  char *name;
+
+  base = base ? (base + 1) : path;
+  len = strcspn(base, ".");
+  name = malloc(len + 1);
+  memcpy(name, base, len);
+  name[len] = '\0';
+
+  return name;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  qsort/bsearch comparison of node names.
+ ******************************************************************************/
+int name_cmp(const void *a, const void *b)
+{
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  qsort comparison putting the largest tasks first.
+ ******************************************************************************/
+int task_cmp(const void *a, const void *b)
+{
+  const TASK_STRUCT *ta = a;
+  const TASK_STRUCT *tb = b;
+
+  return (ta->size < tb->size) - (ta->size > tb->size);
+}
@@ -0,0 +1,762 @@
+/***************************************************************************//**
+ * @file
+ *   logdump.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Host decoder for sample log and event trace dumps
+ *
+ * @details
+ *   Memory-maps a dump pulled off a node and streams it to stdout as CSV or
+ *   JSON lines. A dump is either the sample log flash region (pages of
+ *   log_format.h) or the trace ring (blocks of trace_format.h); the type is
+ *   taken from the first valid page or block unless given with -t.
+ *
+ *   Records are decoded oldest first straight out of the mapping (dump.h),
+ *   so memory use does not grow with the dump. Every page header, frame CRC
+ *   and block CRC is checked and the failures are reported on stderr with
+ *   the throughput.
+ *
+ *   -f timeline renders a trace as one readable line per event (bus bytes,
+ *   interrupts, scheduler posts and callbacks, sleep and wake-ups) and ends
+ *   with the time spent awake and in each sleep mode and the longest
+ *   stretches the core stayed out of deep sleep (EM2/EM3), with the
+ *   callbacks that ran in them.
+ *
+ *   Build (Linux):
+ *     cc -O2 -I../src/Header_Files -o logdump logdump.c dump.c \
+ *        ../src/Source_Files/log_format.c ../src/Source_Files/trace_format.c \
+ *        ../src/Source_Files/convert.c
+ *
+ *   Usage:
+ *     logdump [-f csv|json|timeline] [-t log|trace] dump.bin > out
+ ******************************************************************************/
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// developer included files
+#include "dump.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define OUT_SIZE              (1u << 20)        // output buffer; flushed when less than OUT_SLACK is left
+#define OUT_SLACK             256               // longest line written between checks
+#define LOG_CENTI             100               // logged values are in centi-units
+#define TICK_HZ               1000              // trace ticks per second (LETIMER_HZ)
+#define TIMELINE_MODES        4                 // awake, EM1, EM2, EM3
+#define TIMELINE_WORST        5                 // longest stretches out of deep sleep reported
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+/*! Output formats */
+typedef enum
+{
+  formatCsv,        /*! CSV with a header row */
+  formatJson,       /*! One JSON object per line */
+  formatTimeline    /*! Readable trace timeline with a sleep summary */
+}FORMAT_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! Names of the scheduler event bits (app.h) */
+typedef struct
+{
+    uint32_t                      bit;                    /// event bit
+    const char                   *name;                   /// callback it runs
+}TIMELINE_CB_STRUCT;
+
+
+/*! A stretch the core stayed out of deep sleep */
+typedef struct
+{
+    uint32_t                      start;                  /// ticks at the wake-up
+    uint32_t                      len;                    /// ticks until the next EM2/EM3 sleep
+    uint32_t                      callbacks;              /// event bits of the callbacks that ran
+    bool                          em1;                    /// slept in EM1 on the way: EM2 was blocked
+}TIMELINE_STRETCH_STRUCT;
+
+
+/*! Sleep accounting while the timeline is rendered */
+typedef struct
+{
+    int32_t                       mode;                   /// 0 awake, 1-3 sleeping, -1 not known yet
+    uint32_t                      since;                  /// time the mode was entered
+    uint64_t                      ticks[TIMELINE_MODES];  /// time per mode
+    int32_t                       blocks[TIMELINE_MODES]; /// sleep blocks taken minus released, per mode
+    bool                          shallow;                /// in a stretch out of deep sleep
+    TIMELINE_STRETCH_STRUCT       stretch;                /// the current stretch
+    TIMELINE_STRETCH_STRUCT       worst[TIMELINE_WORST];  /// longest stretches, longest first
+}TIMELINE_STRUCT;
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+static char out_buf[OUT_SIZE];
+static uint32_t out_len;
+static FORMAT_Typedef out_format = formatCsv;
+
+static const char *const log_channel_names[LOG_CHANNELS] =
+{
+  "si7021_rh", "si7021_t", "shtc3_rh", "shtc3_t"
+};
+
+static const char *const log_channel_keys[LOG_CHANNELS] =
+{
+  ",\"si7021_rh\":", ",\"si7021_t\":", ",\"shtc3_rh\":", ",\"shtc3_t\":"
+};
+
+static const TIMELINE_CB_STRUCT timeline_cbs[] =
+{
+  { 0x800, "shtc3_read_req" },  { 0x080, "letimer0_uf" },   { 0x040, "si7021_hum_read" },
+  { 0x020, "si7021_temp_read" },{ 0x010, "si7021_write_reg" },{ 0x008, "si7021_read_reg" },
+  { 0x004, "shtc3_sleep" },     { 0x002, "shtc3_wakeup" },  { 0x001, "shtc3_measurement" }
+};
+
+static const char *const timeline_irqs[traceIrqs] =
+{
+  [traceIrqLetimer0] = "letimer0",
+  [traceIrqTimer1]   = "timer1",
+};
+
+static const char digit_pairs[201] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static void out_flush(void);
+static void out_reserve(void);
+static void out_str(const char *s);
+static void out_u32(uint32_t value);
+static void out_centi(int32_t value);
+static void out_i32(int32_t value);
+static void decode_log(DUMP_ITER_STRUCT *iter, const DUMP_FILE_STRUCT *file);
+static void decode_trace(DUMP_ITER_STRUCT *iter, const DUMP_FILE_STRUCT *file);
+static void decode_timeline(DUMP_ITER_STRUCT *iter, const DUMP_FILE_STRUCT *file);
+static void timeline_event(TIMELINE_STRUCT *tl, const TRACE_EVENT_STRUCT *event);
+static void timeline_sleep(TIMELINE_STRUCT *tl, uint32_t time, int32_t mode);
+static void timeline_summary(const TIMELINE_STRUCT *tl, uint32_t first, uint32_t last);
+static void out_callbacks(uint32_t bits);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/***************************************************************************//**
+ * @brief
+ *  Decodes one dump file.
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  DUMP_Typedef type = dumpAuto;
+  struct timespec t_start, t_end;
+  DUMP_FILE_STRUCT file;
+  DUMP_ITER_STRUCT iter;
+  double secs;
+  int opt;
+
+  while((opt = getopt(argc, argv, "f:t:")) != -1)
+  {
+    if((opt == 'f') && !strcmp(optarg, "csv"))          out_format = formatCsv;
+    else if((opt == 'f') && !strcmp(optarg, "json"))    out_format = formatJson;
+    else if((opt == 'f') && !strcmp(optarg, "timeline")) out_format = formatTimeline;
+    else if((opt == 't') && !strcmp(optarg, "log"))     type = dumpLog;
+    else if((opt == 't') && !strcmp(optarg, "trace"))   type = dumpTrace;
+    else
+    {
+      fprintf(stderr, "usage: %s [-f csv|json|timeline] [-t log|trace] dump.bin\n", argv[0]);
+      return 2;
+    }
+  }
+  if(optind != argc - 1)
+  {
+    fprintf(stderr, "usage: %s [-f csv|json|timeline] [-t log|trace] dump.bin\n", argv[0]);
+    return 2;
+  }
+
+  if(!dump_open(argv[optind], &file))
+  {
+    return 1;
+  }
+  if(type == dumpAuto)
+  {
+    type = dump_detect(&file);
+  }
+
+  if((type == dumpLog) && (out_format == formatTimeline))
+  {
+    fprintf(stderr, "%s: a timeline needs a trace dump\n", argv[optind]);
+    return 2;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t_start);
+  if(type == dumpLog)
+  {
+    decode_log(&iter, &file);
+  }
+  else if((type == dumpTrace) && (out_format == formatTimeline))
+  {
+    decode_timeline(&iter, &file);
+  }
+  else if(type == dumpTrace)
+  {
+    decode_trace(&iter, &file);
+  }
+  else
+  {
+    fprintf(stderr, "%s: no valid log page or trace block\n", argv[optind]);
+    return 1;
+  }
+  out_flush();
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+  secs = (double)(t_end.tv_sec - t_start.tv_sec) + (double)(t_end.tv_nsec - t_start.tv_nsec) * 1e-9;
+  fprintf(stderr, "%s: %llu %s, %llu records (%llu raw), %llu bad %s, %llu bad frames, %.1f MB/s\n",
+          (type == dumpLog) ? "log" : "trace",
+          (unsigned long long)iter.stats.units, (type == dumpLog) ? "pages" : "blocks",
+          (unsigned long long)iter.stats.records, (unsigned long long)iter.stats.raw_records,
+          (unsigned long long)iter.stats.bad_units, (type == dumpLog) ? "pages" : "blocks",
+          (unsigned long long)iter.stats.bad_frames,
+          (secs > 0) ? ((double)file.size / secs / 1e6) : 0.0);
+
+  dump_close(&file);
+
+  return (iter.stats.bad_units || iter.stats.bad_frames) ? 3 : 0;
+}
+
+
+/******************************************************************************
+ ***************************** DECODER FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Decodes a sample log dump.
+ ******************************************************************************/
+void decode_log(DUMP_ITER_STRUCT *iter, const DUMP_FILE_STRUCT *file)
+{
+  LOG_RECORD_STRUCT rec;
+  uint32_t ch;
+
+  if(out_format == formatCsv)
+  {
+    out_str("time");
+    for(ch = 0; ch < LOG_CHANNELS; ch++)
+    {
+      out_str(",");
+      out_str(log_channel_names[ch]);
+    }
+    out_str("\n");
+  }
+
+  dump_log_begin(iter, file);
+  while(dump_log_next(iter, &rec))
+  {
+    out_reserve();
+    if(out_format == formatCsv)
+    {
+      out_u32(rec.time);
+      for(ch = 0; ch < LOG_CHANNELS; ch++)
+      {
+        out_str(",");
+        if(rec.mask & (1 << ch))
+        {
+          out_centi(rec.value[ch]);
+        }
+      }
+    }
+    else
+    {
+      out_str("{\"time\":");
+      out_u32(rec.time);
+      for(ch = 0; ch < LOG_CHANNELS; ch++)
+      {
+        if(rec.mask & (1 << ch))
+        {
+          out_str(log_channel_keys[ch]);
+          out_centi(rec.value[ch]);
+        }
+      }
+      out_str("}");
+    }
+    out_str("\n");
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Decodes a trace dump.
+ *
+ * @details
+ *  I2C events are split into bus and data byte; other kinds print their
+ *  raw argument.
+ ******************************************************************************/
+void decode_trace(DUMP_ITER_STRUCT *iter, const DUMP_FILE_STRUCT *file)
+{
+  TRACE_EVENT_STRUCT event;
+  bool i2c;
+
+  if(out_format == formatCsv)
+  {
+    out_str("time,event,bus,byte,arg\n");
+  }
+
+  dump_trace_begin(iter, file);
+  while(dump_trace_next(iter, &event))
+  {
+    i2c = (event.kind >= traceI2cStart) && (event.kind <= traceI2cBusErr);
+
+    out_reserve();
+    if(out_format == formatCsv)
+    {
+      out_u32(event.time);
+      out_str(",");
+      out_str(trace_kind_name(event.kind));
+      out_str(",");
+      if(i2c)
+      {
+        out_u32(TRACE_I2C_BUS(event.arg));
+        out_str(",");
+        out_u32(TRACE_I2C_BYTE(event.arg));
+        out_str(",");
+      }
+      else
+      {
+        out_str(",,");
+        if(event.has_arg)
+        {
+          out_i32(event.arg);
+        }
+      }
+    }
+    else
+    {
+      out_str("{\"time\":");
+      out_u32(event.time);
+      out_str(",\"event\":\"");
+      out_str(trace_kind_name(event.kind));
+      out_str("\"");
+      if(i2c)
+      {
+        out_str(",\"bus\":");
+        out_u32(TRACE_I2C_BUS(event.arg));
+        out_str(",\"byte\":");
+        out_u32(TRACE_I2C_BYTE(event.arg));
+      }
+      else if(event.has_arg)
+      {
+        out_str(",\"arg\":");
+        out_i32(event.arg);
+      }
+      out_str("}");
+    }
+    out_str("\n");
+  }
+}
+
+
+/******************************************************************************
+ ***************************** TIMELINE FUNCTIONS *****************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Renders a trace dump as a timeline and sums up its sleep.
+ ******************************************************************************/
+void decode_timeline(DUMP_ITER_STRUCT *iter, const DUMP_FILE_STRUCT *file)
+{
+  TIMELINE_STRUCT tl;
+  TRACE_EVENT_STRUCT event;
+  uint32_t first = 0;
+  uint32_t last = 0;
+  bool any = false;
+
+  memset(&tl, 0, sizeof(tl));
+  tl.mode = -1;
+
+  out_str("# time_ms  event\n");
+
+  dump_trace_begin(iter, file);
+  while(dump_trace_next(iter, &event))
+  {
+    if(!any)
+    {
+      first = event.time;
+      any = true;
+    }
+    last = event.time;
+
+    out_reserve();
+    timeline_event(&tl, &event);
+  }
+
+  timeline_summary(&tl, first, last);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes one timeline line and updates the sleep accounting.
+ ******************************************************************************/
+void timeline_event(TIMELINE_STRUCT *tl, const TRACE_EVENT_STRUCT *event)
+{
+  int32_t arg = event->arg;
+
+  out_len += (uint32_t)snprintf(&out_buf[out_len], OUT_SLACK, "%10u  ",
+                                (unsigned)(((uint64_t)event->time * 1000) / TICK_HZ));
+
+  switch(event->kind)
+  {
+    case traceSchedPost:
+      out_str("post ");
+      out_callbacks((uint32_t)arg);
+      break;
+
+    case traceSchedTake:
+      out_str("run  ");
+      out_callbacks((uint32_t)arg);
+      if(tl->shallow)
+      {
+        tl->stretch.callbacks |= (uint32_t)arg;
+      }
+      break;
+
+    case traceIrq:
+      out_str("irq  ");
+      out_str(((arg >= 0) && (arg < traceIrqs) && timeline_irqs[arg]) ? timeline_irqs[arg] : "unknown");
+      break;
+
+    case traceSleep:
+      out_len += (uint32_t)snprintf(&out_buf[out_len], OUT_SLACK, "sleep EM%d", (int)arg);
+      timeline_sleep(tl, event->time, arg);
+      break;
+
+    case traceWake:
+      if(tl->mode > 0)
+      {
+        out_len += (uint32_t)snprintf(&out_buf[out_len], OUT_SLACK, "wake after %u ms in EM%d",
+                                      (unsigned)(((uint64_t)(event->time - tl->since) * 1000) / TICK_HZ),
+                                      (int)tl->mode);
+      }
+      else
+      {
+        out_str("wake");
+      }
+      timeline_sleep(tl, event->time, 0);
+      break;
+
+    case traceEmBlock:
+    case traceEmUnblock:
+      if((arg >= 0) && (arg < TIMELINE_MODES))
+      {
+        tl->blocks[arg] += (event->kind == traceEmBlock) ? 1 : -1;
+      }
+      out_len += (uint32_t)snprintf(&out_buf[out_len], OUT_SLACK, "%s EM%d",
+                                    (event->kind == traceEmBlock) ? "block  " : "unblock", (int)arg);
+      break;
+
+    default:
+      if((event->kind >= traceI2cStart) && (event->kind <= traceI2cBusErr))
+      {
+        // "i2c_start" -> "i2c0 start"; only START, TX and RX carry a byte
+        out_len += (uint32_t)snprintf(&out_buf[out_len], OUT_SLACK, "i2c%u %s",
+                                      (unsigned)TRACE_I2C_BUS(arg), trace_kind_name(event->kind) + 4);
+        if((event->kind == traceI2cStart) || (event->kind == traceI2cTx) || (event->kind == traceI2cRxData))
+        {
+          out_len += (uint32_t)snprintf(&out_buf[out_len], OUT_SLACK, " 0x%02X", (unsigned)TRACE_I2C_BYTE(arg));
+        }
+      }
+      else
+      {
+        out_str(trace_kind_name(event->kind));
+        if(event->has_arg)
+        {
+          out_str(" ");
+          out_i32(arg);
+        }
+      }
+      break;
+  }
+
+  out_str("\n");
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Accounts a change of sleep mode (0: woke up).
+ *
+ * @details
+ *  A stretch out of deep sleep starts when the core wakes from EM2/EM3 (or
+ *  at the first wake-up seen) and ends when it next goes to EM2/EM3; EM1
+ *  sleeps in between are part of it.
+ ******************************************************************************/
+void timeline_sleep(TIMELINE_STRUCT *tl, uint32_t time, int32_t mode)
+{
+  TIMELINE_STRETCH_STRUCT *worst = tl->worst;
+  uint32_t n;
+
+  if((mode < 0) || (mode >= TIMELINE_MODES))
+  {
+    return;
+  }
+
+  if(tl->mode >= 0)
+  {
+    tl->ticks[tl->mode] += time - tl->since;
+  }
+
+  if((mode == 0) && !tl->shallow)
+  {
+    tl->shallow = true;
+    memset(&tl->stretch, 0, sizeof(tl->stretch));
+    tl->stretch.start = time;
+  }
+  else if((mode == 1) && tl->shallow)
+  {
+    tl->stretch.em1 = true;
+  }
+  else if((mode >= 2) && tl->shallow)
+  {
+    tl->shallow = false;
+    tl->stretch.len = time - tl->stretch.start;
+
+    // keep the longest, longest first
+    for(n = 0; n < TIMELINE_WORST; n++)
+    {
+      if(tl->stretch.len > worst[n].len)
+      {
+        memmove(&worst[n + 1], &worst[n], (TIMELINE_WORST - 1 - n) * sizeof(worst[0]));
+        worst[n] = tl->stretch;
+        break;
+      }
+    }
+  }
+
+  tl->mode = mode;
+  tl->since = time;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Appends the time per sleep mode and the longest stretches out of deep
+ *  sleep.
+ ******************************************************************************/
+void timeline_summary(const TIMELINE_STRUCT *tl, uint32_t first, uint32_t last)
+{
+  static const char *const mode_names[TIMELINE_MODES] = { "awake", "EM1", "EM2", "EM3" };
+  uint64_t total = 0;
+  uint32_t n;
+
+  for(n = 0; n < TIMELINE_MODES; n++)
+  {
+    total += tl->ticks[n];
+  }
+
+  out_reserve();
+  out_len += (uint32_t)snprintf(&out_buf[out_len], OUT_SLACK, "# %u ms traced, %u ms accounted:",
+                                (unsigned)(((uint64_t)(last - first) * 1000) / TICK_HZ),
+                                (unsigned)((total * 1000) / TICK_HZ));
+  for(n = 0; n < TIMELINE_MODES; n++)
+  {
+    out_len += (uint32_t)snprintf(&out_buf[out_len], OUT_SLACK, "%s %s %.1f%%", n ? "," : "", mode_names[n],
+                                  total ? (100.0 * (double)tl->ticks[n] / (double)total) : 0.0);
+  }
+  out_str("\n# longest stretches out of EM2/EM3:\n");
+
+  for(n = 0; (n < TIMELINE_WORST) && tl->worst[n].len; n++)
+  {
+    out_reserve();
+    out_len += (uint32_t)snprintf(&out_buf[out_len], OUT_SLACK, "#   at %u ms for %u ms%s, callbacks: ",
+                                  (unsigned)(((uint64_t)tl->worst[n].start * 1000) / TICK_HZ),
+                                  (unsigned)(((uint64_t)tl->worst[n].len * 1000) / TICK_HZ),
+                                  tl->worst[n].em1 ? ", EM2 blocked (slept in EM1)" : "");
+    out_callbacks(tl->worst[n].callbacks);
+    out_str("\n");
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Appends the callback names of a set of scheduler event bits.
+ ******************************************************************************/
+void out_callbacks(uint32_t bits)
+{
+  bool first = true;
+  uint32_t n;
+
+  if(bits == 0)
+  {
+    out_str("none");
+    return;
+  }
+
+  for(n = 0; n < sizeof(timeline_cbs) / sizeof(timeline_cbs[0]); n++)
+  {
+    if(bits & timeline_cbs[n].bit)
+    {
+      out_str(first ? "" : "|");
+      out_str(timeline_cbs[n].name);
+      bits &= ~timeline_cbs[n].bit;
+      first = false;
+    }
+  }
+
+  // bits without a name
+  if(bits)
+  {
+    out_len += (uint32_t)snprintf(&out_buf[out_len], OUT_SLACK, "%s0x%X", first ? "" : "|", (unsigned)bits);
+  }
+}
+
+
+/******************************************************************************
+ ****************************** OUTPUT FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes out the output buffer.
+ ******************************************************************************/
+void out_flush(void)
+{
+  uint32_t done = 0;
+  ssize_t n;
+
+  while(done < out_len)
+  {
+    n = write(STDOUT_FILENO, &out_buf[done], out_len - done);
+    if(n <= 0)
+    {
+      perror("write");
+      exit(1);
+    }
+    done += (uint32_t)n;
+  }
+  out_len = 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Makes room for one output line.
+ ******************************************************************************/
+void out_reserve(void)
+{
+  if(out_len > (OUT_SIZE - OUT_SLACK))
+  {
+    out_flush();
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Appends a string.
+ ******************************************************************************/
+void out_str(const char *s)
+{
+  while(*s)
+  {
+    out_buf[out_len++] = *s++;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Appends an unsigned decimal.
+ *
+ * @details
+ *  Two digits per divide; this and the frame decode are the whole cost of
+ *  a run.
+ ******************************************************************************/
+void out_u32(uint32_t value)
+{
+  char digits[10];
+  uint32_t n = sizeof(digits);
+
+  while(value >= 100)
+  {
+    n -= 2;
+    memcpy(&digits[n], &digit_pairs[(value % 100) * 2], 2);
+    value /= 100;
+  }
+  if(value >= 10)
+  {
+    n -= 2;
+    memcpy(&digits[n], &digit_pairs[value * 2], 2);
+  }
+  else
+  {
+    digits[--n] = (char)('0' + value);
+  }
+
+  memcpy(&out_buf[out_len], &digits[n], sizeof(digits) - n);
+  out_len += sizeof(digits) - n;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Appends a signed decimal.
+ ******************************************************************************/
+void out_i32(int32_t value)
+{
+  if(value < 0)
+  {
+    out_buf[out_len++] = '-';
+  }
+  out_u32((value < 0) ? (0u - (uint32_t)value) : (uint32_t)value);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Appends a centi-unit value as a decimal with two places (-1234 -> -12.34).
+ ******************************************************************************/
+void out_centi(int32_t value)
+{
+  uint32_t mag = (value < 0) ? (0u - (uint32_t)value) : (uint32_t)value;
+  uint32_t frac = mag % LOG_CENTI;
+
+  if(value < 0)
+  {
+    out_buf[out_len++] = '-';
+  }
+  out_u32(mag / LOG_CENTI);
+  out_buf[out_len++] = '.';
+  memcpy(&out_buf[out_len], &digit_pairs[frac * 2], 2);
+  out_len += 2;
+}
@@ -0,0 +1,1962 @@
+/***************************************************************************//**
+ * @file
+ *   replay.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Host bus-trace replay harness for the I2C and sensor drivers
+ *
+ * @details
+ *   Runs the real i2c.c state machine and the Si7021/SHTC3 drivers on a
+ *   host against an I2C trace (trace_format.h), with the ISR inputs taken
+ *   from the trace and a virtual clock (replay_hal.c).
+ *
+ *   Replay: events are fed back in order with the clock at each event's
+ *   time. ACK, NACK, RXDATAV, MSTOP, ARBLOST and BUSERR are raised on the
+ *   peripheral and its IRQ handler is called; every START and data byte
+ *   the driver sends in response must match the next START/TX of that bus
+ *   in the trace. A START on an idle bus is the application's request: the
+ *   harness reads ahead to the transaction's MSTOP, makes the driver call
+ *   that produces it (si7021_i2c_read(), shtc3_write(), ...) and, at the
+ *   MSTOP, checks that the callback was scheduled and that the raw codes the
+ *   driver decoded are the bytes in the trace. A START while the driver
+ *   waits out a backoff fires the backoff timer.
+ *
+ *   A mismatch, a failed EFM_ASSERT or an unbalanced EM2 block is a
+ *   divergence. The bus is then run to the end of its transaction against
+ *   a bus that ACKs everything and followed again after the next MSTOP in
+ *   the trace; a driver that cannot be brought back to idle that way has
+ *   the rest of its bus skipped. A transaction whose header was NACKed
+ *   until the driver gave up carries no command byte; the callback the
+ *   driver posted after its MSTOP (traceSchedPost) names the call instead,
+ *   or, if the post is not in the trace, the call expected next in the
+ *   application's cycle. Transactions no application call
+ *   produces are counted as unreplayable and passed over. A ring dump that starts
+ *   mid-transaction is joined the same way; a dump that starts at
+ *   trace_open() is followed from its first event.
+ *
+ *   Record (-w): the drivers run the application's measurement cycle
+ *   against simulated sensors (conversion NACKs, changing readings and,
+ *   with -f, arbitration losses and bus errors; with -u, an unplugged
+ *   sensor that NACKs every header) and the trace hooks write a trace
+ *   file: the reference a driver change is replayed against. With -a the
+ *   application itself (app.c) runs instead of the fixed cycle: it opens
+ *   both sensors and answers app_sample_now() requests through its own
+ *   callbacks, dispatched the way the main loop does, with its low-energy
+ *   timers expired against the virtual clock; app_sample_stats() is
+ *   printed at the end. With -p the LETIMER0 underflow is posted every
+ *   RECORD_PERIOD as well, so the rate groups run the periodic samples
+ *   next to the requests.
+ *
+ *   Everything runs on one thread as fast as the events decode, so a long
+ *   recording doubles as a benchmark of the ISR paths; the summary gives
+ *   events per second. Built with -DBENCH_ISR and bench.c, it also times
+ *   every handler run (bench.h) against a host clock and prints runs, mean
+ *   and worst case per handler. Host times rank code paths but cannot show
+ *   flash wait states: RAM placement (hotpath.h) is measured on the target.
+ *   Memory use does not grow with the trace.
+ *
+ *   Build (Linux, from tools/replay):
+ *     cc -O2 -Ishim -I. -I.. -I../../src/Header_Files -o replay \
+ *        replay.c replay_hal.c ../dump.c ../../src/Source_Files/i2c.c \
+ *        ../../src/Source_Files/si7021.c ../../src/Source_Files/shtc3.c \
+ *        ../../src/Source_Files/scheduler.c ../../src/Source_Files/convert.c \
+ *        ../../src/Source_Files/calibration.c ../../src/Source_Files/log_format.c \
+ *        ../../src/Source_Files/trace_format.c ../../src/Source_Files/snapshot.c \
+ *        ../../src/Source_Files/app.c ../../src/Source_Files/filter.c \
+ *        ../../src/Source_Files/median.c ../../src/Source_Files/archive.c \
+ *        ../../src/Source_Files/health.c ../../src/Source_Files/rate_group.c \
+ *        ../../src/Source_Files/gpio.c
+ *   add -DBENCH_ISR ../../src/Source_Files/bench.c for per-handler timing,
+ *   -DBENCH_CONV to time the periodic sample path with -a (add
+ *   -DLOG_RAW_CODES for the raw-code build's path).
+ *
+ *   Usage:
+ *     replay [-q] trace.bin
+ *     replay -w trace.bin [-n cycles] [-s seed] [-f faults_per_1000_starts] [-u bus]
+ *     replay -w trace.bin -a [-p] [-n requests] [-s seed] [-u bus]
+ ******************************************************************************/
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+// developer included files
+#include "replay.h"
+#include "dump.h"
+#include "app.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define REPLAY_WINDOW         4096              // events read ahead (power of two)
+#define REPLAY_REPORTS        20                // divergences printed in full
+#define REPLAY_GAP            0                 // window entry for damaged trace data
+#define REPLAY_RX_MAX         6                 // longest read
+#define REPLAY_SI7021_CBS     (SI7021_HUM_READ_CB | SI7021_TEMP_READ_CB | SI7021_WRITE_REG_CB | \
+                               SI7021_READ_REG_CB | SI7021_CHECK_REG_CB) // callbacks the Si7021 driver posts
+#define REPLAY_SHTC3_CBS      (SHTC3_SLEEP_CB | SHTC3_WAKEUP_CB | SHTC3_MEASUREMENT_CB | \
+                               SHTC3_READ_REQ_CB)                         // callbacks the SHTC3 driver posts
+
+#define MODEL_STEPS           4096              // bus events before a transaction is given up on
+#define MODEL_ANY_ADDR        0xFF              // model answers every address
+#define MODEL_NO_ADDR         0x80              // model answers no address: the sensor is unplugged
+#define MODEL_SI7021_POLLS    4                 // conversion NACKs: 0 to 3
+#define MODEL_SHTC3_POLLS     3                 // conversion NACKs: 0 to 2
+
+#define RECORD_PERIOD         (3 * LETIMER_HZ)  // measurement cycle; LETIMER0 underflow period (PWM_PER) with -a -p
+#define RECORD_CHECKSUM_EVERY 8                 // every Nth cycle reads with checksum
+#define RECORD_REQUEST_PERIOD (2 * LETIMER_HZ)  // between on-demand requests; longer than APP_SAMPLE_FRESH_MS
+#define RECORD_REPEAT_EVERY   4                 // every Nth request is repeated at once, and answered from the snapshot
+#define RECORD_SI7021_REQ_CB  0x20000           // requester's event for a Si7021 sample (unused by the application)
+#define RECORD_SHTC3_REQ_CB   0x40000           // requester's event for an SHTC3 sample (unused by the application)
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+/*! Driver calls the harness can replay */
+typedef enum
+{
+  opNone,           /*! Not recognised */
+  opSi7021Read,     /*! si7021_i2c_read() */
+  opSi7021Write,    /*! si7021_i2c_write() */
+  opShtc3Write,     /*! shtc3_write() */
+  opShtc3Read       /*! shtc3_read() */
+}REPLAY_OP_Typedef;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! One I2C trace event */
+typedef struct
+{
+    uint32_t                      time;                   /// LETIMER ticks
+    uint8_t                       kind;                   /// TRACE_KIND_Typedef, or REPLAY_GAP
+    uint8_t                       bus;                    /// 0 = I2C0, 1 = I2C1
+    uint8_t                       byte;                   /// header, data or received byte
+    uint32_t                      cb;                     /// event bits of a traceSchedPost
+}REPLAY_EVENT_STRUCT;
+
+
+/*! A transaction as the trace shows it, and the call that replays it */
+typedef struct
+{
+    REPLAY_OP_Typedef             op;                     /// driver call
+    uint8_t                       hdr;                    /// first header byte
+    bool                          read;                   /// a read header was sent
+    uint8_t                       tx[2];                  /// first data bytes written
+    uint32_t                      tx_count;               /// data bytes written
+    uint8_t                       rx[REPLAY_RX_MAX];      /// bytes read
+    uint32_t                      rx_count;               /// bytes read
+    bool                          checksum;               /// the CRC bytes were read
+    uint32_t                      cb;                     /// scheduler callback passed to the driver
+}REPLAY_TX_STRUCT;
+
+
+/*! Replay state of one bus */
+typedef struct
+{
+    bool                          synced;                 /// following the trace
+    bool                          active;                 /// a replayed transaction is running
+    bool                          wedged;                 /// the driver could not be brought back to idle
+    REPLAY_TX_STRUCT              tx;                     /// the running transaction
+    uint32_t                      next_cb;                /// callback of the call expected next in the application's cycle (0: unknown)
+}REPLAY_BUS_STRUCT;
+
+
+/*! Replay counters */
+typedef struct
+{
+    uint64_t                      events;                 /// I2C events read
+    uint64_t                      skipped;                /// events passed over while not synced
+    uint64_t                      transactions;           /// driver calls made
+    uint64_t                      completed;              /// transactions checked at MSTOP
+    uint64_t                      unreplayable;           /// transactions with no matching driver call
+    uint64_t                      divergences;            /// mismatches
+}REPLAY_STATS_STRUCT;
+
+
+/*! Simulated device on one bus */
+typedef struct
+{
+    uint8_t                       addr;                   /// 7-bit address, or MODEL_ANY_ADDR
+    uint8_t                       cmd[2];                 /// bytes written since the START
+    uint32_t                      cmd_len;
+    uint8_t                       rx[REPLAY_RX_MAX];      /// bytes for the next read
+    uint32_t                      rx_len;
+    uint32_t                      rx_pos;
+    uint32_t                      busy_polls;             /// read headers to NACK while converting
+    bool                          read_hdr;               /// the last header sent was a read
+    bool                          reading;                /// read header ACKed; clocking data
+    bool                          stop;                   /// STOP requested; MSTOP due
+    uint8_t                       user_reg;               /// Si7021 user register 1
+    uint16_t                      rh;                     /// current RH code
+    uint16_t                      temp;                   /// current temperature code
+}MODEL_STRUCT;
+
+
+/*! Trace file being recorded */
+typedef struct
+{
+    FILE                         *file;                   /// output
+    TRACE_BLOCK_STRUCT            block;                  /// block being filled
+    uint32_t                      last;                   /// time of the last event in the block
+    uint64_t                      blocks;                 /// blocks written
+    uint64_t                      events;                 /// events written
+}RECORD_STRUCT;
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+static REPLAY_EVENT_STRUCT replay_window[REPLAY_WINDOW];
+static uint32_t replay_head;          // window index of the next event to replay
+static uint32_t replay_count;         // events in the window
+static REPLAY_BUS_STRUCT replay_bus[REPLAY_BUSES];
+static REPLAY_STATS_STRUCT replay_stats;
+static uint32_t replay_reports = REPLAY_REPORTS;
+static uint32_t replay_asserts;       // asserts already reported
+static uint32_t replay_si7021_rh;     // Si7021 RH code waiting for its temperature
+static SNAPSHOT_VALUES_STRUCT replay_values[REPLAY_BUSES];   // converted snapshots, as the application keeps them
+
+static MODEL_STRUCT model[REPLAY_BUSES];
+static uint32_t model_seed = 1;
+static uint32_t model_faults;         // faults per 1000 STARTs
+static int32_t model_unplugged = -1;  // bus whose sensor is missing when recording (-1: none)
+static bool record_app_mode;          // record the application's on-demand sampling (-a)
+static bool record_app_periodic;      // release the rate groups as well (-p)
+static uint32_t record_app_uf;        // time of the next LETIMER0 underflow (-p)
+static uint64_t model_fault_count;
+static uint32_t model_wait_us;      // backoff time not yet a whole clock tick
+
+static RECORD_STRUCT record;
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+static void replay_open(void);
+static void replay_run(const DUMP_FILE_STRUCT *file);
+static bool replay_fill(DUMP_ITER_STRUCT *iter);
+static void replay_event(const REPLAY_EVENT_STRUCT *event);
+static bool replay_issue(uint32_t bus, uint32_t time);
+static REPLAY_OP_Typedef replay_classify(REPLAY_TX_STRUCT *tx);
+static uint32_t replay_next_cb(uint32_t cb);
+static void replay_expect(uint32_t bus, const REPLAY_EVENT_STRUCT *event);
+static void replay_complete(uint32_t bus, uint32_t time);
+static void replay_check_result(uint32_t bus, uint32_t time);
+static void replay_print(uint32_t bus, uint32_t time, const char *fmt, ...);
+static void replay_diverge(uint32_t bus, uint32_t time, const char *fmt, ...);
+static void replay_skip(uint32_t bus, uint32_t time, const char *fmt, ...);
+static void replay_resync(uint32_t bus);
+static void replay_inject(uint32_t bus, uint32_t flag, uint8_t byte);
+static bool replay_backoff(uint32_t bus);
+static uint32_t replay_flag(uint8_t kind);
+
+static void model_init(uint32_t bus, uint8_t addr);
+static void model_run(uint32_t bus);
+static void model_wait(uint32_t bus);
+static void model_start(uint32_t bus, uint8_t hdr);
+static void model_tx(uint32_t bus, uint8_t byte);
+static void model_note(uint32_t bus, uint32_t flag);
+static void model_sample(MODEL_STRUCT *m, uint16_t code, uint8_t crc_init, uint32_t offset);
+static uint8_t model_crc8(const uint8_t *data, uint32_t len, uint8_t crc);
+static uint32_t model_rand(void);
+
+static void record_run(const char *path, uint32_t cycles);
+static void record_cycles(uint32_t cycles);
+static void record_app(uint32_t requests);
+static void record_app_settle(uint32_t until);
+static void record_app_idle(void);
+static bool record_app_dispatch(uint32_t events);
+static void record_app_report(void);
+static void record_finish(uint32_t bus, uint32_t cb);
+static void record_event(TRACE_KIND_Typedef kind, int32_t arg);
+static void record_block(void);
+
+#ifdef BENCH_ISR
+static void bench_report(void);
+#endif
+
+void I2C0_IRQHandler(void);
+void I2C1_IRQHandler(void);
+void TIMER1_IRQHandler(void);
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/***************************************************************************//**
+ * @brief
+ *  Replays or records one trace file.
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  const char *out_path = NULL;
+  struct timespec t_start, t_end;
+  DUMP_FILE_STRUCT file;
+  uint32_t cycles = 1000;
+  double secs;
+  int opt;
+
+  while((opt = getopt(argc, argv, "qw:n:s:f:u:ap")) != -1)
+  {
+    switch(opt)
+    {
+      case 'q': replay_reports = 0;                                     break;
+      case 'w': out_path = optarg;                                      break;
+      case 'n': cycles = (uint32_t)strtoul(optarg, NULL, 0);            break;
+      case 's': model_seed = (uint32_t)strtoul(optarg, NULL, 0) | 1;    break;
+      case 'f': model_faults = (uint32_t)strtoul(optarg, NULL, 0);      break;
+      case 'u': model_unplugged = (int32_t)strtol(optarg, NULL, 0);     break;
+      case 'a': record_app_mode = true;                                 break;
+      case 'p': record_app_periodic = true;                             break;
+      default:
+        fprintf(stderr, "usage: %s [-q] trace.bin\n"
+                        "       %s -w trace.bin [-a [-p]] [-n cycles] [-s seed] [-f faults_per_1000] [-u bus]\n",
+                argv[0], argv[0]);
+        return 2;
+    }
+  }
+  if((out_path && (optind != argc)) || (!out_path && (optind != argc - 1)))
+  {
+    fprintf(stderr, "usage: %s [-q] trace.bin\n"
+                    "       %s -w trace.bin [-a [-p]] [-n cycles] [-s seed] [-f faults_per_1000] [-u bus]\n",
+            argv[0], argv[0]);
+    return 2;
+  }
+
+  replay_open();
+#ifdef BENCH_ISR
+  bench_isr_open();
+#endif
+
+  clock_gettime(CLOCK_MONOTONIC, &t_start);
+  if(out_path)
+  {
+    record_run(out_path, cycles);
+  }
+  else
+  {
+    // resyncs answer with the model: no made-up faults there
+    model_faults = 0;
+    if(!dump_open(argv[optind], &file))
+    {
+      return 1;
+    }
+    if(dump_detect(&file) != dumpTrace)
+    {
+      fprintf(stderr, "%s: no valid trace block\n", argv[optind]);
+      return 1;
+    }
+    replay_run(&file);
+    dump_close(&file);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t_end);
+  secs = (double)(t_end.tv_sec - t_start.tv_sec) + (double)(t_end.tv_nsec - t_start.tv_nsec) * 1e-9;
+#ifdef BENCH_ISR
+  bench_report();
+#endif
+
+  if(out_path)
+  {
+    fprintf(stderr, "record: %u cycles, %llu events in %llu blocks, %llu faults, %llu asserts, "
+                    "%.2f M events/s\n",
+            cycles, (unsigned long long)record.events, (unsigned long long)record.blocks,
+            (unsigned long long)model_fault_count, (unsigned long long)replay_hal.asserts,
+            (secs > 0) ? ((double)record.events / secs / 1e6) : 0.0);
+
+    return replay_hal.asserts ? 3 : 0;
+  }
+
+  fprintf(stderr, "replay: %llu events (%llu skipped), %llu transactions, %llu checked, "
+                  "%llu unreplayable, %llu divergences, %llu s in timer_delay(), %.2f M events/s\n",
+          (unsigned long long)replay_stats.events, (unsigned long long)replay_stats.skipped,
+          (unsigned long long)replay_stats.transactions, (unsigned long long)replay_stats.completed,
+          (unsigned long long)replay_stats.unreplayable, (unsigned long long)replay_stats.divergences,
+          (unsigned long long)(replay_hal.delay_ms / 1000),
+          (secs > 0) ? ((double)replay_stats.events / secs / 1e6) : 0.0);
+
+  return replay_stats.divergences ? 3 : 0;
+}
+
+
+/******************************************************************************
+ ****************************** REPLAY FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Opens both buses the way the application does.
+ *
+ * @details
+ *  i2c_open() ends with a bus reset that waits for MSTOP, so the flag is
+ *  held up for the call.
+ ******************************************************************************/
+void replay_open(void)
+{
+  I2C_OPEN_STRUCT i2c_open_values;
+  uint32_t bus;
+
+  memset(&i2c_open_values, 0, sizeof(i2c_open_values));
+  i2c_open_values.enable = true;
+  i2c_open_values.master = true;
+  i2c_open_values.freq = I2C_FREQ;
+  i2c_open_values.clhr = I2C_CLHR_6_3;
+
+  scheduler_open();
+
+  for(bus = 0; bus < REPLAY_BUSES; bus++)
+  {
+    replay_i2c[bus].IF = I2C_IF_MSTOP;
+    i2c_open(&replay_i2c[bus], &i2c_open_values);
+    replay_i2c[bus].IF = 0;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Replays a trace dump.
+ ******************************************************************************/
+void replay_run(const DUMP_FILE_STRUCT *file)
+{
+  const TRACE_BLOCK_HEADER_STRUCT *oldest;
+  REPLAY_EVENT_STRUCT event;
+  DUMP_ITER_STRUCT iter;
+  uint32_t bus;
+
+  dump_trace_begin(&iter, file);
+
+  // a ring that has not wrapped starts at trace_open(), on idle buses,
+  // with each driver's open: the Si7021 register write, the SHTC3 wakeup
+  oldest = (const TRACE_BLOCK_HEADER_STRUCT *)(iter.map + (size_t)iter.first * TRACE_BLOCK_SIZE);
+  for(bus = 0; bus < REPLAY_BUSES; bus++)
+  {
+    replay_bus[bus].synced = (oldest->seq == 0);
+  }
+  if(oldest->seq == 0)
+  {
+    replay_bus[0].next_cb = SI7021_WRITE_REG_CB;
+    replay_bus[1].next_cb = SHTC3_WAKEUP_CB;
+  }
+
+  replay_fill(&iter);
+  while(replay_count)
+  {
+    event = replay_window[replay_head];
+    replay_head = (replay_head + 1) % REPLAY_WINDOW;
+    replay_count--;
+
+    replay_event(&event);
+
+    if(replay_count < REPLAY_WINDOW / 2)
+    {
+      replay_fill(&iter);
+    }
+  }
+
+  // a transaction cut off by the end of the dump still holds its EM2 block
+  for(bus = 0; bus < REPLAY_BUSES; bus++)
+  {
+    if(replay_bus[bus].active)
+    {
+      replay_resync(bus);
+    }
+  }
+  if(replay_hal.em_blocks != 0)
+  {
+    replay_diverge(0, replay_hal.now, "%d EM2 blocks left at the end of the trace", replay_hal.em_blocks);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Tops up the read-ahead window.
+ *
+ * @details
+ *  Non-I2C events are dropped, except scheduler posts: they name the call
+ *  behind a transaction no command byte of reached the device. Damaged
+ *  blocks or frames leave a gap entry where they were so both buses are
+ *  re-joined there.
+ *
+ * @return
+ *  Returns false once the dump is exhausted.
+ ******************************************************************************/
+bool replay_fill(DUMP_ITER_STRUCT *iter)
+{
+  REPLAY_EVENT_STRUCT *slot;
+  TRACE_EVENT_STRUCT event;
+  uint64_t damage = iter->stats.bad_units + iter->stats.bad_frames;
+
+  while(replay_count < REPLAY_WINDOW - 1)
+  {
+    if(!dump_trace_next(iter, &event))
+    {
+      return false;
+    }
+
+    slot = &replay_window[(replay_head + replay_count) % REPLAY_WINDOW];
+    if(damage != iter->stats.bad_units + iter->stats.bad_frames)
+    {
+      damage = iter->stats.bad_units + iter->stats.bad_frames;
+      slot->kind = REPLAY_GAP;
+      slot->time = event.time;
+      replay_count++;
+      slot = &replay_window[(replay_head + replay_count) % REPLAY_WINDOW];
+    }
+
+    if(event.kind == traceSchedPost)
+    {
+      slot->time = event.time;
+      slot->kind = event.kind;
+      slot->bus = 0;
+      slot->cb = (uint32_t)event.arg;
+      replay_count++;
+      continue;
+    }
+
+    if((event.kind < traceI2cStart) || (event.kind > traceI2cBusErr) ||
+       (TRACE_I2C_BUS(event.arg) >= REPLAY_BUSES))
+    {
+      continue;
+    }
+
+    slot->time = event.time;
+    slot->kind = event.kind;
+    slot->bus = (uint8_t)TRACE_I2C_BUS(event.arg);
+    slot->byte = (uint8_t)TRACE_I2C_BYTE(event.arg);
+    replay_count++;
+  }
+
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Replays one event.
+ ******************************************************************************/
+void replay_event(const REPLAY_EVENT_STRUCT *event)
+{
+  REPLAY_BUS_STRUCT *bus = &replay_bus[event->bus];
+  uint32_t n;
+
+  replay_hal.now = event->time;
+
+  if(event->kind == REPLAY_GAP)
+  {
+    for(n = 0; n < REPLAY_BUSES; n++)
+    {
+      replay_resync(n);
+    }
+    return;
+  }
+
+  // only looked at by replay_issue()
+  if(event->kind == traceSchedPost)
+  {
+    return;
+  }
+
+  replay_stats.events++;
+
+  if(bus->wedged)
+  {
+    replay_stats.skipped++;
+    return;
+  }
+
+  // wait for a transaction boundary
+  if(!bus->synced)
+  {
+    replay_stats.skipped++;
+    if(event->kind == traceI2cMstop)
+    {
+      bus->synced = true;
+    }
+    return;
+  }
+
+  switch(event->kind)
+  {
+    case traceI2cStart:
+      // nothing pending from the driver: this START is a new request or a
+      // retry after backoff
+      if(replay_hal.out[event->bus].count == 0)
+      {
+        if(!bus->active)
+        {
+          if(!replay_issue(event->bus, event->time))
+          {
+            return;
+          }
+        }
+        else
+        {
+          replay_backoff(event->bus);
+        }
+      }
+      replay_expect(event->bus, event);
+      break;
+
+    case traceI2cTx:
+      replay_expect(event->bus, event);
+      break;
+
+    default:
+      if(replay_hal.out[event->bus].count)
+      {
+        replay_diverge(event->bus, event->time, "driver sent %s 0x%02X, trace has %s",
+                       trace_kind_name(replay_hal.out[event->bus].out[replay_hal.out[event->bus].head].kind),
+                       replay_hal.out[event->bus].out[replay_hal.out[event->bus].head].byte,
+                       trace_kind_name(event->kind));
+        return;
+      }
+
+      replay_inject(event->bus, replay_flag(event->kind), event->byte);
+
+      if((event->kind == traceI2cMstop) && bus->active)
+      {
+        replay_complete(event->bus, event->time);
+      }
+      break;
+  }
+
+  if(replay_hal.asserts != replay_asserts)
+  {
+    replay_diverge(event->bus, event->time, "EFM_ASSERT failed at %s:%d",
+                   replay_hal.assert_file, replay_hal.assert_line);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts the transaction that begins at the next window event.
+ *
+ * @details
+ *  Reads ahead to the transaction's MSTOP. Bytes written and read before
+ *  an arbitration loss or bus error are dropped: the retry sends them again.
+ *  The driver's callback post after the MSTOP is picked up as well, for
+ *  transactions the device NACKed before any command byte.
+ *
+ * @return
+ *  Returns false if the transaction does not end in the window or no
+ *  driver call produces it.
+ ******************************************************************************/
+bool replay_issue(uint32_t bus, uint32_t time)
+{
+  REPLAY_TX_STRUCT *tx = &replay_bus[bus].tx;
+  const REPLAY_EVENT_STRUCT *event;
+  I2C_TypeDef *i2c = &replay_i2c[bus];
+  bool complete = false;
+  bool retry = false;
+  uint32_t posted = 0;
+  uint32_t cbs;
+  uint32_t n;
+
+  memset(tx, 0, sizeof(REPLAY_TX_STRUCT));
+  tx->hdr = replay_window[(replay_head + REPLAY_WINDOW - 1) % REPLAY_WINDOW].byte;
+  tx->read = tx->hdr & i2cReadBit;
+
+  for(n = 0; (n < replay_count) && !complete; n++)
+  {
+    event = &replay_window[(replay_head + n) % REPLAY_WINDOW];
+    if(event->kind == REPLAY_GAP)
+    {
+      break;
+    }
+    if((event->kind == traceSchedPost) || (event->bus != bus))
+    {
+      continue;
+    }
+
+    switch(event->kind)
+    {
+      case traceI2cStart:
+        tx->read |= event->byte & i2cReadBit;
+        if(retry)
+        {
+          tx->tx_count = 0;
+          tx->rx_count = 0;
+          retry = false;
+        }
+        break;
+      case traceI2cTx:
+        if(tx->tx_count < sizeof(tx->tx))
+        {
+          tx->tx[tx->tx_count] = event->byte;
+        }
+        tx->tx_count++;
+        break;
+      case traceI2cRxData:
+        if(tx->rx_count < REPLAY_RX_MAX)
+        {
+          tx->rx[tx->rx_count] = event->byte;
+        }
+        tx->rx_count++;
+        break;
+      case traceI2cArbLost:
+      case traceI2cBusErr:
+        retry = true;
+        break;
+      case traceI2cMstop:
+        complete = true;
+        break;
+    }
+  }
+
+  // the driver's post follows its MSTOP, before the bus's next MSTOP
+  cbs = ((tx->hdr >> I2C_ADDR_RW_SHIFT) == SI7021_ADDR) ? REPLAY_SI7021_CBS : REPLAY_SHTC3_CBS;
+  for(; complete && (n < replay_count) && !posted; n++)
+  {
+    event = &replay_window[(replay_head + n) % REPLAY_WINDOW];
+    if((event->kind == REPLAY_GAP) ||
+       ((event->kind == traceI2cMstop) && (event->bus == bus)))
+    {
+      break;
+    }
+    if(event->kind == traceSchedPost)
+    {
+      posted = event->cb & cbs;
+    }
+  }
+  tx->cb = posted ? posted : replay_bus[bus].next_cb;
+
+  if(!complete || (replay_classify(tx) == opNone))
+  {
+    replay_skip(bus, time, "no driver call for the transaction to 0x%02X, skipped",
+                tx->hdr >> I2C_ADDR_RW_SHIFT);
+    return false;
+  }
+
+  replay_stats.transactions++;
+  replay_bus[bus].active = true;
+  replay_bus[bus].next_cb = replay_next_cb(tx->cb);
+
+  switch(tx->op)
+  {
+    case opSi7021Read:
+      si7021_i2c_read(i2c, tx->tx[0], tx->checksum, tx->cb);
+      break;
+    case opSi7021Write:
+      si7021_i2c_write(i2c, tx->tx[0], tx->tx[1], tx->cb);
+      break;
+    case opShtc3Write:
+      // the application owns the bus from wakeup to sleep
+      if(tx->cb == SHTC3_WAKEUP_CB)
+      {
+        shtc3_acquire(i2c);
+      }
+      shtc3_write(i2c, (tx->tx[0] << SHIFT_MSBYTE) | tx->tx[1], tx->cb);
+      if(tx->cb == SHTC3_SLEEP_CB)
+      {
+        shtc3_release(i2c);
+      }
+      break;
+    case opShtc3Read:
+      shtc3_read(i2c, tx->checksum, tx->cb);
+      break;
+    default:
+      break;
+  }
+
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Finds the driver call that produces a transaction.
+ *
+ * @details
+ *  Only calls the application makes are recognised; anything else would
+ *  trip the drivers' own asserts rather than test them. A header NACKed
+ *  until the driver gave up leaves only the callback (passed in tx->cb)
+ *  to go by; the command bytes never reached the device, so the ones the
+ *  application sends with that callback are used.
+ *
+ * @return
+ *  Returns the call, also stored in tx with its callback and checksum flag.
+ ******************************************************************************/
+REPLAY_OP_Typedef replay_classify(REPLAY_TX_STRUCT *tx)
+{
+  uint32_t addr = tx->hdr >> I2C_ADDR_RW_SHIFT;
+  uint32_t need = 0;
+
+  tx->op = opNone;
+
+  // no command byte reached the device
+  if(!tx->read && (tx->tx_count == 0))
+  {
+    tx->checksum = false;
+    switch(tx->cb)
+    {
+      case SI7021_HUM_READ_CB:
+        tx->tx[0] = measureRH_NHMM;
+        tx->op = opSi7021Read;
+        break;
+      case SI7021_TEMP_READ_CB:
+        tx->tx[0] = MeasureTFromPrevRH;
+        tx->op = opSi7021Read;
+        break;
+      case SI7021_READ_REG_CB:
+      case SI7021_CHECK_REG_CB:
+        tx->tx[0] = readReg1;
+        tx->op = opSi7021Read;
+        break;
+      case SI7021_WRITE_REG_CB:
+        tx->tx[0] = writeReg1;
+        tx->tx[1] = APP_SI7021_RES;
+        tx->op = opSi7021Write;
+        break;
+      case SHTC3_WAKEUP_CB:
+        tx->tx[0] = (uint8_t)(wakeup >> SHIFT_MSBYTE);
+        tx->tx[1] = (uint8_t)wakeup;
+        tx->op = opShtc3Write;
+        break;
+      case SHTC3_MEASUREMENT_CB:
+        tx->tx[0] = (uint8_t)(readRHFirst_LPM >> SHIFT_MSBYTE);
+        tx->tx[1] = (uint8_t)readRHFirst_LPM;
+        tx->op = opShtc3Write;
+        break;
+      case SHTC3_SLEEP_CB:
+        tx->tx[0] = (uint8_t)(sleep >> SHIFT_MSBYTE);
+        tx->tx[1] = (uint8_t)sleep;
+        tx->op = opShtc3Write;
+        break;
+      default:
+        break;
+    }
+    return tx->op;
+  }
+
+  if((addr == SI7021_ADDR) && tx->read && (tx->tx_count >= 1))
+  {
+    switch(tx->tx[0])
+    {
+      case measureRH_NHMM:
+        tx->cb = SI7021_HUM_READ_CB;
+        need = SI7021_REQ_3_BYTES;
+        break;
+      case measureT_NHMM:
+      case MeasureTFromPrevRH:
+        tx->cb = SI7021_TEMP_READ_CB;
+        need = SI7021_REQ_3_BYTES;
+        break;
+      case readReg1:
+        tx->cb = SI7021_READ_REG_CB;
+        need = SI7021_REQ_2_BYTES;
+        break;
+      default:
+        return opNone;
+    }
+    tx->checksum = (tx->rx_count >= need);
+    tx->op = opSi7021Read;
+  }
+  else if((addr == SI7021_ADDR) && !tx->read && (tx->tx_count == 2) &&
+          ((tx->tx[0] == writeReg1) || (tx->tx[0] == writeHeaterCtrl)))
+  {
+    tx->cb = SI7021_WRITE_REG_CB;
+    tx->op = opSi7021Write;
+  }
+  else if((addr == SHTC3_ADDR) && tx->read && (tx->tx_count == 0))
+  {
+    tx->cb = SHTC3_READ_REQ_CB;
+    tx->checksum = (tx->rx_count >= SHTC3_REQ_6_BYTES);
+    tx->op = opShtc3Read;
+  }
+  else if((addr == SHTC3_ADDR) && !tx->read && (tx->tx_count == SHTC3_TX_2_BYTES))
+  {
+    switch((tx->tx[0] << SHIFT_MSBYTE) | tx->tx[1])
+    {
+      case sleep:
+        tx->cb = SHTC3_SLEEP_CB;
+        break;
+      case wakeup:
+        tx->cb = SHTC3_WAKEUP_CB;
+        break;
+      case readRHFirst_LPM:
+        tx->cb = SHTC3_MEASUREMENT_CB;
+        break;
+      default:
+        return opNone;
+    }
+    tx->op = opShtc3Write;
+  }
+
+  return tx->op;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  The callback of the call that follows another in the application's cycle.
+ *
+ * @details
+ *  Si7021: RH, then temperature from the previous RH; setup and the hourly
+ *  register check are followed by an RH read. SHTC3: wake, measure, read,
+ *  sleep.
+ *
+ * @return
+ *  Returns the callback, or 0 if nothing is known to follow.
+ ******************************************************************************/
+uint32_t replay_next_cb(uint32_t cb)
+{
+  switch(cb)
+  {
+    case SI7021_HUM_READ_CB:    return SI7021_TEMP_READ_CB;
+    case SI7021_TEMP_READ_CB:   return SI7021_HUM_READ_CB;
+    case SI7021_WRITE_REG_CB:   return SI7021_READ_REG_CB;
+    case SI7021_READ_REG_CB:    return SI7021_HUM_READ_CB;
+    case SI7021_CHECK_REG_CB:   return SI7021_HUM_READ_CB;
+    case SHTC3_WAKEUP_CB:       return SHTC3_MEASUREMENT_CB;
+    case SHTC3_MEASUREMENT_CB:  return SHTC3_READ_REQ_CB;
+    case SHTC3_READ_REQ_CB:     return SHTC3_SLEEP_CB;
+    case SHTC3_SLEEP_CB:        return SHTC3_WAKEUP_CB;
+    default:                    return 0;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Matches a START or data byte of the trace against the driver's output.
+ ******************************************************************************/
+void replay_expect(uint32_t bus, const REPLAY_EVENT_STRUCT *event)
+{
+  REPLAY_OUT_STRUCT out;
+
+  if(!replay_out_pop(bus, &out))
+  {
+    replay_diverge(bus, event->time, "driver did not send %s 0x%02X",
+                   trace_kind_name(event->kind), event->byte);
+    return;
+  }
+
+  // the device model follows the driver's side of the bus for resyncs
+  if(out.kind == traceI2cStart)
+  {
+    model[bus].read_hdr = out.byte & i2cReadBit;
+  }
+
+  if((out.kind != event->kind) || (out.byte != event->byte))
+  {
+    replay_diverge(bus, event->time, "driver sent %s 0x%02X, trace has %s 0x%02X",
+                   trace_kind_name(out.kind), out.byte, trace_kind_name(event->kind), event->byte);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Checks a replayed transaction at its MSTOP.
+ ******************************************************************************/
+void replay_complete(uint32_t bus, uint32_t time)
+{
+  REPLAY_BUS_STRUCT *state = &replay_bus[bus];
+
+  if(!(get_scheduled_events() & state->tx.cb))
+  {
+    replay_diverge(bus, time, "MSTOP did not complete the transaction to 0x%02X",
+                   state->tx.hdr >> I2C_ADDR_RW_SHIFT);
+    return;
+  }
+
+  remove_scheduled_event(state->tx.cb);
+  state->active = false;
+  replay_stats.completed++;
+
+  replay_check_result(bus, time);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Compares what the driver decoded with the bytes in the trace.
+ *
+ * @details
+ *  Runs the parse functions the application's callbacks run and compares
+ *  the raw codes in the published snapshot. The snapshot is converted the
+ *  way the application converts it, so conversion and calibration are
+ *  exercised but only the byte handling is judged. The Si7021 publishes its RH code with
+ *  the temperature, so the RH read is judged against the snapshot then.
+ ******************************************************************************/
+void replay_check_result(uint32_t bus, uint32_t time)
+{
+  const REPLAY_TX_STRUCT *tx = &replay_bus[bus].tx;
+  SNAPSHOT_STRUCT snap;
+  uint32_t expect;
+  uint32_t got;
+
+  // the device never answered: there is nothing to decode, and the
+  // application reports a missed sample instead of parsing
+  if(tx->rx_count == 0)
+  {
+    return;
+  }
+
+  switch(tx->op)
+  {
+    case opSi7021Read:
+      if(tx->tx[0] == readReg1)
+      {
+        expect = tx->rx[0];
+        got = si7021_store_user_reg();
+      }
+      else if(tx->tx[0] == measureRH_NHMM)
+      {
+        // held by the driver until the temperature completes the pair
+        replay_si7021_rh = (tx->rx[0] << SHIFT_MSBYTE) | tx->rx[1];
+        si7021_parse_RH_data();
+        return;
+      }
+      else
+      {
+        expect = (replay_si7021_rh << 16) | (tx->rx[0] << SHIFT_MSBYTE) | tx->rx[1];
+        si7021_parse_temp_data();
+        si7021_snapshot(&snap);
+        si7021_convert_rh(&snap, &replay_values[bus]);
+        si7021_convert_temp(&snap, &replay_values[bus]);
+        got = ((uint32_t)snap.rh_code << 16) | snap.temp_code;
+      }
+      break;
+
+    case opShtc3Read:
+      expect = ((uint32_t)tx->rx[0] << 24) | ((uint32_t)tx->rx[1] << 16) |
+               ((uint32_t)tx->rx[3] << 8) | tx->rx[4];
+      shtc3_parse_measurement_data_RH_first();
+      shtc3_snapshot(&snap);
+      shtc3_convert_rh(&snap, &replay_values[bus]);
+      shtc3_convert_temp(&snap, &replay_values[bus]);
+      got = ((uint32_t)snap.rh_code << 16) | snap.temp_code;
+      break;
+
+    default:
+      return;
+  }
+
+  // the transaction itself ran as recorded: no resync
+  if(got != expect)
+  {
+    replay_stats.divergences++;
+    replay_print(bus, time, "driver decoded 0x%X from the transaction to 0x%02X, trace bytes give 0x%X",
+                 got, tx->hdr >> I2C_ADDR_RW_SHIFT, expect);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Prints one finding while the report budget lasts.
+ ******************************************************************************/
+void replay_print(uint32_t bus, uint32_t time, const char *fmt, ...)
+{
+  va_list args;
+
+  if(replay_reports == 0)
+  {
+    return;
+  }
+
+  replay_reports--;
+  printf("t=%u bus %u: ", time, bus);
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+  printf("\n");
+  if(replay_reports == 0)
+  {
+    printf("(further findings counted only)\n");
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reports a divergence and re-joins the trace.
+ ******************************************************************************/
+void replay_diverge(uint32_t bus, uint32_t time, const char *fmt, ...)
+{
+  char text[160];
+  va_list args;
+
+  va_start(args, fmt);
+  vsnprintf(text, sizeof(text), fmt, args);
+  va_end(args);
+
+  replay_stats.divergences++;
+  replay_print(bus, time, "%s", text);
+
+  replay_resync(bus);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Reports a transaction the harness cannot replay and passes over it.
+ ******************************************************************************/
+void replay_skip(uint32_t bus, uint32_t time, const char *fmt, ...)
+{
+  char text[160];
+  va_list args;
+
+  va_start(args, fmt);
+  vsnprintf(text, sizeof(text), fmt, args);
+  va_end(args);
+
+  replay_stats.unreplayable++;
+  replay_stats.skipped++;
+  replay_print(bus, time, "%s", text);
+
+  replay_bus[bus].synced = false;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Brings a bus back to idle and waits for the trace's next MSTOP.
+ *
+ * @details
+ *  Whatever the driver is doing is finished against a device that ACKs
+ *  everything, so the driver is idle (and its EM2 block released) before
+ *  the trace is followed again.
+ ******************************************************************************/
+void replay_resync(uint32_t bus)
+{
+  REPLAY_BUS_STRUCT *state = &replay_bus[bus];
+  MODEL_STRUCT *m = &model[bus];
+
+  if(state->wedged)
+  {
+    return;
+  }
+
+  // keep where the bus is (reading, STOP sent) but answer anything, with zeros
+  m->addr = MODEL_ANY_ADDR;
+  m->busy_polls = 0;
+  m->rx_len = 0;
+  model_run(bus);
+
+  if(state->active)
+  {
+    if(get_scheduled_events() & state->tx.cb)
+    {
+      remove_scheduled_event(state->tx.cb);
+    }
+    else
+    {
+      // a driver that is still busy would queue every later call behind it
+      state->wedged = true;
+      replay_print(bus, replay_hal.now, "driver did not return to idle; rest of the bus skipped");
+    }
+  }
+  replay_out_flush(bus);
+
+  state->active = false;
+  state->synced = false;
+  replay_asserts = replay_hal.asserts;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Raises one I2C interrupt flag and runs the peripheral's IRQ handler.
+ ******************************************************************************/
+void replay_inject(uint32_t bus, uint32_t flag, uint8_t byte)
+{
+  I2C_TypeDef *i2c = &replay_i2c[bus];
+  uint32_t held = i2c->IF;
+
+  // start clean so the commands this interrupt issues can be read back
+  i2c->CMD = 0;
+  i2c->IFS = 0;
+
+  i2c->RXDATA = byte;
+  i2c->RXDATAP = byte;
+  i2c->IF = flag;
+
+  if(bus == 0)
+  {
+    I2C0_IRQHandler();
+  }
+  else
+  {
+    I2C1_IRQHandler();
+  }
+
+  // back to what the caller holds up (see record_app_dispatch())
+  i2c->IF = held;
+
+  model_note(bus, flag);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Fires a bus's backoff compare channel if it is armed.
+ *
+ * @return
+ *  Returns true if the driver was waiting out a backoff.
+ ******************************************************************************/
+bool replay_backoff(uint32_t bus)
+{
+  uint32_t flag = TIMER_IF_CC0 << ((bus == 0) ? I2C0_BACKOFF_CC : I2C1_BACKOFF_CC);
+
+  if(!(I2C_BACKOFF_TIMER->IEN & flag))
+  {
+    return false;
+  }
+
+  I2C_BACKOFF_TIMER->IF |= flag;
+  TIMER1_IRQHandler();
+
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Maps an input event kind to its interrupt flag.
+ ******************************************************************************/
+uint32_t replay_flag(uint8_t kind)
+{
+  switch(kind)
+  {
+    case traceI2cAck:       return I2C_IF_ACK;
+    case traceI2cNack:      return I2C_IF_NACK;
+    case traceI2cRxData:    return I2C_IF_RXDATAV;
+    case traceI2cMstop:     return I2C_IF_MSTOP;
+    case traceI2cArbLost:   return I2C_IF_ARBLOST;
+    case traceI2cBusErr:    return I2C_IF_BUSERR;
+    default:                return 0;
+  }
+}
+
+
+/******************************************************************************
+ ****************************** DEVICE MODEL **********************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Resets the simulated device on a bus.
+ *
+ * @param[in] bus
+ *  Bus index.
+ *
+ * @param[in] addr
+ *  Address it answers (MODEL_ANY_ADDR: all, no conversions, zero data;
+ *  MODEL_NO_ADDR: none).
+ ******************************************************************************/
+void model_init(uint32_t bus, uint8_t addr)
+{
+  MODEL_STRUCT *m = &model[bus];
+
+  memset(m, 0, sizeof(MODEL_STRUCT));
+  m->addr = addr;
+  m->user_reg = resetReg1;
+  m->rh = 0x6000;
+  m->temp = 0x6600;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Answers the driver on a bus until it goes quiet.
+ *
+ * @details
+ *  Each START and data byte the driver sends is answered; a STOP is
+ *  followed by MSTOP; a read is clocked out byte by byte; a pending
+ *  backoff (or NACK retry) is fired once the clock is moved on to it.
+ ******************************************************************************/
+void model_run(uint32_t bus)
+{
+  MODEL_STRUCT *m = &model[bus];
+  REPLAY_OUT_STRUCT out;
+  uint32_t steps;
+
+  for(steps = 0; steps < MODEL_STEPS; steps++)
+  {
+    if(replay_out_pop(bus, &out))
+    {
+      if(out.kind == traceI2cStart)
+      {
+        model_start(bus, out.byte);
+      }
+      else
+      {
+        model_tx(bus, out.byte);
+      }
+    }
+    else if(m->stop)
+    {
+      replay_inject(bus, I2C_IF_MSTOP, 0);
+    }
+    else if(m->reading)
+    {
+      replay_inject(bus, I2C_IF_RXDATAV, (m->rx_pos < m->rx_len) ? m->rx[m->rx_pos++] : 0);
+    }
+    else
+    {
+      model_wait(bus);
+      if(!replay_backoff(bus))
+      {
+        return;
+      }
+    }
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Moves the clock on to a bus's armed backoff compare.
+ *
+ * @details
+ *  The driver's time limits (the conversion poll timeout) count the waits
+ *  between retries, so the model lets them pass. Parts of a clock tick are
+ *  carried over to the next wait.
+ ******************************************************************************/
+void model_wait(uint32_t bus)
+{
+  uint32_t cc = (bus == 0) ? I2C0_BACKOFF_CC : I2C1_BACKOFF_CC;
+  uint32_t ticks;
+
+  if(!(I2C_BACKOFF_TIMER->IEN & (TIMER_IF_CC0 << cc)))
+  {
+    return;
+  }
+
+  ticks = (I2C_BACKOFF_TIMER->CC[cc].CCV - I2C_BACKOFF_TIMER->CNT) & I2C_BACKOFF_TOP;
+  model_wait_us += (uint32_t)(((uint64_t)ticks * 1000000u) /
+                              (CMU_ClockFreqGet(cmuClock_HFPER) / I2C_BACKOFF_DIV));
+
+  replay_hal.now += (model_wait_us * LETIMER_HZ) / 1000000u;
+  model_wait_us %= 1000000u / LETIMER_HZ;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Answers a START and header byte.
+ ******************************************************************************/
+void model_start(uint32_t bus, uint8_t hdr)
+{
+  MODEL_STRUCT *m = &model[bus];
+
+  m->cmd_len = 0;
+  m->reading = false;
+  m->read_hdr = hdr & i2cReadBit;
+
+  if((m->addr != MODEL_ANY_ADDR) && ((hdr >> I2C_ADDR_RW_SHIFT) != m->addr))
+  {
+    replay_inject(bus, I2C_IF_NACK, 0);
+    return;
+  }
+
+  if(model_faults && ((model_rand() % 1000) < model_faults))
+  {
+    model_fault_count++;
+    replay_inject(bus, (model_rand() & 1) ? I2C_IF_ARBLOST : I2C_IF_BUSERR, 0);
+    return;
+  }
+
+  if(hdr & i2cReadBit)
+  {
+    // still converting: NACK the read header
+    if(m->busy_polls)
+    {
+      m->busy_polls--;
+      replay_inject(bus, I2C_IF_NACK, 0);
+      return;
+    }
+  }
+
+  replay_inject(bus, I2C_IF_ACK, 0);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Answers a data byte and acts on complete commands.
+ ******************************************************************************/
+void model_tx(uint32_t bus, uint8_t byte)
+{
+  MODEL_STRUCT *m = &model[bus];
+
+  if(m->cmd_len < sizeof(m->cmd))
+  {
+    m->cmd[m->cmd_len] = byte;
+  }
+  m->cmd_len++;
+
+  if((m->addr == SI7021_ADDR) && (m->cmd_len == 1))
+  {
+    switch(byte)
+    {
+      case measureRH_NHMM:
+        m->rh += (uint16_t)((model_rand() % 257) - 128);
+        model_sample(m, m->rh & 0xFFFC, 0x00, 0);
+        m->busy_polls = model_rand() % MODEL_SI7021_POLLS;
+        break;
+      case measureT_NHMM:
+        m->temp += (uint16_t)((model_rand() % 65) - 32);
+        model_sample(m, m->temp & 0xFFFC, 0x00, 0);
+        m->busy_polls = model_rand() % MODEL_SI7021_POLLS;
+        break;
+      case MeasureTFromPrevRH:
+        m->temp += (uint16_t)((model_rand() % 65) - 32);
+        model_sample(m, m->temp & 0xFFFC, 0x00, 0);
+        break;
+      case readReg1:
+        m->rx[0] = m->user_reg;
+        m->rx[1] = model_crc8(&m->user_reg, 1, 0x00);
+        m->rx_len = 2;
+        break;
+    }
+  }
+  else if((m->addr == SI7021_ADDR) && (m->cmd_len == 2) && (m->cmd[0] == writeReg1))
+  {
+    m->user_reg = byte;
+  }
+  else if((m->addr == SHTC3_ADDR) && (m->cmd_len == 2) &&
+          (((m->cmd[0] << SHIFT_MSBYTE) | m->cmd[1]) == readRHFirst_LPM))
+  {
+    m->rh += (uint16_t)((model_rand() % 257) - 128);
+    m->temp += (uint16_t)((model_rand() % 65) - 32);
+    model_sample(m, m->rh, 0xFF, 0);
+    model_sample(m, m->temp, 0xFF, 3);
+    m->busy_polls = model_rand() % MODEL_SHTC3_POLLS;
+  }
+
+  replay_inject(bus, I2C_IF_ACK, 0);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Follows the bus state after an interrupt: read clocking, STOP and MSTOP.
+ ******************************************************************************/
+void model_note(uint32_t bus, uint32_t flag)
+{
+  MODEL_STRUCT *m = &model[bus];
+  I2C_TypeDef *i2c = &replay_i2c[bus];
+
+  switch(flag)
+  {
+    case I2C_IF_ACK:
+      if(m->read_hdr && !m->reading)
+      {
+        m->reading = true;
+        m->rx_pos = 0;
+      }
+      break;
+    case I2C_IF_MSTOP:
+      // only an MSTOP the driver asked for ends its transaction
+      if(m->stop)
+      {
+        m->stop = false;
+        m->reading = false;
+        m->read_hdr = false;
+        m->cmd_len = 0;
+      }
+      break;
+    case I2C_IF_NACK:
+    case I2C_IF_ARBLOST:
+    case I2C_IF_BUSERR:
+      m->reading = false;
+      break;
+  }
+
+  // a STOP command, or MSTOP raised in software after a late bus fault
+  if((i2c->CMD & I2C_CMD_STOP) || (i2c->IFS & I2C_IF_MSTOP))
+  {
+    m->stop = true;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Loads a 16-bit reading and its CRC into the read buffer.
+ ******************************************************************************/
+void model_sample(MODEL_STRUCT *m, uint16_t code, uint8_t crc_init, uint32_t offset)
+{
+  m->rx[offset] = (uint8_t)(code >> SHIFT_MSBYTE);
+  m->rx[offset + 1] = (uint8_t)code;
+  m->rx[offset + 2] = model_crc8(&m->rx[offset], 2, crc_init);
+  m->rx_len = offset + 3;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  CRC-8, polynomial 0x31 (Si7021 starts at 0x00, SHTC3 at 0xFF).
+ ******************************************************************************/
+uint8_t model_crc8(const uint8_t *data, uint32_t len, uint8_t crc)
+{
+  uint32_t i;
+  uint32_t bit;
+
+  for(i = 0; i < len; i++)
+  {
+    crc ^= data[i];
+    for(bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+  }
+
+  return crc;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  xorshift32.
+ ******************************************************************************/
+uint32_t model_rand(void)
+{
+  model_seed ^= model_seed << 13;
+  model_seed ^= model_seed >> 17;
+  model_seed ^= model_seed << 5;
+
+  return model_seed;
+}
+
+
+/******************************************************************************
+ ****************************** RECORD FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Records a trace against the device models.
+ *
+ * @details
+ *  The fixed measurement cycle (record_cycles()), or with -a the
+ *  application's on-demand sampling (record_app()).
+ ******************************************************************************/
+void record_run(const char *path, uint32_t cycles)
+{
+  record.file = fopen(path, "wb");
+  if(!record.file)
+  {
+    perror(path);
+    exit(1);
+  }
+
+  model_init(0, (model_unplugged == 0) ? MODEL_NO_ADDR : SI7021_ADDR);
+  model_init(1, (model_unplugged == 1) ? MODEL_NO_ADDR : SHTC3_ADDR);
+  record.block.header.seq = (uint32_t)-1;
+  record_block();
+  replay_hal.sink = record_event;
+
+  if(record_app_mode)
+  {
+    record_app(cycles);
+  }
+  else
+  {
+    record_cycles(cycles);
+  }
+
+  replay_hal.sink = NULL;
+  record_block();
+
+  if(fclose(record.file) != 0)
+  {
+    perror(path);
+    exit(1);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Records the application's measurement cycle.
+ *
+ * @details
+ *  Si7021 on I2C0 (setup, then RH and temperature from the previous RH),
+ *  SHTC3 on I2C1 (wake, measure, read, sleep), one cycle per
+ *  RECORD_PERIOD; every RECORD_CHECKSUM_EVERY-th cycle reads the CRC bytes
+ *  too.
+ ******************************************************************************/
+void record_cycles(uint32_t cycles)
+{
+  uint32_t start;
+  bool checksum;
+  uint32_t c;
+
+  si7021_i2c_write(I2C0, writeReg1, measureResRH12_T14, SI7021_WRITE_REG_CB);
+  record_finish(0, SI7021_WRITE_REG_CB);
+  si7021_i2c_read(I2C0, readReg1, false, SI7021_READ_REG_CB);
+  record_finish(0, SI7021_READ_REG_CB);
+
+  for(c = 0; c < cycles; c++)
+  {
+    start = c * RECORD_PERIOD;
+    if((int32_t)(replay_hal.now - start) < 0)
+    {
+      replay_hal.now = start;
+    }
+    checksum = ((c % RECORD_CHECKSUM_EVERY) == 0);
+
+    si7021_i2c_read(I2C0, measureRH_NHMM, checksum, SI7021_HUM_READ_CB);
+    record_finish(0, SI7021_HUM_READ_CB);
+    si7021_i2c_read(I2C0, MeasureTFromPrevRH, checksum, SI7021_TEMP_READ_CB);
+    record_finish(0, SI7021_TEMP_READ_CB);
+
+    shtc3_acquire(I2C1);
+    shtc3_write(I2C1, wakeup, SHTC3_WAKEUP_CB);
+    record_finish(1, SHTC3_WAKEUP_CB);
+    shtc3_write(I2C1, readRHFirst_LPM, SHTC3_MEASUREMENT_CB);
+    record_finish(1, SHTC3_MEASUREMENT_CB);
+    shtc3_read(I2C1, checksum, SHTC3_READ_REQ_CB);
+    record_finish(1, SHTC3_READ_REQ_CB);
+    shtc3_write(I2C1, sleep, SHTC3_SLEEP_CB);
+    shtc3_release(I2C1);
+    record_finish(1, SHTC3_SLEEP_CB);
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Records the application answering on-demand sample requests.
+ *
+ * @details
+ *  app_peripheral_setup() opens both sensors (the Si7021 register write
+ *  and check, the SHTC3 sleep), then both sensors get one app_sample_now()
+ *  per RECORD_REQUEST_PERIOD, so every request needs a sample; every
+ *  RECORD_REPEAT_EVERY-th is asked twice and the second is answered from
+ *  the fresh snapshot. A request whose event is never posted is counted
+ *  as an assert. The rate groups are released only with -p: otherwise
+ *  only on-demand samples run.
+ ******************************************************************************/
+void record_app(uint32_t requests)
+{
+  uint32_t start;
+  uint32_t r;
+
+  replay_hal.idle = record_app_idle;
+
+  // i2c_open() waits for the MSTOP of its bus reset
+  replay_i2c[0].IF = I2C_IF_MSTOP;
+  replay_i2c[1].IF = I2C_IF_MSTOP;
+  app_peripheral_setup();
+  replay_i2c[0].IF = 0;
+  replay_i2c[1].IF = 0;
+  record_app_uf = replay_hal.now + RECORD_PERIOD;
+  record_app_settle(RECORD_REQUEST_PERIOD);
+
+  for(r = 1; r <= requests; r++)
+  {
+    start = r * RECORD_REQUEST_PERIOD;
+    if((int32_t)(replay_hal.now - start) < 0)
+    {
+      replay_hal.now = start;
+    }
+
+    app_sample_now(appSensorSi7021, RECORD_SI7021_REQ_CB);
+    app_sample_now(appSensorShtc3, RECORD_SHTC3_REQ_CB);
+    record_app_settle(start + RECORD_REQUEST_PERIOD);
+
+    if((r % RECORD_REPEAT_EVERY) == 0)
+    {
+      app_sample_now(appSensorSi7021, RECORD_SI7021_REQ_CB);
+      app_sample_now(appSensorShtc3, RECORD_SHTC3_REQ_CB);
+      record_app_settle(start + RECORD_REQUEST_PERIOD);
+    }
+  }
+
+  replay_hal.idle = NULL;
+  record_app_report();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Runs the application until it has nothing left to do before a time.
+ *
+ * @details
+ *  The main loop's work: answer both buses, expire the timers that are
+ *  due and run the posted callbacks; with nothing posted the clock moves
+ *  on to the next timer (or, with -p, LETIMER0 underflow). The
+ *  requesters' events are taken here.
+ *
+ * @param[in] until
+ *  Time not to run past (the next request).
+ ******************************************************************************/
+void record_app_settle(uint32_t until)
+{
+  uint32_t events;
+  uint32_t due;
+
+  for(;;)
+  {
+    model_run(0);
+    model_run(1);
+    replay_timer_expire();
+    if(record_app_periodic && ((int32_t)(replay_hal.now - record_app_uf) >= 0))
+    {
+      add_scheduled_event(LETIMER0_UF_CB);
+      record_app_uf += RECORD_PERIOD;
+    }
+
+    events = get_scheduled_events();
+    if(events & (RECORD_SI7021_REQ_CB | RECORD_SHTC3_REQ_CB))
+    {
+      remove_scheduled_event(events & (RECORD_SI7021_REQ_CB | RECORD_SHTC3_REQ_CB));
+      events &= ~(RECORD_SI7021_REQ_CB | RECORD_SHTC3_REQ_CB);
+    }
+    if(events)
+    {
+      if(!record_app_dispatch(events))
+      {
+        fprintf(stderr, "record: t=%u: no callback for events 0x%X\n", replay_hal.now, events);
+        replay_hal.asserts++;
+        remove_scheduled_event(events);
+      }
+      continue;
+    }
+
+    // idle: sleep to the next timer or underflow, if it is before the next request
+    if(!replay_timer_next(&due))
+    {
+      due = until;
+    }
+    if(record_app_periodic && ((int32_t)(due - record_app_uf) > 0))
+    {
+      due = record_app_uf;
+    }
+    if((int32_t)(due - until) >= 0)
+    {
+      return;
+    }
+    if((int32_t)(due - replay_hal.now) > 0)
+    {
+      replay_hal.now = due;
+    }
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  A sync transfer sleeps in EM1: the models answer, or a tick passes.
+ ******************************************************************************/
+void record_app_idle(void)
+{
+  uint32_t events = record.events;
+
+  model_run(0);
+  model_run(1);
+
+  if(record.events == events)
+  {
+    replay_hal.now++;
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Runs the application callback of the lowest posted event, as the main
+ *  loop does.
+ *
+ * @return
+ *  Returns false if no callback handles the event.
+ ******************************************************************************/
+bool record_app_dispatch(uint32_t events)
+{
+  static const struct
+  {
+    uint32_t cb;
+    void (*fn)(void);
+  }table[] =
+  {
+    { SHTC3_MEASUREMENT_CB,   scheduled_shtc3_measurement_cb },
+    { SHTC3_WAKEUP_CB,        scheduled_shtc3_wakeup_cb },
+    { SHTC3_SLEEP_CB,         scheduled_shtc3_sleep_cb },
+    { SI7021_READ_REG_CB,     scheduled_si7021_read_reg_cb },
+    { SI7021_WRITE_REG_CB,    scheduled_si7021_write_reg_cb },
+    { SI7021_TEMP_READ_CB,    scheduled_si7021_temp_read_cb },
+    { SI7021_HUM_READ_CB,     scheduled_si7021_hum_read_cb },
+    { LETIMER0_UF_CB,         scheduled_letimer0_uf_cb },
+    { CMU_CAL_CB,             scheduled_cmu_cal_cb },
+    { SI7021_SAMPLE_CB,       scheduled_si7021_sample_cb },
+    { SHTC3_SAMPLE_CB,        scheduled_shtc3_sample_cb },
+    { SHTC3_READ_REQ_CB,      scheduled_shtc3_read_req_cb },
+    { APP_MINUTE_CB,          scheduled_app_minute_cb },
+    { APP_HOUR_CB,            scheduled_app_hour_cb },
+    { SI7021_CHECK_REG_CB,    scheduled_si7021_check_reg_cb },
+    { SI7021_DEADLINE_CB,     scheduled_si7021_deadline_cb },
+    { SHTC3_DEADLINE_CB,      scheduled_shtc3_deadline_cb },
+  };
+  bool found = false;
+  uint32_t n;
+
+  // a bus reset from a callback waits for its MSTOP
+  replay_i2c[0].IF = I2C_IF_MSTOP;
+  replay_i2c[1].IF = I2C_IF_MSTOP;
+
+  for(n = 0; (n < sizeof(table) / sizeof(table[0])) && !found; n++)
+  {
+    if(events & table[n].cb)
+    {
+      table[n].fn();
+      found = true;
+    }
+  }
+
+  replay_i2c[0].IF = 0;
+  replay_i2c[1].IF = 0;
+
+  return found;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Prints the application's on-demand statistics.
+ ******************************************************************************/
+void record_app_report(void)
+{
+  static const char *const name[appSensors] = { "Si7021", "SHTC3" };
+  APP_SAMPLE_STATS_STRUCT stats;
+  uint32_t sensor;
+
+  for(sensor = 0; sensor < appSensors; sensor++)
+  {
+    app_sample_stats((APP_SENSOR_Typedef)sensor, &stats);
+    fprintf(stderr, "app: %-6s %u requests, %u cached, %u unavailable, %u converted, %u late, "
+                    "latency %u ms last, %u ms max\n",
+            name[sensor], stats.requests, stats.cached, stats.unavailable, stats.converted,
+            stats.late, stats.latency_last, stats.latency_max);
+#ifdef BENCH_CONV
+    fprintf(stderr, "app: %-6s %u periodic samples, %.0f ns mean, %u ns max\n",
+            name[sensor], stats.periodic,
+            stats.periodic ? ((double)stats.cycles / stats.periodic) : 0.0, stats.cycles_max);
+#endif
+  }
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Runs a submitted transaction to its callback.
+ ******************************************************************************/
+void record_finish(uint32_t bus, uint32_t cb)
+{
+  model_run(bus);
+
+  if(!(get_scheduled_events() & cb))
+  {
+    fprintf(stderr, "record: t=%u bus %u: transaction did not complete\n", replay_hal.now, bus);
+    replay_hal.asserts++;
+  }
+  remove_scheduled_event(cb);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Appends one trace event to the recording (replay_hal.sink).
+ ******************************************************************************/
+void record_event(TRACE_KIND_Typedef kind, int32_t arg)
+{
+  TRACE_BLOCK_STRUCT *block = &record.block;
+  uint32_t len;
+
+  if(((uint32_t)block->header.len + TRACE_EVENT_MAX) > TRACE_BLOCK_PAYLOAD)
+  {
+    record_block();
+  }
+
+  len = trace_event_encode(&block->payload[block->header.len], replay_hal.now - record.last, kind, true, arg);
+  block->header.crc = log_crc16(block->header.crc, &block->payload[block->header.len], len);
+  block->header.len += len;
+  record.last = replay_hal.now;
+  record.events++;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Writes out the block being filled and starts the next one.
+ ******************************************************************************/
+void record_block(void)
+{
+  uint32_t seq = record.block.header.seq + 1;
+
+  if(record.block.header.magic == TRACE_BLOCK_MAGIC)
+  {
+    if(fwrite(&record.block, sizeof(record.block), 1, record.file) != 1)
+    {
+      perror("record");
+      exit(1);
+    }
+    record.blocks++;
+  }
+
+  memset(&record.block, 0, sizeof(record.block));
+  record.block.header.magic = TRACE_BLOCK_MAGIC;
+  record.block.header.seq = seq;
+  record.block.header.t0 = replay_hal.now;
+  record.block.header.crc = LOG_CRC_INIT;
+  record.last = replay_hal.now;
+}
+
+
+#ifdef BENCH_ISR
+/******************************************************************************
+ ****************************** BENCH FUNCTIONS *******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Prints the handler timings of a BENCH_ISR build.
+ ******************************************************************************/
+void bench_report(void)
+{
+  static const char *const name[benchIsrs] = { "I2C0", "I2C1", "TIMER1", "LETIMER0", "CMU" };
+  BENCH_ISR_STRUCT stats;
+  uint32_t i;
+
+  for(i = 0; i < benchIsrs; i++)
+  {
+    bench_isr_get((BENCH_ISR_Typedef)i, &stats);
+    if(stats.count == 0)
+    {
+      continue;
+    }
+    fprintf(stderr, "bench: %-8s %u runs, %.1f ns mean, %u ns max\n",
+            name[i], stats.count, (double)stats.cycles / stats.count, stats.max);
+  }
+}
+#endif
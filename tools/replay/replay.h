@@ -0,0 +1,100 @@
+/***************************************************************************//**
+ * @file
+ *   replay.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Header file for the host bus-trace replay harness
+ *
+ * @details
+ *   State shared between the harness (replay.c) and the stand-ins for the
+ *   hardware and firmware services the drivers call (replay_hal.c): the
+ *   virtual clock, the bytes the driver put on each bus, and counters for
+ *   the checks the stand-ins make.
+ ******************************************************************************/
+
+#ifndef REPLAY_HG
+#define REPLAY_HG
+
+
+//***********************************************************************************
+// included files
+//***********************************************************************************
+// system included files
+#include <stdint.h>
+#include <stdbool.h>
+
+// developer included files
+#include "trace_format.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define REPLAY_BUSES          2                 // I2C0 and I2C1
+#define REPLAY_OUT_DEPTH      16                // driver outputs held between two bus events
+#define REPLAY_TIMERS         4                 // letimer_timer_start() timers (LETIMER_TIMERS)
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+/*! One START or data byte the driver put on a bus */
+typedef struct
+{
+    uint8_t                       kind;                   /// traceI2cStart or traceI2cTx
+    uint8_t                       byte;                   /// header or data byte
+}REPLAY_OUT_STRUCT;
+
+
+/*! Outputs of one bus not yet matched against the trace, oldest first */
+typedef struct
+{
+    REPLAY_OUT_STRUCT             out[REPLAY_OUT_DEPTH];  /// ring of outputs
+    uint32_t                      head;                   /// oldest output
+    uint32_t                      count;                  /// outputs held
+}REPLAY_OUT_QUEUE_STRUCT;
+
+
+/*! A low-energy one-shot timer of the application */
+typedef struct
+{
+    uint32_t                      cb;                     /// scheduler event to post (0 = free)
+    uint32_t                      due;                    /// virtual time it expires
+}REPLAY_TIMER_STRUCT;
+
+
+/*! Hardware and firmware stand-in state */
+typedef struct
+{
+    uint32_t                      now;                    /// virtual LETIMER ticks
+    uint64_t                      delay_ms;               /// time the driver spent in timer_delay()
+    int32_t                       em_blocks;              /// sleep_block_mode() calls not yet unblocked
+    uint32_t                      asserts;                /// failed EFM_ASSERTs
+    const char                   *assert_file;            /// location of the last failed EFM_ASSERT
+    int                           assert_line;
+    REPLAY_OUT_QUEUE_STRUCT       out[REPLAY_BUSES];      /// per bus driver outputs
+    void                        (*sink)(TRACE_KIND_Typedef kind, int32_t arg); /// every trace event, when recording
+    void                        (*idle)(void);           /// runs the buses while the driver sleeps in EM1 (NULL: time passes)
+    REPLAY_TIMER_STRUCT           timer[REPLAY_TIMERS];   /// running letimer_timer_start() timers
+}REPLAY_HAL_STRUCT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+extern REPLAY_HAL_STRUCT replay_hal;
+
+bool replay_out_pop(uint32_t bus, REPLAY_OUT_STRUCT *out);
+void replay_out_flush(uint32_t bus);
+uint32_t replay_timer_expire(void);
+bool replay_timer_next(uint32_t *due);
+
+#endif
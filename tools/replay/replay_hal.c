@@ -0,0 +1,508 @@
+/***************************************************************************//**
+ * @file
+ *   replay_hal.c
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Hardware and firmware stand-ins for the bus-trace replay harness
+ *
+ * @details
+ *   The driver sources (i2c.c, si7021.c, shtc3.c, ...) and app.c are
+ *   compiled unchanged against the em_*.h shims; this file supplies what
+ *   they link against instead of emlib, letimer.c, cmu.c, HW_delay.c,
+ *   sleep_routines.c, sample_log.c and trace.c:
+ *
+ *   - peripheral registers are plain memory; the harness raises I2C and
+ *     TIMER flags and calls the IRQ handlers itself
+ *   - letimer_uptime() is the virtual clock, set by the harness
+ *   - timer_delay() returns at once but advances the clock and adds up the
+ *     time the driver would have spun
+ *   - letimer_timer_start() timers are kept for the harness to expire
+ *     against the virtual clock; EM1 sleeps run the harness's idle hook
+ *   - the clocks, LETIMER PWM and the flash log are opened as no-ops
+ *   - sleep_block_mode()/sleep_unblock_mode() keep a balance the harness
+ *     checks
+ *   - trace_event() captures every START and TXDATA byte per bus, which is
+ *     what the driver put on the wire, and passes all events to a sink
+ *     when recording
+ *   - a failed EFM_ASSERT is counted and reported instead of halting
+ *   - BENCH_CYCLES() reads a host clock in ns, so a BENCH_ISR build times
+ *     the handlers, and a BENCH_CONV build the periodic sample path, in
+ *     host terms
+ *   - conv_bench() (target only) is a no-op that reports a match
+ ******************************************************************************/
+
+//***********************************************************************************
+// included header file
+//***********************************************************************************
+#define _POSIX_C_SOURCE 200809L
+#include <string.h>
+#include <time.h>
+
+#include "replay.h"
+#include "i2c.h"
+#include "cmu.h"
+#include "hotpath.h"
+#include "letimer.h"
+#include "sleep_routines.h"
+#include "sample_log.h"
+#include "scheduler.h"
+#include "convert.h"
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define REPLAY_HFPER_HZ       19000000          // HFPER after reset (HFRCO 19 MHz)
+#define REPLAY_LFA_HZ         LETIMER_HZ        // ULFRCO
+
+
+//***********************************************************************************
+// static/private data
+//***********************************************************************************
+REPLAY_HAL_STRUCT replay_hal;
+
+I2C_TypeDef replay_i2c[2];
+TIMER_TypeDef replay_timer[2];
+LETIMER_TypeDef replay_letimer;
+
+static DWT_Type replay_dwt;
+static CoreDebug_Type replay_core_debug;
+static SCB_Type replay_scb;
+static DEVINFO_TypeDef replay_devinfo = { 0x8D2F1C47, 0x000B57FF };
+static CMU_TypeDef replay_cmu;
+static MSC_TypeDef replay_msc;
+uint32_t replay_userdata[FLASH_PAGE_SIZE / 4];
+static GPIO_TypeDef replay_gpio;
+
+DWT_Type *DWT = &replay_dwt;
+CoreDebug_Type *CoreDebug = &replay_core_debug;
+SCB_Type *SCB = &replay_scb;
+DEVINFO_TypeDef *DEVINFO = &replay_devinfo;
+CMU_TypeDef *CMU = &replay_cmu;
+MSC_TypeDef *MSC = &replay_msc;
+GPIO_TypeDef *GPIO = &replay_gpio;
+
+
+//***********************************************************************************
+// static/private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function definitions
+//***********************************************************************************
+
+
+/******************************************************************************
+ ***************************** HARNESS FUNCTIONS ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Takes the oldest unmatched output of a bus.
+ *
+ * @return
+ *  Returns false if the driver has put nothing on the bus.
+ ******************************************************************************/
+bool replay_out_pop(uint32_t bus, REPLAY_OUT_STRUCT *out)
+{
+  REPLAY_OUT_QUEUE_STRUCT *queue = &replay_hal.out[bus];
+
+  if(queue->count == 0)
+  {
+    return false;
+  }
+
+  *out = queue->out[queue->head];
+  queue->head = (queue->head + 1) % REPLAY_OUT_DEPTH;
+  queue->count--;
+
+  return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Drops the unmatched outputs of a bus.
+ ******************************************************************************/
+void replay_out_flush(uint32_t bus)
+{
+  replay_hal.out[bus].count = 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Posts the callbacks of the timers that are due.
+ *
+ * @return
+ *  Returns the number of timers expired.
+ ******************************************************************************/
+uint32_t replay_timer_expire(void)
+{
+  REPLAY_TIMER_STRUCT *timer;
+  uint32_t expired = 0;
+  uint32_t n;
+
+  for(n = 0; n < REPLAY_TIMERS; n++)
+  {
+    timer = &replay_hal.timer[n];
+    if(timer->cb && ((int32_t)(replay_hal.now - timer->due) >= 0))
+    {
+      add_scheduled_event(timer->cb);
+      timer->cb = 0;
+      expired++;
+    }
+  }
+
+  return expired;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Finds the running timer that expires first.
+ *
+ * @return
+ *  Returns false if no timer is running.
+ ******************************************************************************/
+bool replay_timer_next(uint32_t *due)
+{
+  bool found = false;
+  uint32_t n;
+
+  for(n = 0; n < REPLAY_TIMERS; n++)
+  {
+    if(replay_hal.timer[n].cb &&
+       (!found || ((int32_t)(replay_hal.timer[n].due - *due) < 0)))
+    {
+      *due = replay_hal.timer[n].due;
+      found = true;
+    }
+  }
+
+  return found;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Counts a failed EFM_ASSERT.
+ ******************************************************************************/
+void replay_assert(const char *file, int line)
+{
+  replay_hal.asserts++;
+  replay_hal.assert_file = file;
+  replay_hal.assert_line = line;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Host stand-in for the DWT cycle counter.
+ *
+ * @return
+ *  Returns a monotonic host clock in ns (wraps like CYCCNT).
+ ******************************************************************************/
+uint32_t replay_cycles(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint32_t)(((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec);
+}
+
+
+/******************************************************************************
+ ***************************** FIRMWARE SERVICES ******************************
+ ******************************************************************************/
+
+
+/***************************************************************************//**
+ * @brief
+ *  Captures driver outputs and forwards events to the recording sink.
+ ******************************************************************************/
+void trace_event(TRACE_KIND_Typedef kind, int32_t arg)
+{
+  REPLAY_OUT_QUEUE_STRUCT *queue;
+  uint32_t bus = TRACE_I2C_BUS(arg);
+
+  if(((kind == traceI2cStart) || (kind == traceI2cTx)) && (bus < REPLAY_BUSES))
+  {
+    queue = &replay_hal.out[bus];
+
+    // an overflowing queue means the driver talks without the bus answering;
+    // keep the newest so the mismatch is reported where it happens
+    if(queue->count == REPLAY_OUT_DEPTH)
+    {
+      queue->head = (queue->head + 1) % REPLAY_OUT_DEPTH;
+      queue->count--;
+    }
+    queue->out[(queue->head + queue->count) % REPLAY_OUT_DEPTH].kind = (uint8_t)kind;
+    queue->out[(queue->head + queue->count) % REPLAY_OUT_DEPTH].byte = (uint8_t)TRACE_I2C_BYTE(arg);
+    queue->count++;
+  }
+
+  if(replay_hal.sink)
+  {
+    replay_hal.sink(kind, arg);
+  }
+}
+
+
+void trace_open(void)
+{
+}
+
+
+uint32_t letimer_uptime(void)
+{
+  return replay_hal.now;
+}
+
+
+uint32_t letimer_uptime_s(void)
+{
+  return replay_hal.now / LETIMER_HZ;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Busy-wait stand-in: time passes, nothing waits.
+ ******************************************************************************/
+void timer_delay(uint32_t ms_delay)
+{
+  replay_hal.delay_ms += ms_delay;
+  replay_hal.now += (ms_delay * LETIMER_HZ) / 1000;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  Starts, or restarts, a one-shot timer; the slack is not used.
+ ******************************************************************************/
+void letimer_timer_start(uint32_t cb, uint32_t delay_ms, uint32_t slack_ms)
+{
+  REPLAY_TIMER_STRUCT *free_timer = NULL;
+  uint32_t n;
+
+  (void)slack_ms;
+
+  for(n = 0; n < REPLAY_TIMERS; n++)
+  {
+    if(replay_hal.timer[n].cb == cb)
+    {
+      free_timer = &replay_hal.timer[n];
+      break;
+    }
+    if(!replay_hal.timer[n].cb && !free_timer)
+    {
+      free_timer = &replay_hal.timer[n];
+    }
+  }
+  EFM_ASSERT(free_timer);
+  if(!free_timer)
+  {
+    return;
+  }
+
+  free_timer->cb = cb;
+  free_timer->due = replay_hal.now + ((delay_ms * LETIMER_HZ) / 1000);
+}
+
+
+void letimer_timer_stop(uint32_t cb)
+{
+  uint32_t n;
+
+  for(n = 0; n < REPLAY_TIMERS; n++)
+  {
+    if(replay_hal.timer[n].cb == cb)
+    {
+      replay_hal.timer[n].cb = 0;
+    }
+  }
+}
+
+
+void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_letimer_struct)
+{
+  (void)letimer;
+  (void)app_letimer_struct;
+}
+
+
+void letimer_start(LETIMER_TypeDef *letimer, bool enable)
+{
+  (void)letimer;
+  (void)enable;
+}
+
+
+void letimer_calibrate(uint32_t clock_mhz)
+{
+  (void)clock_mhz;
+}
+
+
+void cmu_open(void)
+{
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *  The ULFRCO is taken as nominal: the measurement never completes.
+ ******************************************************************************/
+void cmu_ulfrco_cal_start(uint32_t cb)
+{
+  (void)cb;
+}
+
+
+uint32_t cmu_ulfrco_mhz(void)
+{
+  return 0;
+}
+
+
+void hotpath_open(void)
+{
+}
+
+
+void sleep_open(void)
+{
+}
+
+
+void sample_log_open(const LOG_DESC_STRUCT *desc)
+{
+  (void)desc;
+}
+
+
+uint32_t sample_log_time(void)
+{
+  return letimer_uptime_s();
+}
+
+
+void sample_log_append(const LOG_RECORD_STRUCT *rec)
+{
+  (void)rec;
+}
+
+
+void sample_log_close_page(void)
+{
+}
+
+
+void conv_bench(const CONV_COEF_STRUCT *coef, CONV_BENCH_STRUCT *result)
+{
+  (void)coef;
+  memset(result, 0, sizeof(*result));
+  result->match = true;
+}
+
+
+void sleep_block_mode(uint32_t EM)
+{
+  (void)EM;
+  replay_hal.em_blocks++;
+}
+
+
+void sleep_unblock_mode(uint32_t EM)
+{
+  (void)EM;
+  replay_hal.em_blocks--;
+  EFM_ASSERT(replay_hal.em_blocks >= 0);
+}
+
+
+/******************************************************************************
+ ********************************** EMLIB *************************************
+ ******************************************************************************/
+
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable)                      { (void)clock; (void)enable; }
+void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait)          { (void)osc; (void)enable; (void)wait; }
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref)        { (void)clock; (void)ref; }
+void CMU_CalibrateConfig(uint32_t down, CMU_Osc_TypeDef dsel, CMU_Osc_TypeDef usel) { (void)down; (void)dsel; (void)usel; }
+void CMU_CalibrateStart(void)                                                   { }
+void CMU_CalibrateStop(void)                                                    { }
+uint32_t CMU_CalibrateCountGet(void)                                            { return 0; }
+uint32_t CMU_Calibrate(uint32_t cycles, CMU_Osc_TypeDef ref)                    { (void)ref; return cycles; }
+
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock)
+{
+  return ((clock == cmuClock_LFA) || (clock == cmuClock_LETIMER0)) ? REPLAY_LFA_HZ : REPLAY_HFPER_HZ;
+}
+
+
+void I2C_Init(I2C_TypeDef *i2c, const I2C_Init_TypeDef *init)
+{
+  i2c->CTRL = init->enable ? I2C_CTRL_EN : 0;
+}
+
+
+void I2C_Reset(I2C_TypeDef *i2c)
+{
+  memset((void *)i2c, 0, sizeof(*i2c));
+}
+
+
+void TIMER_Init(TIMER_TypeDef *timer, const TIMER_Init_TypeDef *init)              { timer->CTRL = (uint32_t)init->prescale << _TIMER_CTRL_PRESC_SHIFT; }
+void TIMER_InitCC(TIMER_TypeDef *timer, unsigned int ch, const TIMER_InitCC_TypeDef *init) { timer->CC[ch].CTRL = init->mode; }
+void TIMER_Enable(TIMER_TypeDef *timer, bool enable)                               { timer->STATUS = enable ? TIMER_STATUS_RUNNING : 0; }
+void TIMER_CompareSet(TIMER_TypeDef *timer, unsigned int ch, uint32_t value)       { timer->CC[ch].CCV = value; }
+void TIMER_TopSet(TIMER_TypeDef *timer, uint32_t value)                            { timer->TOP = value; }
+uint32_t TIMER_CounterGet(TIMER_TypeDef *timer)                                    { return timer->CNT; }
+void TIMER_IntEnable(TIMER_TypeDef *timer, uint32_t flags)                         { timer->IEN |= flags; }
+void TIMER_IntDisable(TIMER_TypeDef *timer, uint32_t flags)                        { timer->IEN &= ~flags; }
+void TIMER_IntClear(TIMER_TypeDef *timer, uint32_t flags)                          { timer->IF &= ~flags; }
+uint32_t TIMER_IntGetEnabled(TIMER_TypeDef *timer)                                 { return timer->IF & timer->IEN; }
+
+void LETIMER_Init(LETIMER_TypeDef *letimer, const LETIMER_Init_TypeDef *init)      { (void)letimer; (void)init; }
+void LETIMER_CompareSet(LETIMER_TypeDef *letimer, unsigned int comp, uint32_t value) { (void)letimer; (void)comp; (void)value; }
+uint32_t LETIMER_CompareGet(LETIMER_TypeDef *letimer, unsigned int comp)           { (void)letimer; (void)comp; return 0; }
+void LETIMER_RepeatSet(LETIMER_TypeDef *letimer, unsigned int rep, uint32_t value) { (void)letimer; (void)rep; (void)value; }
+void LETIMER_Enable(LETIMER_TypeDef *letimer, bool enable)                         { (void)letimer; (void)enable; }
+uint32_t LETIMER_CounterGet(LETIMER_TypeDef *letimer)                              { (void)letimer; return 0; }
+
+void GPIO_DriveStrengthSet(GPIO_Port_TypeDef port, GPIO_DriveStrength_TypeDef strength) { (void)port; (void)strength; }
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out) { (void)port; (void)pin; (void)mode; (void)out; }
+void GPIO_PinOutSet(GPIO_Port_TypeDef port, unsigned int pin)                      { (void)port; (void)pin; }
+void GPIO_PinOutClear(GPIO_Port_TypeDef port, unsigned int pin)                    { (void)port; (void)pin; }
+
+/***************************************************************************//**
+ * @brief
+ *  A sync transfer's sleep: the harness answers the bus, or time passes.
+ ******************************************************************************/
+void EMU_EnterEM1(void)
+{
+  if(replay_hal.idle)
+  {
+    replay_hal.idle();
+  }
+  else
+  {
+    replay_hal.now++;
+  }
+}
+
+void EMU_EnterEM2(bool restore)                                                    { (void)restore; }
+void EMU_EnterEM3(bool restore)                                                    { (void)restore; }
+
+void MSC_Init(void)                                                                { }
+void MSC_Deinit(void)                                                              { }
+MSC_Status_TypeDef MSC_ErasePage(uint32_t *startAddress)                           { (void)startAddress; return mscReturnLocked; }
+MSC_Status_TypeDef MSC_WriteWord(uint32_t *address, void const *data, uint32_t numBytes) { (void)address; (void)data; (void)numBytes; return mscReturnLocked; }
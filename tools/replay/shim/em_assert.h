@@ -0,0 +1,11 @@
+/* Replay shim: a failed assert is a divergence, not a halt (replay_hal.c) */
+#ifndef EM_ASSERT_HG
+#define EM_ASSERT_HG
+
+#include "shim_common.h"
+
+void replay_assert(const char *file, int line);
+
+#define EFM_ASSERT(expr)      ((expr) ? (void)0 : replay_assert(__FILE__, __LINE__))
+
+#endif
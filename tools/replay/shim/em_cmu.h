@@ -0,0 +1,30 @@
+/* Replay shim: clock control; only frequencies matter to the driver */
+#ifndef EM_CMU_HG
+#define EM_CMU_HG
+
+#include "shim_common.h"
+
+#define CMU_IF_CALRDY         1u
+#define CMU_STATUS_CALRDY     1u
+
+typedef enum { cmuClock_HFPER, cmuClock_CORELE, cmuClock_LFA, cmuClock_LETIMER0, cmuClock_I2C0,
+               cmuClock_I2C1, cmuClock_TIMER0, cmuClock_TIMER1, cmuClock_GPIO, cmuClock_CORE,
+               cmuClock_HF } CMU_Clock_TypeDef;
+typedef enum { cmuOsc_LFRCO, cmuOsc_LFXO, cmuOsc_ULFRCO, cmuOsc_HFRCO, cmuOsc_HFXO } CMU_Osc_TypeDef;
+typedef enum { cmuSelect_ULFRCO, cmuSelect_LFRCO, cmuSelect_HFRCO } CMU_Select_TypeDef;
+typedef enum { cmuHFRCOFreq_32M0Hz = 32000000 } CMU_HFRCOFreq_TypeDef;
+
+typedef struct { volatile uint32_t CALCTRL, CALCNT, CMD, STATUS, IF, IFC, IEN; } CMU_TypeDef;
+extern CMU_TypeDef *CMU;
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable);
+void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait);
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref);
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock);
+void CMU_CalibrateConfig(uint32_t downCycles, CMU_Osc_TypeDef downSel, CMU_Osc_TypeDef upSel);
+void CMU_CalibrateStart(void);
+void CMU_CalibrateStop(void);
+uint32_t CMU_CalibrateCountGet(void);
+uint32_t CMU_Calibrate(uint32_t cycles, CMU_Osc_TypeDef ref);
+
+#endif
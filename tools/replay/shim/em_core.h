@@ -0,0 +1,21 @@
+/* Replay shim: critical sections are no-ops on the single threaded host */
+#ifndef EM_CORE_HG
+#define EM_CORE_HG
+
+#include "shim_common.h"
+
+typedef uint32_t CORE_irqState_t;
+
+#define CORE_DECLARE_IRQ_STATE            CORE_irqState_t irqState
+#define CORE_ENTER_CRITICAL()             (irqState = 0)
+#define CORE_EXIT_CRITICAL()              ((void)irqState)
+#define CORE_ENTER_ATOMIC()               (irqState = 0)
+#define CORE_EXIT_ATOMIC()                ((void)irqState)
+#define CORE_ATOMIC_BASE_PRIORITY_LEVEL   3
+#define CORE_ATOMIC_METHOD_BASEPRI        1
+#define CORE_ATOMIC_METHOD                CORE_ATOMIC_METHOD_BASEPRI
+#define CORE_NvicIRQPrioritySet(irq, prio)
+
+static inline bool CORE_IrqIsBlocked(IRQn_Type n) { (void)n; return false; }
+
+#endif
@@ -0,0 +1,7 @@
+/* Replay shim: device header (shim_common.h) */
+#ifndef EM_DEVICE_HG
+#define EM_DEVICE_HG
+
+#include "shim_common.h"
+
+#endif
@@ -0,0 +1,11 @@
+/* Replay shim: energy modes return at once */
+#ifndef EM_EMU_HG
+#define EM_EMU_HG
+
+#include "shim_common.h"
+
+void EMU_EnterEM1(void);
+void EMU_EnterEM2(bool restore);
+void EMU_EnterEM3(bool restore);
+
+#endif
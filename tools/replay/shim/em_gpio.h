@@ -0,0 +1,22 @@
+/* Replay shim: pins go nowhere */
+#ifndef EM_GPIO_HG
+#define EM_GPIO_HG
+
+#include "shim_common.h"
+
+#define _GPIO_IFC_RESETVALUE  0
+
+typedef enum { gpioPortA, gpioPortB, gpioPortC, gpioPortD, gpioPortE, gpioPortF } GPIO_Port_TypeDef;
+typedef enum { gpioModeDisabled, gpioModePushPull, gpioModeWiredAnd } GPIO_Mode_TypeDef;
+typedef enum { gpioDriveStrengthWeak, gpioDriveStrengthStrongAlternateStrong,
+               gpioDriveStrengthWeakAlternateWeak } GPIO_DriveStrength_TypeDef;
+
+typedef struct { volatile uint32_t IFC; } GPIO_TypeDef;
+extern GPIO_TypeDef *GPIO;
+
+void GPIO_DriveStrengthSet(GPIO_Port_TypeDef port, GPIO_DriveStrength_TypeDef strength);
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out);
+void GPIO_PinOutSet(GPIO_Port_TypeDef port, unsigned int pin);
+void GPIO_PinOutClear(GPIO_Port_TypeDef port, unsigned int pin);
+
+#endif
@@ -0,0 +1,78 @@
+/* Replay shim: I2C registers in host memory; writes to IFC/IFS do nothing,
+   the harness owns IF */
+#ifndef EM_I2C_HG
+#define EM_I2C_HG
+
+#include "shim_common.h"
+#include "em_cmu.h"
+
+#define I2C_FREQ_FAST_MAX             392157
+#define I2C_IF_START                  0x1u
+#define I2C_IF_RSTART                 0x2u
+#define I2C_IF_ADDR                   0x4u
+#define I2C_IF_TXC                    0x8u
+#define I2C_IF_TXBL                   0x10u
+#define I2C_IF_RXDATAV                0x20u
+#define I2C_IF_ACK                    0x40u
+#define I2C_IF_NACK                   0x80u
+#define I2C_IF_MSTOP                  0x100u
+#define I2C_IF_ARBLOST                0x200u
+#define I2C_IF_BUSERR                 0x400u
+#define I2C_IF_BUSHOLD                0x800u
+#define I2C_IF_CLTO                   0x10000u
+#define I2C_IF_BITO                   0x20000u
+#define I2C_IFS_START                 I2C_IF_START
+#define I2C_IFC_START                 I2C_IF_START
+#define I2C_IFC_MSTOP                 I2C_IF_MSTOP
+#define _I2C_IFC_MASK                 0x7FFCFu
+#define _I2C_IEN_RESETVALUE           0
+#define I2C_IEN_ARBLOST               I2C_IF_ARBLOST
+#define I2C_IEN_BUSERR                I2C_IF_BUSERR
+#define I2C_CMD_START                 0x1u
+#define I2C_CMD_STOP                  0x2u
+#define I2C_CMD_ACK                   0x4u
+#define I2C_CMD_NACK                  0x8u
+#define I2C_CMD_CONT                  0x10u
+#define I2C_CMD_ABORT                 0x20u
+#define I2C_CMD_CLEARTX               0x40u
+#define I2C_CMD_CLEARPC               0x80u
+#define I2C_STATE_BUSY                0x1u
+#define I2C_STATE_BUSHOLD             0x10u
+#define I2C_CTRL_EN                   1u
+#define _I2C_CTRL_BITO_MASK           0x3000u
+#define I2C_CTRL_BITO_160PCC          0x3000u
+#define I2C_CTRL_GIBITO               0x8000u
+#define I2C_ROUTELOC0_SDALOC_LOC6     6u
+#define I2C_ROUTELOC0_SCLLOC_LOC6     (6u << 8)
+#define I2C_ROUTELOC0_SDALOC_LOC15    15u
+#define I2C_ROUTELOC0_SCLLOC_LOC15    (15u << 8)
+#define I2C_ROUTELOC0_SDALOC_LOC19    19u
+#define I2C_ROUTELOC0_SCLLOC_LOC19    (19u << 8)
+#define I2C_ROUTEPEN_SDAPEN           1u
+#define I2C_ROUTEPEN_SCLPEN           2u
+
+typedef struct
+{
+  volatile uint32_t CTRL, CMD, STATE, STATUS, CLKDIV, SADDR, SADDRMASK, RXDATA, RXDOUBLE,
+                    RXDATAP, RXDOUBLEP, TXDATA, TXDOUBLE, IF, IFS, IFC, IEN, ROUTEPEN, ROUTELOC0;
+}I2C_TypeDef;
+
+typedef enum { i2cClockHLRStandard, i2cClockHLRAsymetric, i2cClockHLRFast } I2C_ClockHLR_TypeDef;
+
+typedef struct
+{
+  bool enable;
+  bool master;
+  uint32_t refFreq;
+  uint32_t freq;
+  I2C_ClockHLR_TypeDef clhr;
+}I2C_Init_TypeDef;
+
+extern I2C_TypeDef replay_i2c[2];
+#define I2C0                  (&replay_i2c[0])
+#define I2C1                  (&replay_i2c[1])
+
+void I2C_Init(I2C_TypeDef *i2c, const I2C_Init_TypeDef *init);
+void I2C_Reset(I2C_TypeDef *i2c);
+
+#endif
@@ -0,0 +1,45 @@
+/* Replay shim: LETIMER types only; uptime comes from the virtual clock */
+#ifndef EM_LETIMER_HG
+#define EM_LETIMER_HG
+
+#include "shim_common.h"
+
+#define LETIMER_CMD_START             1u
+#define LETIMER_STATUS_RUNNING        1u
+#define _LETIMER_IFC_RESETVALUE       0
+#define _LETIMER_IEN_UF_MASK          4u
+#define LETIMER_IF_COMP0              1u
+#define LETIMER_IF_COMP1              2u
+#define LETIMER_IF_UF                 4u
+#define LETIMER_IEN_COMP1             LETIMER_IF_COMP1
+#define LETIMER_IFC_COMP1             LETIMER_IF_COMP1
+
+typedef struct
+{
+  volatile uint32_t CTRL, CMD, STATUS, CNT, COMP0, COMP1, REP0, REP1, IF, IFS, IFC, IEN,
+                    SYNCBUSY, ROUTEPEN, ROUTELOC0;
+}LETIMER_TypeDef;
+
+typedef enum { letimerRepeatFree } LETIMER_RepeatMode_TypeDef;
+typedef enum { letimerUFOANone, letimerUFOAPwm } LETIMER_UFOA_TypeDef;
+
+typedef struct
+{
+  bool enable, debugRun, comp0Top, bufTop;
+  uint8_t out0Pol, out1Pol;
+  LETIMER_UFOA_TypeDef ufoa0, ufoa1;
+  LETIMER_RepeatMode_TypeDef repMode;
+  uint32_t topValue;
+}LETIMER_Init_TypeDef;
+
+extern LETIMER_TypeDef replay_letimer;
+#define LETIMER0              (&replay_letimer)
+
+void LETIMER_Init(LETIMER_TypeDef *letimer, const LETIMER_Init_TypeDef *init);
+void LETIMER_CompareSet(LETIMER_TypeDef *letimer, unsigned int comp, uint32_t value);
+uint32_t LETIMER_CompareGet(LETIMER_TypeDef *letimer, unsigned int comp);
+void LETIMER_RepeatSet(LETIMER_TypeDef *letimer, unsigned int rep, uint32_t value);
+void LETIMER_Enable(LETIMER_TypeDef *letimer, bool enable);
+uint32_t LETIMER_CounterGet(LETIMER_TypeDef *letimer);
+
+#endif
@@ -0,0 +1,33 @@
+/* Replay shim: flash writes are refused; nothing the harness runs stores.
+   The user data page is a blank page in RAM, so no calibration is found */
+#ifndef EM_MSC_HG
+#define EM_MSC_HG
+
+#include "shim_common.h"
+
+#define FLASH_PAGE_SIZE           2048u
+#define FLASH_BASE                0x0u
+#define FLASH_SIZE                0x100000u
+#define USERDATA_BASE             ((uintptr_t)replay_userdata)
+#define MSC_READCTRL_IFCDIS       0x8u
+#define MSC_READCTRL_AIDIS        0x10u
+#define MSC_READCTRL_ICCDIS       0x20u
+#define MSC_READCTRL_PREFETCH     0x100u
+#define MSC_READCTRL_USEHPROT     0x200u
+#define MSC_CACHECMD_INVCACHE     1u
+#define MSC_CACHECMD_STARTPC      2u
+#define MSC_CACHECMD_STOPPC       4u
+
+typedef enum { mscReturnOk = 0, mscReturnInvalidAddr = -1, mscReturnLocked = -2,
+               mscReturnTimeOut = -3, mscReturnUnaligned = -4 } MSC_Status_TypeDef;
+
+typedef struct { volatile uint32_t READCTRL, CACHECMD, CACHEHITS, CACHEMISSES; } MSC_TypeDef;
+extern MSC_TypeDef *MSC;
+extern uint32_t replay_userdata[FLASH_PAGE_SIZE / 4];
+
+void MSC_Init(void);
+void MSC_Deinit(void);
+MSC_Status_TypeDef MSC_ErasePage(uint32_t *startAddress);
+MSC_Status_TypeDef MSC_WriteWord(uint32_t *address, void const *data, uint32_t numBytes);
+
+#endif
@@ -0,0 +1,7 @@
+/* Replay shim: PRS is only routed by cmu.c, which the harness does not build */
+#ifndef EM_PRS_HG
+#define EM_PRS_HG
+
+#include "shim_common.h"
+
+#endif
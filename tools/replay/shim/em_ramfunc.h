@@ -0,0 +1,7 @@
+/* Replay shim: RAM functions run from wherever the host put them */
+#ifndef EM_RAMFUNC_HG
+#define EM_RAMFUNC_HG
+
+#include "shim_common.h"
+
+#endif
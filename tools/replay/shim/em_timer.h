@@ -0,0 +1,66 @@
+/* Replay shim: TIMER registers in host memory; the harness fires compare
+   channels by raising IF and calling the IRQ handler */
+#ifndef EM_TIMER_HG
+#define EM_TIMER_HG
+
+#include "shim_common.h"
+
+#define TIMER_IF_OF                   1u
+#define TIMER_IF_CC0                  0x10u
+#define TIMER_IF_CC1                  0x20u
+#define TIMER_IF_CC2                  0x40u
+#define TIMER_IEN_CC0                 TIMER_IF_CC0
+#define TIMER_IEN_CC1                 TIMER_IF_CC1
+#define TIMER_IEN_CC2                 TIMER_IF_CC2
+#define TIMER_STATUS_RUNNING          1u
+#define _TIMER_CTRL_PRESC_SHIFT       24
+
+typedef struct
+{
+  volatile uint32_t CTRL, CMD, STATUS, IF, IFS, IFC, IEN, TOP, TOPB, CNT;
+  struct { volatile uint32_t CTRL, CCV, CCVP, CCVB; } CC[4];
+  volatile uint32_t ROUTEPEN, ROUTELOC0;
+}TIMER_TypeDef;
+
+typedef enum { timerModeUp, timerModeDown } TIMER_Mode_TypeDef;
+typedef enum { timerPrescale1, timerPrescale64 = 6, timerPrescale1024 = 10 } TIMER_Prescale_TypeDef;
+typedef enum { timerCCModeOff, timerCCModeCapture, timerCCModeCompare } TIMER_CCMode_TypeDef;
+
+typedef struct
+{
+  bool enable, debugRun;
+  TIMER_Prescale_TypeDef prescale;
+  int clkSel;
+  bool count2x, ati;
+  int fallAction, riseAction;
+  TIMER_Mode_TypeDef mode;
+  bool dmaClrAct, quadModeX4, oneShot, sync;
+}TIMER_Init_TypeDef;
+
+typedef struct
+{
+  int eventCtrl, edge, prsSel, cufoa, cofoa, cmoa;
+  TIMER_CCMode_TypeDef mode;
+  bool filter, prsInput, coist, outInvert;
+}TIMER_InitCC_TypeDef;
+
+#define TIMER_INIT_DEFAULT    { true, false, timerPrescale1, 0, false, false, 0, 0, timerModeUp, \
+                                false, false, false, false }
+#define TIMER_INITCC_DEFAULT  { 0, 0, 0, 0, 0, 0, timerCCModeOff, false, false, false, false }
+
+extern TIMER_TypeDef replay_timer[2];
+#define TIMER0                (&replay_timer[0])
+#define TIMER1                (&replay_timer[1])
+
+void TIMER_Init(TIMER_TypeDef *timer, const TIMER_Init_TypeDef *init);
+void TIMER_InitCC(TIMER_TypeDef *timer, unsigned int ch, const TIMER_InitCC_TypeDef *init);
+void TIMER_Enable(TIMER_TypeDef *timer, bool enable);
+void TIMER_CompareSet(TIMER_TypeDef *timer, unsigned int ch, uint32_t value);
+void TIMER_TopSet(TIMER_TypeDef *timer, uint32_t value);
+uint32_t TIMER_CounterGet(TIMER_TypeDef *timer);
+void TIMER_IntEnable(TIMER_TypeDef *timer, uint32_t flags);
+void TIMER_IntDisable(TIMER_TypeDef *timer, uint32_t flags);
+void TIMER_IntClear(TIMER_TypeDef *timer, uint32_t flags);
+uint32_t TIMER_IntGetEnabled(TIMER_TypeDef *timer);
+
+#endif
@@ -0,0 +1,94 @@
+/***************************************************************************//**
+ * @file
+ *   shim_common.h
+ * @author
+ *   Frank McDermott
+ * @date
+ *   11/29/2022
+ * @brief
+ *   Core and CMSIS stand-ins shared by the replay harness's em_*.h shims
+ *
+ * @details
+ *   Just enough of the device headers for the driver sources to compile on
+ *   a host. Peripherals are plain structs in host memory (replay_hal.c) so
+ *   the harness can read what the driver wrote and raise flags itself.
+ *   Interrupt masking is a no-op: the harness is single threaded and calls
+ *   the IRQ handlers directly.
+ ******************************************************************************/
+
+#ifndef SHIM_COMMON_HG
+#define SHIM_COMMON_HG
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+//***********************************************************************************
+// defined macros
+//***********************************************************************************
+#define __IOM                 volatile
+#define __IM                  volatile const
+#define __OM                  volatile
+#define __STATIC_INLINE       static inline
+#define __NOP()               do {} while(0)
+#define __WFI()               do {} while(0)
+#define __DSB()               do {} while(0)
+#define __DMB()               __asm__ volatile("" ::: "memory")
+#define __ISB()               do {} while(0)
+#define __NVIC_PRIO_BITS      3
+
+#define SL_RAMFUNC_DECLARATOR
+#define SL_RAMFUNC_DEFINITION_BEGIN
+#define SL_RAMFUNC_DEFINITION_END
+
+#define DWT_CTRL_CYCCNTENA_Msk        1u
+#define BENCH_CYCLES()                replay_cycles()     // host clock (ns) in place of the DWT
+#define CoreDebug_DEMCR_TRCENA_Msk    (1u << 24)
+#define SCB_SCR_SLEEPDEEP_Msk         4u
+
+
+//***********************************************************************************
+// enums
+//***********************************************************************************
+typedef enum
+{
+  TIMER0_IRQn       = 10,
+  TIMER1_IRQn       = 18,
+  I2C0_IRQn         = 17,
+  LETIMER0_IRQn     = 26,
+  GPIO_EVEN_IRQn    = 9,
+  I2C1_IRQn         = 42
+}IRQn_Type;
+
+
+//***********************************************************************************
+// structs
+//***********************************************************************************
+typedef struct { volatile uint32_t CTRL, CYCCNT; } DWT_Type;
+typedef struct { volatile uint32_t DEMCR; } CoreDebug_Type;
+typedef struct { volatile uint32_t SCR, VTOR; } SCB_Type;
+typedef struct { volatile uint32_t UNIQUEL, UNIQUEH; } DEVINFO_TypeDef;
+
+extern DWT_Type *DWT;
+extern CoreDebug_Type *CoreDebug;
+extern SCB_Type *SCB;
+extern DEVINFO_TypeDef *DEVINFO;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+uint32_t replay_cycles(void);
+static inline void NVIC_EnableIRQ(IRQn_Type n)                   { (void)n; }
+static inline void NVIC_DisableIRQ(IRQn_Type n)                  { (void)n; }
+static inline void NVIC_ClearPendingIRQ(IRQn_Type n)             { (void)n; }
+static inline void NVIC_SetPriority(IRQn_Type n, uint32_t p)     { (void)n; (void)p; }
+static inline uint32_t __get_BASEPRI(void)                       { return 0; }
+static inline void __set_BASEPRI(uint32_t v)                     { (void)v; }
+static inline void __set_BASEPRI_MAX(uint32_t v)                 { (void)v; }
+static inline uint32_t __get_PRIMASK(void)                       { return 0; }
+static inline void __disable_irq(void)                           { }
+static inline void __enable_irq(void)                            { }
+
+#endif